@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+#include <depth_image_proc/depth_conversions.h>
+#include <depth_image_proc/depth_registration.h>
+#include <sensor_msgs/image_encodings.h>
+
+using namespace depth_image_proc;
+
+// Arguments are (width, height) at VGA, 1080p and 4K
+static void sizeArgs(benchmark::internal::Benchmark* b)
+{
+  b->Args({640, 480})->Args({1920, 1080})->Args({3840, 2160});
+}
+
+static image_geometry::PinholeCameraModel makeModel(int width, int height)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = width;
+  info.height = height;
+  double f = 0.8 * width;
+  double K[] = {f, 0, width / 2.0, 0, f, height / 2.0, 0, 0, 1};
+  std::copy(K, K + 9, info.K.begin());
+  double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(R, R + 9, info.R.begin());
+  double P[] = {f, 0, width / 2.0, 0, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, info.P.begin());
+
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+  return model;
+}
+
+// Slanted plane from 0.5 to 4 m, with every 17th pixel missing
+template<typename T>
+static sensor_msgs::ImagePtr makeDepth(int width, int height)
+{
+  sensor_msgs::ImagePtr depth(new sensor_msgs::Image);
+  depth->encoding = sizeof(T) == 2 ? sensor_msgs::image_encodings::TYPE_16UC1
+                                   : sensor_msgs::image_encodings::TYPE_32FC1;
+  depth->width = width;
+  depth->height = height;
+  depth->step = width * sizeof(T);
+  depth->data.resize(depth->step * height);
+  T* data = reinterpret_cast<T*>(&depth->data[0]);
+  for (int i = 0; i < width * height; ++i)
+  {
+    float meters = 0.5f + 3.5f * (i % width) / width;
+    data[i] = i % 17 == 0 ? std::numeric_limits<T>::quiet_NaN() : DepthTraits<T>::fromMeters(meters);
+  }
+  return depth;
+}
+
+template<typename T>
+static void BM_Convert(benchmark::State& state)
+{
+  int width = state.range(0), height = state.range(1);
+  image_geometry::PinholeCameraModel model = makeModel(width, height);
+  sensor_msgs::ImagePtr depth = makeDepth<T>(width, height);
+
+  PointCloud::Ptr cloud(new PointCloud);
+  cloud->height = height;
+  cloud->width = width;
+  sensor_msgs::PointCloud2Modifier modifier(*cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  while (state.KeepRunning())
+    convert<T>(depth, cloud, model);
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK_TEMPLATE(BM_Convert, uint16_t)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Convert, float)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+// RGB camera 2.5 cm to the side of the depth camera, at the same resolution
+template<typename T>
+static void BM_RegisterDepth(benchmark::State& state)
+{
+  int width = state.range(0), height = state.range(1);
+  image_geometry::PinholeCameraModel model = makeModel(width, height);
+  sensor_msgs::ImagePtr depth = makeDepth<T>(width, height);
+  Eigen::Affine3d depth_to_rgb(Eigen::Translation3d(-0.025, 0.0, 0.0));
+
+  while (state.KeepRunning())
+  {
+    // A fresh message per frame, as the nodelet does
+    sensor_msgs::ImagePtr registered(new sensor_msgs::Image);
+    registered->width = width;
+    registered->height = height;
+    registerDepth<T>(depth, registered, model, model, depth_to_rgb);
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK_TEMPLATE(BM_RegisterDepth, uint16_t)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RegisterDepth, float)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
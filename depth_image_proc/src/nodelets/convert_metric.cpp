@@ -36,6 +36,7 @@
 #include <image_transport/image_transport.h>
 #include <sensor_msgs/image_encodings.h>
 #include <boost/thread.hpp>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -51,6 +52,8 @@ class ConvertMetricNodelet : public nodelet::Nodelet
   boost::mutex connect_mutex_;
   image_transport::Publisher pub_depth_;
 
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
   virtual void onInit();
 
   void connectCb();
@@ -61,6 +64,7 @@ class ConvertMetricNodelet : public nodelet::Nodelet
 void ConvertMetricNodelet::onInit()
 {
   ros::NodeHandle& nh = getNodeHandle();
+  monitor_ = image_proc::LatencyMonitor::create(nh, getPrivateNodeHandle(), getName());
   it_.reset(new image_transport::ImageTransport(nh));
 
   // Monitor whether anyone is subscribed to the output
@@ -87,6 +91,8 @@ void ConvertMetricNodelet::connectCb()
 
 void ConvertMetricNodelet::depthCb(const sensor_msgs::ImageConstPtr& raw_msg)
 {
+  image_proc::LatencyMonitor::Scope scope(monitor_.get(), raw_msg->header);
+
   if (raw_msg->encoding != enc::TYPE_16UC1)
   {
     NODELET_ERROR_THROTTLE(2, "Expected data of type [%s], got [%s]", enc::TYPE_16UC1.c_str(),
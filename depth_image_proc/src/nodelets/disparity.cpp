@@ -45,6 +45,7 @@
 #include <sensor_msgs/image_encodings.h>
 #include <stereo_msgs/DisparityImage.h>
 #include <depth_image_proc/depth_traits.h>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -65,6 +66,8 @@ class DisparityNodelet : public nodelet::Nodelet
   double max_range_;
   double delta_d_;
 
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
   virtual void onInit();
 
   void connectCb();
@@ -81,6 +84,7 @@ void DisparityNodelet::onInit()
 {
   ros::NodeHandle &nh         = getNodeHandle();
   ros::NodeHandle &private_nh = getPrivateNodeHandle();
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
   ros::NodeHandle left_nh(nh, "left");
   left_it_.reset(new image_transport::ImageTransport(left_nh));
   right_nh_.reset( new ros::NodeHandle(nh, "right") );
@@ -123,6 +127,8 @@ void DisparityNodelet::connectCb()
 void DisparityNodelet::depthCb(const sensor_msgs::ImageConstPtr& depth_msg,
                                const sensor_msgs::CameraInfoConstPtr& info_msg)
 {
+  image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_msg->header);
+
   // Allocate new DisparityImage message
   stereo_msgs::DisparityImagePtr disp_msg( new stereo_msgs::DisparityImage );
   disp_msg->header         = depth_msg->header;
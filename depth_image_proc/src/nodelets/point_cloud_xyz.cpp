@@ -40,6 +40,7 @@
 #include <depth_image_proc/depth_conversions.h>
 
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -59,6 +60,8 @@ class PointCloudXyzNodelet : public nodelet::Nodelet
 
   image_geometry::PinholeCameraModel model_;
 
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
   virtual void onInit();
 
   void connectCb();
@@ -71,6 +74,7 @@ void PointCloudXyzNodelet::onInit()
 {
   ros::NodeHandle& nh         = getNodeHandle();
   ros::NodeHandle& private_nh = getPrivateNodeHandle();
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
   it_.reset(new image_transport::ImageTransport(nh));
 
   // Read parameters
@@ -101,6 +105,8 @@ void PointCloudXyzNodelet::connectCb()
 void PointCloudXyzNodelet::depthCb(const sensor_msgs::ImageConstPtr& depth_msg,
                                    const sensor_msgs::CameraInfoConstPtr& info_msg)
 {
+  image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_msg->header);
+
   PointCloud::Ptr cloud_msg(new PointCloud);
   cloud_msg->header = depth_msg->header;
   cloud_msg->height = depth_msg->height;
@@ -40,6 +40,7 @@
 #include <depth_image_proc/depth_traits.h>
 
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -66,6 +67,8 @@ namespace depth_image_proc {
 
 	cv::Mat binned;
   
+	boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
 	virtual void onInit();
 
 	void connectCb();
@@ -124,6 +127,7 @@ namespace depth_image_proc {
     {
 	ros::NodeHandle& nh         = getNodeHandle();
 	ros::NodeHandle& private_nh = getPrivateNodeHandle();
+	monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
 	it_.reset(new image_transport::ImageTransport(nh));
 
 	// Read parameters
@@ -158,6 +162,8 @@ namespace depth_image_proc {
     void PointCloudXyzRadialNodelet::depthCb(const sensor_msgs::ImageConstPtr& depth_msg,
 					     const sensor_msgs::CameraInfoConstPtr& info_msg)
     {
+	image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_msg->header);
+
 	PointCloud::Ptr cloud_msg(new PointCloud);
 	cloud_msg->header = depth_msg->header;
 	cloud_msg->height = depth_msg->height;
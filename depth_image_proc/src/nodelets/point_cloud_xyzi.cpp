@@ -50,6 +50,7 @@
 #include <depth_image_proc/depth_traits.h>
 #include <cv_bridge/cv_bridge.h>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -75,6 +76,8 @@ class PointCloudXyziNodelet : public nodelet::Nodelet
 
   image_geometry::PinholeCameraModel model_;
 
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
   virtual void onInit();
 
   void connectCb();
@@ -93,6 +96,7 @@ void PointCloudXyziNodelet::onInit()
 {
   ros::NodeHandle& nh         = getNodeHandle();
   ros::NodeHandle& private_nh = getPrivateNodeHandle();
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
   intensity_nh_.reset( new ros::NodeHandle(nh, "intensity") );
   ros::NodeHandle depth_nh(nh, "depth");
   intensity_it_  .reset( new image_transport::ImageTransport(*intensity_nh_) );
@@ -144,6 +148,8 @@ void PointCloudXyziNodelet::imageCb(const sensor_msgs::ImageConstPtr& depth_msg,
                                       const sensor_msgs::ImageConstPtr& intensity_msg_in,
                                       const sensor_msgs::CameraInfoConstPtr& info_msg)
 {
+  image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_msg->header);
+
   // Check for bad inputs
   if (depth_msg->header.frame_id != intensity_msg_in->header.frame_id)
   {
@@ -44,6 +44,7 @@
 #include <depth_image_proc/depth_traits.h>
 
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -79,6 +80,8 @@ namespace depth_image_proc {
 
 	cv::Mat transform_;
   
+	boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
 	virtual void onInit();
 
 	void connectCb();
@@ -144,6 +147,7 @@ namespace depth_image_proc {
     {
 	ros::NodeHandle& nh         = getNodeHandle();
 	ros::NodeHandle& private_nh = getPrivateNodeHandle();
+	monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
 
 	intensity_nh_.reset( new ros::NodeHandle(nh, "intensity") );
 	ros::NodeHandle depth_nh(nh, "depth");
@@ -197,6 +201,8 @@ namespace depth_image_proc {
 					      const sensor_msgs::ImageConstPtr& intensity_msg,
 					      const sensor_msgs::CameraInfoConstPtr& info_msg)
     {
+	image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_msg->header);
+
 	PointCloud::Ptr cloud_msg(new PointCloud);
 	cloud_msg->header = depth_msg->header;
 	cloud_msg->height = depth_msg->height;
@@ -50,6 +50,7 @@
 #include <depth_image_proc/depth_traits.h>
 #include <cv_bridge/cv_bridge.h>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -75,6 +76,8 @@ class PointCloudXyzrgbNodelet : public nodelet::Nodelet
 
   image_geometry::PinholeCameraModel model_;
 
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+
   virtual void onInit();
 
   void connectCb();
@@ -94,6 +97,7 @@ void PointCloudXyzrgbNodelet::onInit()
 {
   ros::NodeHandle& nh         = getNodeHandle();
   ros::NodeHandle& private_nh = getPrivateNodeHandle();
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
   rgb_nh_.reset( new ros::NodeHandle(nh, "rgb") );
   ros::NodeHandle depth_nh(nh, "depth_registered");
   rgb_it_  .reset( new image_transport::ImageTransport(*rgb_nh_) );
@@ -145,6 +149,8 @@ void PointCloudXyzrgbNodelet::imageCb(const sensor_msgs::ImageConstPtr& depth_ms
                                       const sensor_msgs::ImageConstPtr& rgb_msg_in,
                                       const sensor_msgs::CameraInfoConstPtr& info_msg)
 {
+  image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_msg->header);
+
   // Check for bad inputs
   if (depth_msg->header.frame_id != rgb_msg_in->header.frame_id)
   {
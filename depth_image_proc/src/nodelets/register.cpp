@@ -42,9 +42,12 @@
 #include <tf2_ros/transform_listener.h>
 #include <sensor_msgs/image_encodings.h>
 #include <image_geometry/pinhole_camera_model.h>
+#include <boost/make_shared.hpp>
 #include <Eigen/Geometry>
 #include <eigen_conversions/eigen_msg.h>
-#include <depth_image_proc/depth_traits.h>
+#include <depth_image_proc/depth_registration.h>
+#include <image_proc/batch_scheduler.h>
+#include <image_proc/latency_monitor.h>
 
 namespace depth_image_proc {
 
@@ -69,7 +72,24 @@ class RegisterNodelet : public nodelet::Nodelet
   boost::mutex connect_mutex_;
   image_transport::CameraPublisher pub_registered_;
 
-  image_geometry::PinholeCameraModel depth_model_, rgb_model_;
+  // Processing state, one per frame in flight
+  struct Worker
+  {
+    image_geometry::PinholeCameraModel depth_model, rgb_model;
+  };
+  std::vector< boost::shared_ptr<Worker> > workers_;
+
+  // Registered depth image and camera info, left empty if the frame failed
+  struct Output
+  {
+    sensor_msgs::ImagePtr image;
+    sensor_msgs::CameraInfoPtr info;
+  };
+  typedef boost::shared_ptr<Output> OutputPtr;
+
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+  // Processes frames concurrently and publishes them in order, if ~concurrent_frames > 1
+  boost::shared_ptr<image_proc::BatchScheduler> scheduler_;
 
   virtual void onInit();
 
@@ -79,16 +99,21 @@ class RegisterNodelet : public nodelet::Nodelet
                const sensor_msgs::CameraInfoConstPtr& depth_info_msg,
                const sensor_msgs::CameraInfoConstPtr& rgb_info_msg);
 
-  template<typename T>
-  void convert(const sensor_msgs::ImageConstPtr& depth_msg,
-               const sensor_msgs::ImagePtr& registered_msg,
-               const Eigen::Affine3d& depth_to_rgb);
+  void process(int worker_index,
+               const sensor_msgs::ImageConstPtr& depth_image_msg,
+               const sensor_msgs::CameraInfoConstPtr& depth_info_msg,
+               const sensor_msgs::CameraInfoConstPtr& rgb_info_msg,
+               const OutputPtr& output);
+
+  void publish(const OutputPtr& output, image_proc::LatencyMonitor::Clock::time_point start,
+               const ros::Time& stamp);
 };
 
 void RegisterNodelet::onInit()
 {
   ros::NodeHandle& nh         = getNodeHandle();
   ros::NodeHandle& private_nh = getPrivateNodeHandle();
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
   nh_depth_.reset( new ros::NodeHandle(nh, "depth") );
   nh_rgb_.reset( new ros::NodeHandle(nh, "rgb") );
   it_depth_.reset( new image_transport::ImageTransport(*nh_depth_) );
@@ -98,6 +123,13 @@ void RegisterNodelet::onInit()
   // Read parameters
   int queue_size;
   private_nh.param("queue_size", queue_size, 5);
+  // Optionally register several frames at once, for when one takes longer than the frame period
+  int concurrent_frames;
+  private_nh.param("concurrent_frames", concurrent_frames, 1);
+  for (int i = 0; i < std::max(concurrent_frames, 1); ++i)
+    workers_.push_back(boost::make_shared<Worker>());
+  if (concurrent_frames > 1)
+    scheduler_.reset(new image_proc::BatchScheduler(concurrent_frames, concurrent_frames));
 
   // Synchronize inputs. Topic subscriptions happen on demand in the connection callback.
   sync_.reset( new Synchronizer(SyncPolicy(queue_size), sub_depth_image_, sub_depth_info_, sub_rgb_info_) );
@@ -137,9 +169,36 @@ void RegisterNodelet::imageCb(const sensor_msgs::ImageConstPtr& depth_image_msg,
                               const sensor_msgs::CameraInfoConstPtr& depth_info_msg,
                               const sensor_msgs::CameraInfoConstPtr& rgb_info_msg)
 {
+  OutputPtr output = boost::make_shared<Output>();
+  if (!scheduler_)
+  {
+    image_proc::LatencyMonitor::Scope scope(monitor_.get(), depth_image_msg->header);
+    process(0, depth_image_msg, depth_info_msg, rgb_info_msg, output);
+    if (output->image)
+      pub_registered_.publish(output->image, output->info);
+    return;
+  }
+
+  // Frames are published in the order they arrive here, which blocks while all workers are busy
+  image_proc::LatencyMonitor::Clock::time_point start;
+  if (monitor_)
+    start = monitor_->begin(depth_image_msg->header);
+  scheduler_->submit(boost::bind(&RegisterNodelet::process, this, _1,
+                                 depth_image_msg, depth_info_msg, rgb_info_msg, output),
+                     boost::bind(&RegisterNodelet::publish, this, output, start, depth_image_msg->header.stamp));
+}
+
+void RegisterNodelet::process(int worker_index,
+                              const sensor_msgs::ImageConstPtr& depth_image_msg,
+                              const sensor_msgs::CameraInfoConstPtr& depth_info_msg,
+                              const sensor_msgs::CameraInfoConstPtr& rgb_info_msg,
+                              const OutputPtr& output)
+{
+  Worker& worker = *workers_[worker_index];
+
   // Update camera models - these take binning & ROI into account
-  depth_model_.fromCameraInfo(depth_info_msg);
-  rgb_model_  .fromCameraInfo(rgb_info_msg);
+  worker.depth_model.fromCameraInfo(depth_info_msg);
+  worker.rgb_model  .fromCameraInfo(rgb_info_msg);
 
   // Query tf2 for transform from (X,Y,Z) in depth camera frame to RGB camera frame
   Eigen::Affine3d depth_to_rgb;
@@ -165,18 +224,18 @@ void RegisterNodelet::imageCb(const sensor_msgs::ImageConstPtr& depth_image_msg,
   registered_msg->header.frame_id = rgb_info_msg->header.frame_id;
   registered_msg->encoding        = depth_image_msg->encoding;
   
-  cv::Size resolution = rgb_model_.reducedResolution();
+  cv::Size resolution = worker.rgb_model.reducedResolution();
   registered_msg->height = resolution.height;
   registered_msg->width  = resolution.width;
-  // step and data set in convert(), depend on depth data type
+  // step and data set in registerDepth(), depend on depth data type
 
   if (depth_image_msg->encoding == enc::TYPE_16UC1)
   {
-    convert<uint16_t>(depth_image_msg, registered_msg, depth_to_rgb);
+    registerDepth<uint16_t>(depth_image_msg, registered_msg, worker.depth_model, worker.rgb_model, depth_to_rgb);
   }
   else if (depth_image_msg->encoding == enc::TYPE_32FC1)
   {
-    convert<float>(depth_image_msg, registered_msg, depth_to_rgb);
+    registerDepth<float>(depth_image_msg, registered_msg, worker.depth_model, worker.rgb_model, depth_to_rgb);
   }
   else
   {
@@ -188,72 +247,17 @@ void RegisterNodelet::imageCb(const sensor_msgs::ImageConstPtr& depth_image_msg,
   sensor_msgs::CameraInfoPtr registered_info_msg( new sensor_msgs::CameraInfo(*rgb_info_msg) );
   registered_info_msg->header.stamp = registered_msg->header.stamp;
 
-  pub_registered_.publish(registered_msg, registered_info_msg);
+  output->image = registered_msg;
+  output->info = registered_info_msg;
 }
 
-template<typename T>
-void RegisterNodelet::convert(const sensor_msgs::ImageConstPtr& depth_msg,
-                              const sensor_msgs::ImagePtr& registered_msg,
-                              const Eigen::Affine3d& depth_to_rgb)
+void RegisterNodelet::publish(const OutputPtr& output, image_proc::LatencyMonitor::Clock::time_point start,
+                              const ros::Time& stamp)
 {
-  // Allocate memory for registered depth image
-  registered_msg->step = registered_msg->width * sizeof(T);
-  registered_msg->data.resize( registered_msg->height * registered_msg->step );
-  // data is already zero-filled in the uint16 case, but for floats we want to initialize everything to NaN.
-  DepthTraits<T>::initializeBuffer(registered_msg->data);
-
-  // Extract all the parameters we need
-  double inv_depth_fx = 1.0 / depth_model_.fx();
-  double inv_depth_fy = 1.0 / depth_model_.fy();
-  double depth_cx = depth_model_.cx(), depth_cy = depth_model_.cy();
-  double depth_Tx = depth_model_.Tx(), depth_Ty = depth_model_.Ty();
-  double rgb_fx = rgb_model_.fx(), rgb_fy = rgb_model_.fy();
-  double rgb_cx = rgb_model_.cx(), rgb_cy = rgb_model_.cy();
-  double rgb_Tx = rgb_model_.Tx(), rgb_Ty = rgb_model_.Ty();
-  
-  // Transform the depth values into the RGB frame
-  /// @todo When RGB is higher res, interpolate by rasterizing depth triangles onto the registered image  
-  const T* depth_row = reinterpret_cast<const T*>(&depth_msg->data[0]);
-  int row_step = depth_msg->step / sizeof(T);
-  T* registered_data = reinterpret_cast<T*>(&registered_msg->data[0]);
-  int raw_index = 0;
-  for (unsigned v = 0; v < depth_msg->height; ++v, depth_row += row_step)
-  {
-    for (unsigned u = 0; u < depth_msg->width; ++u, ++raw_index)
-    {
-      T raw_depth = depth_row[u];
-      if (!DepthTraits<T>::valid(raw_depth))
-        continue;
-      
-      double depth = DepthTraits<T>::toMeters(raw_depth);
-
-      /// @todo Combine all operations into one matrix multiply on (u,v,d)
-      // Reproject (u,v,Z) to (X,Y,Z,1) in depth camera frame
-      Eigen::Vector4d xyz_depth;
-      xyz_depth << ((u - depth_cx)*depth - depth_Tx) * inv_depth_fx,
-                   ((v - depth_cy)*depth - depth_Ty) * inv_depth_fy,
-                   depth,
-                   1;
-
-      // Transform to RGB camera frame
-      Eigen::Vector4d xyz_rgb = depth_to_rgb * xyz_depth;
-
-      // Project to (u,v) in RGB image
-      double inv_Z = 1.0 / xyz_rgb.z();
-      int u_rgb = (rgb_fx*xyz_rgb.x() + rgb_Tx)*inv_Z + rgb_cx + 0.5;
-      int v_rgb = (rgb_fy*xyz_rgb.y() + rgb_Ty)*inv_Z + rgb_cy + 0.5;
-      
-      if (u_rgb < 0 || u_rgb >= (int)registered_msg->width ||
-          v_rgb < 0 || v_rgb >= (int)registered_msg->height)
-        continue;
-      
-      T& reg_depth = registered_data[v_rgb*registered_msg->width + u_rgb];
-      T  new_depth = DepthTraits<T>::fromMeters(xyz_rgb.z());
-      // Validity and Z-buffer checks
-      if (!DepthTraits<T>::valid(reg_depth) || reg_depth > new_depth)
-        reg_depth = new_depth;
-    }
-  }
+  if (output->image)
+    pub_registered_.publish(output->image, output->info);
+  if (monitor_)
+    monitor_->end(start, stamp);
 }
 
 } // namespace depth_image_proc
@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../src/nodelets/color_convert.h"
+
+// Frame sizes of the USB cameras that deliver YUV 4:2:2
+static void sizes(benchmark::internal::Benchmark* b)
+{
+  b->Args({640, 480});
+  b->Args({1280, 720});
+  b->Args({1920, 1080});
+}
+
+// Baseline: what cv_bridge does for yuv422, minus its extra copy
+static void BM_CvtColorYuv422ToBGR(benchmark::State& state)
+{
+  cv::Mat yuv(state.range(1), state.range(0), CV_8UC2, cv::Scalar::all(128)), bgr;
+  while (state.KeepRunning())
+#if OPENCV3
+    cv::cvtColor(yuv, bgr, cv::COLOR_YUV2BGR_UYVY);
+#else
+    cv::cvtColor(yuv, bgr, CV_YUV2BGR_UYVY);
+#endif
+  state.SetItemsProcessed(state.iterations() * yuv.total());
+}
+BENCHMARK(BM_CvtColorYuv422ToBGR)->Apply(sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_Yuv422ToBGR(benchmark::State& state)
+{
+  cv::Mat yuv(state.range(1), state.range(0), CV_8UC2, cv::Scalar::all(128)), bgr;
+  while (state.KeepRunning())
+    image_proc::yuv422ToBGR(yuv, image_proc::YUV422_UYVY, bgr);
+  state.SetItemsProcessed(state.iterations() * yuv.total());
+}
+BENCHMARK(BM_Yuv422ToBGR)->Apply(sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_Yuv422ToMono(benchmark::State& state)
+{
+  cv::Mat yuv(state.range(1), state.range(0), CV_8UC2, cv::Scalar::all(128)), mono;
+  while (state.KeepRunning())
+    image_proc::yuv422ToMono(yuv, image_proc::YUV422_UYVY, mono);
+  state.SetItemsProcessed(state.iterations() * yuv.total());
+}
+BENCHMARK(BM_Yuv422ToMono)->Apply(sizes)->Unit(benchmark::kMicrosecond);
+
+// Argument is the number of channels, RGB or RGBA order
+static void BM_PackedToBGR(benchmark::State& state)
+{
+  image_proc::PackedLayout layout = { (int)state.range(0), 0 };
+  cv::Mat src(1080, 1920, CV_MAKETYPE(CV_8U, layout.channels), cv::Scalar::all(128)), bgr;
+  while (state.KeepRunning())
+    image_proc::packedToBGR(src, layout, bgr);
+  state.SetItemsProcessed(state.iterations() * src.total());
+}
+BENCHMARK(BM_PackedToBGR)->Arg(3)->Arg(4)->Unit(benchmark::kMicrosecond);
+
+static void BM_PackedToMono(benchmark::State& state)
+{
+  image_proc::PackedLayout layout = { (int)state.range(0), 0 };
+  cv::Mat src(1080, 1920, CV_MAKETYPE(CV_8U, layout.channels), cv::Scalar::all(128)), mono;
+  while (state.KeepRunning())
+    image_proc::packedToMono(src, layout, mono);
+  state.SetItemsProcessed(state.iterations() * src.total());
+}
+BENCHMARK(BM_PackedToMono)->Arg(3)->Arg(4)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../src/nodelets/decimate.h"
+
+// 4K frames, the size where CropDecimate shows up in profiles
+static const int WIDTH = 3840, HEIGHT = 2160;
+
+static int typeForPixelSize(int pixel_size)
+{
+  return pixel_size == 1 ? CV_8UC1 : pixel_size == 3 ? CV_8UC3 : CV_8UC4;
+}
+
+// Arguments are (pixel size in bytes, decimation factor)
+static void decimateArgs(benchmark::internal::Benchmark* b)
+{
+  int pixel_sizes[] = {1, 3, 4};
+  int factors[] = {2, 4, 8};
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      b->Args({pixel_sizes[i], factors[j]});
+}
+
+// Baseline: the memcpy-per-pixel templates
+static void BM_DecimateTemplate(benchmark::State& state)
+{
+  int pixel_size = state.range(0), factor = state.range(1);
+  cv::Mat src(HEIGHT, WIDTH, typeForPixelSize(pixel_size), cv::Scalar::all(128)), dst;
+  while (state.KeepRunning())
+  {
+    if (pixel_size == 1)
+      image_proc::decimate<1>(src, dst, factor, factor);
+    else if (pixel_size == 3)
+      image_proc::decimate<3>(src, dst, factor, factor);
+    else
+      image_proc::decimate<4>(src, dst, factor, factor);
+  }
+  state.SetItemsProcessed(state.iterations() * dst.total());
+}
+BENCHMARK(BM_DecimateTemplate)->Apply(decimateArgs)->Unit(benchmark::kMicrosecond);
+
+static void BM_DecimateNearest(benchmark::State& state)
+{
+  int pixel_size = state.range(0), factor = state.range(1);
+  cv::Mat src(HEIGHT, WIDTH, typeForPixelSize(pixel_size), cv::Scalar::all(128)), dst;
+  while (state.KeepRunning())
+    image_proc::decimateNearest(src, dst, factor, factor);
+  state.SetItemsProcessed(state.iterations() * dst.total());
+}
+BENCHMARK(BM_DecimateNearest)->Apply(decimateArgs)->Unit(benchmark::kMicrosecond);
+
+static void BM_ResizeNearest(benchmark::State& state)
+{
+  int pixel_size = state.range(0), factor = state.range(1);
+  cv::Mat src(HEIGHT, WIDTH, typeForPixelSize(pixel_size), cv::Scalar::all(128)), dst;
+  cv::Size size(WIDTH / factor, HEIGHT / factor);
+  while (state.KeepRunning())
+    cv::resize(src, dst, size, 0.0, 0.0, cv::INTER_NEAREST);
+  state.SetItemsProcessed(state.iterations() * dst.total());
+}
+BENCHMARK(BM_ResizeNearest)->Apply(decimateArgs)->Unit(benchmark::kMicrosecond);
+
+// Argument is the bit depth of the Bayer image; the pattern is GRBG
+static void BM_Debayer2x2Template(benchmark::State& state)
+{
+  cv::Mat bayer(HEIGHT, WIDTH, state.range(0) == 8 ? CV_8UC1 : CV_16UC1, cv::Scalar::all(128)), bgr;
+  int step = bayer.step1();
+  while (state.KeepRunning())
+  {
+    if (state.range(0) == 8)
+      image_proc::debayer2x2toBGR<uint8_t>(bayer, bgr, 1, 0, step + 1, step, 2, 2);
+    else
+      image_proc::debayer2x2toBGR<uint16_t>(bayer, bgr, 1, 0, step + 1, step, 2, 2);
+  }
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_Debayer2x2Template)->Arg(8)->Arg(16)->Unit(benchmark::kMicrosecond);
+
+static void BM_Debayer2x2(benchmark::State& state)
+{
+  cv::Mat bayer(HEIGHT, WIDTH, state.range(0) == 8 ? CV_8UC1 : CV_16UC1, cv::Scalar::all(128)), bgr;
+  image_proc::BayerPattern grbg = { 1, 0 };
+  while (state.KeepRunning())
+    image_proc::debayer2x2toBGR(bayer, grbg, bgr, 2, 2);
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_Debayer2x2)->Arg(8)->Arg(16)->Unit(benchmark::kMicrosecond);
+
+// Area-averaged Bayer decimation, argument is the decimation factor. The
+// baseline is a full debayer followed by an INTER_AREA resize.
+static void BM_BayerDebayerResizeArea(benchmark::State& state)
+{
+  cv::Mat bayer(HEIGHT, WIDTH, CV_8UC1, cv::Scalar::all(128)), color, bgr;
+  cv::Size size(WIDTH / state.range(0), HEIGHT / state.range(0));
+  while (state.KeepRunning())
+  {
+    cv::cvtColor(bayer, color, cv::COLOR_BayerGB2BGR);
+    cv::resize(color, bgr, size, 0.0, 0.0, cv::INTER_AREA);
+  }
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_BayerDebayerResizeArea)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+static void BM_BinBayer(benchmark::State& state)
+{
+  cv::Mat bayer(HEIGHT, WIDTH, CV_8UC1, cv::Scalar::all(128)), bgr;
+  image_proc::BayerPattern grbg = { 1, 0 };
+  while (state.KeepRunning())
+    image_proc::binBayerToBGR(bayer, grbg, bgr, state.range(0), state.range(0));
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_BinBayer)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,59 @@
+#include <benchmark/benchmark.h>
+#include <image_proc/rectifier.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../src/nodelets/depth_remap.h"
+
+// Rectification maps of a depth camera with mild distortion
+static void makeMaps(int width, int height, cv::Mat& map1, cv::Mat& map2)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = width;
+  info.height = height;
+  info.distortion_model = "plumb_bob";
+  double D[] = {0.08, -0.15, 0.0, 0.0, 0.0};
+  info.D.assign(D, D + 5);
+  double f = 0.9 * width;
+  double K[] = {f, 0, width / 2.0, 0, f, height / 2.0, 0, 0, 1};
+  std::copy(K, K + 9, info.K.begin());
+  double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(R, R + 9, info.R.begin());
+  double P[] = {f, 0, width / 2.0, 0, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, info.P.begin());
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+  image_proc::Rectifier rectifier;
+  rectifier.update(model);
+  map1 = rectifier.map1().clone();
+  map2 = rectifier.map2().clone();
+}
+
+// Arguments are the depth type and the interpolation
+static void BM_DepthRemap(benchmark::State& state)
+{
+  cv::Mat map1, map2, rect;
+  makeMaps(640, 480, map1, map2);
+  cv::Mat depth(480, 640, state.range(0), cv::Scalar(1000));
+  image_proc::DepthInterpolation interpolation = (image_proc::DepthInterpolation)state.range(1);
+  while (state.KeepRunning())
+    image_proc::depthRemap(depth, map1, map2, interpolation, rect);
+  state.SetItemsProcessed(state.iterations() * rect.total());
+}
+BENCHMARK(BM_DepthRemap)
+  ->Args({CV_16UC1, image_proc::DEPTH_NEAREST})
+  ->Args({CV_16UC1, image_proc::DEPTH_MIN_VALID})
+  ->Args({CV_32FC1, image_proc::DEPTH_MIN_VALID})
+  ->Unit(benchmark::kMicrosecond);
+
+// Baseline: what RectifyNodelet did for depth before, blending across edges
+static void BM_RemapLinear(benchmark::State& state)
+{
+  cv::Mat map1, map2, rect;
+  makeMaps(640, 480, map1, map2);
+  cv::Mat depth(480, 640, state.range(0), cv::Scalar(1000));
+  while (state.KeepRunning())
+    cv::remap(depth, rect, map1, map2, cv::INTER_LINEAR);
+  state.SetItemsProcessed(state.iterations() * rect.total());
+}
+BENCHMARK(BM_RemapLinear)->Arg(CV_16UC1)->Arg(CV_32FC1)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/core/core.hpp>
+#include "../src/nodelets/edge_aware.h"
+
+// Arguments are (width, height) at VGA, 1080p and 4K
+static void sizeArgs(benchmark::internal::Benchmark* b)
+{
+  b->Args({640, 480})->Args({1920, 1080})->Args({3840, 2160});
+}
+
+static cv::Mat makeBayer(int width, int height, int depth)
+{
+  cv::Mat bayer(height, width, CV_MAKETYPE(depth, 1));
+  cv::randu(bayer, cv::Scalar::all(0), cv::Scalar::all(depth == CV_8U ? 255 : 65535));
+  return bayer;
+}
+
+static void BM_EdgeAware8(benchmark::State& state)
+{
+  cv::Mat bayer = makeBayer(state.range(0), state.range(1), CV_8U), color;
+  image_proc::BayerPattern pattern = {1, 0};
+  while (state.KeepRunning())
+    image_proc::debayerEdgeAware(bayer, pattern, color);
+  state.SetItemsProcessed(state.iterations() * bayer.total());
+}
+BENCHMARK(BM_EdgeAware8)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_EdgeAware16(benchmark::State& state)
+{
+  cv::Mat bayer = makeBayer(state.range(0), state.range(1), CV_16U), color;
+  image_proc::BayerPattern pattern = {1, 0};
+  while (state.KeepRunning())
+    image_proc::debayerEdgeAware(bayer, pattern, color);
+  state.SetItemsProcessed(state.iterations() * bayer.total());
+}
+BENCHMARK(BM_EdgeAware16)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_EdgeAwareWeighted8(benchmark::State& state)
+{
+  cv::Mat bayer = makeBayer(state.range(0), state.range(1), CV_8U), color;
+  image_proc::BayerPattern pattern = {1, 0};
+  while (state.KeepRunning())
+    image_proc::debayerEdgeAwareWeighted(bayer, pattern, color);
+  state.SetItemsProcessed(state.iterations() * bayer.total());
+}
+BENCHMARK(BM_EdgeAwareWeighted8)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_EdgeAwareWeighted16(benchmark::State& state)
+{
+  cv::Mat bayer = makeBayer(state.range(0), state.range(1), CV_16U), color;
+  image_proc::BayerPattern pattern = {1, 0};
+  while (state.KeepRunning())
+    image_proc::debayerEdgeAwareWeighted(bayer, pattern, color);
+  state.SetItemsProcessed(state.iterations() * bayer.total());
+}
+BENCHMARK(BM_EdgeAwareWeighted16)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
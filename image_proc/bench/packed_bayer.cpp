@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../src/nodelets/packed_bayer.h"
+
+// 5 MP, a common machine-vision sensor size
+static const int WIDTH = 2448, HEIGHT = 2048;
+
+static cv::Mat makePacked(int bits)
+{
+  return cv::Mat(HEIGHT, image_proc::packedRowBytes(WIDTH, bits), CV_8UC1, cv::Scalar::all(0x5a));
+}
+
+// Argument is the sample size in bits
+static void BM_Unpack(benchmark::State& state)
+{
+  cv::Mat packed = makePacked(state.range(0)), bayer;
+  while (state.KeepRunning())
+    image_proc::unpackBayer(packed, WIDTH, state.range(0), bayer);
+  state.SetItemsProcessed(state.iterations() * bayer.total());
+}
+BENCHMARK(BM_Unpack)->Arg(10)->Arg(12)->Unit(benchmark::kMicrosecond);
+
+// Baseline: what the driver and debayer did before, unpack to 16 bits then cvtColor
+static void BM_UnpackThenCvtColor(benchmark::State& state)
+{
+  cv::Mat packed = makePacked(state.range(0)), bayer, bgr;
+  while (state.KeepRunning())
+  {
+    image_proc::unpackBayer(packed, WIDTH, state.range(0), bayer);
+#if OPENCV3
+    cv::cvtColor(bayer, bgr, cv::COLOR_BayerBG2BGR);
+#else
+    cv::cvtColor(bayer, bgr, CV_BayerBG2BGR);
+#endif
+  }
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_UnpackThenCvtColor)->Arg(10)->Arg(12)->Unit(benchmark::kMicrosecond);
+
+static void BM_DebayerPacked(benchmark::State& state)
+{
+  cv::Mat packed = makePacked(state.range(0)), bgr;
+  image_proc::BayerPattern rggb = { 0, 0 };
+  while (state.KeepRunning())
+    image_proc::debayerPacked(packed, WIDTH, state.range(0), rggb, NULL, bgr);
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_DebayerPacked)->Arg(10)->Arg(12)->Unit(benchmark::kMicrosecond);
+
+static void BM_DebayerPackedToneMapped(benchmark::State& state)
+{
+  cv::Mat packed = makePacked(state.range(0)), bgr;
+  image_proc::BayerPattern rggb = { 0, 0 };
+  std::vector<uint8_t> curve;
+  image_proc::toneCurve(2.2, curve);
+  while (state.KeepRunning())
+    image_proc::debayerPacked(packed, WIDTH, state.range(0), rggb, &curve, bgr);
+  state.SetItemsProcessed(state.iterations() * bgr.total());
+}
+BENCHMARK(BM_DebayerPackedToneMapped)->Arg(10)->Arg(12)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,71 @@
+#include <benchmark/benchmark.h>
+#include <image_proc/point_rectifier.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// 12 MP camera with a wide-angle lens
+static image_geometry::PinholeCameraModel makeModel()
+{
+  sensor_msgs::CameraInfo info;
+  info.width = 4096;
+  info.height = 3000;
+  info.distortion_model = "plumb_bob";
+  double D[] = {-0.28, 0.09, 0.0004, -0.0002, 0.0};
+  info.D.assign(D, D + 5);
+  double f = 0.8 * info.width;
+  double K[] = {f, 0, info.width / 2.0, 0, f, info.height / 2.0, 0, 0, 1};
+  std::copy(K, K + 9, info.K.begin());
+  double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(R, R + 9, info.R.begin());
+  double P[] = {f, 0, info.width / 2.0, 0, 0, f, info.height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, info.P.begin());
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+  return model;
+}
+
+static std::vector<cv::Point2f> makePoints(int n)
+{
+  std::vector<cv::Point2f> points(n);
+  cv::RNG rng(1);
+  for (int i = 0; i < n; ++i)
+    points[i] = cv::Point2f(rng.uniform(0.0f, 4095.0f), rng.uniform(0.0f, 2999.0f));
+  return points;
+}
+
+// Baseline: per-call iterative undistortion
+static void BM_UndistortPoints(benchmark::State& state)
+{
+  image_geometry::PinholeCameraModel model = makeModel();
+  std::vector<cv::Point2f> raw = makePoints(state.range(0)), rectified;
+  while (state.KeepRunning())
+    cv::undistortPoints(raw, rectified, model.intrinsicMatrix(), model.distortionCoeffs(),
+                        model.rotationMatrix(), model.projectionMatrix());
+  state.SetItemsProcessed(state.iterations() * raw.size());
+}
+BENCHMARK(BM_UndistortPoints)->Arg(1000)->Arg(30000)->Unit(benchmark::kMicrosecond);
+
+static void BM_PointRectifier(benchmark::State& state)
+{
+  image_geometry::PinholeCameraModel model = makeModel();
+  image_proc::PointRectifier rectifier;
+  rectifier.update(model);
+  std::vector<cv::Point2f> raw = makePoints(state.range(0)), rectified;
+  while (state.KeepRunning())
+    rectifier.rectify(raw, rectified);
+  state.SetItemsProcessed(state.iterations() * raw.size());
+}
+BENCHMARK(BM_PointRectifier)->Arg(1000)->Arg(30000)->Unit(benchmark::kMicrosecond);
+
+// One-off cost of building the table when the calibration changes
+static void BM_PointRectifierUpdate(benchmark::State& state)
+{
+  image_geometry::PinholeCameraModel model = makeModel();
+  while (state.KeepRunning())
+  {
+    image_proc::PointRectifier rectifier(state.range(0));
+    rectifier.update(model);
+  }
+}
+BENCHMARK(BM_PointRectifierUpdate)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+#include <image_proc/processor.h>
+#include <sensor_msgs/image_encodings.h>
+#include <opencv2/core/core.hpp>
+
+// Synthetic camera with a fair amount of barrel distortion
+static image_geometry::PinholeCameraModel makeModel(int width, int height)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = width;
+  info.height = height;
+  info.distortion_model = "plumb_bob";
+  double D[] = {-0.28, 0.09, 0.0004, -0.0002, 0.0};
+  info.D.assign(D, D + 5);
+  double f = 0.8 * width;
+  double K[] = {f, 0, width / 2.0, 0, f, height / 2.0, 0, 0, 1};
+  std::copy(K, K + 9, info.K.begin());
+  double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(R, R + 9, info.R.begin());
+  double P[] = {f, 0, width / 2.0, 0, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, info.P.begin());
+
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+  return model;
+}
+
+static const char* ENCODINGS[] = {"mono8", "rgb8", "bgr8", "bayer_rggb8", "bayer_grbg8"};
+
+static sensor_msgs::ImagePtr makeImage(const std::string& encoding, int width, int height)
+{
+  sensor_msgs::ImagePtr image(new sensor_msgs::Image);
+  image->encoding = encoding;
+  image->width = width;
+  image->height = height;
+  image->step = width * sensor_msgs::image_encodings::numChannels(encoding);
+  image->data.resize(image->step * height);
+  cv::Mat data(height, image->step, CV_8UC1, &image->data[0]);
+  cv::randu(data, cv::Scalar::all(0), cv::Scalar::all(255));
+  return image;
+}
+
+// Arguments are (index into ENCODINGS, width, height) at VGA, 1080p and 4K
+static void processArgs(benchmark::internal::Benchmark* b)
+{
+  int sizes[][2] = {{640, 480}, {1920, 1080}, {3840, 2160}};
+  for (int e = 0; e < 5; ++e)
+    for (int s = 0; s < 3; ++s)
+      b->Args({e, sizes[s][0], sizes[s][1]});
+}
+
+static void runProcess(benchmark::State& state, int flags)
+{
+  std::string encoding = ENCODINGS[state.range(0)];
+  int width = state.range(1), height = state.range(2);
+  image_geometry::PinholeCameraModel model = makeModel(width, height);
+  sensor_msgs::ImagePtr raw = makeImage(encoding, width, height);
+
+  image_proc::Processor processor;
+  image_proc::ImageSet output;
+  processor.process(raw, model, output, flags); // build maps outside the loop
+  while (state.KeepRunning())
+    processor.process(raw, model, output, flags);
+  state.SetItemsProcessed(state.iterations() * width * height);
+  state.SetLabel(encoding);
+}
+
+static void BM_ProcessAll(benchmark::State& state)
+{
+  runProcess(state, image_proc::Processor::ALL);
+}
+BENCHMARK(BM_ProcessAll)->Apply(processArgs)->Unit(benchmark::kMillisecond);
+
+// What a monochrome stereo pair asks for
+static void BM_ProcessMonoRect(benchmark::State& state)
+{
+  runProcess(state, image_proc::Processor::MONO | image_proc::Processor::RECT);
+}
+BENCHMARK(BM_ProcessMonoRect)->Apply(processArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_ProcessRectColor(benchmark::State& state)
+{
+  runProcess(state, image_proc::Processor::RECT_COLOR);
+}
+BENCHMARK(BM_ProcessRectColor)->Apply(processArgs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
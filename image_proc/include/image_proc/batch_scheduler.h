@@ -0,0 +1,113 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_BATCH_SCHEDULER_H
+#define IMAGE_PROC_BATCH_SCHEDULER_H
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace image_proc {
+
+/**
+ * Runs independent jobs, such as whole frames, on a fixed set of threads and
+ * commits their results in the order they were submitted. Submitted jobs are
+ * dealt round-robin onto per-thread queues; each thread runs its own queue
+ * oldest first and, when it runs dry, steals the newest job from another.
+ *
+ * At most max_in_flight jobs are queued, running or waiting to be committed
+ * at once, and submit() blocks beyond that, so a fast reader can't buffer a
+ * whole recording in memory. Jobs must not throw.
+ */
+class BatchScheduler : boost::noncopyable
+{
+public:
+  /// Does the work of a job on any thread, which is passed its index in [0, size()).
+  typedef boost::function<void (int)> Work;
+  /// Consumes the result of a job. Commits run one at a time, in submission order.
+  typedef boost::function<void ()> Commit;
+
+  BatchScheduler(int num_threads, int max_in_flight);
+  /// Waits for all submitted jobs to be committed.
+  ~BatchScheduler();
+
+  int size() const { return (int)queues_.size(); }
+
+  void submit(const Work& work, const Commit& commit);
+
+  /// Returns once every job submitted so far has been committed.
+  void wait();
+
+private:
+  struct Job
+  {
+    uint64_t index;
+    Work work;
+    Commit commit;
+  };
+
+  struct Queue
+  {
+    boost::mutex mutex;
+    std::deque<Job*> jobs;
+  };
+
+  void workerLoop(int id);
+  Job* takeJob(int id);
+  void complete(Job* job);
+
+  std::vector< boost::shared_ptr<Queue> > queues_;
+  boost::thread_group threads_;
+  int max_in_flight_;
+
+  boost::mutex mutex_; // guards everything below
+  boost::condition_variable work_cond_;
+  boost::condition_variable commit_cond_;
+  int queued_;
+  uint64_t submitted_;
+  uint64_t committed_;
+  std::map<uint64_t, Job*> completed_; // waiting for earlier jobs to commit
+  bool committing_;
+  bool shutdown_;
+};
+
+} // namespace image_proc
+
+#endif
@@ -0,0 +1,85 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_BAYER_H
+#define IMAGE_PROC_BAYER_H
+
+#include <opencv2/core/core.hpp>
+#include <string>
+
+namespace image_proc {
+
+/// Layout of a Bayer mosaic, as the position of the red sample in each 2x2 cell.
+/// Blue is diagonally opposite red; the other two samples are green.
+struct BayerPattern
+{
+  int red_x;
+  int red_y;
+};
+
+/// Looks up the pattern of a bayer_* encoding. Returns false for other encodings.
+bool bayerPattern(const std::string& encoding, BayerPattern& pattern);
+
+/**
+ * Debayers and rectifies in a single pass, without building the intermediate
+ * full-size color image. Each output pixel is interpolated through the
+ * fixed-point (CV_16SC2, CV_16UC1) rectification maps from the bilinearly
+ * debayered values of the raw pixels around it, computed on the fly.
+ *
+ * bayer is CV_8UC1 or CV_16UC1 and at least 2x2; color has the same depth with
+ * BGR channels and the size of the maps. Only INTER_NEAREST and INTER_LINEAR
+ * are supported. Like cv::remap, samples outside the raw image are black.
+ */
+void debayerRemap(const cv::Mat& bayer, BayerPattern pattern,
+                  const cv::Mat& map1, const cv::Mat& map2, int interpolation,
+                  cv::Mat& color);
+
+/// As debayerRemap(), but only fills rows [row_begin, row_end) of an already allocated color image.
+void debayerRemapRows(const cv::Mat& bayer, BayerPattern pattern,
+                      const cv::Mat& map1, const cv::Mat& map2, int interpolation,
+                      cv::Mat& color, int row_begin, int row_end);
+
+/**
+ * Computes the luminance of a Bayer image in a single pass, without building
+ * the color image. Each pixel is the BGR2GRAY weighting of its bilinearly
+ * debayered color, evaluated in fixed point without rounding the channels in
+ * between, so it is within one level of cvtColor to BGR followed by BGR2GRAY.
+ *
+ * bayer is CV_8UC1 or CV_16UC1 and at least 2x2; mono gets the same type and
+ * size. Borders are reflected (BORDER_REFLECT_101).
+ */
+void debayerMono(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& mono);
+
+} // namespace image_proc
+
+#endif
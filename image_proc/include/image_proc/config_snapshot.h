@@ -0,0 +1,84 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_CONFIG_SNAPSHOT_H
+#define IMAGE_PROC_CONFIG_SNAPSHOT_H
+
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace image_proc {
+
+/**
+ * The current dynamic_reconfigure config of a nodelet, for frame callbacks to
+ * read without taking the reconfigure mutex. The reconfigure callback
+ * publishes each new config as an immutable copy with set(); get() returns
+ * whichever copy is current. A callback keeps the copy it got for the whole
+ * frame, so it sees one consistent config even if it is replaced meanwhile,
+ * and the old copy is freed when the last reader lets go of it. Anything
+ * derived from the config can be bundled with it in a struct and published
+ * the same way.
+ *
+ * The pointer is exchanged with boost's atomic shared_ptr operations, which
+ * at most hold a spinlock for the pointer copy itself.
+ */
+template <typename Config>
+class ConfigSnapshot : boost::noncopyable
+{
+public:
+  typedef boost::shared_ptr<const Config> ConstPtr;
+
+  ConfigSnapshot()
+    : config_(boost::make_shared<Config>())
+  {
+  }
+
+  ConstPtr get() const
+  {
+    return boost::atomic_load(&config_);
+  }
+
+  void set(const Config& config)
+  {
+    ConstPtr copy = boost::make_shared<Config>(config);
+    boost::atomic_store(&config_, copy);
+  }
+
+private:
+  ConstPtr config_;
+};
+
+} // namespace image_proc
+
+#endif
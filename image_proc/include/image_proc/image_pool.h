@@ -0,0 +1,89 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_IMAGE_POOL_H
+#define IMAGE_PROC_IMAGE_POOL_H
+
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <sensor_msgs/Image.h>
+
+namespace image_proc {
+
+/**
+ * Recycles sensor_msgs::Image messages, so that publishing a large image does
+ * not cost an allocation, page faults and a zero fill on every frame.
+ *
+ * allocate() hands out a message whose data has the requested size but
+ * unspecified contents. Once the last shared_ptr to it is released, whether by
+ * the publisher or by an intra-process subscriber, the message returns to the
+ * pool and is handed out again for the next request with the same encoding and
+ * dimensions. At most max_free idle messages are kept; the least recently
+ * returned ones are freed first.
+ *
+ * Thread-safe. Messages may outlive the pool, in which case they are simply
+ * deleted when released.
+ */
+class ImagePool : boost::noncopyable
+{
+public:
+  explicit ImagePool(size_t max_free = 8);
+  ~ImagePool();
+
+  /// Message with height, width, encoding and step set and height * step bytes of data.
+  /// The header is default-constructed.
+  sensor_msgs::ImagePtr allocate(uint32_t height, uint32_t width,
+                                 const std::string& encoding, uint32_t step);
+
+  /// As above, with rows tightly packed for the encoding.
+  sensor_msgs::ImagePtr allocate(uint32_t height, uint32_t width, const std::string& encoding);
+
+  /// Number of idle messages held for reuse.
+  size_t numFree() const;
+
+  /// Frees all idle messages.
+  void clear();
+
+  /// Pool shared by all image_proc nodelets in the process, so buffers released
+  /// downstream of one nodelet can be reused by another.
+  static ImagePool& shared();
+
+private:
+  struct Impl;
+  boost::shared_ptr<Impl> impl_;
+};
+
+} // namespace image_proc
+
+#endif
@@ -0,0 +1,155 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_LATENCY_MONITOR_H
+#define IMAGE_PROC_LATENCY_MONITOR_H
+
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <ros/ros.h>
+#include <std_msgs/Header.h>
+
+namespace image_proc {
+
+/**
+ * Histogram of durations that any number of threads can record into without
+ * locking. Buckets are spaced logarithmically, four per power of two
+ * microseconds, so percentiles are resolved to within about 20%.
+ */
+class LatencyHistogram : boost::noncopyable
+{
+public:
+  struct Summary
+  {
+    uint64_t count;
+    // In seconds
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+  };
+
+  LatencyHistogram();
+
+  void record(double seconds);
+
+  /// Summarizes the durations recorded since the last call, and starts over.
+  Summary takeSummary();
+
+private:
+  enum { NUM_BUCKETS = 4 * 31 };
+
+  static int bucket(uint64_t usec);
+  static uint64_t bucketStart(int i);
+
+  boost::atomic<uint64_t> buckets_[NUM_BUCKETS];
+  boost::atomic<uint64_t> sum_usec_;
+  boost::atomic<uint64_t> max_usec_;
+};
+
+/**
+ * Per-nodelet latency and throughput statistics, published periodically on
+ * /diagnostics. For each frame it records the input age (now minus
+ * header.stamp) when the callback starts, which includes the time spent in
+ * the subscriber queue; the time spent in the callback; and the output age
+ * when the callback returns, after its results have been published. Frames
+ * lost upstream or in the queue are counted from gaps in header.seq.
+ *
+ * Nodelets create one through create(), which returns a null pointer unless
+ * the private parameter ~instrumentation is set, and open a Scope with it in
+ * their callbacks. A Scope on a null monitor does nothing.
+ */
+class LatencyMonitor : boost::noncopyable
+{
+public:
+  typedef boost::chrono::steady_clock Clock;
+
+  LatencyMonitor(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh, const std::string& name);
+
+  static boost::shared_ptr<LatencyMonitor> create(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh,
+                                                  const std::string& name);
+
+  /// Times one callback from construction to destruction.
+  class Scope : boost::noncopyable
+  {
+  public:
+    Scope(LatencyMonitor* monitor, const std_msgs::Header& input)
+      : monitor_(monitor)
+    {
+      if (monitor_)
+      {
+        stamp_ = input.stamp;
+        start_ = monitor_->begin(input);
+      }
+    }
+
+    ~Scope()
+    {
+      if (monitor_)
+        monitor_->end(start_, stamp_);
+    }
+
+  private:
+    LatencyMonitor* monitor_;
+    Clock::time_point start_;
+    ros::Time stamp_;
+  };
+
+  /// Records the arrival of a frame, returning the time processing started.
+  Clock::time_point begin(const std_msgs::Header& input);
+  void end(Clock::time_point start, const ros::Time& stamp);
+
+private:
+  void diagnose(diagnostic_updater::DiagnosticStatusWrapper& stat);
+  void timerCb(const ros::TimerEvent&);
+
+  LatencyHistogram input_age_;
+  LatencyHistogram processing_;
+  LatencyHistogram output_age_;
+  boost::atomic<uint64_t> frames_;
+  boost::atomic<uint64_t> dropped_;
+  boost::atomic<uint32_t> last_seq_;
+  Clock::time_point window_start_;
+
+  diagnostic_updater::Updater updater_;
+  ros::Timer timer_;
+};
+
+} // namespace image_proc
+
+#endif
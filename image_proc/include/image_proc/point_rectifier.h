@@ -0,0 +1,100 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_POINT_RECTIFIER_H
+#define IMAGE_PROC_POINT_RECTIFIER_H
+
+#include <opencv2/core/core.hpp>
+#include <image_geometry/pinhole_camera_model.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+namespace image_proc {
+
+/**
+ * Rectifies sparse pixel coordinates, such as tracked features, through a
+ * lookup table instead of solving the undistortion per point as
+ * cv::undistortPoints() does.
+ *
+ * The table holds the rectified position of every step-th raw pixel in each
+ * direction, solved to well under a thousandth of a pixel; points in between
+ * are interpolated bilinearly. Raw coordinates are at the camera's binning and
+ * ROI, and rectified ones are in the coordinates of Rectifier's output, as with
+ * PinholeCameraModel::rectifyPoint(). Points outside the raw image are
+ * extrapolated from the cells along its border; NaN or infinite coordinates
+ * give a NaN point.
+ */
+class PointRectifier
+{
+public:
+  explicit PointRectifier(int step = 4);
+
+  /// Rebuilds the table if the calibration in model differs from the last call.
+  void update(const image_geometry::PinholeCameraModel& model);
+
+  bool initialized() const { return initialized_; }
+
+  cv::Point2f rectify(const cv::Point2f& raw) const;
+
+  void rectify(const std::vector<cv::Point2f>& raw, std::vector<cv::Point2f>& rectified) const;
+
+private:
+  int step_;
+  float inverse_step_;
+  uint64_t hash_; // of the calibration the table was built from
+  bool initialized_;
+  cv::Mat table_; // CV_32FC2 rectified positions of raw pixels (x * step_, y * step_)
+};
+
+inline cv::Point2f PointRectifier::rectify(const cv::Point2f& raw) const
+{
+  if (!std::isfinite(raw.x) || !std::isfinite(raw.y))
+    return cv::Point2f(std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::quiet_NaN());
+
+  // Clamp before converting, far-off points would overflow an int
+  float gx = raw.x * inverse_step_;
+  float gy = raw.y * inverse_step_;
+  int x = (int)std::min(std::max(std::floor(gx), 0.0f), (float)(table_.cols - 2));
+  int y = (int)std::min(std::max(std::floor(gy), 0.0f), (float)(table_.rows - 2));
+  float fx = gx - x, fy = gy - y;
+  const cv::Point2f* top = table_.ptr<cv::Point2f>(y) + x;
+  const cv::Point2f* bottom = table_.ptr<cv::Point2f>(y + 1) + x;
+  return (top[0] * (1.0f - fx) + top[1] * fx) * (1.0f - fy) + (bottom[0] * (1.0f - fx) + bottom[1] * fx) * fy;
+}
+
+} // namespace image_proc
+
+#endif
@@ -36,6 +36,7 @@
 
 #include <opencv2/core/core.hpp>
 #include <image_geometry/pinhole_camera_model.h>
+#include <image_proc/rectifier.h>
 #include <sensor_msgs/Image.h>
 
 namespace image_proc {
@@ -49,6 +50,8 @@ struct ImageSet
   cv::Mat rect_color;
 };
 
+// Note: process() caches the rectification maps of the last camera model it was
+// given, so use one Processor per camera and don't share it between threads.
 class Processor
 {
 public:
@@ -74,6 +77,9 @@ public:
   bool process(const sensor_msgs::ImageConstPtr& raw_image,
                const image_geometry::PinholeCameraModel& model,
                ImageSet& output, int flags = ALL) const;
+
+private:
+  mutable Rectifier rectifier_;
 };
 
 } //namespace image_proc
@@ -0,0 +1,171 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_RECTIFIER_H
+#define IMAGE_PROC_RECTIFIER_H
+
+#include <opencv2/core/core.hpp>
+#include <image_proc/bayer.h>
+#include <image_geometry/pinhole_camera_model.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace boost { namespace interprocess { class mapped_region; } }
+
+namespace image_proc {
+
+class WorkerPool;
+
+/**
+ * Owns the rectification maps for one camera and applies them, optionally
+ * splitting the remap into horizontal bands across a WorkerPool.
+ *
+ * The maps are built exactly as image_geometry::PinholeCameraModel builds its
+ * own (taking binning and ROI into account), so the output is bit-identical
+ * to PinholeCameraModel::rectifyImage() whatever the number of bands.
+ *
+ * The maps are fixed-point (CV_16SC2 integer coordinates plus a CV_16UC1
+ * interpolation table index). If a cache directory is set they are saved there
+ * under a hash of the calibration, and later memory-mapped instead of rebuilt.
+ *
+ * setOutput() restricts the output to part of the rectified image, optionally
+ * resized. The maps then go straight from raw pixels to output pixels, so
+ * nothing is interpolated outside the output. outputCameraInfo() describes the
+ * images produced.
+ */
+class Rectifier
+{
+public:
+  Rectifier();
+
+  /// Directory to load maps from and save them to. Empty (the default) disables caching.
+  void setCacheDirectory(const std::string& dir) { cache_dir_ = dir; }
+
+  /**
+   * Produces only roi of the rectified image, in the coordinates rectify()
+   * would otherwise use, resized by scale. A roi width or height of 0 extends
+   * it to the edge of the image. With valid_only, roi is further cropped to
+   * validRegion(), leaving out the corners that fall outside the raw image.
+   * Takes effect at the next update().
+   */
+  void setOutput(const cv::Rect& roi, double scale, bool valid_only = false);
+
+  /**
+   * True if setOutput() changes the output geometry, so that the images no
+   * longer match the camera's own calibration and should be published with
+   * outputCameraInfo() instead. The region validRegion() crops to moves with
+   * the calibration, so take outputCameraInfo() after each update().
+   */
+  bool hasOutputRegion() const;
+
+  /// Rebuilds the maps if the calibration in model differs from the last call.
+  void update(const image_geometry::PinholeCameraModel& model);
+
+  /**
+   * Largest upright rectangle of the rectified image, in the coordinates
+   * rectify() uses by default, whose pixels all come from inside the raw image
+   * (the region cv::getOptimalNewCameraMatrix() keeps at alpha 0, without
+   * rescaling). Found by rectifying the border of the raw image.
+   */
+  static cv::Rect validRegion(const image_geometry::PinholeCameraModel& model);
+
+  /**
+   * Maps rectified points to raw ones exactly, as
+   * PinholeCameraModel::unrectifyPoint() does, but in the reduced (binned
+   * and ROI) coordinates of model throughout.
+   */
+  static void unrectifyPoints(const image_geometry::PinholeCameraModel& model,
+                              const std::vector<cv::Point2d>& rectified, std::vector<cv::Point2d>& raw);
+
+  /// Hash of everything in info that affects the rectification maps.
+  static uint64_t calibrationHash(const sensor_msgs::CameraInfo& info);
+
+  /// False if the camera has no distortion, in which case rectify() just copies.
+  bool hasMaps() const { return !map1_.empty(); }
+
+  const cv::Mat& map1() const { return map1_; }
+  const cv::Mat& map2() const { return map2_; }
+
+  /**
+   * Calibration of the images rectify() produces, as of the last update(): no
+   * distortion, identity R, and K and P adjusted for the output region and
+   * scale. Copies the rest of the calibration the maps were built from.
+   */
+  const sensor_msgs::CameraInfo& outputCameraInfo() const { return output_info_; }
+
+  void rectify(const cv::Mat& raw, cv::Mat& rectified, int interpolation) const;
+
+  /// Rectifies in horizontal bands, one or more per thread of pool.
+  void rectify(const cv::Mat& raw, cv::Mat& rectified, int interpolation,
+               WorkerPool& pool) const;
+
+  /// Fills rows [row_begin, row_end) of an already allocated rectified image.
+  void rectifyRows(const cv::Mat& raw, cv::Mat& rectified, int interpolation,
+                   int row_begin, int row_end) const;
+
+  /// True if rectifyBayer() can be used with this interpolation (and the current maps).
+  bool canRectifyBayer(int interpolation) const;
+
+  /// Debayers and rectifies a raw Bayer image in one pass, see debayerRemap().
+  void rectifyBayer(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color,
+                    int interpolation) const;
+  void rectifyBayer(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color,
+                    int interpolation, WorkerPool& pool) const;
+
+private:
+  void buildMaps(const image_geometry::PinholeCameraModel& model);
+  std::string cachePath() const;
+  bool loadMaps();
+  void saveMaps() const;
+
+  uint64_t hash_; // of the calibration the maps were built from
+  bool initialized_;
+  std::string cache_dir_;
+  cv::Rect output_roi_;
+  double output_scale_;
+  bool output_valid_only_;
+  // Output region in the binned full-resolution rectified image, and its size after scaling
+  cv::Rect output_rect_;
+  cv::Size output_size_;
+  cv::Matx34d output_P_;
+  sensor_msgs::CameraInfo output_info_;
+  cv::Mat map1_, map2_;
+  boost::shared_ptr<boost::interprocess::mapped_region> region_; // backs the maps if loaded from cache
+};
+
+} // namespace image_proc
+
+#endif
@@ -0,0 +1,83 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_WORKER_POOL_H
+#define IMAGE_PROC_WORKER_POOL_H
+
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace image_proc {
+
+/**
+ * Fixed-size pool of worker threads for splitting per-frame work into
+ * independent pieces. The calling thread takes part in parallelFor(), so a
+ * pool of size N uses N-1 background threads.
+ */
+class WorkerPool : boost::noncopyable
+{
+public:
+  explicit WorkerPool(int num_threads);
+  ~WorkerPool();
+
+  /// Total number of threads working on a parallelFor(), including the caller.
+  int size() const { return (int)threads_.size() + 1; }
+
+  /**
+   * Calls fn(i) for each i in [0, n), returning once all calls have completed.
+   * If any call throws, the rest still run and a std::runtime_error with the
+   * first one's message is thrown here.
+   */
+  void parallelFor(int n, const boost::function<void (int)>& fn);
+
+private:
+  struct Batch;
+
+  void workerLoop();
+  static void runItems(const boost::shared_ptr<Batch>& batch);
+
+  boost::thread_group threads_;
+  boost::mutex queue_mutex_;
+  boost::condition_variable queue_cond_;
+  std::deque< boost::function<void ()> > queue_;
+  bool shutdown_;
+};
+
+} // namespace image_proc
+
+#endif
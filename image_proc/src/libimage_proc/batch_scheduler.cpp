@@ -0,0 +1,164 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/batch_scheduler.h"
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+namespace image_proc {
+
+BatchScheduler::BatchScheduler(int num_threads, int max_in_flight)
+  : max_in_flight_(std::max(max_in_flight, 1)),
+    queued_(0), submitted_(0), committed_(0), committing_(false), shutdown_(false)
+{
+  num_threads = std::max(num_threads, 1);
+  for (int i = 0; i < num_threads; ++i)
+    queues_.push_back(boost::make_shared<Queue>());
+  for (int i = 0; i < num_threads; ++i)
+    threads_.create_thread(boost::bind(&BatchScheduler::workerLoop, this, i));
+}
+
+BatchScheduler::~BatchScheduler()
+{
+  wait();
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  work_cond_.notify_all();
+  threads_.join_all();
+}
+
+void BatchScheduler::submit(const Work& work, const Commit& commit)
+{
+  Job* job = new Job;
+  job->work = work;
+  job->commit = commit;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (submitted_ - committed_ >= (uint64_t)max_in_flight_)
+      commit_cond_.wait(lock);
+    job->index = submitted_++;
+  }
+
+  // Count the job while still holding the queue lock, in the same order as
+  // takeJob(), so no worker can take it before queued_ accounts for it
+  Queue& queue = *queues_[job->index % queues_.size()];
+  {
+    boost::lock_guard<boost::mutex> queue_lock(queue.mutex);
+    queue.jobs.push_back(job);
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ++queued_;
+  }
+  work_cond_.notify_one();
+}
+
+void BatchScheduler::wait()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (committed_ < submitted_)
+    commit_cond_.wait(lock);
+}
+
+BatchScheduler::Job* BatchScheduler::takeJob(int id)
+{
+  // Own queue first, then the others starting with the next one
+  for (size_t i = 0; i < queues_.size(); ++i)
+  {
+    Queue& queue = *queues_[(id + i) % queues_.size()];
+    boost::lock_guard<boost::mutex> queue_lock(queue.mutex);
+    if (queue.jobs.empty())
+      continue;
+
+    Job* job;
+    if (i == 0)
+    {
+      job = queue.jobs.front();
+      queue.jobs.pop_front();
+    }
+    else
+    {
+      job = queue.jobs.back();
+      queue.jobs.pop_back();
+    }
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    --queued_;
+    return job;
+  }
+  return NULL;
+}
+
+void BatchScheduler::workerLoop(int id)
+{
+  while (true)
+  {
+    Job* job = takeJob(id);
+    if (!job)
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (queued_ == 0 && !shutdown_)
+        work_cond_.wait(lock);
+      if (queued_ == 0)
+        return; // shutting down
+      continue;
+    }
+
+    job->work(id);
+    complete(job);
+  }
+}
+
+void BatchScheduler::complete(Job* job)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  completed_[job->index] = job;
+  // Whoever is committing already will pick this job up when its turn comes
+  if (committing_)
+    return;
+
+  committing_ = true;
+  while (!completed_.empty() && completed_.begin()->first == committed_)
+  {
+    Job* next = completed_.begin()->second;
+    completed_.erase(completed_.begin());
+    lock.unlock();
+    next->commit();
+    delete next;
+    lock.lock();
+    ++committed_;
+    commit_cond_.notify_all();
+  }
+  committing_ = false;
+}
+
+} // namespace image_proc
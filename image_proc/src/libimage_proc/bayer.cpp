@@ -0,0 +1,419 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/bayer.h"
+#include <sensor_msgs/image_encodings.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace image_proc {
+
+namespace enc = sensor_msgs::image_encodings;
+
+bool bayerPattern(const std::string& encoding, BayerPattern& pattern)
+{
+  if (encoding == enc::BAYER_RGGB8 || encoding == enc::BAYER_RGGB16)
+  {
+    pattern.red_x = 0;
+    pattern.red_y = 0;
+  }
+  else if (encoding == enc::BAYER_BGGR8 || encoding == enc::BAYER_BGGR16)
+  {
+    pattern.red_x = 1;
+    pattern.red_y = 1;
+  }
+  else if (encoding == enc::BAYER_GBRG8 || encoding == enc::BAYER_GBRG16)
+  {
+    pattern.red_x = 0;
+    pattern.red_y = 1;
+  }
+  else if (encoding == enc::BAYER_GRBG8 || encoding == enc::BAYER_GRBG16)
+  {
+    pattern.red_x = 1;
+    pattern.red_y = 0;
+  }
+  else
+    return false;
+  return true;
+}
+
+// Mirrors an out-of-range coordinate back into [0, n) without changing its
+// parity, so the Bayer pattern is preserved (BORDER_REFLECT_101).
+static inline int reflect101(int i, int n)
+{
+  if (i < 0)
+    return -i;
+  if (i >= n)
+    return 2 * n - 2 - i;
+  return i;
+}
+
+// 4x4 window of raw samples around the 2x2 neighbourhood of a remapped point
+struct Patch
+{
+  int v[4][4];
+};
+
+template <typename T>
+static inline void loadPatch(const cv::Mat& bayer, int x0, int y0, Patch& patch)
+{
+  // x0, y0 is the top-left of the window, one pixel above/left of the sample point
+  if (x0 >= 0 && y0 >= 0 && x0 + 3 < bayer.cols && y0 + 3 < bayer.rows)
+  {
+    for (int j = 0; j < 4; ++j)
+    {
+      const T* row = bayer.ptr<T>(y0 + j) + x0;
+      patch.v[j][0] = row[0];
+      patch.v[j][1] = row[1];
+      patch.v[j][2] = row[2];
+      patch.v[j][3] = row[3];
+    }
+  }
+  else
+  {
+    for (int j = 0; j < 4; ++j)
+    {
+      const T* row = bayer.ptr<T>(reflect101(y0 + j, bayer.rows));
+      for (int i = 0; i < 4; ++i)
+        patch.v[j][i] = row[reflect101(x0 + i, bayer.cols)];
+    }
+  }
+}
+
+// Bilinear debayering of the patch sample at (i, j), whose raw image
+// coordinates are (x, y), with the same rounding as cv::cvtColor.
+static inline void demosaic(const Patch& p, int i, int j, int x, int y,
+                            BayerPattern pattern, int bgr[3])
+{
+  int center = p.v[j][i];
+  int px = x & 1, py = y & 1;
+  if (px == pattern.red_x && py == pattern.red_y)
+  {
+    bgr[2] = center;
+    bgr[1] = (p.v[j][i-1] + p.v[j][i+1] + p.v[j-1][i] + p.v[j+1][i] + 2) >> 2;
+    bgr[0] = (p.v[j-1][i-1] + p.v[j-1][i+1] + p.v[j+1][i-1] + p.v[j+1][i+1] + 2) >> 2;
+  }
+  else if (px != pattern.red_x && py != pattern.red_y)
+  {
+    bgr[0] = center;
+    bgr[1] = (p.v[j][i-1] + p.v[j][i+1] + p.v[j-1][i] + p.v[j+1][i] + 2) >> 2;
+    bgr[2] = (p.v[j-1][i-1] + p.v[j-1][i+1] + p.v[j+1][i-1] + p.v[j+1][i+1] + 2) >> 2;
+  }
+  else
+  {
+    int horizontal = (p.v[j][i-1] + p.v[j][i+1] + 1) >> 1;
+    int vertical   = (p.v[j-1][i] + p.v[j+1][i] + 1) >> 1;
+    bgr[1] = center;
+    if (py == pattern.red_y)
+    {
+      bgr[2] = horizontal;
+      bgr[0] = vertical;
+    }
+    else
+    {
+      bgr[2] = vertical;
+      bgr[0] = horizontal;
+    }
+  }
+}
+
+template <typename T>
+static void debayerRemapNearest(const cv::Mat& bayer, BayerPattern pattern, const cv::Mat& map1,
+                                cv::Mat& color, int row_begin, int row_end)
+{
+  Patch patch;
+  int bgr[3];
+  for (int y = row_begin; y < row_end; ++y)
+  {
+    const short* xy = map1.ptr<short>(y);
+    T* out = color.ptr<T>(y);
+    for (int x = 0; x < color.cols; ++x, xy += 2, out += 3)
+    {
+      int sx = xy[0], sy = xy[1];
+      if (sx < 0 || sy < 0 || sx >= bayer.cols || sy >= bayer.rows)
+      {
+        out[0] = out[1] = out[2] = 0;
+        continue;
+      }
+      loadPatch<T>(bayer, sx - 1, sy - 1, patch);
+      demosaic(patch, 1, 1, sx, sy, pattern, bgr);
+      out[0] = bgr[0];
+      out[1] = bgr[1];
+      out[2] = bgr[2];
+    }
+  }
+}
+
+template <typename T>
+static void debayerRemapLinear(const cv::Mat& bayer, BayerPattern pattern,
+                               const cv::Mat& map1, const cv::Mat& map2,
+                               cv::Mat& color, int row_begin, int row_end)
+{
+  static const int TAB = cv::INTER_TAB_SIZE;
+  static const int SHIFT = 2 * cv::INTER_BITS;
+  Patch patch;
+  int bgr[4][3];
+  for (int y = row_begin; y < row_end; ++y)
+  {
+    const short* xy = map1.ptr<short>(y);
+    const uint16_t* frac = map2.ptr<uint16_t>(y);
+    T* out = color.ptr<T>(y);
+    for (int x = 0; x < color.cols; ++x, xy += 2, out += 3)
+    {
+      int sx = xy[0], sy = xy[1];
+      // Whole 2x2 neighbourhood outside the image: border value
+      if (sx < -1 || sy < -1 || sx >= bayer.cols || sy >= bayer.rows)
+      {
+        out[0] = out[1] = out[2] = 0;
+        continue;
+      }
+
+      loadPatch<T>(bayer, sx - 1, sy - 1, patch);
+      bool inside[4];
+      for (int k = 0; k < 4; ++k)
+      {
+        int dx = k & 1, dy = k >> 1;
+        inside[k] = sx + dx >= 0 && sx + dx < bayer.cols && sy + dy >= 0 && sy + dy < bayer.rows;
+        if (inside[k])
+          demosaic(patch, 1 + dx, 1 + dy, sx + dx, sy + dy, pattern, bgr[k]);
+        else
+          bgr[k][0] = bgr[k][1] = bgr[k][2] = 0;
+      }
+
+      int fx = frac[x] & (TAB - 1);
+      int fy = frac[x] >> cv::INTER_BITS;
+      int w00 = (TAB - fx) * (TAB - fy);
+      int w01 = fx * (TAB - fy);
+      int w10 = (TAB - fx) * fy;
+      int w11 = fx * fy;
+      for (int c = 0; c < 3; ++c)
+      {
+        int value = bgr[0][c] * w00 + bgr[1][c] * w01 + bgr[2][c] * w10 + bgr[3][c] * w11;
+        out[c] = (value + (1 << (SHIFT - 1))) >> SHIFT;
+      }
+    }
+  }
+}
+
+void debayerRemap(const cv::Mat& bayer, BayerPattern pattern,
+                  const cv::Mat& map1, const cv::Mat& map2, int interpolation,
+                  cv::Mat& color)
+{
+  color.create(map1.rows, map1.cols, CV_MAKETYPE(bayer.depth(), 3));
+  debayerRemapRows(bayer, pattern, map1, map2, interpolation, color, 0, color.rows);
+}
+
+void debayerRemapRows(const cv::Mat& bayer, BayerPattern pattern,
+                      const cv::Mat& map1, const cv::Mat& map2, int interpolation,
+                      cv::Mat& color, int row_begin, int row_end)
+{
+  CV_Assert(bayer.type() == CV_8UC1 || bayer.type() == CV_16UC1);
+  CV_Assert(bayer.rows >= 2 && bayer.cols >= 2);
+  CV_Assert(map1.type() == CV_16SC2 && map2.type() == CV_16UC1);
+  CV_Assert(interpolation == cv::INTER_NEAREST || interpolation == cv::INTER_LINEAR);
+
+  if (interpolation == cv::INTER_NEAREST)
+  {
+    if (bayer.depth() == CV_8U)
+      debayerRemapNearest<uint8_t>(bayer, pattern, map1, color, row_begin, row_end);
+    else
+      debayerRemapNearest<uint16_t>(bayer, pattern, map1, color, row_begin, row_end);
+  }
+  else
+  {
+    if (bayer.depth() == CV_8U)
+      debayerRemapLinear<uint8_t>(bayer, pattern, map1, map2, color, row_begin, row_end);
+    else
+      debayerRemapLinear<uint16_t>(bayer, pattern, map1, map2, color, row_begin, row_end);
+  }
+}
+
+// Luma weights of cv::cvtColor BGR2GRAY, in 14-bit fixed point. The bilinear
+// neighbour sums below carry two more fractional bits, so luma is the weighted
+// sum shifted down by 16.
+static const int LUMA_R = 4899, LUMA_G = 9617, LUMA_B = 1868;
+static const int LUMA_SHIFT = 16;
+
+// In each row, "own" is the color sampled in that row (red or blue) and
+// "opposite" the one sampled in the rows above and below.
+template <typename T>
+static inline T lumaAt(const T* up, const T* row, const T* down, int xl, int x, int xr,
+                       bool colored, unsigned own, unsigned opposite)
+{
+  unsigned horizontal = row[xl] + row[xr];
+  unsigned vertical = up[x] + down[x];
+  unsigned sum;
+  if (colored)
+  {
+    unsigned diagonal = up[xl] + up[xr] + down[xl] + down[xr];
+    sum = 4 * own * row[x] + LUMA_G * (horizontal + vertical) + opposite * diagonal;
+  }
+  else
+    sum = 4 * LUMA_G * row[x] + 2 * own * horizontal + 2 * opposite * vertical;
+  // At most 65535 * 2^16 + 2^15 for 16-bit input, which still fits in 32 bits
+  return (T)((sum + (1u << (LUMA_SHIFT - 1))) >> LUMA_SHIFT);
+}
+
+#if defined(__SSE2__)
+// Per-row constants of the 8-bit kernel. Pixel i of a block is colored if
+// colored_mask is set in lane i; weights are interleaved for _mm_madd_epi16.
+struct LumaWeights
+{
+  __m128i colored_mask;
+  __m128i green_mask;
+  __m128i center_horizontal; // (center, horizontal [+ vertical]) pairs
+  __m128i cross;             // (diagonal or vertical, 0) pairs
+};
+
+static LumaWeights lumaWeights(int colored_lane_parity, int own, int opposite)
+{
+  LumaWeights w;
+  short mask[8], ch[8], cr[8];
+  for (int i = 0; i < 8; ++i)
+    mask[i] = (i & 1) == colored_lane_parity ? -1 : 0;
+  // Pairs for lanes 0-3, which have the same parities as lanes 4-7
+  for (int i = 0; i < 4; ++i)
+  {
+    bool colored = (i & 1) == colored_lane_parity;
+    // Green pixels take twice their center value, keeping weights in int16
+    ch[2 * i]     = colored ? 4 * own : 2 * LUMA_G;
+    ch[2 * i + 1] = colored ? LUMA_G : 2 * own;
+    cr[2 * i]     = colored ? opposite : 2 * opposite;
+    cr[2 * i + 1] = 0;
+  }
+  w.colored_mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+  w.green_mask = _mm_xor_si128(w.colored_mask, _mm_set1_epi16(-1));
+  w.center_horizontal = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ch));
+  w.cross = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cr));
+  return w;
+}
+
+static inline __m128i lumaSums(__m128i a, __m128i b, __m128i c, const LumaWeights& w)
+{
+  const __m128i round = _mm_set1_epi32(1 << (LUMA_SHIFT - 1));
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), w.center_horizontal),
+                             _mm_madd_epi16(_mm_unpacklo_epi16(c, zero), w.cross));
+  __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), w.center_horizontal),
+                             _mm_madd_epi16(_mm_unpackhi_epi16(c, zero), w.cross));
+  lo = _mm_srli_epi32(_mm_add_epi32(lo, round), LUMA_SHIFT);
+  hi = _mm_srli_epi32(_mm_add_epi32(hi, round), LUMA_SHIFT);
+  return _mm_packs_epi32(lo, hi);
+}
+
+// Luma of 8 pixels from their 16-bit samples; l/r are shifted one column left/right
+static inline __m128i luma8(__m128i ul, __m128i u, __m128i ur,
+                            __m128i l, __m128i m, __m128i r,
+                            __m128i dl, __m128i d, __m128i dr, const LumaWeights& w)
+{
+  __m128i vertical = _mm_add_epi16(u, d);
+  __m128i horizontal = _mm_add_epi16(l, r);
+  __m128i diagonal = _mm_add_epi16(_mm_add_epi16(ul, dl), _mm_add_epi16(ur, dr));
+  __m128i a = _mm_add_epi16(m, _mm_and_si128(m, w.green_mask));
+  __m128i b = _mm_add_epi16(horizontal, _mm_and_si128(vertical, w.colored_mask));
+  __m128i c = _mm_or_si128(_mm_and_si128(diagonal, w.colored_mask),
+                           _mm_and_si128(vertical, w.green_mask));
+  return lumaSums(a, b, c, w);
+}
+
+static inline __m128i loadu(const uint8_t* p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// Luma of the 16 pixels starting at column x. Reads columns [x-1, x+16].
+static inline void luma16(const uint8_t* up, const uint8_t* row, const uint8_t* down,
+                          uint8_t* out, int x, const LumaWeights& w)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i ul = loadu(up + x - 1), u = loadu(up + x), ur = loadu(up + x + 1);
+  __m128i l = loadu(row + x - 1), m = loadu(row + x), r = loadu(row + x + 1);
+  __m128i dl = loadu(down + x - 1), d = loadu(down + x), dr = loadu(down + x + 1);
+
+  __m128i lo = luma8(_mm_unpacklo_epi8(ul, zero), _mm_unpacklo_epi8(u, zero), _mm_unpacklo_epi8(ur, zero),
+                     _mm_unpacklo_epi8(l, zero), _mm_unpacklo_epi8(m, zero), _mm_unpacklo_epi8(r, zero),
+                     _mm_unpacklo_epi8(dl, zero), _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(dr, zero), w);
+  __m128i hi = luma8(_mm_unpackhi_epi8(ul, zero), _mm_unpackhi_epi8(u, zero), _mm_unpackhi_epi8(ur, zero),
+                     _mm_unpackhi_epi8(l, zero), _mm_unpackhi_epi8(m, zero), _mm_unpackhi_epi8(r, zero),
+                     _mm_unpackhi_epi8(dl, zero), _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(dr, zero), w);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(lo, hi));
+}
+#endif
+
+template <typename T>
+static void debayerMonoRow(const cv::Mat& bayer, BayerPattern pattern, int y, T* out)
+{
+  const T* up = bayer.ptr<T>(reflect101(y - 1, bayer.rows));
+  const T* row = bayer.ptr<T>(y);
+  const T* down = bayer.ptr<T>(reflect101(y + 1, bayer.rows));
+  bool red_row = (y & 1) == pattern.red_y;
+  unsigned own = red_row ? LUMA_R : LUMA_B;
+  unsigned opposite = red_row ? LUMA_B : LUMA_R;
+  int colored_parity = red_row ? pattern.red_x : 1 - pattern.red_x;
+  int cols = bayer.cols;
+
+  out[0] = lumaAt(up, row, down, 1, 0, 1, colored_parity == 0, own, opposite);
+  int x = 1;
+#if defined(__SSE2__)
+  if (sizeof(T) == 1)
+  {
+    // x stays odd, so lane i is colored when i has the other parity
+    LumaWeights w = lumaWeights(1 - colored_parity, own, opposite);
+    for (; x + 17 <= cols; x += 16)
+      luma16((const uint8_t*)up, (const uint8_t*)row, (const uint8_t*)down, (uint8_t*)out, x, w);
+  }
+#endif
+  for (; x < cols - 1; ++x)
+    out[x] = lumaAt(up, row, down, x - 1, x, x + 1, (x & 1) == colored_parity, own, opposite);
+  out[cols - 1] = lumaAt(up, row, down, cols - 2, cols - 1, cols - 2,
+                         ((cols - 1) & 1) == colored_parity, own, opposite);
+}
+
+void debayerMono(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& mono)
+{
+  CV_Assert(bayer.type() == CV_8UC1 || bayer.type() == CV_16UC1);
+  CV_Assert(bayer.rows >= 2 && bayer.cols >= 2);
+  mono.create(bayer.rows, bayer.cols, bayer.type());
+
+  for (int y = 0; y < bayer.rows; ++y)
+  {
+    if (bayer.depth() == CV_8U)
+      debayerMonoRow<uint8_t>(bayer, pattern, y, mono.ptr<uint8_t>(y));
+    else
+      debayerMonoRow<uint16_t>(bayer, pattern, y, mono.ptr<uint16_t>(y));
+  }
+}
+
+} // namespace image_proc
@@ -0,0 +1,177 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/image_pool.h"
+#include <list>
+#include <boost/thread/mutex.hpp>
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+#include <boost/weak_ptr.hpp>
+#include <sensor_msgs/image_encodings.h>
+
+namespace image_proc {
+
+namespace enc = sensor_msgs::image_encodings;
+
+struct ImagePool::Impl
+{
+  mutable boost::mutex mutex;
+  std::list<sensor_msgs::Image*> free; // most recently returned first
+  size_t max_free;
+
+  explicit Impl(size_t max_free) : max_free(max_free) {}
+
+  ~Impl()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    std::list<sensor_msgs::Image*> released;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      released.swap(free);
+    }
+    for (std::list<sensor_msgs::Image*>::iterator it = released.begin(); it != released.end(); ++it)
+      delete *it;
+  }
+
+  sensor_msgs::Image* take(uint32_t height, uint32_t width, const std::string& encoding, uint32_t step)
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    for (std::list<sensor_msgs::Image*>::iterator it = free.begin(); it != free.end(); ++it)
+    {
+      sensor_msgs::Image* msg = *it;
+      if (msg->height == height && msg->width == width && msg->step == step && msg->encoding == encoding)
+      {
+        free.erase(it);
+        return msg;
+      }
+    }
+    return NULL;
+  }
+
+  void give(sensor_msgs::Image* msg)
+  {
+    sensor_msgs::Image* evicted = NULL;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      free.push_front(msg);
+      if (free.size() > max_free)
+      {
+        evicted = free.back();
+        free.pop_back();
+      }
+    }
+    // Freeing a large buffer can take a while, so do it outside the lock
+    delete evicted;
+  }
+
+  // shared_ptr deleter returning the message to the pool, if it still exists
+  struct Recycler
+  {
+    boost::weak_ptr<Impl> pool;
+
+    explicit Recycler(const boost::shared_ptr<Impl>& pool) : pool(pool) {}
+
+    void operator()(sensor_msgs::Image* msg) const
+    {
+      boost::shared_ptr<Impl> impl = pool.lock();
+      if (impl)
+        impl->give(msg);
+      else
+        delete msg;
+    }
+  };
+};
+
+ImagePool::ImagePool(size_t max_free)
+  : impl_(new Impl(max_free))
+{
+}
+
+ImagePool::~ImagePool()
+{
+}
+
+sensor_msgs::ImagePtr ImagePool::allocate(uint32_t height, uint32_t width,
+                                          const std::string& encoding, uint32_t step)
+{
+  sensor_msgs::Image* msg = impl_->take(height, width, encoding, step);
+  if (msg)
+  {
+    msg->header = std_msgs::Header();
+  }
+  else
+  {
+    msg = new sensor_msgs::Image;
+    msg->height = height;
+    msg->width = width;
+    msg->encoding = encoding;
+    msg->step = step;
+  }
+  msg->is_bigendian = false;
+  // Only a new message pays for the zero fill here; a recycled one already has
+  // the right size, unless a subscriber misbehaved and changed it
+  msg->data.resize((size_t)height * step);
+  return sensor_msgs::ImagePtr(msg, Impl::Recycler(impl_));
+}
+
+sensor_msgs::ImagePtr ImagePool::allocate(uint32_t height, uint32_t width, const std::string& encoding)
+{
+  uint32_t step = width * enc::numChannels(encoding) * (enc::bitDepth(encoding) / 8);
+  return allocate(height, width, encoding, step);
+}
+
+size_t ImagePool::numFree() const
+{
+  boost::lock_guard<boost::mutex> lock(impl_->mutex);
+  return impl_->free.size();
+}
+
+void ImagePool::clear()
+{
+  impl_->clear();
+}
+
+ImagePool& ImagePool::shared()
+{
+  // Enough for a few nodelets each with a frame in flight
+  static ImagePool pool(16);
+  return pool;
+}
+
+} // namespace image_proc
@@ -0,0 +1,200 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/latency_monitor.h"
+#include <algorithm>
+
+namespace image_proc {
+
+LatencyHistogram::LatencyHistogram()
+  : sum_usec_(0), max_usec_(0)
+{
+  for (int i = 0; i < NUM_BUCKETS; ++i)
+    buckets_[i].store(0, boost::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucket(uint64_t usec)
+{
+  if (usec < 4)
+    return (int)usec;
+  // Octave and the two bits below its leading one
+  int e = 2;
+  while (e < 63 && (usec >> (e + 1)) != 0)
+    ++e;
+  int i = 4 * (e - 1) + (int)((usec >> (e - 2)) & 3);
+  return i < NUM_BUCKETS ? i : NUM_BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::bucketStart(int i)
+{
+  if (i < 4)
+    return i;
+  int e = i / 4 + 1;
+  return (uint64_t)(4 + i % 4) << (e - 2);
+}
+
+void LatencyHistogram::record(double seconds)
+{
+  uint64_t usec = seconds > 0.0 ? (uint64_t)(seconds * 1e6 + 0.5) : 0;
+  buckets_[bucket(usec)].fetch_add(1, boost::memory_order_relaxed);
+  sum_usec_.fetch_add(usec, boost::memory_order_relaxed);
+  uint64_t max = max_usec_.load(boost::memory_order_relaxed);
+  while (usec > max && !max_usec_.compare_exchange_weak(max, usec, boost::memory_order_relaxed))
+    ;
+}
+
+LatencyHistogram::Summary LatencyHistogram::takeSummary()
+{
+  // Not an atomic snapshot: a duration recorded meanwhile may land in either window
+  uint64_t counts[NUM_BUCKETS];
+  Summary summary;
+  summary.count = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i)
+  {
+    counts[i] = buckets_[i].exchange(0, boost::memory_order_relaxed);
+    summary.count += counts[i];
+  }
+  uint64_t sum = sum_usec_.exchange(0, boost::memory_order_relaxed);
+  uint64_t max = max_usec_.exchange(0, boost::memory_order_relaxed);
+
+  summary.max = max * 1e-6;
+  summary.mean = summary.count ? sum * 1e-6 / summary.count : 0.0;
+
+  // Interpolate linearly within the bucket holding each percentile
+  double percentiles[3] = {0.5, 0.9, 0.99};
+  double* values[3] = {&summary.p50, &summary.p90, &summary.p99};
+  for (int p = 0; p < 3; ++p)
+  {
+    double target = percentiles[p] * summary.count;
+    uint64_t below = 0;
+    *values[p] = 0.0;
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+      if (counts[i] == 0)
+        continue;
+      if (below + counts[i] >= target)
+      {
+        double start = (double)bucketStart(i);
+        double end = i + 1 < NUM_BUCKETS ? (double)bucketStart(i + 1) : 2.0 * start;
+        double value = start + (end - start) * (target - below) / counts[i];
+        *values[p] = std::min(value, (double)max) * 1e-6;
+        break;
+      }
+      below += counts[i];
+    }
+  }
+  return summary;
+}
+
+LatencyMonitor::LatencyMonitor(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh,
+                               const std::string& name)
+  : frames_(0), dropped_(0), last_seq_(0),
+    window_start_(Clock::now()),
+    updater_(nh, private_nh)
+{
+  updater_.setHardwareID("none");
+  updater_.add(name + " latency", this, &LatencyMonitor::diagnose);
+  timer_ = nh.createTimer(ros::Duration(updater_.getPeriod()), &LatencyMonitor::timerCb, this);
+}
+
+boost::shared_ptr<LatencyMonitor> LatencyMonitor::create(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh,
+                                                         const std::string& name)
+{
+  bool enabled;
+  private_nh.param("instrumentation", enabled, false);
+  if (!enabled)
+    return boost::shared_ptr<LatencyMonitor>();
+  return boost::shared_ptr<LatencyMonitor>(new LatencyMonitor(nh, private_nh, name));
+}
+
+LatencyMonitor::Clock::time_point LatencyMonitor::begin(const std_msgs::Header& input)
+{
+  frames_.fetch_add(1, boost::memory_order_relaxed);
+
+  // Drivers that don't fill in seq leave it at 0; count nothing for those
+  uint32_t last = last_seq_.exchange(input.seq, boost::memory_order_relaxed);
+  if (last != 0 && input.seq > last + 1)
+    dropped_.fetch_add(input.seq - last - 1, boost::memory_order_relaxed);
+
+  if (!input.stamp.isZero())
+    input_age_.record((ros::Time::now() - input.stamp).toSec());
+  return Clock::now();
+}
+
+void LatencyMonitor::end(Clock::time_point start, const ros::Time& stamp)
+{
+  processing_.record(boost::chrono::duration<double>(Clock::now() - start).count());
+  if (!stamp.isZero())
+    output_age_.record((ros::Time::now() - stamp).toSec());
+}
+
+static void addSummary(diagnostic_updater::DiagnosticStatusWrapper& stat, const std::string& name,
+                       const LatencyHistogram::Summary& summary)
+{
+  stat.addf(name + " mean (ms)", "%.3f", summary.mean * 1e3);
+  stat.addf(name + " p50 (ms)", "%.3f", summary.p50 * 1e3);
+  stat.addf(name + " p90 (ms)", "%.3f", summary.p90 * 1e3);
+  stat.addf(name + " p99 (ms)", "%.3f", summary.p99 * 1e3);
+  stat.addf(name + " max (ms)", "%.3f", summary.max * 1e3);
+}
+
+void LatencyMonitor::diagnose(diagnostic_updater::DiagnosticStatusWrapper& stat)
+{
+  Clock::time_point now = Clock::now();
+  double elapsed = boost::chrono::duration<double>(now - window_start_).count();
+  window_start_ = now;
+
+  unsigned long long frames = frames_.exchange(0, boost::memory_order_relaxed);
+  unsigned long long dropped = dropped_.exchange(0, boost::memory_order_relaxed);
+  LatencyHistogram::Summary processing = processing_.takeSummary();
+
+  if (dropped > 0)
+    stat.summaryf(diagnostic_msgs::DiagnosticStatus::WARN, "%llu frames dropped before processing", dropped);
+  else
+    stat.summaryf(diagnostic_msgs::DiagnosticStatus::OK, "%.1f Hz, %.2f ms per frame",
+                  frames / elapsed, processing.mean * 1e3);
+
+  stat.addf("Frames received", "%llu", frames);
+  stat.addf("Frames dropped", "%llu", dropped);
+  stat.addf("Frame rate (Hz)", "%.2f", frames / elapsed);
+  addSummary(stat, "Input age", input_age_.takeSummary());
+  addSummary(stat, "Processing", processing);
+  addSummary(stat, "Output age", output_age_.takeSummary());
+}
+
+void LatencyMonitor::timerCb(const ros::TimerEvent&)
+{
+  updater_.update();
+}
+
+} // namespace image_proc
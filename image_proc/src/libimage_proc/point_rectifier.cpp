@@ -0,0 +1,113 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/point_rectifier.h"
+#include "image_proc/rectifier.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+namespace image_proc {
+
+PointRectifier::PointRectifier(int step)
+  : step_(std::max(step, 1)),
+    inverse_step_(1.0f / std::max(step, 1)),
+    hash_(0),
+    initialized_(false)
+{
+}
+
+void PointRectifier::update(const image_geometry::PinholeCameraModel& model)
+{
+  uint64_t hash = Rectifier::calibrationHash(model.cameraInfo());
+  if (initialized_ && hash == hash_)
+    return;
+  hash_ = hash;
+  initialized_ = true;
+
+  // One node past the last raw pixel, so every pixel is inside a cell
+  cv::Size size = model.reducedResolution();
+  int cols = (size.width - 1) / step_ + 2;
+  int rows = (size.height - 1) / step_ + 2;
+  std::vector<cv::Point2d> raw(rows * cols), rectified;
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      raw[y * cols + x] = cv::Point2d(x * step_, y * step_);
+
+  // cv::undistortPoints() stops after a few fixed-point iterations, which can
+  // leave a tenth of a pixel near the corners of a wide lens, so polish its
+  // answer with Newton's method on the exact forward mapping
+  cv::undistortPoints(raw, rectified, model.intrinsicMatrix(), model.distortionCoeffs(),
+                      model.rotationMatrix(), model.projectionMatrix());
+  const double h = 0.5;
+  size_t n = raw.size();
+  std::vector<cv::Point2d> probes(3 * n), projected;
+  for (int iteration = 0; iteration < 2; ++iteration)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      probes[i] = rectified[i];
+      probes[n + i] = rectified[i] + cv::Point2d(h, 0.0);
+      probes[2 * n + i] = rectified[i] + cv::Point2d(0.0, h);
+    }
+    Rectifier::unrectifyPoints(model, probes, projected);
+    for (size_t i = 0; i < n; ++i)
+    {
+      // Finite-difference Jacobian of rectified -> raw
+      cv::Point2d du = (projected[n + i] - projected[i]) * (1.0 / h);
+      cv::Point2d dv = (projected[2 * n + i] - projected[i]) * (1.0 / h);
+      double det = du.x * dv.y - dv.x * du.y;
+      if (std::fabs(det) < 1e-12)
+        continue;
+      cv::Point2d error = raw[i] - projected[i];
+      rectified[i].x += (dv.y * error.x - dv.x * error.y) / det;
+      rectified[i].y += (du.x * error.y - du.y * error.x) / det;
+    }
+  }
+
+  table_.create(rows, cols, CV_32FC2);
+  for (int y = 0; y < rows; ++y)
+  {
+    cv::Point2f* node = table_.ptr<cv::Point2f>(y);
+    for (int x = 0; x < cols; ++x)
+      node[x] = cv::Point2f((float)rectified[y * cols + x].x, (float)rectified[y * cols + x].y);
+  }
+}
+
+void PointRectifier::rectify(const std::vector<cv::Point2f>& raw, std::vector<cv::Point2f>& rectified) const
+{
+  rectified.resize(raw.size());
+  for (size_t i = 0; i < raw.size(); ++i)
+    rectified[i] = rectify(raw[i]);
+}
+
+} // namespace image_proc
@@ -64,46 +64,66 @@ bool Processor::process(const sensor_msgs::ImageConstPtr& raw_image,
   
   // Bayer case
   if (raw_encoding.find("bayer") != std::string::npos) {
-    // Convert to color BGR
-    /// @todo Faster to convert directly to mono when color is not requested, but OpenCV doesn't support
-    int code = 0;
-    if (raw_encoding == enc::BAYER_RGGB8)
+    // Only rectified color requested: debayer straight through the rectification
+    // maps, skipping the full-size intermediate color image
+    BayerPattern pattern;
+    if ((flags & ALL) == RECT_COLOR && enc::bitDepth(raw_encoding) == 8 &&
+        bayerPattern(raw_encoding, pattern)) {
+      rectifier_.update(model);
+      if (rectifier_.canRectifyBayer(interpolation_)) {
+        rectifier_.rectifyBayer(raw, pattern, output.rect_color, interpolation_);
+        output.color_encoding = enc::BGR8;
+        return true;
+      }
+    }
+
+    // Only mono or rectified mono requested: compute luminance straight from
+    // the mosaic, without building a color image
+    if (!(flags & COLOR_EITHER) && enc::bitDepth(raw_encoding) == 8 &&
+        bayerPattern(raw_encoding, pattern)) {
+      debayerMono(raw, pattern, output.mono);
+    }
+    else {
+      // Convert to color BGR
+      int code = 0;
+      if (raw_encoding == enc::BAYER_RGGB8)
 #if OPENCV3
-      code = cv::COLOR_BayerBG2BGR;
+        code = cv::COLOR_BayerBG2BGR;
 #else
-      code = CV_BayerBG2BGR;
+        code = CV_BayerBG2BGR;
 #endif
-    else if (raw_encoding == enc::BAYER_BGGR8)
+      else if (raw_encoding == enc::BAYER_BGGR8)
 #if OPENCV3
-      code = cv::COLOR_BayerRG2BGR;
+        code = cv::COLOR_BayerRG2BGR;
 #else
-      code = CV_BayerRG2BGR;
+        code = CV_BayerRG2BGR;
 #endif
-    else if (raw_encoding == enc::BAYER_GBRG8)
+      else if (raw_encoding == enc::BAYER_GBRG8)
 #if OPENCV3
-      code = cv::COLOR_BayerGR2BGR;
+        code = cv::COLOR_BayerGR2BGR;
 #else
-      code = CV_BayerGR2BGR;
+        code = CV_BayerGR2BGR;
 #endif
-    else if (raw_encoding == enc::BAYER_GRBG8)
+      else if (raw_encoding == enc::BAYER_GRBG8)
 #if OPENCV3
-      code = cv::COLOR_BayerGB2BGR;
+        code = cv::COLOR_BayerGB2BGR;
 #else
-      code = CV_BayerGB2BGR;
+        code = CV_BayerGB2BGR;
 #endif
-    else {
-      ROS_ERROR("[image_proc] Unsupported encoding '%s'", raw_encoding.c_str());
-      return false;
-    }
-    cv::cvtColor(raw, output.color, code);
-    output.color_encoding = enc::BGR8;
-    
-    if (flags & MONO_EITHER)
+      else {
+        ROS_ERROR("[image_proc] Unsupported encoding '%s'", raw_encoding.c_str());
+        return false;
+      }
+      cv::cvtColor(raw, output.color, code);
+      output.color_encoding = enc::BGR8;
+
+      if (flags & MONO_EITHER)
 #if OPENCV3
-      cv::cvtColor(output.color, output.mono, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(output.color, output.mono, cv::COLOR_BGR2GRAY);
 #else
-      cv::cvtColor(output.color, output.mono, CV_BGR2GRAY);
+        cv::cvtColor(output.color, output.mono, CV_BGR2GRAY);
 #endif
+    }
   }
   // Color case
   else if (raw_type == CV_8UC3) {
@@ -143,10 +163,12 @@ bool Processor::process(const sensor_msgs::ImageConstPtr& raw_image,
   
   /// @todo If no distortion, could just point to the colorized data. But copy is
   /// already way faster than remap.
+  if (flags & (RECT | RECT_COLOR))
+    rectifier_.update(model);
   if (flags & RECT)
-    model.rectifyImage(output.mono, output.rect, interpolation_);
+    rectifier_.rectify(output.mono, output.rect, interpolation_);
   if (flags & RECT_COLOR)
-    model.rectifyImage(output.color, output.rect_color, interpolation_);
+    rectifier_.rectify(output.color, output.rect_color, interpolation_);
 
   return true;
 }
@@ -0,0 +1,555 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/rectifier.h"
+#include "image_proc/worker_pool.h"
+#include <ros/console.h>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/ref.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace image_proc {
+
+// Bump whenever the map file layout or the way maps are built changes
+static const uint64_t MAP_VERSION = 1;
+
+struct MapFileHeader
+{
+  char magic[8];
+  uint64_t hash;
+  int32_t rows, cols;
+  int32_t map1_type, map2_type;
+};
+static const char MAP_MAGIC[8] = {'I', 'P', 'R', 'E', 'C', 'T', 'M', 'P'};
+
+// 64-bit FNV-1a
+static void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+template <typename T>
+static void hashValue(uint64_t& hash, const T& value)
+{
+  hashBytes(hash, &value, sizeof(T));
+}
+
+template <typename Container>
+static void hashArray(uint64_t& hash, const Container& values)
+{
+  hashValue(hash, (uint64_t)values.size());
+  if (!values.empty())
+    hashBytes(hash, &values[0], values.size() * sizeof(values[0]));
+}
+
+Rectifier::Rectifier()
+  : hash_(0),
+    initialized_(false),
+    output_scale_(1.0),
+    output_valid_only_(false)
+{
+}
+
+void Rectifier::setOutput(const cv::Rect& roi, double scale, bool valid_only)
+{
+  output_roi_ = roi;
+  output_scale_ = scale > 0.0 ? scale : 1.0;
+  output_valid_only_ = valid_only;
+}
+
+bool Rectifier::hasOutputRegion() const
+{
+  return output_roi_ != cv::Rect() || output_scale_ != 1.0 || output_valid_only_;
+}
+
+void Rectifier::unrectifyPoints(const image_geometry::PinholeCameraModel& model,
+                                const std::vector<cv::Point2d>& rectified, std::vector<cv::Point2d>& raw)
+{
+  const cv::Matx34d& P = model.projectionMatrix();
+  std::vector<cv::Point3d> rays(rectified.size());
+  for (size_t i = 0; i < rectified.size(); ++i)
+    rays[i] = cv::Point3d((rectified[i].x - P(0,2)) / P(0,0), (rectified[i].y - P(1,2)) / P(1,1), 1.0);
+  cv::Mat r_vec;
+  cv::Rodrigues(model.rotationMatrix().t(), r_vec);
+  cv::projectPoints(rays, r_vec, cv::Vec3d(0.0, 0.0, 0.0), model.intrinsicMatrix(),
+                    model.distortionCoeffs(), raw);
+}
+
+// True if the rectified pixels from (x, y) to (x + dx * (n - 1), y + dy * (n - 1)) all come from raw pixels
+static bool segmentValid(const image_geometry::PinholeCameraModel& model, const cv::Size& size,
+                         int x, int y, int dx, int dy, int n)
+{
+  std::vector<cv::Point2d> rectified(n), raw;
+  for (int i = 0; i < n; ++i)
+    rectified[i] = cv::Point2d(x + i * dx, y + i * dy);
+  Rectifier::unrectifyPoints(model, rectified, raw);
+  for (int i = 0; i < n; ++i)
+  {
+    if (!(raw[i].x >= 0.0 && raw[i].x <= size.width - 1 && raw[i].y >= 0.0 && raw[i].y <= size.height - 1))
+      return false;
+  }
+  return true;
+}
+
+cv::Rect Rectifier::validRegion(const image_geometry::PinholeCameraModel& model)
+{
+  // Every pixel of the raw border, at the current binning and ROI
+  cv::Size size = model.reducedResolution();
+  std::vector<cv::Point2f> border;
+  for (int x = 0; x < size.width; ++x)
+  {
+    border.push_back(cv::Point2f(x, 0));
+    border.push_back(cv::Point2f(x, size.height - 1));
+  }
+  for (int y = 0; y < size.height; ++y)
+  {
+    border.push_back(cv::Point2f(0, y));
+    border.push_back(cv::Point2f(size.width - 1, y));
+  }
+  std::vector<cv::Point2f> rectified;
+  cv::undistortPoints(border, rectified, model.intrinsicMatrix(), model.distortionCoeffs(),
+                      model.rotationMatrix(), model.projectionMatrix());
+
+  // Innermost extent of each side, assuming the rectified border stays convex or concave
+  float left = 0.0f, right = size.width - 1, top = 0.0f, bottom = size.height - 1;
+  for (int x = 0; x < size.width; ++x)
+  {
+    top    = std::max(top,    rectified[2 * x].y);
+    bottom = std::min(bottom, rectified[2 * x + 1].y);
+  }
+  for (int y = 0; y < size.height; ++y)
+  {
+    left  = std::max(left,  rectified[2 * size.width + 2 * y].x);
+    right = std::min(right, rectified[2 * size.width + 2 * y + 1].x);
+  }
+  cv::Rect region(cvCeil(left), cvCeil(top), cvFloor(right) - cvCeil(left) + 1,
+                  cvFloor(bottom) - cvCeil(top) + 1);
+
+  // undistortPoints() only iterates a few times, so check the sides with the
+  // exact forward mapping and pull in any that stick out
+  for (int i = 0; i < 16 && region.width > 0 && region.height > 0; ++i)
+  {
+    cv::Point br = region.br() - cv::Point(1, 1);
+    bool top_valid    = segmentValid(model, size, region.x, region.y, 1, 0, region.width);
+    bool bottom_valid = segmentValid(model, size, region.x, br.y,     1, 0, region.width);
+    bool left_valid   = segmentValid(model, size, region.x, region.y, 0, 1, region.height);
+    bool right_valid  = segmentValid(model, size, br.x,     region.y, 0, 1, region.height);
+    if (top_valid && bottom_valid && left_valid && right_valid)
+      break;
+    region.y += !top_valid;
+    region.height -= !top_valid + !bottom_valid;
+    region.x += !left_valid;
+    region.width -= !left_valid + !right_valid;
+  }
+  if (region.width <= 0 || region.height <= 0)
+    return cv::Rect(0, 0, size.width, size.height);
+  return region;
+}
+
+uint64_t Rectifier::calibrationHash(const sensor_msgs::CameraInfo& info)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  hashValue(hash, MAP_VERSION);
+  hashValue(hash, info.height);
+  hashValue(hash, info.width);
+  hashArray(hash, info.distortion_model);
+  hashArray(hash, info.D);
+  hashArray(hash, info.K);
+  hashArray(hash, info.R);
+  hashArray(hash, info.P);
+  hashValue(hash, info.binning_x);
+  hashValue(hash, info.binning_y);
+  hashValue(hash, info.roi.x_offset);
+  hashValue(hash, info.roi.y_offset);
+  hashValue(hash, info.roi.height);
+  hashValue(hash, info.roi.width);
+  return hash;
+}
+
+// Intrinsics at the binned resolution
+static void binnedIntrinsics(const image_geometry::PinholeCameraModel& model,
+                             cv::Matx33d& K_binned, cv::Matx34d& P_binned)
+{
+  int binning_x = model.binningX();
+  int binning_y = model.binningY();
+  K_binned = model.fullIntrinsicMatrix();
+  P_binned = model.fullProjectionMatrix();
+  if (binning_x > 1)
+  {
+    double scale_x = 1.0 / binning_x;
+    K_binned(0,0) *= scale_x;
+    K_binned(0,2) *= scale_x;
+    P_binned(0,0) *= scale_x;
+    P_binned(0,2) *= scale_x;
+    P_binned(0,3) *= scale_x;
+  }
+  if (binning_y > 1)
+  {
+    double scale_y = 1.0 / binning_y;
+    K_binned(1,1) *= scale_y;
+    K_binned(1,2) *= scale_y;
+    P_binned(1,1) *= scale_y;
+    P_binned(1,2) *= scale_y;
+    P_binned(1,3) *= scale_y;
+  }
+}
+
+void Rectifier::update(const image_geometry::PinholeCameraModel& model)
+{
+  const sensor_msgs::CameraInfo& info = model.cameraInfo();
+  uint64_t hash = calibrationHash(info);
+  if (hasOutputRegion())
+  {
+    hashValue(hash, output_roi_.x);
+    hashValue(hash, output_roi_.y);
+    hashValue(hash, output_roi_.width);
+    hashValue(hash, output_roi_.height);
+    hashValue(hash, output_scale_);
+    hashValue(hash, output_valid_only_);
+  }
+  if (initialized_ && hash == hash_)
+    return;
+
+  hash_ = hash;
+  initialized_ = true;
+  map1_.release();
+  map2_.release();
+  region_.reset();
+
+  // The raw ROI at the binned resolution, which is what rectify() produces by default
+  int binning_x = model.binningX();
+  int binning_y = model.binningY();
+  cv::Rect raw_roi = model.rawRoi();
+  raw_roi.x /= binning_x;
+  raw_roi.y /= binning_y;
+  raw_roi.width  /= binning_x;
+  raw_roi.height /= binning_y;
+
+  // Clip the requested output to it, or to the part of it with valid pixels
+  cv::Rect bounds(0, 0, raw_roi.width, raw_roi.height);
+  if (output_valid_only_)
+    bounds &= validRegion(model);
+  cv::Rect roi = output_roi_;
+  roi.x = std::min(std::max(roi.x, bounds.x), bounds.br().x - 1);
+  roi.y = std::min(std::max(roi.y, bounds.y), bounds.br().y - 1);
+  roi.width  = roi.width  > 0 ? std::min(roi.width,  bounds.br().x - roi.x) : bounds.br().x - roi.x;
+  roi.height = roi.height > 0 ? std::min(roi.height, bounds.br().y - roi.y) : bounds.br().y - roi.y;
+  output_rect_ = roi + raw_roi.tl();
+  output_size_ = output_rect_.size();
+  if (output_scale_ != 1.0)
+  {
+    output_size_.width  = std::max(cvRound(output_rect_.width  * output_scale_), 1);
+    output_size_.height = std::max(cvRound(output_rect_.height * output_scale_), 1);
+  }
+
+  // Output pixel centers are scale apart, and the corner ones half a pixel in
+  // from the corners of the region, as with cv::resize():
+  //   u_out = (u_rect - output_rect_.x + 0.5) * scale - 0.5
+  cv::Matx33d K_binned;
+  binnedIntrinsics(model, K_binned, output_P_);
+  double shift[2] = { (double)output_rect_.x, (double)output_rect_.y };
+  for (int i = 0; i < 2; ++i)
+  {
+    if (output_scale_ == 1.0)
+    {
+      output_P_(i,2) -= shift[i];
+      continue;
+    }
+    output_P_(i,i) *= output_scale_;
+    output_P_(i,2) = (output_P_(i,2) - shift[i] + 0.5) * output_scale_ - 0.5;
+    output_P_(i,3) *= output_scale_;
+  }
+
+  output_info_ = info;
+  output_info_.width  = output_size_.width;
+  output_info_.height = output_size_.height;
+  std::fill(output_info_.D.begin(), output_info_.D.end(), 0.0);
+  for (int i = 0; i < 9; ++i)
+  {
+    output_info_.K[i] = output_P_(i / 3, i % 3);
+    output_info_.R[i] = (i % 4 == 0) ? 1.0 : 0.0;
+  }
+  for (int i = 0; i < 12; ++i)
+    output_info_.P[i] = output_P_(i / 4, i % 4);
+  output_info_.binning_x = output_info_.binning_y = 0;
+  output_info_.roi = sensor_msgs::RegionOfInterest();
+
+  // Same test PinholeCameraModel uses: all-zero distortion means rectification is a copy
+  bool distorted = false;
+  for (size_t i = 0; i < info.D.size(); ++i)
+    distorted = distorted || info.D[i] != 0.0;
+  if (!distorted && output_rect_ == raw_roi && output_scale_ == 1.0)
+    return;
+
+  if (!cache_dir_.empty() && loadMaps())
+    return;
+
+  buildMaps(model);
+
+  if (!cache_dir_.empty())
+    saveMaps();
+}
+
+void Rectifier::buildMaps(const image_geometry::PinholeCameraModel& model)
+{
+  int binning_x = model.binningX();
+  int binning_y = model.binningY();
+  cv::Matx33d K_binned;
+  cv::Matx34d P_binned;
+  binnedIntrinsics(model, K_binned, P_binned);
+
+  // map1 holds integer (x,y) offsets, which we adjust by the ROI offset so they
+  // index the raw image; map2 holds LUT indices for subpixel interpolation, left as-is.
+  cv::Rect raw_roi = model.rawRoi();
+  cv::Scalar raw_offset(raw_roi.x / binning_x, raw_roi.y / binning_y);
+
+  // Note: m1type=CV_16SC2 to use fast fixed-point maps (see cv::remap)
+  cv::Mat full_map1, full_map2;
+  if (output_scale_ != 1.0)
+  {
+    // Build the maps straight from raw pixels to the scaled output
+    cv::initUndistortRectifyMap(K_binned, model.distortionCoeffs(), model.rotationMatrix(),
+                                output_P_, output_size_, CV_16SC2, full_map1, full_map2);
+    if (raw_offset != cv::Scalar())
+      full_map1 -= raw_offset;
+    map1_ = full_map1;
+    map2_ = full_map2;
+    return;
+  }
+
+  // Build the full-size maps at the binned resolution
+  cv::Size binned_resolution = model.fullResolution();
+  binned_resolution.width  /= binning_x;
+  binned_resolution.height /= binning_y;
+  cv::initUndistortRectifyMap(K_binned, model.distortionCoeffs(), model.rotationMatrix(),
+                              P_binned, binned_resolution, CV_16SC2, full_map1, full_map2);
+
+  // Reduce to the output region
+  if (output_rect_.size() != binned_resolution)
+  {
+    map1_ = full_map1(output_rect_) - raw_offset;
+    map2_ = full_map2(output_rect_).clone();
+  }
+  else
+  {
+    map1_ = full_map1;
+    map2_ = full_map2;
+  }
+}
+
+std::string Rectifier::cachePath() const
+{
+  char name[64];
+  snprintf(name, sizeof(name), "rectify_%016llx.map", (unsigned long long)hash_);
+  return (boost::filesystem::path(cache_dir_) / name).string();
+}
+
+bool Rectifier::loadMaps()
+{
+  namespace bip = boost::interprocess;
+  std::string path = cachePath();
+  try
+  {
+    if (!boost::filesystem::exists(path))
+      return false;
+
+    bip::file_mapping file(path.c_str(), bip::read_only);
+    boost::shared_ptr<bip::mapped_region> region(new bip::mapped_region(file, bip::read_only));
+    if (region->get_size() < sizeof(MapFileHeader))
+      return false;
+
+    MapFileHeader header;
+    memcpy(&header, region->get_address(), sizeof(header));
+    if (memcmp(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC)) != 0 || header.hash != hash_ ||
+        header.map1_type != CV_16SC2 || header.map2_type != CV_16UC1)
+    {
+      ROS_WARN("[image_proc] Ignoring invalid rectification map cache '%s'", path.c_str());
+      return false;
+    }
+
+    size_t map1_size = (size_t)header.rows * header.cols * CV_ELEM_SIZE(CV_16SC2);
+    size_t map2_size = (size_t)header.rows * header.cols * CV_ELEM_SIZE(CV_16UC1);
+    if (region->get_size() != sizeof(header) + map1_size + map2_size)
+    {
+      ROS_WARN("[image_proc] Ignoring truncated rectification map cache '%s'", path.c_str());
+      return false;
+    }
+
+    // The maps are only ever read, so pointing at the read-only mapping is safe
+    uint8_t* data = static_cast<uint8_t*>(region->get_address()) + sizeof(header);
+    map1_ = cv::Mat(header.rows, header.cols, CV_16SC2, data);
+    map2_ = cv::Mat(header.rows, header.cols, CV_16UC1, data + map1_size);
+    region_ = region;
+    return true;
+  }
+  catch (const std::exception& e)
+  {
+    ROS_WARN("[image_proc] Failed to load rectification map cache '%s': %s", path.c_str(), e.what());
+    map1_.release();
+    map2_.release();
+    return false;
+  }
+}
+
+static void writeMat(std::ofstream& out, const cv::Mat& mat)
+{
+  size_t row_size = mat.cols * mat.elemSize();
+  for (int y = 0; y < mat.rows; ++y)
+    out.write(reinterpret_cast<const char*>(mat.ptr(y)), row_size);
+}
+
+void Rectifier::saveMaps() const
+{
+  std::string path = cachePath();
+  // Write to a temporary file and rename it into place, so that other
+  // processes never map a partially written file. Each save gets its own
+  // temporary, as nodelets in one process may save the same maps at once.
+  boost::filesystem::path tmp_path;
+  try
+  {
+    boost::filesystem::create_directories(cache_dir_);
+
+    MapFileHeader header;
+    memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+    header.hash = hash_;
+    header.rows = map1_.rows;
+    header.cols = map1_.cols;
+    header.map1_type = map1_.type();
+    header.map2_type = map2_.type();
+
+    tmp_path = boost::filesystem::unique_path(path + ".%%%%-%%%%-%%%%-%%%%.tmp");
+    {
+      std::ofstream out(tmp_path.string().c_str(), std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      writeMat(out, map1_);
+      writeMat(out, map2_);
+      if (!out)
+        throw std::runtime_error("write failed");
+    }
+    boost::filesystem::rename(tmp_path, path);
+  }
+  catch (const std::exception& e)
+  {
+    ROS_WARN("[image_proc] Failed to save rectification map cache '%s': %s", path.c_str(), e.what());
+    if (!tmp_path.empty())
+    {
+      boost::system::error_code ignored;
+      boost::filesystem::remove(tmp_path, ignored);
+    }
+  }
+}
+
+// Splits rows [0, rows) into bands and calls fn(row_begin, row_end) for each on the pool
+static void runBand(const boost::function<void (int, int)>* fn, int rows, int num_bands, int band)
+{
+  (*fn)(rows * band / num_bands, rows * (band + 1) / num_bands);
+}
+
+static void forEachBand(WorkerPool& pool, int rows, const boost::function<void (int, int)>& fn)
+{
+  // A few bands per thread evens out the load where the remap hits the cache unevenly
+  int num_bands = std::min(pool.size() * 4, rows);
+  pool.parallelFor(num_bands, boost::bind(&runBand, &fn, rows, num_bands, _1));
+}
+
+void Rectifier::rectify(const cv::Mat& raw, cv::Mat& rectified, int interpolation) const
+{
+  if (!hasMaps())
+    raw.copyTo(rectified);
+  else
+    cv::remap(raw, rectified, map1_, map2_, interpolation);
+}
+
+void Rectifier::rectify(const cv::Mat& raw, cv::Mat& rectified, int interpolation,
+                        WorkerPool& pool) const
+{
+  if (!hasMaps() || pool.size() == 1)
+  {
+    rectify(raw, rectified, interpolation);
+    return;
+  }
+
+  rectified.create(map1_.size(), raw.type());
+  forEachBand(pool, rectified.rows,
+              boost::bind(&Rectifier::rectifyRows, this, boost::cref(raw), boost::ref(rectified),
+                          interpolation, _1, _2));
+}
+
+void Rectifier::rectifyRows(const cv::Mat& raw, cv::Mat& rectified, int interpolation,
+                            int row_begin, int row_end) const
+{
+  cv::Mat band = rectified.rowRange(row_begin, row_end);
+  if (!hasMaps())
+    raw.rowRange(row_begin, row_end).copyTo(band);
+  else
+    cv::remap(raw, band, map1_.rowRange(row_begin, row_end), map2_.rowRange(row_begin, row_end),
+              interpolation);
+}
+
+bool Rectifier::canRectifyBayer(int interpolation) const
+{
+  return hasMaps() && (interpolation == cv::INTER_NEAREST || interpolation == cv::INTER_LINEAR);
+}
+
+void Rectifier::rectifyBayer(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color,
+                             int interpolation) const
+{
+  debayerRemap(bayer, pattern, map1_, map2_, interpolation, color);
+}
+
+void Rectifier::rectifyBayer(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color,
+                             int interpolation, WorkerPool& pool) const
+{
+  color.create(map1_.size(), CV_MAKETYPE(bayer.depth(), 3));
+  forEachBand(pool, color.rows,
+              boost::bind(&debayerRemapRows, boost::cref(bayer), pattern, boost::cref(map1_),
+                          boost::cref(map2_), interpolation, boost::ref(color), _1, _2));
+}
+
+} // namespace image_proc
@@ -0,0 +1,166 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "image_proc/worker_pool.h"
+#include <algorithm>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <stdexcept>
+
+namespace image_proc {
+
+// Workers and the caller take items by index until none are left. Helper tasks
+// still queued when the caller returns find nothing to take, so the batch is
+// shared with them rather than living on the caller's stack.
+struct WorkerPool::Batch
+{
+  Batch(int n, const boost::function<void (int)>* fn)
+    : n(n), fn(fn), next(0), completed(0), failed(false)
+  {
+  }
+
+  const int n;
+  const boost::function<void (int)>* fn; // only valid while items are left to take
+  boost::atomic<int> next;
+
+  boost::mutex mutex;
+  boost::condition_variable done;
+  int completed;
+  bool failed;
+  std::string error; // from the first item that threw
+};
+
+WorkerPool::WorkerPool(int num_threads)
+  : shutdown_(false)
+{
+  for (int i = 1; i < num_threads; ++i)
+    threads_.create_thread(boost::bind(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(queue_mutex_);
+    shutdown_ = true;
+  }
+  queue_cond_.notify_all();
+  threads_.join_all();
+}
+
+void WorkerPool::parallelFor(int n, const boost::function<void (int)>& fn)
+{
+  if (n <= 0)
+    return;
+
+  // Nothing to gain from handing off a single item, or with no workers
+  if (n == 1 || threads_.size() == 0)
+  {
+    for (int i = 0; i < n; ++i)
+      fn(i);
+    return;
+  }
+
+  // Wake at most one helper per item besides our own
+  boost::shared_ptr<Batch> batch = boost::make_shared<Batch>(n, &fn);
+  int helpers = std::min(n - 1, (int)threads_.size());
+  {
+    boost::lock_guard<boost::mutex> lock(queue_mutex_);
+    for (int i = 0; i < helpers; ++i)
+      queue_.push_back(boost::bind(&WorkerPool::runItems, batch));
+  }
+  queue_cond_.notify_all();
+
+  // Work through the items alongside the helpers, then wait for the ones they took
+  runItems(batch);
+  boost::unique_lock<boost::mutex> lock(batch->mutex);
+  while (batch->completed < n)
+    batch->done.wait(lock);
+  if (batch->failed)
+    throw std::runtime_error(batch->error);
+}
+
+void WorkerPool::runItems(const boost::shared_ptr<Batch>& batch)
+{
+  while (true)
+  {
+    int i = batch->next.fetch_add(1, boost::memory_order_relaxed);
+    if (i >= batch->n)
+      return;
+
+    std::string error;
+    bool failed = false;
+    try
+    {
+      (*batch->fn)(i);
+    }
+    catch (std::exception& e)
+    {
+      failed = true;
+      error = e.what();
+    }
+    catch (...)
+    {
+      failed = true;
+      error = "unknown exception";
+    }
+
+    boost::lock_guard<boost::mutex> lock(batch->mutex);
+    if (failed && !batch->failed)
+    {
+      batch->failed = true;
+      batch->error = error;
+    }
+    if (++batch->completed == batch->n)
+      batch->done.notify_all();
+  }
+}
+void WorkerPool::workerLoop()
+{
+  while (true)
+  {
+    boost::function<void ()> task;
+    {
+      boost::unique_lock<boost::mutex> lock(queue_mutex_);
+      while (queue_.empty() && !shutdown_)
+        queue_cond_.wait(lock);
+      if (queue_.empty())
+        return; // shutting down
+      task.swap(queue_.front());
+      queue_.pop_front();
+    }
+    task();
+  }
+}
+
+} // namespace image_proc
@@ -0,0 +1,417 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "color_convert.h"
+#include "simd.h"
+#include <sensor_msgs/image_encodings.h>
+#include <algorithm>
+#include <cstring>
+
+namespace image_proc {
+
+namespace enc = sensor_msgs::image_encodings;
+
+bool yuv422Order(const std::string& encoding, Yuv422Order& order)
+{
+  if (encoding == enc::YUV422)
+    order = YUV422_UYVY;
+  // Spelled out, as older sensor_msgs have no constant for it
+  else if (encoding == "yuv422_yuy2")
+    order = YUV422_YUYV;
+  else
+    return false;
+  return true;
+}
+
+bool packedLayout(const std::string& encoding, PackedLayout& layout)
+{
+  if (encoding == enc::RGB8 || encoding == enc::BGR8)
+    layout.channels = 3;
+  else if (encoding == enc::RGBA8 || encoding == enc::BGRA8)
+    layout.channels = 4;
+  else
+    return false;
+  layout.red = (encoding == enc::RGB8 || encoding == enc::RGBA8) ? 0 : 2;
+  return true;
+}
+
+namespace {
+
+// BT.601 video range, as in cv::cvtColor: Y' = 1.164 (Y - 16), then
+// R = Y' + 1.596 V, G = Y' - 0.391 U - 0.813 V, B = Y' + 2.018 U with U and V
+// centered on 128. 13 fractional bits keep every coefficient in int16 for
+// _mm_madd_epi16.
+const int YUV_SHIFT = 13;
+const int YUV_CY  = 9535;
+const int YUV_CVR = 13074;
+const int YUV_CUG = -3203;
+const int YUV_CVG = -6660;
+const int YUV_CUB = 16531;
+
+// Luma weights of cv::cvtColor BGR2GRAY, in 14-bit fixed point
+const int LUMA_R = 4899, LUMA_G = 9617, LUMA_B = 1868;
+const int LUMA_SHIFT = 14;
+
+inline uint8_t saturateByte(int v)
+{
+  return (uint8_t)std::min(std::max(v, 0), 255);
+}
+
+// Converts the two pixels of one 4-byte group. In both orders Y0 is at byte
+// luma and Y1 at luma + 2, with U and V in the other two.
+inline void yuvPairToBGR(const uint8_t* src, int luma, uint8_t* dst)
+{
+  int u = src[1 - luma] - 128, v = src[3 - luma] - 128;
+  int round = 1 << (YUV_SHIFT - 1);
+  int b = round + YUV_CUB * u;
+  int g = round + YUV_CUG * u + YUV_CVG * v;
+  int r = round + YUV_CVR * v;
+  for (int i = 0; i < 2; ++i)
+  {
+    int y = std::max(src[luma + 2 * i] - 16, 0) * YUV_CY;
+    dst[3 * i]     = saturateByte((y + b) >> YUV_SHIFT);
+    dst[3 * i + 1] = saturateByte((y + g) >> YUV_SHIFT);
+    dst[3 * i + 2] = saturateByte((y + r) >> YUV_SHIFT);
+  }
+}
+
+inline uint8_t gray(unsigned b, unsigned g, unsigned r)
+{
+  return (uint8_t)((b * LUMA_B + g * LUMA_G + r * LUMA_R + (1u << (LUMA_SHIFT - 1))) >> LUMA_SHIFT);
+}
+
+/*
+ * Vectorized rows. Each returns how many pixels it wrote, leaving the rest to
+ * the scalar loops.
+ */
+
+#if defined(__SSE2__)
+
+// Two int16 lanes (a, b), repeated, as the second operand of _mm_madd_epi16
+inline __m128i pairs(int a, int b)
+{
+  return _mm_set1_epi32((int)(((unsigned)b << 16) | (a & 0xFFFF)));
+}
+
+// One channel of 8 pixels, from the luma terms of pixels 0-3 and 4-7 and the
+// chroma terms of their 4 groups
+inline __m128i yuvChannel(__m128i y_lo, __m128i y_hi, __m128i uv)
+{
+  __m128i lo = _mm_add_epi32(y_lo, _mm_unpacklo_epi32(uv, uv));
+  __m128i hi = _mm_add_epi32(y_hi, _mm_unpackhi_epi32(uv, uv));
+  return _mm_packs_epi32(_mm_srai_epi32(lo, YUV_SHIFT), _mm_srai_epi32(hi, YUV_SHIFT));
+}
+
+// B, G and R of 8 pixels as int16 lanes, from 16 bytes of YUV 4:2:2
+inline void yuv8(const uint8_t* src, int luma, __m128i& b, __m128i& g, __m128i& r)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low_byte = _mm_set1_epi16(0xFF);
+  const __m128i round = _mm_set1_epi32(1 << (YUV_SHIFT - 1));
+  __m128i v = simd::load(src);
+  __m128i y = luma ? _mm_srli_epi16(v, 8) : _mm_and_si128(v, low_byte);
+  __m128i c = luma ? _mm_and_si128(v, low_byte) : _mm_srli_epi16(v, 8);
+  y = _mm_max_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), zero);
+  c = _mm_sub_epi16(c, _mm_set1_epi16(128)); // (U, V) of each group
+
+  __m128i y_lo = _mm_madd_epi16(_mm_unpacklo_epi16(y, zero), pairs(YUV_CY, 0));
+  __m128i y_hi = _mm_madd_epi16(_mm_unpackhi_epi16(y, zero), pairs(YUV_CY, 0));
+  b = yuvChannel(y_lo, y_hi, _mm_add_epi32(_mm_madd_epi16(c, pairs(YUV_CUB, 0)), round));
+  g = yuvChannel(y_lo, y_hi, _mm_add_epi32(_mm_madd_epi16(c, pairs(YUV_CUG, YUV_CVG)), round));
+  r = yuvChannel(y_lo, y_hi, _mm_add_epi32(_mm_madd_epi16(c, pairs(0, YUV_CVR)), round));
+}
+
+int yuv422ToBGRRowSimd(const uint8_t* src, uint8_t* dst, int width, int luma)
+{
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    __m128i b0, g0, r0, b1, g1, r1;
+    yuv8(src + 2 * x, luma, b0, g0, r0);
+    yuv8(src + 2 * x + 16, luma, b1, g1, r1);
+    simd::storeBGR(dst + 3 * x, _mm_packus_epi16(b0, b1), _mm_packus_epi16(g0, g1),
+                   _mm_packus_epi16(r0, r1));
+  }
+  return x;
+}
+
+int yuv422ToMonoRowSimd(const uint8_t* src, uint8_t* dst, int width, int luma)
+{
+  const __m128i low_byte = _mm_set1_epi16(0xFF);
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    __m128i a = simd::load(src + 2 * x), b = simd::load(src + 2 * x + 16);
+    if (luma)
+    {
+      a = _mm_srli_epi16(a, 8);
+      b = _mm_srli_epi16(b, 8);
+    }
+    else
+    {
+      a = _mm_and_si128(a, low_byte);
+      b = _mm_and_si128(b, low_byte);
+    }
+    simd::store(dst + x, _mm_packus_epi16(a, b));
+  }
+  return x;
+}
+
+// Luma of 8 pixels from their int16 channels
+inline __m128i luma8(__m128i b, __m128i g, __m128i r)
+{
+  const __m128i round_one = _mm_set1_epi16(1);
+  __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(b, g), pairs(LUMA_B, LUMA_G)),
+                             _mm_madd_epi16(_mm_unpacklo_epi16(r, round_one),
+                                            pairs(LUMA_R, 1 << (LUMA_SHIFT - 1))));
+  __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(b, g), pairs(LUMA_B, LUMA_G)),
+                             _mm_madd_epi16(_mm_unpackhi_epi16(r, round_one),
+                                            pairs(LUMA_R, 1 << (LUMA_SHIFT - 1))));
+  return _mm_packs_epi32(_mm_srli_epi32(lo, LUMA_SHIFT), _mm_srli_epi32(hi, LUMA_SHIFT));
+}
+
+inline __m128i luma16(__m128i b, __m128i g, __m128i r)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo = luma8(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(r, zero));
+  __m128i hi = luma8(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(r, zero));
+  return _mm_packus_epi16(lo, hi);
+}
+
+#elif defined(IMAGE_PROC_SIMD) // NEON
+
+// One channel of 16 pixels, as even and odd pixels sharing the chroma terms of their group
+inline uint8x8_t yuvNarrow(int16x8_t y, int32x4_t uv_lo, int32x4_t uv_hi)
+{
+  int32x4_t lo = vmlal_n_s16(uv_lo, vget_low_s16(y), YUV_CY);
+  int32x4_t hi = vmlal_n_s16(uv_hi, vget_high_s16(y), YUV_CY);
+  return vqmovun_s16(vcombine_s16(vshrn_n_s32(lo, YUV_SHIFT), vshrn_n_s32(hi, YUV_SHIFT)));
+}
+
+inline uint8x16_t yuvChannel(int16x8_t y0, int16x8_t y1, int32x4_t uv_lo, int32x4_t uv_hi)
+{
+  uint8x8x2_t zipped = vzip_u8(yuvNarrow(y0, uv_lo, uv_hi), yuvNarrow(y1, uv_lo, uv_hi));
+  return vcombine_u8(zipped.val[0], zipped.val[1]);
+}
+
+// Y - 16, clamped at 0
+inline int16x8_t yuvLuma(uint8x8_t y)
+{
+  return vmaxq_s16(vreinterpretq_s16_u16(vsubl_u8(y, vdup_n_u8(16))), vdupq_n_s16(0));
+}
+
+int yuv422ToBGRRowSimd(const uint8_t* src, uint8_t* dst, int width, int luma)
+{
+  const int32x4_t round = vdupq_n_s32(1 << (YUV_SHIFT - 1));
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    uint8x8x4_t groups = vld4_u8(src + 2 * x);
+    int16x8_t y0 = yuvLuma(groups.val[luma]);
+    int16x8_t y1 = yuvLuma(groups.val[luma + 2]);
+    int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(groups.val[1 - luma], vdup_n_u8(128)));
+    int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(groups.val[3 - luma], vdup_n_u8(128)));
+    int16x4_t u_lo = vget_low_s16(u), u_hi = vget_high_s16(u);
+    int16x4_t v_lo = vget_low_s16(v), v_hi = vget_high_s16(v);
+
+    uint8x16_t b = yuvChannel(y0, y1, vmlal_n_s16(round, u_lo, YUV_CUB),
+                              vmlal_n_s16(round, u_hi, YUV_CUB));
+    uint8x16_t g = yuvChannel(y0, y1, vmlal_n_s16(vmlal_n_s16(round, u_lo, YUV_CUG), v_lo, YUV_CVG),
+                              vmlal_n_s16(vmlal_n_s16(round, u_hi, YUV_CUG), v_hi, YUV_CVG));
+    uint8x16_t r = yuvChannel(y0, y1, vmlal_n_s16(round, v_lo, YUV_CVR),
+                              vmlal_n_s16(round, v_hi, YUV_CVR));
+    simd::storeBGR(dst + 3 * x, b, g, r);
+  }
+  return x;
+}
+
+int yuv422ToMonoRowSimd(const uint8_t* src, uint8_t* dst, int width, int luma)
+{
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+    vst1q_u8(dst + x, vld2q_u8(src + 2 * x).val[luma]);
+  return x;
+}
+
+inline uint8x8_t luma8(uint8x8_t b, uint8x8_t g, uint8x8_t r)
+{
+  uint16x8_t b16 = vmovl_u8(b), g16 = vmovl_u8(g), r16 = vmovl_u8(r);
+  uint32x4_t lo = vmull_n_u16(vget_low_u16(b16), LUMA_B);
+  uint32x4_t hi = vmull_n_u16(vget_high_u16(b16), LUMA_B);
+  lo = vmlal_n_u16(vmlal_n_u16(lo, vget_low_u16(g16), LUMA_G), vget_low_u16(r16), LUMA_R);
+  hi = vmlal_n_u16(vmlal_n_u16(hi, vget_high_u16(g16), LUMA_G), vget_high_u16(r16), LUMA_R);
+  return vmovn_u16(vcombine_u16(vrshrn_n_u32(lo, LUMA_SHIFT), vrshrn_n_u32(hi, LUMA_SHIFT)));
+}
+
+inline uint8x16_t luma16(uint8x16_t b, uint8x16_t g, uint8x16_t r)
+{
+  return vcombine_u8(luma8(vget_low_u8(b), vget_low_u8(g), vget_low_u8(r)),
+                     luma8(vget_high_u8(b), vget_high_u8(g), vget_high_u8(r)));
+}
+
+#endif
+
+#ifdef IMAGE_PROC_SIMD
+int packedToBGRRowSimd(const uint8_t* src, uint8_t* dst, int width, PackedLayout layout)
+{
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+#if defined(__SSE2__)
+    __m128i c[4];
+#else
+    uint8x16_t c[4];
+#endif
+    if (layout.channels == 3)
+      simd::loadPlanes3(src + 3 * x, c[0], c[1], c[2]);
+    else
+      simd::loadPlanes4(src + 4 * x, c[0], c[1], c[2], c[3]);
+    simd::storeBGR(dst + 3 * x, c[2 - layout.red], c[1], c[layout.red]);
+  }
+  return x;
+}
+
+int packedToMonoRowSimd(const uint8_t* src, uint8_t* dst, int width, PackedLayout layout)
+{
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+#if defined(__SSE2__)
+    __m128i c[4];
+#else
+    uint8x16_t c[4];
+#endif
+    if (layout.channels == 3)
+      simd::loadPlanes3(src + 3 * x, c[0], c[1], c[2]);
+    else
+      simd::loadPlanes4(src + 4 * x, c[0], c[1], c[2], c[3]);
+#if defined(__SSE2__)
+    simd::store(dst + x, luma16(c[2 - layout.red], c[1], c[layout.red]));
+#else
+    vst1q_u8(dst + x, luma16(c[2 - layout.red], c[1], c[layout.red]));
+#endif
+  }
+  return x;
+}
+#endif
+
+} // namespace
+
+void yuv422ToBGR(const cv::Mat& yuv, Yuv422Order order, cv::Mat& bgr)
+{
+  CV_Assert(yuv.type() == CV_8UC2 && yuv.cols % 2 == 0);
+  bgr.create(yuv.rows, yuv.cols, CV_8UC3);
+  int luma = order == YUV422_UYVY ? 1 : 0;
+
+  for (int y = 0; y < yuv.rows; ++y)
+  {
+    const uint8_t* src = yuv.ptr<uint8_t>(y);
+    uint8_t* dst = bgr.ptr<uint8_t>(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    x = yuv422ToBGRRowSimd(src, dst, yuv.cols, luma);
+#endif
+    for (; x < yuv.cols; x += 2)
+      yuvPairToBGR(src + 2 * x, luma, dst + 3 * x);
+  }
+}
+
+void yuv422ToMono(const cv::Mat& yuv, Yuv422Order order, cv::Mat& mono)
+{
+  CV_Assert(yuv.type() == CV_8UC2);
+  mono.create(yuv.rows, yuv.cols, CV_8UC1);
+  int luma = order == YUV422_UYVY ? 1 : 0;
+
+  for (int y = 0; y < yuv.rows; ++y)
+  {
+    const uint8_t* src = yuv.ptr<uint8_t>(y);
+    uint8_t* dst = mono.ptr<uint8_t>(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    x = yuv422ToMonoRowSimd(src, dst, yuv.cols, luma);
+#endif
+    for (; x < yuv.cols; ++x)
+      dst[x] = src[2 * x + luma];
+  }
+}
+
+void packedToBGR(const cv::Mat& src, PackedLayout layout, cv::Mat& bgr)
+{
+  CV_Assert(src.type() == CV_MAKETYPE(CV_8U, layout.channels));
+  CV_Assert((layout.channels == 3 || layout.channels == 4) && (layout.red == 0 || layout.red == 2));
+  bgr.create(src.rows, src.cols, CV_8UC3);
+  int n = layout.channels, red = layout.red, blue = 2 - red;
+
+  for (int y = 0; y < src.rows; ++y)
+  {
+    const uint8_t* s = src.ptr<uint8_t>(y);
+    uint8_t* d = bgr.ptr<uint8_t>(y);
+    if (n == 3 && red == 2)
+    {
+      memcpy(d, s, 3 * src.cols);
+      continue;
+    }
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    x = packedToBGRRowSimd(s, d, src.cols, layout);
+#endif
+    for (; x < src.cols; ++x)
+    {
+      d[3 * x]     = s[n * x + blue];
+      d[3 * x + 1] = s[n * x + 1];
+      d[3 * x + 2] = s[n * x + red];
+    }
+  }
+}
+
+void packedToMono(const cv::Mat& src, PackedLayout layout, cv::Mat& mono)
+{
+  CV_Assert(src.type() == CV_MAKETYPE(CV_8U, layout.channels));
+  CV_Assert((layout.channels == 3 || layout.channels == 4) && (layout.red == 0 || layout.red == 2));
+  mono.create(src.rows, src.cols, CV_8UC1);
+  int n = layout.channels, red = layout.red, blue = 2 - red;
+
+  for (int y = 0; y < src.rows; ++y)
+  {
+    const uint8_t* s = src.ptr<uint8_t>(y);
+    uint8_t* d = mono.ptr<uint8_t>(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    x = packedToMonoRowSimd(s, d, src.cols, layout);
+#endif
+    for (; x < src.cols; ++x)
+      d[x] = gray(s[n * x + blue], s[n * x + 1], s[n * x + red]);
+  }
+}
+
+} // namespace image_proc
@@ -0,0 +1,84 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_COLOR_CONVERT
+#define IMAGE_PROC_COLOR_CONVERT
+
+#include <opencv2/core/core.hpp>
+#include <string>
+
+// Conversions of packed 8-bit camera encodings used by DebayerNodelet, written
+// straight into the output image instead of going through cv_bridge.
+
+namespace image_proc {
+
+/// Byte order of a YUV 4:2:2 encoding
+enum Yuv422Order
+{
+  YUV422_UYVY, // U0 Y0 V0 Y1, the ROS "yuv422" encoding
+  YUV422_YUYV  // Y0 U0 Y1 V0, "yuv422_yuy2"
+};
+
+/// Looks up the byte order of a YUV 4:2:2 encoding. Returns false for other encodings.
+bool yuv422Order(const std::string& encoding, Yuv422Order& order);
+
+/**
+ * Converts CV_8UC2 YUV 4:2:2 of even width to BGR8 with the BT.601 video-range
+ * coefficients of cv::cvtColor COLOR_YUV2BGR_UYVY (or _YUYV). Computed in
+ * 13-bit fixed point, so it is within one level of cvtColor.
+ */
+void yuv422ToBGR(const cv::Mat& yuv, Yuv422Order order, cv::Mat& bgr);
+
+/// Extracts the luma plane of CV_8UC2 YUV 4:2:2 into MONO8, like COLOR_YUV2GRAY_UYVY.
+void yuv422ToMono(const cv::Mat& yuv, Yuv422Order order, cv::Mat& mono);
+
+/// Layout of a packed 8-bit color encoding. Green is always channel 1 and blue
+/// is channel 2 - red; a fourth channel, if any, is ignored.
+struct PackedLayout
+{
+  int channels;
+  int red;
+};
+
+/// Looks up the layout of rgb8, bgr8, rgba8 and bgra8. Returns false for other encodings.
+bool packedLayout(const std::string& encoding, PackedLayout& layout);
+
+/// Reorders packed 8-bit color to BGR8, dropping alpha.
+void packedToBGR(const cv::Mat& src, PackedLayout layout, cv::Mat& bgr);
+
+/// Same result as cv::cvtColor to GRAY, for packed 8-bit color in the given layout.
+void packedToMono(const cv::Mat& src, PackedLayout layout, cv::Mat& mono);
+
+} // namespace image_proc
+
+#endif
@@ -43,7 +43,11 @@
 #include <dynamic_reconfigure/server.h>
 #include <cv_bridge/cv_bridge.h>
 #include <image_proc/CropDecimateConfig.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/image_pool.h>
+#include <image_proc/latency_monitor.h>
 #include <opencv2/imgproc/imgproc.hpp>
+#include "decimate.h"
 
 namespace image_proc {
 
@@ -64,7 +68,10 @@ class CropDecimateNodelet : public nodelet::Nodelet
   typedef image_proc::CropDecimateConfig Config;
   typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
   boost::shared_ptr<ReconfigureServer> reconfigure_server_;
-  Config config_;
+  ConfigSnapshot<Config> config_;
+
+  // Latency statistics, null unless ~instrumentation is set
+  boost::shared_ptr<LatencyMonitor> monitor_;
 
   virtual void onInit();
 
@@ -87,6 +94,7 @@ void CropDecimateNodelet::onInit()
 
   // Read parameters
   private_nh.param("queue_size", queue_size_, 5);
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
 
   // Set up dynamic reconfigure
   reconfigure_server_.reset(new ReconfigureServer(config_mutex_, private_nh));
@@ -114,70 +122,16 @@ void CropDecimateNodelet::connectCb()
   }
 }
 
-template <typename T>
-void debayer2x2toBGR(const cv::Mat& src, cv::Mat& dst, int R, int G1, int G2, int B)
-{
-  typedef cv::Vec<T, 3> DstPixel; // 8- or 16-bit BGR
-  dst.create(src.rows / 2, src.cols / 2, cv::DataType<DstPixel>::type);
-
-  int src_row_step = src.step1();
-  int dst_row_step = dst.step1();
-  const T* src_row = src.ptr<T>();
-  T* dst_row = dst.ptr<T>();
-
-  // 2x2 downsample and debayer at once
-  for (int y = 0; y < dst.rows; ++y)
-  {
-    for (int x = 0; x < dst.cols; ++x)
-    {
-      dst_row[x*3 + 0] = src_row[x*2 + B];
-      dst_row[x*3 + 1] = (src_row[x*2 + G1] + src_row[x*2 + G2]) / 2;
-      dst_row[x*3 + 2] = src_row[x*2 + R];
-    }
-    src_row += src_row_step * 2;
-    dst_row += dst_row_step;
-  }
-}
-
-// Templated on pixel size, in bytes (MONO8 = 1, BGR8 = 3, RGBA16 = 8, ...)
-template <int N>
-void decimate(const cv::Mat& src, cv::Mat& dst, int decimation_x, int decimation_y)
-{
-  dst.create(src.rows / decimation_y, src.cols / decimation_x, src.type());
-
-  int src_row_step = src.step[0] * decimation_y;
-  int src_pixel_step = N * decimation_x;
-  int dst_row_step = dst.step[0];
-
-  const uint8_t* src_row = src.ptr();
-  uint8_t* dst_row = dst.ptr();
-  
-  for (int y = 0; y < dst.rows; ++y)
-  {
-    const uint8_t* src_pixel = src_row;
-    uint8_t* dst_pixel = dst_row;
-    for (int x = 0; x < dst.cols; ++x)
-    {
-      memcpy(dst_pixel, src_pixel, N); // Should inline with small, fixed N
-      src_pixel += src_pixel_step;
-      dst_pixel += N;
-    }
-    src_row += src_row_step;
-    dst_row += dst_row_step;
-  }
-}
-
 void CropDecimateNodelet::imageCb(const sensor_msgs::ImageConstPtr& image_msg,
                                   const sensor_msgs::CameraInfoConstPtr& info_msg)
 {
+  LatencyMonitor::Scope scope(monitor_.get(), image_msg->header);
+
   /// @todo Check image dimensions match info_msg
   /// @todo Publish tweaks to config_ so they appear in reconfigure_gui
 
-  Config config;
-  {
-    boost::lock_guard<boost::recursive_mutex> lock(config_mutex_);
-    config = config_;
-  }
+  // Copy, since the Bayer case adjusts the ROI below
+  Config config = *config_.get();
   int decimation_x = config.decimation_x;
   int decimation_y = config.decimation_y;
 
@@ -216,127 +170,103 @@ void CropDecimateNodelet::imageCb(const sensor_msgs::ImageConstPtr& image_msg,
 
   // Get a cv::Mat view of the source data
   CvImageConstPtr source = toCvShare(image_msg);
-
-  // Except in Bayer downsampling case, output has same encoding as the input
-  CvImage output(source->header, source->encoding);
   // Apply ROI (no copy, still a view of the image_msg data)
-  output.image = source->image(cv::Rect(config.x_offset, config.y_offset, width, height));
+  const cv::Mat roi = source->image(cv::Rect(config.x_offset, config.y_offset, width, height));
 
-  // Special case: when decimating Bayer images, we first do a 2x2 decimation to BGR
-  if (is_bayer && (decimation_x > 1 || decimation_y > 1))
+  // Except in Bayer downsampling case, output has same encoding as the input
+  std::string encoding = image_msg->encoding;
+  int type = roi.type();
+  bool debayer = is_bayer && (decimation_x > 1 || decimation_y > 1);
+  if (debayer)
   {
     if (decimation_x % 2 != 0 || decimation_y % 2 != 0)
     {
       NODELET_ERROR_THROTTLE(2, "Odd decimation not supported for Bayer images");
       return;
     }
-
-    cv::Mat bgr;
-    int step = output.image.step1();
-    if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_RGGB8)
-      debayer2x2toBGR<uint8_t>(output.image, bgr, 0, 1, step, step + 1);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_BGGR8)
-      debayer2x2toBGR<uint8_t>(output.image, bgr, step + 1, 1, step, 0);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_GBRG8)
-      debayer2x2toBGR<uint8_t>(output.image, bgr, step, 0, step + 1, 1);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_GRBG8)
-      debayer2x2toBGR<uint8_t>(output.image, bgr, 1, 0, step + 1, step);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_RGGB16)
-      debayer2x2toBGR<uint16_t>(output.image, bgr, 0, 1, step, step + 1);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_BGGR16)
-      debayer2x2toBGR<uint16_t>(output.image, bgr, step + 1, 1, step, 0);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_GBRG16)
-      debayer2x2toBGR<uint16_t>(output.image, bgr, step, 0, step + 1, 1);
-    else if (image_msg->encoding == sensor_msgs::image_encodings::BAYER_GRBG16)
-      debayer2x2toBGR<uint16_t>(output.image, bgr, 1, 0, step + 1, step);
+    if (roi.depth() == CV_8U)
+      encoding = sensor_msgs::image_encodings::BGR8;
     else
-    {
-      NODELET_ERROR_THROTTLE(2, "Unrecognized Bayer encoding '%s'", image_msg->encoding.c_str());
-      return;
-    }
+      encoding = sensor_msgs::image_encodings::BGR16;
+    type = CV_MAKETYPE(roi.depth(), 3);
+  }
 
-    output.image = bgr;
-    output.encoding = (bgr.depth() == CV_8U) ? sensor_msgs::image_encodings::BGR8
-                                             : sensor_msgs::image_encodings::BGR16;
-    decimation_x /= 2;
-    decimation_y /= 2;
+  // Allocate the output message up front, and have the kernels write straight into it
+  int out_width = width / decimation_x;
+  int out_height = height / decimation_y;
+  if (out_width <= 0 || out_height <= 0)
+  {
+    NODELET_WARN_THROTTLE(2, "Dropping frame: %dx%d crop decimated by %dx%d leaves no pixels",
+                          width, height, decimation_x, decimation_y);
+    return;
   }
+  int out_step = out_width * CV_ELEM_SIZE(type);
+  sensor_msgs::ImagePtr out_image =
+    ImagePool::shared().allocate(out_height, out_width, encoding, out_step);
+  out_image->header = image_msg->header;
+  cv::Mat output(out_height, out_width, type, &out_image->data[0], out_step);
 
-  // Apply further downsampling, if necessary
-  if (decimation_x > 1 || decimation_y > 1)
+  if (debayer)
   {
-    cv::Mat decimated;
+    BayerPattern pattern;
+    if (!bayerPattern(image_msg->encoding, pattern))
+    {
+      NODELET_ERROR_THROTTLE(2, "Unrecognized Bayer encoding '%s'", image_msg->encoding.c_str());
+      return;
+    }
 
-    if (config.interpolation == image_proc::CropDecimate_NN)
+    if (config.interpolation == image_proc::CropDecimate_Area)
+    {
+      // Average all same-color samples of each window, straight from the raw image
+      binBayerToBGR(roi, pattern, output, decimation_x, decimation_y);
+    }
+    else if (config.interpolation == image_proc::CropDecimate_NN ||
+             (decimation_x == 2 && decimation_y == 2))
     {
-      // Use optimized method instead of OpenCV's more general NN resize
-      int pixel_size = output.image.elemSize();
-      switch (pixel_size)
-      {
-        // Currently support up through 4-channel float
-        case 1:
-          decimate<1>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 2:
-          decimate<2>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 3:
-          decimate<3>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 4:
-          decimate<4>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 6:
-          decimate<6>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 8:
-          decimate<8>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 12:
-          decimate<12>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        case 16:
-          decimate<16>(output.image, decimated, decimation_x, decimation_y);
-          break;
-        default:
-          NODELET_ERROR_THROTTLE(2, "Unsupported pixel size, %d bytes", pixel_size);
-          return;
-      }
+      // 2x2 decimation to BGR. With nearest neighbor the rest of the decimation
+      // just skips 2x2 cells, so that is done in the same pass.
+      debayer2x2toBGR(roi, pattern, output, decimation_x, decimation_y);
     }
     else
     {
-      // Linear, cubic, area, ...
-      cv::Size size(output.image.cols / decimation_x, output.image.rows / decimation_y);
-      cv::resize(output.image, decimated, size, 0.0, 0.0, config.interpolation);
+      // 2x2 decimation to BGR, then linear, cubic, ... on the half-resolution image
+      cv::Mat bgr;
+      debayer2x2toBGR(roi, pattern, bgr, 2, 2);
+      cv::resize(bgr, output, output.size(), 0.0, 0.0, config.interpolation);
     }
-
-    output.image = decimated;
   }
-
-  // Create output Image message
-  /// @todo Could save copies by allocating this above and having output.image alias it
-  sensor_msgs::ImagePtr out_image = output.toImageMsg();
+  else if (decimation_x == 1 && decimation_y == 1)
+  {
+    // Pure crop. The message has to own its data, so this is the one copy left.
+    roi.copyTo(output);
+  }
+  else if (config.interpolation == image_proc::CropDecimate_NN)
+  {
+    // Use optimized method instead of OpenCV's more general NN resize
+    if (!decimateNearest(roi, output, decimation_x, decimation_y))
+    {
+      // Currently support up through 4-channel float
+      NODELET_ERROR_THROTTLE(2, "Unsupported pixel size, %d bytes", (int)roi.elemSize());
+      return;
+    }
+  }
+  else
+  {
+    // Linear, cubic, area, ...
+    cv::resize(roi, output, output.size(), 0.0, 0.0, config.interpolation);
+  }
 
   // Create updated CameraInfo message
-  sensor_msgs::CameraInfoPtr out_info = boost::make_shared<sensor_msgs::CameraInfo>(*info_msg);
-  int binning_x = std::max((int)info_msg->binning_x, 1);
-  int binning_y = std::max((int)info_msg->binning_y, 1);
-  out_info->binning_x = binning_x * config.decimation_x;
-  out_info->binning_y = binning_y * config.decimation_y;
-  out_info->roi.x_offset += config.x_offset * binning_x;
-  out_info->roi.y_offset += config.y_offset * binning_y;
-  out_info->roi.height = height * binning_y;
-  out_info->roi.width = width * binning_x;
-  // If no ROI specified, leave do_rectify as-is. If ROI specified, set do_rectify = true.
-  if (width != (int)image_msg->width || height != (int)image_msg->height)
-    out_info->roi.do_rectify = true;
-  
+  cv::Rect crop(config.x_offset, config.y_offset, width, height);
+  sensor_msgs::CameraInfoPtr out_info =
+    decimateCameraInfo(*info_msg, image_msg->width, image_msg->height, crop, decimation_x, decimation_y);
+
   pub_.publish(out_image, out_info);
 }
 
 void CropDecimateNodelet::configCb(Config &config, uint32_t level)
 {
-  config_ = config;
+  config_.set(config);
 }
 
 } // namespace image_proc
@@ -31,11 +31,11 @@
 *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 *  POSSIBILITY OF SUCH DAMAGE.
 *********************************************************************/
-#include <boost/make_shared.hpp>
 #include <boost/version.hpp>
 #if ((BOOST_VERSION / 100) % 1000) >= 53
 #include <boost/thread/lock_guard.hpp>
 #endif
+#include <boost/make_shared.hpp>
 
 #include <ros/ros.h>
 #include <nodelet/nodelet.h>
@@ -43,10 +43,15 @@
 #include <sensor_msgs/image_encodings.h>
 #include <dynamic_reconfigure/server.h>
 #include <image_proc/DebayerConfig.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/image_pool.h>
+#include <image_proc/latency_monitor.h>
 
 #include <opencv2/imgproc/imgproc.hpp>
 // Until merged into OpenCV
 #include "edge_aware.h"
+#include "color_convert.h"
+#include "packed_bayer.h"
 
 #include <cv_bridge/cv_bridge.h>
 
@@ -69,7 +74,17 @@ class DebayerNodelet : public nodelet::Nodelet
   typedef image_proc::DebayerConfig Config;
   typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
   boost::shared_ptr<ReconfigureServer> reconfigure_server_;
-  Config config_;
+  // The config and the tone curve made from it, swapped in together
+  struct Settings
+  {
+    Config config;
+    // 8-bit tone curve for packed Bayer input, null unless tone_map is set
+    boost::shared_ptr<const std::vector<uint8_t> > tone_curve;
+  };
+  ConfigSnapshot<Settings> settings_;
+
+  // Latency statistics, null unless ~instrumentation is set
+  boost::shared_ptr<LatencyMonitor> monitor_;
 
   virtual void onInit();
 
@@ -85,6 +100,7 @@ void DebayerNodelet::onInit()
   ros::NodeHandle &nh         = getNodeHandle();
   ros::NodeHandle &private_nh = getPrivateNodeHandle();
   it_.reset(new image_transport::ImageTransport(nh));
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
 
   // Set up dynamic reconfigure
   reconfigure_server_.reset(new ReconfigureServer(config_mutex_, private_nh));
@@ -115,16 +131,100 @@ void DebayerNodelet::connectCb()
 
 void DebayerNodelet::imageCb(const sensor_msgs::ImageConstPtr& raw_msg)
 {
-  int bit_depth = enc::bitDepth(raw_msg->encoding);
-  //@todo Fix as soon as bitDepth fixes it
-  if (raw_msg->encoding == enc::YUV422)
-    bit_depth = 8;
+  LatencyMonitor::Scope scope(monitor_.get(), raw_msg->header);
+  boost::shared_ptr<const Settings> settings = settings_.get();
+
+  // bitDepth() does not know every YUV 4:2:2 encoding. Odd widths have no
+  // complete last chroma pair and are left to cv_bridge.
+  Yuv422Order yuv_order;
+  bool yuv422 = yuv422Order(raw_msg->encoding, yuv_order);
+  bool yuv422_direct = yuv422 && raw_msg->width % 2 == 0;
+
+  // Nor the packed Bayer encodings. They are unpacked here, so check their size first.
+  BayerPattern packed_pattern;
+  int packed_bits = 0;
+  bool is_packed = packedBayerFormat(raw_msg->encoding, packed_pattern, packed_bits);
+
+  // Every debayering path needs at least one full 2x2 Bayer cell
+  if ((is_packed || enc::isBayer(raw_msg->encoding)) && (raw_msg->width < 2 || raw_msg->height < 2))
+  {
+    NODELET_ERROR_THROTTLE(10, "Raw image topic '%s' has %ux%u %s data, too small to debayer",
+                           sub_raw_.getTopic().c_str(), raw_msg->width, raw_msg->height,
+                           raw_msg->encoding.c_str());
+    return;
+  }
+
+  if (is_packed)
+  {
+    int row_bytes = packedRowBytes(raw_msg->width, packed_bits);
+    if (row_bytes == 0 || raw_msg->height < 2 || raw_msg->step < (uint32_t)row_bytes ||
+        raw_msg->data.size() < (size_t)raw_msg->step * raw_msg->height)
+    {
+      NODELET_ERROR_THROTTLE(10, "Raw image topic '%s' has %ux%u %s data of inconsistent size",
+                             sub_raw_.getTopic().c_str(), raw_msg->width, raw_msg->height,
+                             raw_msg->encoding.c_str());
+      return;
+    }
+  }
+  int bit_depth = yuv422 ? 8 : packed_bits ? 16 : enc::bitDepth(raw_msg->encoding);
 
   // First publish to mono if needed
   if (pub_mono_.getNumSubscribers())
   {
+    BayerPattern pattern;
+    PackedLayout layout;
     if (enc::isMono(raw_msg->encoding))
       pub_mono_.publish(raw_msg);
+    else if (packed_bits)
+    {
+      const std::vector<uint8_t>* curve = settings->tone_curve.get();
+      const cv::Mat packed(raw_msg->height, packedRowBytes(raw_msg->width, packed_bits), CV_8UC1,
+                           const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
+      cv::Mat bayer, luma;
+      unpackBayer(packed, raw_msg->width, packed_bits, bayer);
+      sensor_msgs::ImagePtr gray_msg =
+        ImagePool::shared().allocate(raw_msg->height, raw_msg->width, curve ? enc::MONO8 : enc::MONO16);
+      gray_msg->header = raw_msg->header;
+      cv::Mat gray(gray_msg->height, gray_msg->width, curve ? CV_8UC1 : CV_16UC1,
+                   &gray_msg->data[0], gray_msg->step);
+      if (curve)
+      {
+        debayerMono(bayer, packed_pattern, luma);
+        toneMap(luma, *curve, gray);
+      }
+      else
+        debayerMono(bayer, packed_pattern, gray);
+      pub_mono_.publish(gray_msg);
+    }
+    else if (bayerPattern(raw_msg->encoding, pattern))
+    {
+      // Luminance straight from the mosaic, without debayering to color first
+      int type = bit_depth == 8 ? CV_8UC1 : CV_16UC1;
+      const cv::Mat bayer(raw_msg->height, raw_msg->width, type,
+                          const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
+      sensor_msgs::ImagePtr gray_msg =
+        ImagePool::shared().allocate(raw_msg->height, raw_msg->width,
+                                     bit_depth == 8 ? enc::MONO8 : enc::MONO16);
+      gray_msg->header = raw_msg->header;
+      cv::Mat gray(gray_msg->height, gray_msg->width, type, &gray_msg->data[0], gray_msg->step);
+      debayerMono(bayer, pattern, gray);
+      pub_mono_.publish(gray_msg);
+    }
+    else if (yuv422_direct || packedLayout(raw_msg->encoding, layout))
+    {
+      sensor_msgs::ImagePtr gray_msg =
+        ImagePool::shared().allocate(raw_msg->height, raw_msg->width, enc::MONO8);
+      gray_msg->header = raw_msg->header;
+      cv::Mat gray(gray_msg->height, gray_msg->width, CV_8UC1, &gray_msg->data[0], gray_msg->step);
+      int type = yuv422_direct ? CV_8UC2 : CV_MAKETYPE(CV_8U, layout.channels);
+      const cv::Mat raw(raw_msg->height, raw_msg->width, type,
+                        const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
+      if (yuv422_direct)
+        yuv422ToMono(raw, yuv_order, gray);
+      else
+        packedToMono(raw, layout, gray);
+      pub_mono_.publish(gray_msg);
+    }
     else
     {
       if ((bit_depth != 8) && (bit_depth != 16))
@@ -168,47 +268,82 @@ void DebayerNodelet::imageCb(const sensor_msgs::ImageConstPtr& raw_msg)
   }
   else if (enc::isColor(raw_msg->encoding))
   {
-    pub_color_.publish(raw_msg);
+    // Passing the message through is free, so only convert if asked to
+    PackedLayout layout;
+    if (settings->config.color_to_bgr && raw_msg->encoding != enc::BGR8 &&
+        packedLayout(raw_msg->encoding, layout))
+    {
+      sensor_msgs::ImagePtr color_msg =
+        ImagePool::shared().allocate(raw_msg->height, raw_msg->width, enc::BGR8);
+      color_msg->header = raw_msg->header;
+      const cv::Mat raw(raw_msg->height, raw_msg->width, CV_MAKETYPE(CV_8U, layout.channels),
+                        const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
+      cv::Mat color(color_msg->height, color_msg->width, CV_8UC3, &color_msg->data[0], color_msg->step);
+      packedToBGR(raw, layout, color);
+      pub_color_.publish(color_msg);
+    }
+    else
+      pub_color_.publish(raw_msg);
+  }
+  else if (packed_bits)
+  {
+    int algorithm = settings->config.debayer;
+    const std::vector<uint8_t>* curve = settings->tone_curve.get();
+
+    const cv::Mat packed(raw_msg->height, packedRowBytes(raw_msg->width, packed_bits), CV_8UC1,
+                         const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
+    sensor_msgs::ImagePtr color_msg =
+      ImagePool::shared().allocate(raw_msg->height, raw_msg->width, curve ? enc::BGR8 : enc::BGR16);
+    color_msg->header = raw_msg->header;
+    cv::Mat color(color_msg->height, color_msg->width, curve ? CV_8UC3 : CV_16UC3,
+                  &color_msg->data[0], color_msg->step);
+
+    if (algorithm == Debayer_EdgeAware ||
+        algorithm == Debayer_EdgeAwareWeighted)
+    {
+      cv::Mat bayer, color16;
+      unpackBayer(packed, raw_msg->width, packed_bits, bayer);
+      cv::Mat& out = curve ? color16 : color;
+      if (algorithm == Debayer_EdgeAware)
+        debayerEdgeAware(bayer, packed_pattern, out);
+      else
+        debayerEdgeAwareWeighted(bayer, packed_pattern, out);
+      if (curve)
+        toneMap(color16, *curve, color);
+    }
+    else
+    {
+      // Unpack and debayer in one pass. OpenCV's VNG only takes 8-bit input,
+      // so it is bilinear here as well.
+      debayerPacked(packed, raw_msg->width, packed_bits, packed_pattern, curve, color);
+    }
+    pub_color_.publish(color_msg);
   }
   else if (enc::isBayer(raw_msg->encoding)) {
     int type = bit_depth == 8 ? CV_8U : CV_16U;
     const cv::Mat bayer(raw_msg->height, raw_msg->width, CV_MAKETYPE(type, 1),
                         const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
 
-      sensor_msgs::ImagePtr color_msg = boost::make_shared<sensor_msgs::Image>();
+      sensor_msgs::ImagePtr color_msg =
+        ImagePool::shared().allocate(raw_msg->height, raw_msg->width,
+                                     bit_depth == 8? enc::BGR8 : enc::BGR16);
       color_msg->header   = raw_msg->header;
-      color_msg->height   = raw_msg->height;
-      color_msg->width    = raw_msg->width;
-      color_msg->encoding = bit_depth == 8? enc::BGR8 : enc::BGR16;
-      color_msg->step     = color_msg->width * 3 * (bit_depth / 8);
-      color_msg->data.resize(color_msg->height * color_msg->step);
 
       cv::Mat color(color_msg->height, color_msg->width, CV_MAKETYPE(type, 3),
                     &color_msg->data[0], color_msg->step);
 
-      int algorithm;
-      {
-        boost::lock_guard<boost::recursive_mutex> lock(config_mutex_);
-        algorithm = config_.debayer;
-      }
+      int algorithm = settings->config.debayer;
       
       if (algorithm == Debayer_EdgeAware ||
           algorithm == Debayer_EdgeAwareWeighted)
       {
         // These algorithms are not in OpenCV yet
-        if (raw_msg->encoding != enc::BAYER_GRBG8)
-        {
-          NODELET_WARN_THROTTLE(30, "Edge aware algorithms currently only support GRBG8 Bayer. "
-                                "Falling back to bilinear interpolation.");
-          algorithm = Debayer_Bilinear;
-        }
+        BayerPattern pattern;
+        bayerPattern(raw_msg->encoding, pattern);
+        if (algorithm == Debayer_EdgeAware)
+          debayerEdgeAware(bayer, pattern, color);
         else
-        {
-          if (algorithm == Debayer_EdgeAware)
-            debayerEdgeAware(bayer, color);
-          else
-            debayerEdgeAwareWeighted(bayer, color);
-        }
+          debayerEdgeAwareWeighted(bayer, pattern, color);
       }
       if (algorithm == Debayer_Bilinear ||
           algorithm == Debayer_VNG)
@@ -255,6 +390,17 @@ void DebayerNodelet::imageCb(const sensor_msgs::ImageConstPtr& raw_msg)
       
       pub_color_.publish(color_msg);
   }
+  else if (yuv422_direct)
+  {
+    sensor_msgs::ImagePtr color_msg =
+      ImagePool::shared().allocate(raw_msg->height, raw_msg->width, enc::BGR8);
+    color_msg->header = raw_msg->header;
+    const cv::Mat yuv(raw_msg->height, raw_msg->width, CV_8UC2,
+                      const_cast<uint8_t*>(&raw_msg->data[0]), raw_msg->step);
+    cv::Mat color(color_msg->height, color_msg->width, CV_8UC3, &color_msg->data[0], color_msg->step);
+    yuv422ToBGR(yuv, yuv_order, color);
+    pub_color_.publish(color_msg);
+  }
   else if (raw_msg->encoding == enc::YUV422)
   {
     // Use cv_bridge to convert to BGR8
@@ -286,7 +432,18 @@ void DebayerNodelet::imageCb(const sensor_msgs::ImageConstPtr& raw_msg)
 
 void DebayerNodelet::configCb(Config &config, uint32_t level)
 {
-  config_ = config;
+  boost::shared_ptr<const Settings> current = settings_.get();
+  Settings settings;
+  settings.config = config;
+  if (config.tone_map && current->tone_curve && config.gamma == current->config.gamma)
+    settings.tone_curve = current->tone_curve;
+  else if (config.tone_map)
+  {
+    boost::shared_ptr<std::vector<uint8_t> > curve = boost::make_shared<std::vector<uint8_t> >();
+    toneCurve(config.gamma, *curve);
+    settings.tone_curve = curve;
+  }
+  settings_.set(settings);
 }
 
 } // namespace image_proc
@@ -0,0 +1,448 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "decimate.h"
+#include "simd.h"
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace image_proc {
+
+namespace {
+
+// Copies output pixels [x_begin, width) of one row
+template <int N>
+void decimateRow(const uint8_t* src, uint8_t* dst, int x_begin, int width, int decimation_x)
+{
+  const uint8_t* src_pixel = src + x_begin * N * decimation_x;
+  uint8_t* dst_pixel = dst + x_begin * N;
+  for (int x = x_begin; x < width; ++x)
+  {
+    memcpy(dst_pixel, src_pixel, N);
+    src_pixel += N * decimation_x;
+    dst_pixel += N;
+  }
+}
+
+/*
+ * Vectorized rows. Each returns how many output pixels it wrote, leaving the
+ * rest to decimateRow(). Reads stay within the src_bytes bytes of the source
+ * row and writes within the width pixels of the output row.
+ */
+#if defined(__SSE2__)
+
+int decimateRow1(const uint8_t* src, uint8_t* dst, int width, int src_bytes, int decimation_x)
+{
+  int x = 0;
+  if (decimation_x == 2)
+  {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; x + 16 <= width && 2 * x + 32 <= src_bytes; x += 16)
+    {
+      const uint8_t* s = src + 2 * x;
+      simd::store(dst + x, _mm_packus_epi16(_mm_and_si128(simd::load(s), mask),
+                                            _mm_and_si128(simd::load(s + 16), mask)));
+    }
+  }
+  else if (decimation_x == 4)
+  {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    for (; x + 16 <= width && 4 * x + 64 <= src_bytes; x += 16)
+    {
+      const uint8_t* s = src + 4 * x;
+      __m128i lo = _mm_packs_epi32(_mm_and_si128(simd::load(s), mask),
+                                   _mm_and_si128(simd::load(s + 16), mask));
+      __m128i hi = _mm_packs_epi32(_mm_and_si128(simd::load(s + 32), mask),
+                                   _mm_and_si128(simd::load(s + 48), mask));
+      simd::store(dst + x, _mm_packus_epi16(lo, hi));
+    }
+  }
+  else if (decimation_x == 8)
+  {
+    // Keep byte 0 of each 64-bit lane; two signed packs of 32-bit lanes then
+    // bring them together as words
+    const __m128i mask = _mm_set_epi32(0, 0xFF, 0, 0xFF);
+    for (; x + 16 <= width && 8 * x + 128 <= src_bytes; x += 16)
+    {
+      const uint8_t* s = src + 8 * x;
+      __m128i q[4];
+      for (int i = 0; i < 4; ++i)
+        q[i] = _mm_packs_epi32(_mm_and_si128(simd::load(s + 32 * i), mask),
+                               _mm_and_si128(simd::load(s + 32 * i + 16), mask));
+      simd::store(dst + x, _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]),
+                                            _mm_packs_epi32(q[2], q[3])));
+    }
+  }
+  return x;
+}
+
+int decimateRow3(const uint8_t* src, uint8_t* dst, int width, int src_bytes, int decimation_x)
+{
+  int x = 0;
+#if defined(__SSSE3__)
+  // 4 pixels per iteration, gathered from two overlapping loads. The 16-byte
+  // store spills 4 bytes into the next pixels, which are written afterwards.
+  if (decimation_x == 2)
+  {
+    const __m128i lo = _mm_setr_epi8(0, 1, 2, 6, 7, 8, 12, 13, 14, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, -1, -1, -1, -1);
+    for (; 3 * x + 16 <= 3 * width && 6 * x + 24 <= src_bytes; x += 4)
+    {
+      const uint8_t* s = src + 6 * x;
+      simd::store(dst + 3 * x, _mm_or_si128(_mm_shuffle_epi8(simd::load(s), lo),
+                                            _mm_shuffle_epi8(simd::load(s + 8), hi)));
+    }
+  }
+  else if (decimation_x == 4)
+  {
+    const __m128i lo = _mm_setr_epi8(0, 1, 2, 12, 13, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 0, 1, 2, 12, 13, 14, -1, -1, -1, -1);
+    for (; 3 * x + 16 <= 3 * width && 12 * x + 40 <= src_bytes; x += 4)
+    {
+      const uint8_t* s = src + 12 * x;
+      simd::store(dst + 3 * x, _mm_or_si128(_mm_shuffle_epi8(simd::load(s), lo),
+                                            _mm_shuffle_epi8(simd::load(s + 24), hi)));
+    }
+  }
+#endif
+  return x;
+}
+
+int decimateRow4(const uint8_t* src, uint8_t* dst, int width, int src_bytes, int decimation_x)
+{
+  int x = 0;
+  if (decimation_x == 2)
+  {
+    for (; x + 4 <= width && 8 * x + 32 <= src_bytes; x += 4)
+    {
+      const uint8_t* s = src + 8 * x;
+      __m128 a = _mm_castsi128_ps(simd::load(s)), b = _mm_castsi128_ps(simd::load(s + 16));
+      simd::store(dst + 4 * x, _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+    }
+  }
+  else if (decimation_x == 4 || decimation_x == 8)
+  {
+    int stride = 4 * decimation_x;
+    for (; x + 4 <= width && stride * (x + 3) + 16 <= src_bytes; x += 4)
+    {
+      const uint8_t* s = src + stride * x;
+      __m128i ab = _mm_unpacklo_epi32(simd::load(s), simd::load(s + stride));
+      __m128i cd = _mm_unpacklo_epi32(simd::load(s + 2 * stride), simd::load(s + 3 * stride));
+      simd::store(dst + 4 * x, _mm_unpacklo_epi64(ab, cd));
+    }
+  }
+  return x;
+}
+
+#elif defined(IMAGE_PROC_SIMD) // NEON
+
+int decimateRow1(const uint8_t* src, uint8_t* dst, int width, int src_bytes, int decimation_x)
+{
+  int x = 0;
+  if (decimation_x == 2)
+  {
+    for (; x + 16 <= width && 2 * x + 32 <= src_bytes; x += 16)
+      vst1q_u8(dst + x, vld2q_u8(src + 2 * x).val[0]);
+  }
+  else if (decimation_x == 4)
+  {
+    for (; x + 16 <= width && 4 * x + 64 <= src_bytes; x += 16)
+      vst1q_u8(dst + x, vld4q_u8(src + 4 * x).val[0]);
+  }
+  return x;
+}
+
+int decimateRow3(const uint8_t* src, uint8_t* dst, int width, int src_bytes, int decimation_x)
+{
+  int x = 0;
+  if (decimation_x == 2)
+  {
+    // Deinterleave 16 pixels into planes and keep the even lanes of each
+    for (; x + 8 <= width && 6 * x + 48 <= src_bytes; x += 8)
+    {
+      uint8x16x3_t in = vld3q_u8(src + 6 * x);
+      uint8x8x3_t out;
+      for (int c = 0; c < 3; ++c)
+        out.val[c] = vget_low_u8(vuzpq_u8(in.val[c], in.val[c]).val[0]);
+      vst3_u8(dst + 3 * x, out);
+    }
+  }
+  return x;
+}
+
+int decimateRow4(const uint8_t*, uint8_t*, int, int, int)
+{
+  return 0;
+}
+
+#endif
+
+template <typename T>
+void debayer2x2Row(const T* row0, const T* row1, T* dst, int x_begin, int width,
+                   BayerPattern pattern, int decimation_x)
+{
+  // Offsets of the samples within a 2x2 cell, as (row, column)
+  const T* r  = (pattern.red_y ? row1 : row0) + pattern.red_x;
+  const T* b  = (pattern.red_y ? row0 : row1) + 1 - pattern.red_x;
+  const T* g1 = (pattern.red_y ? row1 : row0) + 1 - pattern.red_x;
+  const T* g2 = (pattern.red_y ? row0 : row1) + pattern.red_x;
+  for (int x = x_begin; x < width; ++x)
+  {
+    int i = x * decimation_x;
+    dst[3 * x + 0] = b[i];
+    dst[3 * x + 1] = (T)(((int)g1[i] + (int)g2[i]) >> 1);
+    dst[3 * x + 2] = r[i];
+  }
+}
+
+#if defined(__SSE2__)
+
+// Splits the bytes of a row into its even and odd columns, 16 of each
+inline void deinterleave(const uint8_t* p, __m128i& even, __m128i& odd)
+{
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  __m128i a = simd::load(p), b = simd::load(p + 16);
+  even = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+  odd  = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+}
+
+// Same for words, 8 of each. Sign extension keeps the bit patterns intact
+// through the signed pack.
+inline void deinterleave(const uint16_t* p, __m128i& even, __m128i& odd)
+{
+  __m128i a = simd::load(p), b = simd::load(p + 8);
+  even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                         _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+  odd  = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+inline __m128i avgFloor(__m128i a, __m128i b, uint8_t*)  { return simd::avgFloor8(a, b); }
+inline __m128i avgFloor(__m128i a, __m128i b, uint16_t*) { return simd::avgFloor16(a, b); }
+
+template <typename T>
+int debayer2x2RowSimd(const T* row0, const T* row1, T* dst, int width, BayerPattern pattern)
+{
+  const int N = 16 / sizeof(T);
+  int x = 0;
+  for (; x + N <= width; x += N)
+  {
+    __m128i plane[2][2];
+    deinterleave(row0 + 2 * x, plane[0][0], plane[0][1]);
+    deinterleave(row1 + 2 * x, plane[1][0], plane[1][1]);
+    int rx = pattern.red_x, ry = pattern.red_y;
+    __m128i g = avgFloor(plane[ry][1 - rx], plane[1 - ry][rx], (T*)0);
+    simd::storeBGR(dst + 3 * x, plane[1 - ry][1 - rx], g, plane[ry][rx]);
+  }
+  return x;
+}
+
+#elif defined(IMAGE_PROC_SIMD) // NEON
+
+int debayer2x2RowSimd(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width,
+                      BayerPattern pattern)
+{
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    uint8x16x2_t rows[2] = { vld2q_u8(row0 + 2 * x), vld2q_u8(row1 + 2 * x) };
+    int rx = pattern.red_x, ry = pattern.red_y;
+    uint8x16_t g = vhaddq_u8(rows[ry].val[1 - rx], rows[1 - ry].val[rx]);
+    simd::storeBGR(dst + 3 * x, rows[1 - ry].val[1 - rx], g, rows[ry].val[rx]);
+  }
+  return x;
+}
+
+int debayer2x2RowSimd(const uint16_t* row0, const uint16_t* row1, uint16_t* dst, int width,
+                      BayerPattern pattern)
+{
+  int x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    uint16x8x2_t rows[2] = { vld2q_u16(row0 + 2 * x), vld2q_u16(row1 + 2 * x) };
+    int rx = pattern.red_x, ry = pattern.red_y;
+    uint16x8_t g = vhaddq_u16(rows[ry].val[1 - rx], rows[1 - ry].val[rx]);
+    simd::storeBGR(dst + 3 * x, rows[1 - ry].val[1 - rx], g, rows[ry].val[rx]);
+  }
+  return x;
+}
+
+#endif
+
+template <typename T>
+void debayer2x2(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& bgr,
+                int decimation_x, int decimation_y)
+{
+  for (int y = 0; y < bgr.rows; ++y)
+  {
+    const T* row0 = bayer.ptr<T>(y * decimation_y);
+    const T* row1 = bayer.ptr<T>(y * decimation_y + 1);
+    T* dst = bgr.ptr<T>(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    if (decimation_x == 2)
+      x = debayer2x2RowSimd(row0, row1, dst, bgr.cols, pattern);
+#endif
+    debayer2x2Row(row0, row1, dst, x, bgr.cols, pattern, decimation_x);
+  }
+}
+
+template <typename T>
+void binBayer(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& bgr,
+              int decimation_x, int decimation_y)
+{
+  int cells_x = decimation_x / 2, cells_y = decimation_y / 2;
+  uint32_t count_rb = cells_x * cells_y, count_g = 2 * count_rb;
+
+  // Per output pixel B, G and R sums, accumulated over the 2x2 cell rows of the window
+  std::vector<uint32_t> sums(bgr.cols * 3);
+  for (int y = 0; y < bgr.rows; ++y)
+  {
+    std::fill(sums.begin(), sums.end(), 0);
+    for (int cy = 0; cy < cells_y; ++cy)
+    {
+      const T* row0 = bayer.ptr<T>(y * decimation_y + 2 * cy);
+      const T* row1 = bayer.ptr<T>(y * decimation_y + 2 * cy + 1);
+      const T* r  = (pattern.red_y ? row1 : row0) + pattern.red_x;
+      const T* b  = (pattern.red_y ? row0 : row1) + 1 - pattern.red_x;
+      const T* g1 = (pattern.red_y ? row1 : row0) + 1 - pattern.red_x;
+      const T* g2 = (pattern.red_y ? row0 : row1) + pattern.red_x;
+      uint32_t* sum = &sums[0];
+      for (int x = 0; x < bgr.cols; ++x, sum += 3)
+      {
+        int begin = x * decimation_x, end = begin + decimation_x;
+        for (int i = begin; i < end; i += 2)
+        {
+          sum[0] += b[i];
+          sum[1] += g1[i] + g2[i];
+          sum[2] += r[i];
+        }
+      }
+    }
+
+    T* dst = bgr.ptr<T>(y);
+    for (int i = 0; i < bgr.cols * 3; i += 3)
+    {
+      dst[i + 0] = (T)((sums[i + 0] + count_rb / 2) / count_rb);
+      dst[i + 1] = (T)((sums[i + 1] + count_g / 2) / count_g);
+      dst[i + 2] = (T)((sums[i + 2] + count_rb / 2) / count_rb);
+    }
+  }
+}
+
+} // namespace
+
+bool decimateNearest(const cv::Mat& src, cv::Mat& dst, int decimation_x, int decimation_y)
+{
+  int pixel_size = src.elemSize();
+  switch (pixel_size)
+  {
+    case 1: case 2: case 3: case 4: case 6: case 8: case 12: case 16:
+      break;
+    default:
+      return false;
+  }
+  dst.create(src.rows / decimation_y, src.cols / decimation_x, src.type());
+
+  for (int y = 0; y < dst.rows; ++y)
+  {
+    const uint8_t* s = src.ptr(y * decimation_y);
+    uint8_t* d = dst.ptr(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    int src_bytes = src.cols * pixel_size;
+    if (pixel_size == 1)
+      x = decimateRow1(s, d, dst.cols, src_bytes, decimation_x);
+    else if (pixel_size == 3)
+      x = decimateRow3(s, d, dst.cols, src_bytes, decimation_x);
+    else if (pixel_size == 4)
+      x = decimateRow4(s, d, dst.cols, src_bytes, decimation_x);
+#endif
+    switch (pixel_size)
+    {
+      case 1:  decimateRow<1> (s, d, x, dst.cols, decimation_x); break;
+      case 2:  decimateRow<2> (s, d, x, dst.cols, decimation_x); break;
+      case 3:  decimateRow<3> (s, d, x, dst.cols, decimation_x); break;
+      case 4:  decimateRow<4> (s, d, x, dst.cols, decimation_x); break;
+      case 6:  decimateRow<6> (s, d, x, dst.cols, decimation_x); break;
+      case 8:  decimateRow<8> (s, d, x, dst.cols, decimation_x); break;
+      case 12: decimateRow<12>(s, d, x, dst.cols, decimation_x); break;
+      case 16: decimateRow<16>(s, d, x, dst.cols, decimation_x); break;
+    }
+  }
+  return true;
+}
+
+void debayer2x2toBGR(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& bgr,
+                     int decimation_x, int decimation_y)
+{
+  CV_Assert(bayer.type() == CV_8UC1 || bayer.type() == CV_16UC1);
+  bgr.create(bayer.rows / decimation_y, bayer.cols / decimation_x, CV_MAKETYPE(bayer.depth(), 3));
+  if (bayer.depth() == CV_8U)
+    debayer2x2<uint8_t>(bayer, pattern, bgr, decimation_x, decimation_y);
+  else
+    debayer2x2<uint16_t>(bayer, pattern, bgr, decimation_x, decimation_y);
+}
+
+void binBayerToBGR(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& bgr,
+                   int decimation_x, int decimation_y)
+{
+  CV_Assert(bayer.type() == CV_8UC1 || bayer.type() == CV_16UC1);
+  CV_Assert(decimation_x % 2 == 0 && decimation_y % 2 == 0);
+  bgr.create(bayer.rows / decimation_y, bayer.cols / decimation_x, CV_MAKETYPE(bayer.depth(), 3));
+  if (bayer.depth() == CV_8U)
+    binBayer<uint8_t>(bayer, pattern, bgr, decimation_x, decimation_y);
+  else
+    binBayer<uint16_t>(bayer, pattern, bgr, decimation_x, decimation_y);
+}
+
+sensor_msgs::CameraInfoPtr decimateCameraInfo(const sensor_msgs::CameraInfo& info,
+                                              int image_width, int image_height, const cv::Rect& roi,
+                                              int decimation_x, int decimation_y)
+{
+  sensor_msgs::CameraInfoPtr out_info = boost::make_shared<sensor_msgs::CameraInfo>(info);
+  int binning_x = std::max((int)info.binning_x, 1);
+  int binning_y = std::max((int)info.binning_y, 1);
+  out_info->binning_x = binning_x * decimation_x;
+  out_info->binning_y = binning_y * decimation_y;
+  out_info->roi.x_offset += roi.x * binning_x;
+  out_info->roi.y_offset += roi.y * binning_y;
+  out_info->roi.height = roi.height * binning_y;
+  out_info->roi.width = roi.width * binning_x;
+  // If no ROI specified, leave do_rectify as-is. If ROI specified, set do_rectify = true.
+  if (roi.width != image_width || roi.height != image_height)
+    out_info->roi.do_rectify = true;
+  return out_info;
+}
+
+} // namespace image_proc
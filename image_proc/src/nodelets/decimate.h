@@ -0,0 +1,137 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_DECIMATE
+#define IMAGE_PROC_DECIMATE
+
+#include <cstring>
+#include <opencv2/core/core.hpp>
+#include <sensor_msgs/CameraInfo.h>
+#include "image_proc/bayer.h"
+
+// Downsampling kernels used by CropDecimateNodelet and PyramidNodelet.
+
+namespace image_proc {
+
+// Templated on pixel size, in bytes (MONO8 = 1, BGR8 = 3, RGBA16 = 8, ...)
+template <int N>
+void decimate(const cv::Mat& src, cv::Mat& dst, int decimation_x, int decimation_y)
+{
+  dst.create(src.rows / decimation_y, src.cols / decimation_x, src.type());
+
+  int src_row_step = src.step[0] * decimation_y;
+  int src_pixel_step = N * decimation_x;
+  int dst_row_step = dst.step[0];
+
+  const uint8_t* src_row = src.ptr();
+  uint8_t* dst_row = dst.ptr();
+  
+  for (int y = 0; y < dst.rows; ++y)
+  {
+    const uint8_t* src_pixel = src_row;
+    uint8_t* dst_pixel = dst_row;
+    for (int x = 0; x < dst.cols; ++x)
+    {
+      memcpy(dst_pixel, src_pixel, N); // Should inline with small, fixed N
+      src_pixel += src_pixel_step;
+      dst_pixel += N;
+    }
+    src_row += src_row_step;
+    dst_row += dst_row_step;
+  }
+}
+
+// Takes one 2x2 cell every decimation_x columns and decimation_y rows (both even)
+template <typename T>
+void debayer2x2toBGR(const cv::Mat& src, cv::Mat& dst, int R, int G1, int G2, int B,
+                     int decimation_x, int decimation_y)
+{
+  typedef cv::Vec<T, 3> DstPixel; // 8- or 16-bit BGR
+  dst.create(src.rows / decimation_y, src.cols / decimation_x, cv::DataType<DstPixel>::type);
+
+  int src_row_step = src.step1();
+  int dst_row_step = dst.step1();
+  const T* src_row = src.ptr<T>();
+  T* dst_row = dst.ptr<T>();
+
+  // Downsample and debayer at once
+  for (int y = 0; y < dst.rows; ++y)
+  {
+    const T* src_cell = src_row;
+    for (int x = 0; x < dst.cols; ++x)
+    {
+      dst_row[x*3 + 0] = src_cell[B];
+      dst_row[x*3 + 1] = (src_cell[G1] + src_cell[G2]) / 2;
+      dst_row[x*3 + 2] = src_cell[R];
+      src_cell += decimation_x;
+    }
+    src_row += src_row_step * decimation_y;
+    dst_row += dst_row_step;
+  }
+}
+
+/**
+ * Same result as decimate<N> for pixels of 1 to 16 bytes, with vectorized
+ * paths for 1, 3 and 4 byte pixels decimated horizontally by 2, 4 or 8.
+ * Returns false if the pixel size is not supported.
+ */
+bool decimateNearest(const cv::Mat& src, cv::Mat& dst, int decimation_x, int decimation_y);
+
+/**
+ * Same result as debayer2x2toBGR<T> for a CV_8UC1 or CV_16UC1 Bayer image,
+ * with a vectorized path for the plain 2x2 case.
+ */
+void debayer2x2toBGR(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& bgr,
+                     int decimation_x, int decimation_y);
+
+/**
+ * Area-averaging counterpart of debayer2x2toBGR(): each output pixel is the
+ * mean, rounded to nearest, of all the samples of each color in its
+ * decimation_x by decimation_y window (both even). Bins the raw samples in a
+ * single pass instead of debayering at full resolution and then resizing.
+ */
+void binBayerToBGR(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& bgr,
+                   int decimation_x, int decimation_y);
+
+/**
+ * CameraInfo of an image_width x image_height image cropped to roi and then
+ * decimated. Binning grows by the decimation and the ROI moves by the crop,
+ * in full-resolution sensor pixels. do_rectify is set if roi crops anything.
+ */
+sensor_msgs::CameraInfoPtr decimateCameraInfo(const sensor_msgs::CameraInfo& info,
+                                              int image_width, int image_height, const cv::Rect& roi,
+                                              int decimation_x, int decimation_y);
+
+} // namespace image_proc
+
+#endif
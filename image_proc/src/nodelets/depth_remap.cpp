@@ -0,0 +1,459 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "depth_remap.h"
+#include "simd.h"
+#include <image_proc/worker_pool.h>
+#include <sensor_msgs/image_encodings.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace image_proc {
+
+namespace enc = sensor_msgs::image_encodings;
+
+bool isDepthEncoding(const std::string& encoding)
+{
+  return encoding == enc::TYPE_16UC1 || encoding == enc::TYPE_32FC1;
+}
+
+namespace {
+
+// Invalid depths are read as infinity, so they never win the minimum
+const float NO_DEPTH = std::numeric_limits<float>::infinity();
+
+template <typename T> float fromDepth(T depth);
+template <typename T> T toDepth(float depth);
+template <typename T> T invalidDepth();
+
+template <> inline float fromDepth<uint16_t>(uint16_t depth)
+{
+  return depth ? depth : NO_DEPTH;
+}
+
+template <> inline float fromDepth<float>(float depth)
+{
+  // Also false for NaN
+  return (depth > 0.0f && depth < NO_DEPTH) ? depth : NO_DEPTH;
+}
+
+template <typename T> inline float depthAt(const cv::Mat& src, int x, int y)
+{
+  if ((unsigned)x >= (unsigned)src.cols || (unsigned)y >= (unsigned)src.rows)
+    return NO_DEPTH;
+  return fromDepth<T>(src.ptr<T>(y)[x]);
+}
+
+template <> inline uint16_t invalidDepth<uint16_t>() { return 0; }
+template <> inline float invalidDepth<float>() { return std::numeric_limits<float>::quiet_NaN(); }
+
+// Anything that isn't a finite depth, including NaN, is written as invalid
+template <> inline uint16_t toDepth<uint16_t>(float depth)
+{
+  return depth < NO_DEPTH ? (uint16_t)(depth + 0.5f) : 0;
+}
+
+template <> inline float toDepth<float>(float depth)
+{
+  return depth < NO_DEPTH ? depth : invalidDepth<float>();
+}
+
+const float FRACTION_SCALE = 1.0f / cv::INTER_TAB_SIZE;
+
+// See DEPTH_MIN_VALID. v holds the four samples around the pixel: top left, top
+// right, bottom left, bottom right; fx and fy its position between them.
+inline float blendMinValid(const float v[4], float fx, float fy)
+{
+  float w[4] = { (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy };
+  float nearest = std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+  if (!(nearest < NO_DEPTH))
+    return NO_DEPTH;
+  float limit = nearest * DEPTH_BLEND_RATIO;
+  float sum = 0.0f, weight = 0.0f;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (v[i] <= limit)
+    {
+      sum += w[i] * v[i];
+      weight += w[i];
+    }
+  }
+  // All the weight can be on invalid samples, with valid ones at zero weight
+  return weight > 0.0f ? sum / weight : nearest;
+}
+
+#ifdef IMAGE_PROC_SIMD
+// Decoding of four map entries at a time into offsets of raw samples from the
+// start of src, -1 for samples outside it. Both the (x, y) pairs of map1 and
+// the offsets stay in 16 and 32 bits, which holds for any src of at most
+// 32767 rows and row stride.
+struct SampleGrid
+{
+  template <typename T>
+  static SampleGrid of(const cv::Mat& src)
+  {
+    SampleGrid grid;
+    grid.cols = src.cols;
+    grid.rows = src.rows;
+    grid.stride = (int)(src.step[0] / sizeof(T));
+    grid.decodable = src.step[0] % sizeof(T) == 0 && grid.stride <= 32767 && grid.rows <= 32767;
+    return grid;
+  }
+
+  int cols, rows, stride;
+  bool decodable;
+};
+
+#if defined(__SSE2__)
+// pos holds four (x, y) pairs; size and weights are (cols, rows) and (1, stride) in each pair
+inline __m128i sampleOffsets(__m128i pos, __m128i size, __m128i weights)
+{
+  __m128i inside = _mm_and_si128(_mm_cmpgt_epi16(pos, _mm_set1_epi16(-1)), _mm_cmplt_epi16(pos, size));
+  inside = _mm_cmpeq_epi32(inside, _mm_set1_epi32(-1));
+  return _mm_or_si128(_mm_madd_epi16(pos, weights), _mm_xor_si128(inside, _mm_set1_epi32(-1)));
+}
+#else // NEON
+inline int32x4_t sampleOffsets(int16x4_t x, int16x4_t y, const SampleGrid& grid)
+{
+  uint16x4_t inside = vand_u16(vand_u16(vcge_s16(x, vdup_n_s16(0)), vclt_s16(x, vdup_n_s16(grid.cols))),
+                               vand_u16(vcge_s16(y, vdup_n_s16(0)), vclt_s16(y, vdup_n_s16(grid.rows))));
+  int32x4_t offset = vmlal_n_s16(vmovl_s16(x), y, (int16_t)grid.stride);
+  // Sign extension turns each lane of the mask into all ones or all zeros
+  int32x4_t outside = vmovl_s16(vreinterpret_s16_u16(vmvn_u16(inside)));
+  return vorrq_s32(offset, outside);
+}
+#endif
+
+// For DEPTH_MIN_VALID: the offsets of the samples around each pixel (top left,
+// top right, bottom left, bottom right) and its position between them.
+inline void decodeLinear4(const int16_t* xy, const uint16_t* fraction, const SampleGrid& grid,
+                          int32_t offset[4][4], float fx[4], float fy[4])
+{
+#if defined(__SSE2__)
+  __m128i size = _mm_set1_epi32((grid.rows << 16) | grid.cols);
+  __m128i weights = _mm_set1_epi32((grid.stride << 16) | 1);
+  __m128i pos = simd::load(xy);
+  const __m128i right = _mm_set1_epi32(1), down = _mm_set1_epi32(1 << 16);
+  simd::store(offset[0], sampleOffsets(pos, size, weights));
+  simd::store(offset[1], sampleOffsets(_mm_add_epi16(pos, right), size, weights));
+  simd::store(offset[2], sampleOffsets(_mm_add_epi16(pos, down), size, weights));
+  simd::store(offset[3], sampleOffsets(_mm_add_epi16(pos, _mm_add_epi16(right, down)), size, weights));
+
+  __m128i f = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(fraction)),
+                                 _mm_setzero_si128());
+  const __m128 scale = _mm_set1_ps(FRACTION_SCALE);
+  _mm_storeu_ps(fx, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(f, _mm_set1_epi32(cv::INTER_TAB_SIZE - 1))),
+                               scale));
+  _mm_storeu_ps(fy, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(f, cv::INTER_BITS)), scale));
+#else // NEON
+  int16x4x2_t pos = vld2_s16(xy);
+  const int16x4_t one = vdup_n_s16(1);
+  int16x4_t x1 = vadd_s16(pos.val[0], one), y1 = vadd_s16(pos.val[1], one);
+  vst1q_s32(offset[0], sampleOffsets(pos.val[0], pos.val[1], grid));
+  vst1q_s32(offset[1], sampleOffsets(x1, pos.val[1], grid));
+  vst1q_s32(offset[2], sampleOffsets(pos.val[0], y1, grid));
+  vst1q_s32(offset[3], sampleOffsets(x1, y1, grid));
+
+  uint16x4_t f = vld1_u16(fraction);
+  const float32x4_t scale = vdupq_n_f32(FRACTION_SCALE);
+  vst1q_f32(fx, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vand_u16(f, vdup_n_u16(cv::INTER_TAB_SIZE - 1)))), scale));
+  vst1q_f32(fy, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vshr_n_u16(f, cv::INTER_BITS))), scale));
+#endif
+}
+
+// For DEPTH_NEAREST: the offset of the sample nearest each pixel, rounding as remapRowsNearest() does
+inline void decodeNearest4(const int16_t* xy, const uint16_t* fraction, const SampleGrid& grid,
+                           int32_t offset[4])
+{
+#if defined(__SSE2__)
+  __m128i f = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(fraction));
+  const __m128i bit = _mm_set1_epi16(1);
+  __m128i round_x = _mm_and_si128(_mm_srli_epi16(f, cv::INTER_BITS - 1), bit);
+  __m128i round_y = _mm_and_si128(_mm_srli_epi16(f, 2 * cv::INTER_BITS - 1), bit);
+  __m128i pos = _mm_add_epi16(simd::load(xy), _mm_unpacklo_epi16(round_x, round_y));
+  simd::store(offset, sampleOffsets(pos, _mm_set1_epi32((grid.rows << 16) | grid.cols),
+                                    _mm_set1_epi32((grid.stride << 16) | 1)));
+#else // NEON
+  uint16x4_t f = vld1_u16(fraction);
+  const uint16x4_t bit = vdup_n_u16(1);
+  int16x4_t round_x = vreinterpret_s16_u16(vand_u16(vshr_n_u16(f, cv::INTER_BITS - 1), bit));
+  int16x4_t round_y = vreinterpret_s16_u16(vand_u16(vshr_n_u16(f, 2 * cv::INTER_BITS - 1), bit));
+  int16x4x2_t pos = vld2_s16(xy);
+  vst1q_s32(offset, sampleOffsets(vadd_s16(pos.val[0], round_x), vadd_s16(pos.val[1], round_y), grid));
+#endif
+}
+
+// fromDepth() of the four samples at offset from samples, NO_DEPTH where offset
+// is negative (outside src). Neither SSE2 nor NEON can gather, so the samples are
+// loaded one by one, straight into vector lanes; those outside src are read from
+// its first pixel and then discarded.
+template <typename T> void gatherDepth4(const T* samples, const int32_t offset[4], float* out);
+
+template <> inline void gatherDepth4<uint16_t>(const uint16_t* samples, const int32_t offset[4], float* out)
+{
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i depth = zero;
+  depth = _mm_insert_epi16(depth, samples[std::max(offset[0], 0)], 0);
+  depth = _mm_insert_epi16(depth, samples[std::max(offset[1], 0)], 2);
+  depth = _mm_insert_epi16(depth, samples[std::max(offset[2], 0)], 4);
+  depth = _mm_insert_epi16(depth, samples[std::max(offset[3], 0)], 6);
+  __m128 invalid = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(depth, zero),
+                                                 _mm_cmplt_epi32(simd::load(offset), zero)));
+  _mm_storeu_ps(out, _mm_or_ps(_mm_andnot_ps(invalid, _mm_cvtepi32_ps(depth)),
+                               _mm_and_ps(invalid, _mm_set1_ps(NO_DEPTH))));
+#else // NEON
+  uint16x4_t raw = vdup_n_u16(0);
+  raw = vld1_lane_u16(samples + std::max(offset[0], 0), raw, 0);
+  raw = vld1_lane_u16(samples + std::max(offset[1], 0), raw, 1);
+  raw = vld1_lane_u16(samples + std::max(offset[2], 0), raw, 2);
+  raw = vld1_lane_u16(samples + std::max(offset[3], 0), raw, 3);
+  uint32x4_t depth = vmovl_u16(raw);
+  uint32x4_t invalid = vorrq_u32(vceqq_u32(depth, vdupq_n_u32(0)), vcltq_s32(vld1q_s32(offset), vdupq_n_s32(0)));
+  vst1q_f32(out, vbslq_f32(invalid, vdupq_n_f32(NO_DEPTH), vcvtq_f32_u32(depth)));
+#endif
+}
+
+template <> inline void gatherDepth4<float>(const float* samples, const int32_t offset[4], float* out)
+{
+#if defined(__SSE2__)
+  const __m128 no_depth = _mm_set1_ps(NO_DEPTH);
+  __m128 depth = _mm_setr_ps(samples[std::max(offset[0], 0)], samples[std::max(offset[1], 0)],
+                             samples[std::max(offset[2], 0)], samples[std::max(offset[3], 0)]);
+  // Comparisons with NaN are false, so NaN is invalid too
+  __m128 valid = _mm_and_ps(_mm_cmpgt_ps(depth, _mm_setzero_ps()), _mm_cmplt_ps(depth, no_depth));
+  valid = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmplt_epi32(simd::load(offset), _mm_setzero_si128())), valid);
+  _mm_storeu_ps(out, _mm_or_ps(_mm_and_ps(valid, depth), _mm_andnot_ps(valid, no_depth)));
+#else // NEON
+  const float32x4_t no_depth = vdupq_n_f32(NO_DEPTH);
+  float32x4_t depth = vdupq_n_f32(0.0f);
+  depth = vld1q_lane_f32(samples + std::max(offset[0], 0), depth, 0);
+  depth = vld1q_lane_f32(samples + std::max(offset[1], 0), depth, 1);
+  depth = vld1q_lane_f32(samples + std::max(offset[2], 0), depth, 2);
+  depth = vld1q_lane_f32(samples + std::max(offset[3], 0), depth, 3);
+  uint32x4_t valid = vandq_u32(vandq_u32(vcgtq_f32(depth, vdupq_n_f32(0.0f)), vcltq_f32(depth, no_depth)),
+                               vcgeq_s32(vld1q_s32(offset), vdupq_n_s32(0)));
+  vst1q_f32(out, vbslq_f32(valid, depth, no_depth));
+#endif
+}
+
+// blendMinValid() of four pixels at once; v[i] holds sample i of each pixel.
+// Pixels without a valid sample come out infinite or NaN.
+inline void blendMinValid4(const float v[4][4], const float fx[4], const float fy[4], float* out)
+{
+#if defined(__SSE2__)
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128 x1 = _mm_loadu_ps(fx), y1 = _mm_loadu_ps(fy);
+  __m128 x0 = _mm_sub_ps(one, x1), y0 = _mm_sub_ps(one, y1);
+  __m128 w[4] = { _mm_mul_ps(x0, y0), _mm_mul_ps(x1, y0), _mm_mul_ps(x0, y1), _mm_mul_ps(x1, y1) };
+  __m128 s[4] = { _mm_loadu_ps(v[0]), _mm_loadu_ps(v[1]), _mm_loadu_ps(v[2]), _mm_loadu_ps(v[3]) };
+
+  __m128 nearest = _mm_min_ps(_mm_min_ps(s[0], s[1]), _mm_min_ps(s[2], s[3]));
+  __m128 limit = _mm_mul_ps(nearest, _mm_set1_ps(DEPTH_BLEND_RATIO));
+  __m128 sum = _mm_setzero_ps(), weight = _mm_setzero_ps();
+  for (int i = 0; i < 4; ++i)
+  {
+    // Zero both weight and depth of excluded samples, as 0 * infinity is NaN
+    __m128 keep = _mm_cmple_ps(s[i], limit);
+    __m128 wi = _mm_and_ps(keep, w[i]);
+    sum = _mm_add_ps(sum, _mm_mul_ps(wi, _mm_and_ps(keep, s[i])));
+    weight = _mm_add_ps(weight, wi);
+  }
+  __m128 has_weight = _mm_cmpgt_ps(weight, _mm_setzero_ps());
+  __m128 blend = _mm_div_ps(sum, weight);
+  _mm_storeu_ps(out, _mm_or_ps(_mm_and_ps(has_weight, blend), _mm_andnot_ps(has_weight, nearest)));
+#else // NEON
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  float32x4_t x1 = vld1q_f32(fx), y1 = vld1q_f32(fy);
+  float32x4_t x0 = vsubq_f32(one, x1), y0 = vsubq_f32(one, y1);
+  float32x4_t w[4] = { vmulq_f32(x0, y0), vmulq_f32(x1, y0), vmulq_f32(x0, y1), vmulq_f32(x1, y1) };
+  float32x4_t s[4] = { vld1q_f32(v[0]), vld1q_f32(v[1]), vld1q_f32(v[2]), vld1q_f32(v[3]) };
+
+  float32x4_t nearest = vminq_f32(vminq_f32(s[0], s[1]), vminq_f32(s[2], s[3]));
+  float32x4_t limit = vmulq_n_f32(nearest, DEPTH_BLEND_RATIO);
+  float32x4_t sum = vdupq_n_f32(0.0f), weight = vdupq_n_f32(0.0f);
+  for (int i = 0; i < 4; ++i)
+  {
+    // Zero both weight and depth of excluded samples, as 0 * infinity is NaN
+    uint32x4_t keep = vcleq_f32(s[i], limit);
+    float32x4_t wi = vreinterpretq_f32_u32(vandq_u32(keep, vreinterpretq_u32_f32(w[i])));
+    float32x4_t si = vreinterpretq_f32_u32(vandq_u32(keep, vreinterpretq_u32_f32(s[i])));
+    sum = vaddq_f32(sum, vmulq_f32(wi, si));
+    weight = vaddq_f32(weight, wi);
+  }
+  uint32x4_t has_weight = vcgtq_f32(weight, vdupq_n_f32(0.0f));
+#if defined(__aarch64__)
+  float32x4_t blend = vdivq_f32(sum, weight);
+#else
+  // Reciprocal estimate refined twice, good to about one float ulp
+  float32x4_t inverse = vrecpeq_f32(weight);
+  inverse = vmulq_f32(inverse, vrecpsq_f32(weight, inverse));
+  inverse = vmulq_f32(inverse, vrecpsq_f32(weight, inverse));
+  float32x4_t blend = vmulq_f32(sum, inverse);
+#endif
+  vst1q_f32(out, vbslq_f32(has_weight, blend, nearest));
+#endif
+}
+#endif
+
+template <typename T>
+void remapRowsMinValid(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2, cv::Mat& dst,
+                       int row_begin, int row_end)
+{
+#ifdef IMAGE_PROC_SIMD
+  const SampleGrid grid = SampleGrid::of<T>(src);
+  const T* samples = src.ptr<T>(0);
+#endif
+  for (int y = row_begin; y < row_end; ++y)
+  {
+    const int16_t* xy = map1.ptr<int16_t>(y);
+    const uint16_t* fraction = map2.ptr<uint16_t>(y);
+    T* out = dst.ptr<T>(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    // Four pixels at a time: decoding the maps, loading the samples and blending them
+    for (; grid.decodable && x + 4 <= dst.cols; x += 4)
+    {
+      int32_t offset[4][4];
+      float v[4][4], fx[4], fy[4], depth[4];
+      decodeLinear4(xy + 2 * x, fraction + x, grid, offset, fx, fy);
+      for (int j = 0; j < 4; ++j)
+        gatherDepth4<T>(samples, offset[j], v[j]);
+      blendMinValid4(v, fx, fy, depth);
+      for (int i = 0; i < 4; ++i)
+        out[x + i] = toDepth<T>(depth[i]);
+    }
+#endif
+    for (; x < dst.cols; ++x)
+    {
+      int sx = xy[2 * x], sy = xy[2 * x + 1];
+      float v[4] = { depthAt<T>(src, sx, sy),     depthAt<T>(src, sx + 1, sy),
+                     depthAt<T>(src, sx, sy + 1), depthAt<T>(src, sx + 1, sy + 1) };
+      float fx = (fraction[x] & (cv::INTER_TAB_SIZE - 1)) * FRACTION_SCALE;
+      float fy = (fraction[x] >> cv::INTER_BITS) * FRACTION_SCALE;
+      out[x] = toDepth<T>(blendMinValid(v, fx, fy));
+    }
+  }
+}
+
+template <typename T>
+void remapRowsNearest(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2, cv::Mat& dst,
+                      int row_begin, int row_end)
+{
+#ifdef IMAGE_PROC_SIMD
+  const SampleGrid grid = SampleGrid::of<T>(src);
+  const T* samples = src.ptr<T>(0);
+#endif
+  for (int y = row_begin; y < row_end; ++y)
+  {
+    const int16_t* xy = map1.ptr<int16_t>(y);
+    const uint16_t* fraction = map2.ptr<uint16_t>(y);
+    T* out = dst.ptr<T>(y);
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    // Decoded four pixels at a time, then copied one by one
+    for (; grid.decodable && x + 4 <= dst.cols; x += 4)
+    {
+      int32_t offset[4];
+      decodeNearest4(xy + 2 * x, fraction + x, grid, offset);
+      for (int i = 0; i < 4; ++i)
+        out[x + i] = offset[i] >= 0 ? samples[offset[i]] : invalidDepth<T>();
+    }
+#endif
+    for (; x < dst.cols; ++x)
+    {
+      // Round to the nearest sample; cv::remap truncates
+      int sx = xy[2 * x]     + ((fraction[x] & (cv::INTER_TAB_SIZE - 1)) >= cv::INTER_TAB_SIZE / 2);
+      int sy = xy[2 * x + 1] + ((fraction[x] >> cv::INTER_BITS) >= cv::INTER_TAB_SIZE / 2);
+      if ((unsigned)sx < (unsigned)src.cols && (unsigned)sy < (unsigned)src.rows)
+        out[x] = src.ptr<T>(sy)[sx];
+      else
+        out[x] = invalidDepth<T>();
+    }
+  }
+}
+
+void runBand(const cv::Mat* src, const cv::Mat* map1, const cv::Mat* map2,
+             DepthInterpolation interpolation, cv::Mat* dst, int num_bands, int band)
+{
+  int rows = dst->rows;
+  depthRemapRows(*src, *map1, *map2, interpolation, *dst,
+                 rows * band / num_bands, rows * (band + 1) / num_bands);
+}
+
+} // namespace
+
+void depthRemapRows(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                    DepthInterpolation interpolation, cv::Mat& dst, int row_begin, int row_end)
+{
+  CV_Assert(src.type() == CV_16UC1 || src.type() == CV_32FC1);
+  CV_Assert(map1.type() == CV_16SC2 && map2.type() == CV_16UC1 && map1.size() == map2.size());
+  CV_Assert(dst.type() == src.type() && dst.size() == map1.size());
+
+  if (src.type() == CV_16UC1)
+  {
+    if (interpolation == DEPTH_NEAREST)
+      remapRowsNearest<uint16_t>(src, map1, map2, dst, row_begin, row_end);
+    else
+      remapRowsMinValid<uint16_t>(src, map1, map2, dst, row_begin, row_end);
+  }
+  else
+  {
+    if (interpolation == DEPTH_NEAREST)
+      remapRowsNearest<float>(src, map1, map2, dst, row_begin, row_end);
+    else
+      remapRowsMinValid<float>(src, map1, map2, dst, row_begin, row_end);
+  }
+}
+
+void depthRemap(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                DepthInterpolation interpolation, cv::Mat& dst)
+{
+  dst.create(map1.size(), src.type());
+  depthRemapRows(src, map1, map2, interpolation, dst, 0, dst.rows);
+}
+
+void depthRemap(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                DepthInterpolation interpolation, cv::Mat& dst, WorkerPool& pool)
+{
+  dst.create(map1.size(), src.type());
+  // A few bands per thread, as in Rectifier
+  int num_bands = std::min(pool.size() * 4, std::max(dst.rows, 1));
+  pool.parallelFor(num_bands, boost::bind(&runBand, &src, &map1, &map2, interpolation, &dst,
+                                          num_bands, _1));
+}
+
+} // namespace image_proc
@@ -0,0 +1,91 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_DEPTH_REMAP
+#define IMAGE_PROC_DEPTH_REMAP
+
+#include <opencv2/core/core.hpp>
+#include <string>
+
+// Remapping of depth images for RectifyNodelet. Interpolating depth the way
+// cv::remap does blends foreground and background across object edges into
+// points that aren't there, and pulls depths toward zero next to holes.
+
+namespace image_proc {
+
+class WorkerPool;
+
+enum DepthInterpolation
+{
+  /// Copies the raw sample nearest to each output pixel, rounding rather than
+  /// truncating the map coordinates.
+  DEPTH_NEAREST,
+  /**
+   * Finds the nearest valid depth among the four raw samples around each
+   * output pixel, and blends it bilinearly with those within
+   * DEPTH_BLEND_RATIO of it, renormalizing the weights. Invalid samples and
+   * samples across an edge get no weight; pixels with no valid sample are
+   * invalid.
+   */
+  DEPTH_MIN_VALID
+};
+
+/// Depths at most this factor beyond the nearest sample are treated as the same surface.
+const float DEPTH_BLEND_RATIO = 1.05f;
+
+/**
+ * True for the encodings remapped with depthRemap(): 16UC1, where 0 is invalid
+ * and written for invalid pixels, and 32FC1, where zero and non-finite depths
+ * are invalid and NaN is written for invalid pixels.
+ */
+bool isDepthEncoding(const std::string& encoding);
+
+/**
+ * Remaps a CV_16UC1 or CV_32FC1 depth image through fixed-point maps (CV_16SC2
+ * map1 and CV_16UC1 map2, as built by Rectifier). Raw samples outside src
+ * count as invalid.
+ */
+void depthRemap(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                DepthInterpolation interpolation, cv::Mat& dst);
+
+/// Same, in horizontal bands on pool.
+void depthRemap(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                DepthInterpolation interpolation, cv::Mat& dst, WorkerPool& pool);
+
+/// Fills rows [row_begin, row_end) of an already allocated dst.
+void depthRemapRows(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                    DepthInterpolation interpolation, cv::Mat& dst, int row_begin, int row_end);
+
+} // namespace image_proc
+
+#endif
@@ -32,773 +32,401 @@
 *  POSSIBILITY OF SUCH DAMAGE.
 *********************************************************************/
 #include "edge_aware.h"
-
-#define AVG(a,b) (((int)(a) + (int)(b)) >> 1)
-#define AVG3(a,b,c) (((int)(a) + (int)(b) + (int)(c)) / 3)
-#define AVG4(a,b,c,d) (((int)(a) + (int)(b) + (int)(c) + (int)(d)) >> 2)
-#define WAVG4(a,b,c,d,x,y)  ( ( ((int)(a) + (int)(b)) * (int)(x) + ((int)(c) + (int)(d)) * (int)(y) ) / ( 2 * ((int)(x) + (int(y))) ) )
-using namespace std;
+#include "simd.h"
+#include <cstdlib>
 
 namespace image_proc {
 
-void debayerEdgeAware(const cv::Mat& bayer, cv::Mat& color)
+/*
+ * Generic edge-aware debayering for every Bayer pattern at 8 and 16 bits.
+ *
+ * Each pixel is reconstructed from its 3x3 neighbourhood:
+ *  - at a green sample, red and blue are the average of the two neighbours of
+ *    that color, horizontal or vertical depending on the row;
+ *  - at a red or blue sample, the opposite color is the average of the four
+ *    diagonal neighbours, and green is interpolated along the direction with
+ *    the smaller gradient (or as a gradient-weighted blend of both).
+ * Out-of-image neighbours are reflected (BORDER_REFLECT_101), so border pixels
+ * follow the same rules. Output is BGR.
+ *
+ * The interior of each row is vectorized with SSE2 (plus SSSE3 for storing
+ * interleaved pixels, when enabled) or NEON. All arithmetic is exact integer
+ * arithmetic, so the vectorized code matches the scalar code bit for bit.
+ */
+
+namespace {
+
+inline int reflect101(int i, int n)
+{
+  if (n == 1)
+    return 0;
+  if (i < 0)
+    return -i;
+  if (i >= n)
+    return 2 * n - 2 - i;
+  return i;
+}
+
+template <typename T>
+inline T edgeAwareGreen(int u, int d, int l, int r, bool weighted)
 {
-  unsigned width = bayer.cols;
-  unsigned height = bayer.rows;
-  unsigned rgb_line_step = color.step[0];
-  unsigned rgb_line_skip = rgb_line_step - width * 3;
-  int bayer_line_step = bayer.step[0];
-  int bayer_line_step2 = bayer_line_step * 2;
-
-  unsigned char* rgb_buffer = color.data;
-  unsigned char* bayer_pixel = bayer.data;
-  unsigned yIdx, xIdx;
-
-  int dh, dv;
-
-  // first two pixel values for first two lines
-  // Bayer         0 1 2
-  //         0     G r g
-  // line_step     b g b
-  // line_step2    g r g
-
-  rgb_buffer[3] = rgb_buffer[0] = bayer_pixel[1]; // red pixel
-  rgb_buffer[1] = bayer_pixel[0]; // green pixel
-  rgb_buffer[rgb_line_step + 2] = rgb_buffer[2] = bayer_pixel[bayer_line_step]; // blue;
-
-  // Bayer         0 1 2
-  //         0     g R g
-  // line_step     b g b
-  // line_step2    g r g
-  //rgb_pixel[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG3 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1]);
-  rgb_buffer[rgb_line_step + 5] = rgb_buffer[5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-
-  // BGBG line
-  // Bayer         0 1 2
-  //         0     g r g
-  // line_step     B g b
-  // line_step2    g r g
-  rgb_buffer[rgb_line_step + 3] = rgb_buffer[rgb_line_step ] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-  rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step + 1], bayer_pixel[bayer_line_step2]);
-  //rgb_pixel[rgb_line_step + 2] = bayer_pixel[line_step];
-
-  // pixel (1, 1)  0 1 2
-  //         0     g r g
-  // line_step     b G b
-  // line_step2    g r g
-  //rgb_pixel[rgb_line_step + 3] = AVG( bayer_pixel[1] , bayer_pixel[line_step2+1] );
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  //rgb_pixel[rgb_line_step + 5] = AVG( bayer_pixel[line_step] , bayer_pixel[line_step+2] );
-
-  rgb_buffer += 6;
-  bayer_pixel += 2;
-  // rest of the first two lines
-  for (xIdx = 2; xIdx < width - 2; xIdx += 2, rgb_buffer += 6, bayer_pixel += 2)
+  int dh = std::abs(l - r);
+  int dv = std::abs(u - d);
+  if (weighted)
   {
-    // GRGR line
-    // Bayer        -1 0 1 2
-    //           0   r G r g
-    //   line_step   g b g b
-    // line_step2    r g r g
-    rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-    rgb_buffer[1] = bayer_pixel[0];
-    rgb_buffer[2] = bayer_pixel[bayer_line_step + 1];
-
-    // Bayer        -1 0 1 2
-    //          0    r g R g
-    //  line_step    g b g b
-    // line_step2    r g r g
-    rgb_buffer[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG3 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1]);
-    rgb_buffer[rgb_line_step + 5] = rgb_buffer[5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-
-    // BGBG line
-    // Bayer         -1 0 1 2
-    //         0      r g r g
-    // line_step      g B g b
-    // line_step2     r g r g
-    rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-    rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-    rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-
-    // Bayer         -1 0 1 2
-    //         0      r g r g
-    // line_step      g b G b
-    // line_step2     r g r g
-    rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    //rgb_pixel[rgb_line_step + 5] = AVG( bayer_pixel[line_step] , bayer_pixel[line_step+2] );
+    if (dh == 0 && dv == 0)
+      return (T)((u + d + l + r) >> 2);
+    // The products overflow 32 bits for 16-bit data
+    int64_t num = (int64_t)(u + d) * dh + (int64_t)(l + r) * dv;
+    return (T)(num / (2 * (dh + dv)));
   }
+  if (dh > dv)
+    return (T)((u + d) >> 1);
+  if (dv > dh)
+    return (T)((l + r) >> 1);
+  return (T)((u + d + l + r) >> 2);
+}
+
+// Debayers pixels [x_begin, x_end) of row y one at a time.
+template <typename T>
+void edgeAwareRowScalar(const cv::Mat& bayer, BayerPattern pattern, bool weighted,
+                        cv::Mat& color, int y, int x_begin, int x_end)
+{
+  const T* up   = bayer.ptr<T>(reflect101(y - 1, bayer.rows));
+  const T* row  = bayer.ptr<T>(y);
+  const T* down = bayer.ptr<T>(reflect101(y + 1, bayer.rows));
+  T* bgr = color.ptr<T>(y);
+  bool red_row = (y & 1) == pattern.red_y;
+  // Red and blue samples are where x ^ y has the same parity as red_x ^ red_y
+  int colored_parity = (pattern.red_x ^ pattern.red_y) & 1;
 
-  // last two pixel values for first two lines
-  // GRGR line
-  // Bayer        -1 0 1
-  //           0   r G r
-  //   line_step   g b g
-  // line_step2    r g r
-  rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-  rgb_buffer[1] = bayer_pixel[0];
-  rgb_buffer[rgb_line_step + 5] = rgb_buffer[rgb_line_step + 2] = rgb_buffer[5] = rgb_buffer[2] = bayer_pixel[bayer_line_step];
-
-  // Bayer        -1 0 1
-  //          0    r g R
-  //  line_step    g b g
-  // line_step2    r g r
-  rgb_buffer[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step + 1]);
-  //rgb_pixel[5] = bayer_pixel[line_step];
-
-  // BGBG line
-  // Bayer        -1 0 1
-  //          0    r g r
-  //  line_step    g B g
-  // line_step2    r g r
-  rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-  rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-  //rgb_pixel[rgb_line_step + 2] = bayer_pixel[line_step];
-
-  // Bayer         -1 0 1
-  //         0      r g r
-  // line_step      g b G
-  // line_step2     r g r
-  rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  //rgb_pixel[rgb_line_step + 5] = bayer_pixel[line_step];
-
-  bayer_pixel += bayer_line_step + 2;
-  rgb_buffer += rgb_line_step + 6 + rgb_line_skip;
-  // main processing
-  for (yIdx = 2; yIdx < height - 2; yIdx += 2)
+  for (int x = x_begin; x < x_end; ++x)
   {
-    // first two pixel values
-    // Bayer         0 1 2
-    //        -1     b g b
-    //         0     G r g
-    // line_step     b g b
-    // line_step2    g r g
-    
-    rgb_buffer[3] = rgb_buffer[0] = bayer_pixel[1]; // red pixel
-    rgb_buffer[1] = bayer_pixel[0]; // green pixel
-    rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]); // blue;
-    
-    // Bayer         0 1 2
-    //        -1     b g b
-    //         0     g R g
-    // line_step     b g b
-    // line_step2    g r g
-    //rgb_pixel[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG4 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1], bayer_pixel[1 - bayer_line_step]);
-    rgb_buffer[5] = AVG4 (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2], bayer_pixel[-bayer_line_step], bayer_pixel[2 - bayer_line_step]);
-    
-    // BGBG line
-    // Bayer         0 1 2
-    //         0     g r g
-    // line_step     B g b
-    // line_step2    g r g
-    rgb_buffer[rgb_line_step + 3] = rgb_buffer[rgb_line_step ] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-    rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step + 1], bayer_pixel[bayer_line_step2]);
-    rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-    
-    // pixel (1, 1)  0 1 2
-    //         0     g r g
-    // line_step     b G b
-    // line_step2    g r g
-    //rgb_pixel[rgb_line_step + 3] = AVG( bayer_pixel[1] , bayer_pixel[line_step2+1] );
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-    
-    rgb_buffer += 6;
-    bayer_pixel += 2;
-    // continue with rest of the line
-    for (xIdx = 2; xIdx < width - 2; xIdx += 2, rgb_buffer += 6, bayer_pixel += 2)
+    int xl = reflect101(x - 1, bayer.cols);
+    int xr = reflect101(x + 1, bayer.cols);
+    int c = row[x], l = row[xl], r = row[xr], u = up[x], d = down[x];
+    T* out = bgr + 3 * x;
+    if (((x ^ y) & 1) != colored_parity)
+    {
+      T h = (T)((l + r) >> 1);
+      T v = (T)((u + d) >> 1);
+      out[0] = red_row ? v : h;
+      out[1] = (T)c;
+      out[2] = red_row ? h : v;
+    }
+    else
     {
-      // GRGR line
-      // Bayer        -1 0 1 2
-      //          -1   g b g b
-      //           0   r G r g
-      //   line_step   g b g b
-      // line_step2    r g r g
-      rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-      rgb_buffer[1] = bayer_pixel[0];
-      rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]);
-      
-      // Bayer        -1 0 1 2
-      //          -1   g b g b
-      //          0    r g R g
-      //  line_step    g b g b
-      // line_step2    r g r g
-      
-      dh = abs (bayer_pixel[0] - bayer_pixel[2]);
-      dv = abs (bayer_pixel[-bayer_line_step + 1] - bayer_pixel[bayer_line_step + 1]);
-      
-      if (dh > dv)
-        rgb_buffer[4] = AVG (bayer_pixel[-bayer_line_step + 1], bayer_pixel[bayer_line_step + 1]);
-      else if (dv > dh)
-        rgb_buffer[4] = AVG (bayer_pixel[0], bayer_pixel[2]);
-      else
-        rgb_buffer[4] = AVG4 (bayer_pixel[-bayer_line_step + 1], bayer_pixel[bayer_line_step + 1], bayer_pixel[0], bayer_pixel[2]);
-      
-      rgb_buffer[3] = bayer_pixel[1];
-      rgb_buffer[5] = AVG4 (bayer_pixel[-bayer_line_step], bayer_pixel[2 - bayer_line_step], bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-      
-      // BGBG line
-      // Bayer         -1 0 1 2
-      //         -1     g b g b
-      //          0     r g r g
-      // line_step      g B g b
-      // line_step2     r g r g
-      rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-      rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-      
-      dv = abs (bayer_pixel[0] - bayer_pixel[bayer_line_step2]);
-      dh = abs (bayer_pixel[bayer_line_step - 1] - bayer_pixel[bayer_line_step + 1]);
-      
-      if (dv > dh)
-        rgb_buffer[rgb_line_step + 1] = AVG (bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-      else if (dh > dv)
-        rgb_buffer[rgb_line_step + 1] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step2]);
-      else
-        rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-      
-      // Bayer         -1 0 1 2
-      //         -1     g b g b
-      //          0     r g r g
-      // line_step      g b G b
-      // line_step2     r g r g
-      rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-      rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-      rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
+      T diag = (T)(((int)up[xl] + (int)up[xr] + (int)down[xl] + (int)down[xr]) >> 2);
+      out[0] = red_row ? diag : (T)c;
+      out[1] = edgeAwareGreen<T>(u, d, l, r, weighted);
+      out[2] = red_row ? (T)c : diag;
     }
-    
-    // last two pixels of the line
-    // last two pixel values for first two lines
-    // GRGR line
-    // Bayer        -1 0 1
-    //           0   r G r
-    //   line_step   g b g
-    // line_step2    r g r
-    rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-    rgb_buffer[1] = bayer_pixel[0];
-    rgb_buffer[rgb_line_step + 5] = rgb_buffer[rgb_line_step + 2] = rgb_buffer[5] = rgb_buffer[2] = bayer_pixel[bayer_line_step];
-    
-    // Bayer        -1 0 1
-    //          0    r g R
-    //  line_step    g b g
-    // line_step2    r g r
-    rgb_buffer[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step + 1]);
-    //rgb_pixel[5] = bayer_pixel[line_step];
-    
-    // BGBG line
-    // Bayer        -1 0 1
-    //          0    r g r
-    //  line_step    g B g
-    // line_step2    r g r
-    rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-    rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-    //rgb_pixel[rgb_line_step + 2] = bayer_pixel[line_step];
-    
-    // Bayer         -1 0 1
-    //         0      r g r
-    // line_step      g b G
-    // line_step2     r g r
-    rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    //rgb_pixel[rgb_line_step + 5] = bayer_pixel[line_step];
-    
-    bayer_pixel += bayer_line_step + 2;
-    rgb_buffer += rgb_line_step + 6 + rgb_line_skip;
   }
-  
-  //last two lines
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     G r g
-  // line_step     b g b
-  
-  rgb_buffer[rgb_line_step + 3] = rgb_buffer[rgb_line_step ] = rgb_buffer[3] = rgb_buffer[0] = bayer_pixel[1]; // red pixel
-  rgb_buffer[1] = bayer_pixel[0]; // green pixel
-  rgb_buffer[rgb_line_step + 2] = rgb_buffer[2] = bayer_pixel[bayer_line_step]; // blue;
-  
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     g R g
-  // line_step     b g b
-  //rgb_pixel[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG4 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1], bayer_pixel[1 - bayer_line_step]);
-  rgb_buffer[5] = AVG4 (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2], bayer_pixel[-bayer_line_step], bayer_pixel[2 - bayer_line_step]);
-  
-  // BGBG line
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     g r g
-  // line_step     B g b
-  //rgb_pixel[rgb_line_step    ] = bayer_pixel[1];
-  rgb_buffer[rgb_line_step + 1] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step + 1]);
-  rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-  
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     g r g
-  // line_step     b G b
-  //rgb_pixel[rgb_line_step + 3] = AVG( bayer_pixel[1] , bayer_pixel[line_step2+1] );
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-  
-  rgb_buffer += 6;
-  bayer_pixel += 2;
-  // rest of the last two lines
-  for (xIdx = 2; xIdx < width - 2; xIdx += 2, rgb_buffer += 6, bayer_pixel += 2)
+}
+
+#ifdef IMAGE_PROC_SIMD
+
+/*
+ * Per-type vector operations. Everything is unsigned and, except for the
+ * weighted blend, stays within the element width instead of widening.
+ */
+#if defined(__SSE2__)
+
+struct SimdBase
+{
+  typedef __m128i V;
+  static V and_(V a, V b) { return _mm_and_si128(a, b); }
+  static V or_(V a, V b)  { return _mm_or_si128(a, b); }
+  static V xor_(V a, V b) { return _mm_xor_si128(a, b); }
+  static V select(V mask, V a, V b)
+  {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+};
+
+struct Simd8U : SimdBase
+{
+  typedef uint8_t T;
+  enum { LANES = 16 };
+
+  static V load(const T* p) { return simd::load(p); }
+  static V one() { return _mm_set1_epi8(1); }
+  static V add(V a, V b) { return _mm_add_epi8(a, b); }
+  static V avg(V a, V b) { return simd::avgFloor8(a, b); }
+  static V absdiff(V a, V b) { return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); }
+  static V le(V a, V b) { return _mm_cmpeq_epi8(_mm_subs_epu8(a, b), _mm_setzero_si128()); }
+  static V isZero(V a) { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+  static V evenLanes(bool even) { return _mm_set1_epi16(even ? 0x00FF : (short)0xFF00); }
+
+  // ((u + d) * dh + (l + r) * dv) / (2 * (dh + dv)) on 8 lanes widened to 16 bits.
+  // The numerator is below 2^18, so the float division truncates exactly.
+  static __m128i weighted16(V u, V d, V l, V r, V dh, V dv)
+  {
+    const __m128i z = _mm_setzero_si128();
+    __m128i vs = _mm_add_epi16(u, d), hs = _mm_add_epi16(l, r);
+    // Lanes with dh == dv == 0 are replaced by the caller; just avoid 0 / 0
+    __m128i den = _mm_max_epi16(_mm_slli_epi16(_mm_add_epi16(dh, dv), 1), _mm_set1_epi16(1));
+    __m128i num_lo = _mm_madd_epi16(_mm_unpacklo_epi16(vs, hs), _mm_unpacklo_epi16(dh, dv));
+    __m128i num_hi = _mm_madd_epi16(_mm_unpackhi_epi16(vs, hs), _mm_unpackhi_epi16(dh, dv));
+    __m128 q_lo = _mm_div_ps(_mm_cvtepi32_ps(num_lo), _mm_cvtepi32_ps(_mm_unpacklo_epi16(den, z)));
+    __m128 q_hi = _mm_div_ps(_mm_cvtepi32_ps(num_hi), _mm_cvtepi32_ps(_mm_unpackhi_epi16(den, z)));
+    return _mm_packs_epi32(_mm_cvttps_epi32(q_lo), _mm_cvttps_epi32(q_hi));
+  }
+
+  static V weighted(V u, V d, V l, V r, V dh, V dv)
+  {
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = weighted16(_mm_unpacklo_epi8(u, z), _mm_unpacklo_epi8(d, z),
+                            _mm_unpacklo_epi8(l, z), _mm_unpacklo_epi8(r, z),
+                            _mm_unpacklo_epi8(dh, z), _mm_unpacklo_epi8(dv, z));
+    __m128i hi = weighted16(_mm_unpackhi_epi8(u, z), _mm_unpackhi_epi8(d, z),
+                            _mm_unpackhi_epi8(l, z), _mm_unpackhi_epi8(r, z),
+                            _mm_unpackhi_epi8(dh, z), _mm_unpackhi_epi8(dv, z));
+    return _mm_packus_epi16(lo, hi);
+  }
+
+  static void store3(T* dst, V b, V g, V r) { simd::storeBGR(dst, b, g, r); }
+};
+
+struct Simd16U : SimdBase
+{
+  typedef uint16_t T;
+  enum { LANES = 8 };
+
+  static V load(const T* p) { return simd::load(p); }
+  static V one() { return _mm_set1_epi16(1); }
+  static V add(V a, V b) { return _mm_add_epi16(a, b); }
+  static V avg(V a, V b) { return simd::avgFloor16(a, b); }
+  static V absdiff(V a, V b) { return _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a)); }
+  static V le(V a, V b) { return _mm_cmpeq_epi16(_mm_subs_epu16(a, b), _mm_setzero_si128()); }
+  static V isZero(V a) { return _mm_cmpeq_epi16(a, _mm_setzero_si128()); }
+  static V evenLanes(bool even) { return _mm_set1_epi32(even ? 0x0000FFFF : (int)0xFFFF0000); }
+
+  // Weighted blend of lanes 0 and 1 of 32-bit vectors. For 16-bit data the
+  // numerator needs up to 35 bits, which doubles hold exactly.
+  static __m128d weightedPair(__m128i vs, __m128i hs, __m128i dh, __m128i dv)
+  {
+    __m128d h = _mm_cvtepi32_pd(dh), v = _mm_cvtepi32_pd(dv);
+    __m128d num = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(vs), h), _mm_mul_pd(_mm_cvtepi32_pd(hs), v));
+    __m128d den = _mm_max_pd(_mm_add_pd(_mm_add_pd(h, v), _mm_add_pd(h, v)), _mm_set1_pd(1.0));
+    return _mm_div_pd(num, den);
+  }
+
+  static __m128i weighted32(__m128i vs, __m128i hs, __m128i dh, __m128i dv)
+  {
+    __m128i lo = _mm_cvttpd_epi32(weightedPair(vs, hs, dh, dv));
+    __m128i hi = _mm_cvttpd_epi32(weightedPair(_mm_srli_si128(vs, 8), _mm_srli_si128(hs, 8),
+                                               _mm_srli_si128(dh, 8), _mm_srli_si128(dv, 8)));
+    return _mm_unpacklo_epi64(lo, hi);
+  }
+
+  static V weighted(V u, V d, V l, V r, V dh, V dv)
+  {
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = weighted32(_mm_add_epi32(_mm_unpacklo_epi16(u, z), _mm_unpacklo_epi16(d, z)),
+                            _mm_add_epi32(_mm_unpacklo_epi16(l, z), _mm_unpacklo_epi16(r, z)),
+                            _mm_unpacklo_epi16(dh, z), _mm_unpacklo_epi16(dv, z));
+    __m128i hi = weighted32(_mm_add_epi32(_mm_unpackhi_epi16(u, z), _mm_unpackhi_epi16(d, z)),
+                            _mm_add_epi32(_mm_unpackhi_epi16(l, z), _mm_unpackhi_epi16(r, z)),
+                            _mm_unpackhi_epi16(dh, z), _mm_unpackhi_epi16(dv, z));
+    // No unsigned 32->16 pack before SSE4.1: shift into signed range and back
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32)), bias16);
+  }
+
+  static void store3(T* dst, V b, V g, V r) { simd::storeBGR(dst, b, g, r); }
+};
+
+#else // NEON
+
+// ARMv7 NEON has no vector division, so the weighted blend is done per lane.
+template <typename T, int N>
+inline void weightedLanes(const T* u, const T* d, const T* l, const T* r, T* out)
+{
+  for (int i = 0; i < N; ++i)
+    out[i] = edgeAwareGreen<T>(u[i], d[i], l[i], r[i], true);
+}
+
+struct Simd8U
+{
+  typedef uint8_t T;
+  typedef uint8x16_t V;
+  enum { LANES = 16 };
+
+  static V load(const T* p) { return vld1q_u8(p); }
+  static V one() { return vdupq_n_u8(1); }
+  static V add(V a, V b) { return vaddq_u8(a, b); }
+  static V and_(V a, V b) { return vandq_u8(a, b); }
+  static V or_(V a, V b)  { return vorrq_u8(a, b); }
+  static V xor_(V a, V b) { return veorq_u8(a, b); }
+  static V select(V mask, V a, V b) { return vbslq_u8(mask, a, b); }
+  static V avg(V a, V b) { return vhaddq_u8(a, b); }
+  static V absdiff(V a, V b) { return vabdq_u8(a, b); }
+  static V le(V a, V b) { return vcleq_u8(a, b); }
+  static V isZero(V a) { return vceqq_u8(a, vdupq_n_u8(0)); }
+  static V evenLanes(bool even) { return vreinterpretq_u8_u16(vdupq_n_u16(even ? 0x00FF : 0xFF00)); }
+
+  static V weighted(V u, V d, V l, V r, V, V)
+  {
+    T uu[LANES], dd[LANES], ll[LANES], rr[LANES], out[LANES];
+    vst1q_u8(uu, u);
+    vst1q_u8(dd, d);
+    vst1q_u8(ll, l);
+    vst1q_u8(rr, r);
+    weightedLanes<T, LANES>(uu, dd, ll, rr, out);
+    return vld1q_u8(out);
+  }
+
+  static void store3(T* dst, V b, V g, V r) { simd::storeBGR(dst, b, g, r); }
+};
+
+struct Simd16U
+{
+  typedef uint16_t T;
+  typedef uint16x8_t V;
+  enum { LANES = 8 };
+
+  static V load(const T* p) { return vld1q_u16(p); }
+  static V one() { return vdupq_n_u16(1); }
+  static V add(V a, V b) { return vaddq_u16(a, b); }
+  static V and_(V a, V b) { return vandq_u16(a, b); }
+  static V or_(V a, V b)  { return vorrq_u16(a, b); }
+  static V xor_(V a, V b) { return veorq_u16(a, b); }
+  static V select(V mask, V a, V b) { return vbslq_u16(mask, a, b); }
+  static V avg(V a, V b) { return vhaddq_u16(a, b); }
+  static V absdiff(V a, V b) { return vabdq_u16(a, b); }
+  static V le(V a, V b) { return vcleq_u16(a, b); }
+  static V isZero(V a) { return vceqq_u16(a, vdupq_n_u16(0)); }
+  static V evenLanes(bool even) { return vreinterpretq_u16_u32(vdupq_n_u32(even ? 0x0000FFFF : 0xFFFF0000)); }
+
+  static V weighted(V u, V d, V l, V r, V, V)
   {
-    // GRGR line
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r G r g
-    // line_step    g b g b
-    rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-    rgb_buffer[1] = bayer_pixel[0];
-    rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]);
-    
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r g R g
-    // line_step    g b g b
-    rgb_buffer[rgb_line_step + 3] = rgb_buffer[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG4 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1], bayer_pixel[1 - bayer_line_step]);
-    rgb_buffer[5] = AVG4 (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2], bayer_pixel[-bayer_line_step], bayer_pixel[-bayer_line_step + 2]);
-    
-    // BGBG line
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r g r g
-    // line_step    g B g b
-    rgb_buffer[rgb_line_step ] = AVG (bayer_pixel[-1], bayer_pixel[1]);
-    rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-    rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-    
-    
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r g r g
-    // line_step    g b G b
-    //rgb_pixel[rgb_line_step + 3] = bayer_pixel[1];
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
+    T uu[LANES], dd[LANES], ll[LANES], rr[LANES], out[LANES];
+    vst1q_u16(uu, u);
+    vst1q_u16(dd, d);
+    vst1q_u16(ll, l);
+    vst1q_u16(rr, r);
+    weightedLanes<T, LANES>(uu, dd, ll, rr, out);
+    return vld1q_u16(out);
   }
-  
-  // last two pixel values for first two lines
-  // GRGR line
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r G r
-  // line_step    g b g
-  rgb_buffer[rgb_line_step ] = rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-  rgb_buffer[1] = bayer_pixel[0];
-  rgb_buffer[5] = rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]);
-  
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r g R
-  // line_step    g b g
-  rgb_buffer[rgb_line_step + 3] = rgb_buffer[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step + 1], bayer_pixel[-bayer_line_step + 1]);
-  //rgb_pixel[5] = AVG( bayer_pixel[line_step], bayer_pixel[-line_step] );
-  
-  // BGBG line
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r g r
-  // line_step    g B g
-  //rgb_pixel[rgb_line_step    ] = AVG2( bayer_pixel[-1], bayer_pixel[1] );
-  rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-  rgb_buffer[rgb_line_step + 5] = rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-  
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r g r
-  // line_step    g b G
-  //rgb_pixel[rgb_line_step + 3] = bayer_pixel[1];
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  //rgb_pixel[rgb_line_step + 5] = bayer_pixel[line_step];
+
+  static void store3(T* dst, V b, V g, V r) { simd::storeBGR(dst, b, g, r); }
+};
+
+#endif
+
+// floor((a + b + c + d) / 4) without widening: average the two pair averages
+// and add back the carry lost when both pair sums and their sum were odd.
+template <class S>
+inline typename S::V avg4(typename S::V a, typename S::V b, typename S::V c, typename S::V d)
+{
+  typename S::V p = S::avg(a, b), q = S::avg(c, d);
+  typename S::V carry = S::and_(S::and_(S::xor_(a, b), S::xor_(c, d)),
+                                S::and_(S::xor_(p, q), S::one()));
+  return S::add(S::avg(p, q), carry);
 }
 
-void debayerEdgeAwareWeighted(const cv::Mat& bayer, cv::Mat& color)
+// Debayers the interior of row y (0 < y < rows - 1) from x = 1 in whole
+// vectors. Returns the first column left for the scalar code.
+template <class S>
+int edgeAwareRowSimd(const cv::Mat& bayer, BayerPattern pattern, bool weighted,
+                     cv::Mat& color, int y)
 {
-  unsigned width = bayer.cols;
-  unsigned height = bayer.rows;
-  unsigned rgb_line_step = color.step[0];
-  unsigned rgb_line_skip = rgb_line_step - width * 3;
-  int bayer_line_step = bayer.step[0];
-  int bayer_line_step2 = bayer_line_step * 2;
-
-  unsigned char* rgb_buffer = color.data;
-  unsigned char* bayer_pixel = bayer.data;
-  unsigned yIdx, xIdx;
-
-  int dh, dv;
-
-  // first two pixel values for first two lines
-  // Bayer         0 1 2
-  //         0     G r g
-  // line_step     b g b
-  // line_step2    g r g
-
-  rgb_buffer[3] = rgb_buffer[0] = bayer_pixel[1]; // red pixel
-  rgb_buffer[1] = bayer_pixel[0]; // green pixel
-  rgb_buffer[rgb_line_step + 2] = rgb_buffer[2] = bayer_pixel[bayer_line_step]; // blue;
-  
-  // Bayer         0 1 2
-  //         0     g R g
-  // line_step     b g b
-  // line_step2    g r g
-  //rgb_pixel[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG3 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1]);
-  rgb_buffer[rgb_line_step + 5] = rgb_buffer[5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-  
-  // BGBG line
-  // Bayer         0 1 2
-  //         0     g r g
-  // line_step     B g b
-  // line_step2    g r g
-  rgb_buffer[rgb_line_step + 3] = rgb_buffer[rgb_line_step ] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-  rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step + 1], bayer_pixel[bayer_line_step2]);
-  //rgb_pixel[rgb_line_step + 2] = bayer_pixel[line_step];
-  
-  // pixel (1, 1)  0 1 2
-  //         0     g r g
-  // line_step     b G b
-  // line_step2    g r g
-  //rgb_pixel[rgb_line_step + 3] = AVG( bayer_pixel[1] , bayer_pixel[line_step2+1] );
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  //rgb_pixel[rgb_line_step + 5] = AVG( bayer_pixel[line_step] , bayer_pixel[line_step+2] );
-  
-  rgb_buffer += 6;
-  bayer_pixel += 2;
-  // rest of the first two lines
-  for (xIdx = 2; xIdx < width - 2; xIdx += 2, rgb_buffer += 6, bayer_pixel += 2)
+  typedef typename S::T T;
+  typedef typename S::V V;
+  const T* up   = bayer.ptr<T>(y - 1);
+  const T* row  = bayer.ptr<T>(y);
+  const T* down = bayer.ptr<T>(y + 1);
+  T* bgr = color.ptr<T>(y);
+  bool red_row = (y & 1) == pattern.red_y;
+
+  // x advances by an even number of lanes, so the red/blue lanes are fixed per row
+  int x = 1;
+  V colored = S::evenLanes(((x ^ y) & 1) == ((pattern.red_x ^ pattern.red_y) & 1));
+
+  for (; x + S::LANES < bayer.cols; x += S::LANES)
   {
-    // GRGR line
-    // Bayer        -1 0 1 2
-    //           0   r G r g
-    //   line_step   g b g b
-    // line_step2    r g r g
-    rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-    rgb_buffer[1] = bayer_pixel[0];
-    rgb_buffer[2] = bayer_pixel[bayer_line_step + 1];
-    
-    // Bayer        -1 0 1 2
-    //          0    r g R g
-    //  line_step    g b g b
-    // line_step2    r g r g
-    rgb_buffer[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG3 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1]);
-    rgb_buffer[rgb_line_step + 5] = rgb_buffer[5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-    
-    // BGBG line
-    // Bayer         -1 0 1 2
-    //         0      r g r g
-    // line_step      g B g b
-    // line_step2     r g r g
-    rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-    rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-    rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-    
-    // Bayer         -1 0 1 2
-    //         0      r g r g
-    // line_step      g b G b
-    // line_step2     r g r g
-    rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    //rgb_pixel[rgb_line_step + 5] = AVG( bayer_pixel[line_step] , bayer_pixel[line_step+2] );
+    V c = S::load(row + x);
+    V l = S::load(row + x - 1), r = S::load(row + x + 1);
+    V u = S::load(up + x),      d = S::load(down + x);
+    V h = S::avg(l, r), v = S::avg(u, d);
+    V cross = avg4<S>(u, d, l, r);
+    V diag = avg4<S>(S::load(up + x - 1), S::load(up + x + 1),
+                     S::load(down + x - 1), S::load(down + x + 1));
+    V dh = S::absdiff(l, r), dv = S::absdiff(u, d);
+
+    V g;
+    if (weighted)
+      g = S::select(S::isZero(S::or_(dh, dv)), cross, S::weighted(u, d, l, r, dh, dv));
+    else
+      g = S::select(S::le(dh, dv), S::select(S::le(dv, dh), cross, h), v);
+    g = S::select(colored, g, c);
+
+    if (red_row)
+      S::store3(bgr + 3 * x, S::select(colored, diag, v), g, S::select(colored, c, h));
+    else
+      S::store3(bgr + 3 * x, S::select(colored, c, h), g, S::select(colored, diag, v));
   }
-  
-  // last two pixel values for first two lines
-  // GRGR line
-  // Bayer        -1 0 1
-  //           0   r G r
-  //   line_step   g b g
-  // line_step2    r g r
-  rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-  rgb_buffer[1] = bayer_pixel[0];
-  rgb_buffer[rgb_line_step + 5] = rgb_buffer[rgb_line_step + 2] = rgb_buffer[5] = rgb_buffer[2] = bayer_pixel[bayer_line_step];
-  
-  // Bayer        -1 0 1
-  //          0    r g R
-  //  line_step    g b g
-  // line_step2    r g r
-  rgb_buffer[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step + 1]);
-  //rgb_pixel[5] = bayer_pixel[line_step];
-  
-  // BGBG line
-  // Bayer        -1 0 1
-  //          0    r g r
-  //  line_step    g B g
-  // line_step2    r g r
-  rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-  rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-  //rgb_pixel[rgb_line_step + 2] = bayer_pixel[line_step];
-  
-  // Bayer         -1 0 1
-  //         0      r g r
-  // line_step      g b G
-  // line_step2     r g r
-  rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  //rgb_pixel[rgb_line_step + 5] = bayer_pixel[line_step];
-  
-  bayer_pixel += bayer_line_step + 2;
-  rgb_buffer += rgb_line_step + 6 + rgb_line_skip;
-  // main processing
-  for (yIdx = 2; yIdx < height - 2; yIdx += 2)
+  return x;
+}
+
+#endif // SIMD
+
+template <typename T, class S>
+void debayerEdgeAwareImpl(const cv::Mat& bayer, BayerPattern pattern, bool weighted,
+                          bool simd, cv::Mat& color)
+{
+  for (int y = 0; y < bayer.rows; ++y)
   {
-    // first two pixel values
-    // Bayer         0 1 2
-    //        -1     b g b
-    //         0     G r g
-    // line_step     b g b
-    // line_step2    g r g
-    
-    rgb_buffer[3] = rgb_buffer[0] = bayer_pixel[1]; // red pixel
-    rgb_buffer[1] = bayer_pixel[0]; // green pixel
-    rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]); // blue;
-    
-    // Bayer         0 1 2
-    //        -1     b g b
-    //         0     g R g
-    // line_step     b g b
-    // line_step2    g r g
-    //rgb_pixel[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG4 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1], bayer_pixel[1 - bayer_line_step]);
-    rgb_buffer[5] = AVG4 (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2], bayer_pixel[-bayer_line_step], bayer_pixel[2 - bayer_line_step]);
-    
-    // BGBG line
-    // Bayer         0 1 2
-    //         0     g r g
-    // line_step     B g b
-    // line_step2    g r g
-    rgb_buffer[rgb_line_step + 3] = rgb_buffer[rgb_line_step ] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-    rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step + 1], bayer_pixel[bayer_line_step2]);
-    rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-    
-    // pixel (1, 1)  0 1 2
-    //         0     g r g
-    // line_step     b G b
-    // line_step2    g r g
-    //rgb_pixel[rgb_line_step + 3] = AVG( bayer_pixel[1] , bayer_pixel[line_step2+1] );
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-    
-    rgb_buffer += 6;
-    bayer_pixel += 2;
-    // continue with rest of the line
-    for (xIdx = 2; xIdx < width - 2; xIdx += 2, rgb_buffer += 6, bayer_pixel += 2)
+    int x = 0;
+#ifdef IMAGE_PROC_SIMD
+    if (simd && y > 0 && y < bayer.rows - 1)
     {
-      // GRGR line
-      // Bayer        -1 0 1 2
-      //          -1   g b g b
-      //           0   r G r g
-      //   line_step   g b g b
-      // line_step2    r g r g
-      rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-      rgb_buffer[1] = bayer_pixel[0];
-      rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]);
-      
-      // Bayer        -1 0 1 2
-      //          -1   g b g b
-      //          0    r g R g
-      //  line_step    g b g b
-      // line_step2    r g r g
-      
-      dh = abs (bayer_pixel[0] - bayer_pixel[2]);
-      dv = abs (bayer_pixel[-bayer_line_step + 1] - bayer_pixel[bayer_line_step + 1]);
-      
-      if (dv == 0 && dh == 0)
-        rgb_buffer[4] = AVG4 (bayer_pixel[1 - bayer_line_step], bayer_pixel[1 + bayer_line_step], bayer_pixel[0], bayer_pixel[2]);
-      else
-        rgb_buffer[4] = WAVG4 (bayer_pixel[1 - bayer_line_step], bayer_pixel[1 + bayer_line_step], bayer_pixel[0], bayer_pixel[2], dh, dv);
-      rgb_buffer[3] = bayer_pixel[1];
-      rgb_buffer[5] = AVG4 (bayer_pixel[-bayer_line_step], bayer_pixel[2 - bayer_line_step], bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-      
-      // BGBG line
-      // Bayer         -1 0 1 2
-      //         -1     g b g b
-      //          0     r g r g
-      // line_step      g B g b
-      // line_step2     r g r g
-      rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-      rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-      
-      dv = abs (bayer_pixel[0] - bayer_pixel[bayer_line_step2]);
-      dh = abs (bayer_pixel[bayer_line_step - 1] - bayer_pixel[bayer_line_step + 1]);
-      
-      if (dv == 0 && dh == 0)
-        rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-      else
-        rgb_buffer[rgb_line_step + 1] = WAVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1], dh, dv);
-      
-      // Bayer         -1 0 1 2
-      //         -1     g b g b
-      //          0     r g r g
-      // line_step      g b G b
-      // line_step2     r g r g
-      rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-      rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-      rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
+      edgeAwareRowScalar<T>(bayer, pattern, weighted, color, y, 0, 1);
+      x = edgeAwareRowSimd<S>(bayer, pattern, weighted, color, y);
     }
-    
-    // last two pixels of the line
-    // last two pixel values for first two lines
-    // GRGR line
-    // Bayer        -1 0 1
-    //           0   r G r
-    //   line_step   g b g
-    // line_step2    r g r
-    rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-    rgb_buffer[1] = bayer_pixel[0];
-    rgb_buffer[rgb_line_step + 5] = rgb_buffer[rgb_line_step + 2] = rgb_buffer[5] = rgb_buffer[2] = bayer_pixel[bayer_line_step];
-    
-    // Bayer        -1 0 1
-    //          0    r g R
-    //  line_step    g b g
-    // line_step2    r g r
-    rgb_buffer[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step + 1]);
-    //rgb_pixel[5] = bayer_pixel[line_step];
-    
-    // BGBG line
-    // Bayer        -1 0 1
-    //          0    r g r
-    //  line_step    g B g
-    // line_step2    r g r
-    rgb_buffer[rgb_line_step ] = AVG4 (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1], bayer_pixel[-1], bayer_pixel[bayer_line_step2 - 1]);
-    rgb_buffer[rgb_line_step + 1] = AVG4 (bayer_pixel[0], bayer_pixel[bayer_line_step2], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-    //rgb_pixel[rgb_line_step + 2] = bayer_pixel[line_step];
-    
-    // Bayer         -1 0 1
-    //         0      r g r
-    // line_step      g b G
-    // line_step2     r g r
-    rgb_buffer[rgb_line_step + 3] = AVG (bayer_pixel[1], bayer_pixel[bayer_line_step2 + 1]);
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    //rgb_pixel[rgb_line_step + 5] = bayer_pixel[line_step];
-    
-    bayer_pixel += bayer_line_step + 2;
-    rgb_buffer += rgb_line_step + 6 + rgb_line_skip;
+#endif
+    edgeAwareRowScalar<T>(bayer, pattern, weighted, color, y, x, bayer.cols);
   }
-  
-  //last two lines
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     G r g
-  // line_step     b g b
-  
-  rgb_buffer[rgb_line_step + 3] = rgb_buffer[rgb_line_step ] = rgb_buffer[3] = rgb_buffer[0] = bayer_pixel[1]; // red pixel
-  rgb_buffer[1] = bayer_pixel[0]; // green pixel
-  rgb_buffer[rgb_line_step + 2] = rgb_buffer[2] = bayer_pixel[bayer_line_step]; // blue;
-  
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     g R g
-  // line_step     b g b
-  //rgb_pixel[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG4 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1], bayer_pixel[1 - bayer_line_step]);
-  rgb_buffer[5] = AVG4 (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2], bayer_pixel[-bayer_line_step], bayer_pixel[2 - bayer_line_step]);
-  
-  // BGBG line
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     g r g
-  // line_step     B g b
-  //rgb_pixel[rgb_line_step    ] = bayer_pixel[1];
-  rgb_buffer[rgb_line_step + 1] = AVG (bayer_pixel[0], bayer_pixel[bayer_line_step + 1]);
-  rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-
-  // Bayer         0 1 2
-  //        -1     b g b
-  //         0     g r g
-  // line_step     b G b
-  //rgb_pixel[rgb_line_step + 3] = AVG( bayer_pixel[1] , bayer_pixel[line_step2+1] );
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-  
-  rgb_buffer += 6;
-  bayer_pixel += 2;
-  // rest of the last two lines
-  for (xIdx = 2; xIdx < width - 2; xIdx += 2, rgb_buffer += 6, bayer_pixel += 2)
-  {
-    // GRGR line
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r G r g
-    // line_step    g b g b
-    rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-    rgb_buffer[1] = bayer_pixel[0];
-    rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]);
-    
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r g R g
-    // line_step    g b g b
-    rgb_buffer[rgb_line_step + 3] = rgb_buffer[3] = bayer_pixel[1];
-    rgb_buffer[4] = AVG4 (bayer_pixel[0], bayer_pixel[2], bayer_pixel[bayer_line_step + 1], bayer_pixel[1 - bayer_line_step]);
-    rgb_buffer[5] = AVG4 (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2], bayer_pixel[-bayer_line_step], bayer_pixel[-bayer_line_step + 2]);
-
-    // BGBG line
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r g r g
-    // line_step    g B g b
-    rgb_buffer[rgb_line_step ] = AVG (bayer_pixel[-1], bayer_pixel[1]);
-    rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-    rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-    
-    
-    // Bayer       -1 0 1 2
-    //        -1    g b g b
-    //         0    r g r g
-    // line_step    g b G b
-    //rgb_pixel[rgb_line_step + 3] = bayer_pixel[1];
-    rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-    rgb_buffer[rgb_line_step + 5] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[bayer_line_step + 2]);
-  }
-  
-  // last two pixel values for first two lines
-  // GRGR line
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r G r
-  // line_step    g b g
-  rgb_buffer[rgb_line_step ] = rgb_buffer[0] = AVG (bayer_pixel[1], bayer_pixel[-1]);
-  rgb_buffer[1] = bayer_pixel[0];
-  rgb_buffer[5] = rgb_buffer[2] = AVG (bayer_pixel[bayer_line_step], bayer_pixel[-bayer_line_step]);
-  
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r g R
-  // line_step    g b g
-  rgb_buffer[rgb_line_step + 3] = rgb_buffer[3] = bayer_pixel[1];
-  rgb_buffer[4] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step + 1], bayer_pixel[-bayer_line_step + 1]);
-  //rgb_pixel[5] = AVG( bayer_pixel[line_step], bayer_pixel[-line_step] );
-  
-  // BGBG line
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r g r
-  // line_step    g B g
-  //rgb_pixel[rgb_line_step    ] = AVG2( bayer_pixel[-1], bayer_pixel[1] );
-  rgb_buffer[rgb_line_step + 1] = AVG3 (bayer_pixel[0], bayer_pixel[bayer_line_step - 1], bayer_pixel[bayer_line_step + 1]);
-  rgb_buffer[rgb_line_step + 5] = rgb_buffer[rgb_line_step + 2] = bayer_pixel[bayer_line_step];
-  
-  // Bayer       -1 0 1
-  //        -1    g b g
-  //         0    r g r
-  // line_step    g b G
-  //rgb_pixel[rgb_line_step + 3] = bayer_pixel[1];
-  rgb_buffer[rgb_line_step + 4] = bayer_pixel[bayer_line_step + 1];
-  //rgb_pixel[rgb_line_step + 5] = bayer_pixel[line_step];
+}
+
+#ifndef IMAGE_PROC_SIMD
+struct Simd8U {};
+struct Simd16U {};
+#endif
+
+void debayerEdgeAwareGeneric(const cv::Mat& bayer, BayerPattern pattern, bool weighted,
+                             bool simd, cv::Mat& color)
+{
+  CV_Assert(bayer.type() == CV_8UC1 || bayer.type() == CV_16UC1);
+  color.create(bayer.rows, bayer.cols, CV_MAKETYPE(bayer.depth(), 3));
+  if (bayer.depth() == CV_8U)
+    debayerEdgeAwareImpl<uint8_t, Simd8U>(bayer, pattern, weighted, simd, color);
+  else
+    debayerEdgeAwareImpl<uint16_t, Simd16U>(bayer, pattern, weighted, simd, color);
+}
+
+} // namespace
 
+void debayerEdgeAware(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color)
+{
+  debayerEdgeAwareGeneric(bayer, pattern, false, true, color);
+}
+
+void debayerEdgeAwareWeighted(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color)
+{
+  debayerEdgeAwareGeneric(bayer, pattern, true, true, color);
+}
+
+void debayerEdgeAwareScalar(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color)
+{
+  debayerEdgeAwareGeneric(bayer, pattern, false, false, color);
+}
+
+void debayerEdgeAwareWeightedScalar(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color)
+{
+  debayerEdgeAwareGeneric(bayer, pattern, true, false, color);
 }
 
 } // namespace image_proc
@@ -35,14 +35,25 @@
 #define IMAGE_PROC_EDGE_AWARE
 
 #include <opencv2/core/core.hpp>
+#include "image_proc/bayer.h"
 
 // Edge-aware debayering algorithms, intended for eventual inclusion in OpenCV.
 
 namespace image_proc {
 
-void debayerEdgeAware(const cv::Mat& bayer, cv::Mat& color);
+/**
+ * Edge-aware debayering of any Bayer pattern, CV_8UC1 or CV_16UC1, to BGR of
+ * the same depth. Borders are reflected and handled like the interior.
+ * Vectorized with SSE2 or NEON when available.
+ */
+void debayerEdgeAware(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color);
 
-void debayerEdgeAwareWeighted(const cv::Mat& bayer, cv::Mat& color);
+void debayerEdgeAwareWeighted(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color);
+
+/// Plain C versions of the two functions above, the reference for testing them.
+void debayerEdgeAwareScalar(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color);
+
+void debayerEdgeAwareWeightedScalar(const cv::Mat& bayer, BayerPattern pattern, cv::Mat& color);
 
 } // namespace image_proc
 
@@ -0,0 +1,419 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+
+#include <algorithm>
+#include <boost/make_shared.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+#include <image_transport/camera_common.h>
+#include <image_geometry/pinhole_camera_model.h>
+#include <dynamic_reconfigure/server.h>
+#include <image_proc/RectifyConfig.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/image_pool.h>
+#include <image_proc/latency_monitor.h>
+#include <image_proc/processor.h>
+#include <image_proc/worker_pool.h>
+
+namespace image_proc {
+
+namespace enc = sensor_msgs::image_encodings;
+
+/**
+ * Does the work of a pipeline nodelet for each of several cameras, listed by
+ * namespace in ~cameras: <camera>/image_raw -> <camera>/image_mono,
+ * image_color, image_rect and image_rect_color.
+ *
+ * All cameras share ~num_threads threads: the dispatcher thread, which gathers
+ * the batches and works through each one alongside the pool, and a pool of
+ * ~num_threads - 1 more. Frames are gathered into
+ * batches: once one camera delivers a frame, the nodelet waits up to
+ * ~batch_window seconds for the other subscribed cameras, so a hardware-triggered
+ * rig is processed as one batch, then runs the batch with one whole frame per
+ * thread, largest first. Each frame is debayered and rectified by a single
+ * thread while its intermediate images are still in that core's cache, rather
+ * than being split into bands. A camera that delivers again before its last
+ * frame was picked up replaces it, so at most one frame per camera is waiting.
+ *
+ * As in the pipeline nodelet, debayering is done by Processor: Bayer images are
+ * always debayered bilinearly, ignoring the Debayer config's algorithm, and
+ * frames in encodings other than 8-bit Bayer, bgr8, rgb8 and mono8 (16-bit or
+ * packed Bayer, YUV 4:2:2, ...) are dropped with an error.
+ */
+class MultiPipelineNodelet : public nodelet::Nodelet
+{
+  struct Camera
+  {
+    Camera() : active(false) {}
+
+    std::string name;
+    std::string info_topic; // fixed at init, so workers can log it without connect_mutex_
+    boost::shared_ptr<image_transport::ImageTransport> it;
+    image_transport::CameraSubscriber sub;
+    image_transport::Publisher pub_mono;
+    image_transport::Publisher pub_color;
+    image_transport::Publisher pub_rect;
+    image_transport::Publisher pub_rect_color;
+
+    // Guarded by batch_mutex_
+    bool active; // subscribed to image_raw
+    sensor_msgs::ImageConstPtr pending_raw;
+    sensor_msgs::CameraInfoConstPtr pending_info;
+    LatencyMonitor::Clock::time_point pending_start;
+
+    // Processing state, only touched by the thread processing this camera's frame
+    image_geometry::PinholeCameraModel model;
+    Processor processor;
+  };
+
+  struct Job
+  {
+    Camera* camera;
+    sensor_msgs::ImageConstPtr raw;
+    sensor_msgs::CameraInfoConstPtr info;
+    LatencyMonitor::Clock::time_point start;
+    int interpolation;
+
+    // Largest frames first, so the batch doesn't end waiting on one big frame
+    bool operator<(const Job& other) const
+    {
+      return raw->height * raw->step > other.raw->height * other.raw->step;
+    }
+  };
+
+  int queue_size_;
+  boost::mutex connect_mutex_;
+
+  // Dynamic reconfigure
+  boost::recursive_mutex config_mutex_;
+  typedef image_proc::RectifyConfig Config;
+  typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
+  boost::shared_ptr<ReconfigureServer> reconfigure_server_;
+  ConfigSnapshot<Config> config_;
+
+  // Batching state
+  boost::mutex batch_mutex_;
+  boost::condition_variable batch_cond_;
+  int num_pending_;
+  LatencyMonitor::Clock::time_point batch_start_; // arrival of the first pending frame
+  LatencyMonitor::Clock::duration batch_window_;
+  bool shutdown_;
+
+  boost::shared_ptr<LatencyMonitor> monitor_;
+  boost::shared_ptr<WorkerPool> pool_;
+  boost::thread dispatcher_;
+  // Declared last so the subscribers go away before the state their callbacks use
+  std::vector< boost::shared_ptr<Camera> > cameras_;
+
+public:
+  MultiPipelineNodelet() : num_pending_(0), shutdown_(false) {}
+  virtual ~MultiPipelineNodelet();
+
+private:
+  virtual void onInit();
+
+  void connectCb(Camera* camera);
+
+  void imageCb(Camera* camera, const sensor_msgs::ImageConstPtr& raw_msg,
+               const sensor_msgs::CameraInfoConstPtr& info_msg);
+
+  void dispatchLoop();
+
+  void process(std::vector<Job>* batch, int i);
+
+  void publish(const image_transport::Publisher& pub, const sensor_msgs::ImageConstPtr& raw_msg,
+               const cv::Mat& image, const std::string& encoding);
+
+  void configCb(Config &config, uint32_t level);
+};
+
+MultiPipelineNodelet::~MultiPipelineNodelet()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(batch_mutex_);
+    shutdown_ = true;
+  }
+  batch_cond_.notify_all();
+  if (dispatcher_.joinable())
+    dispatcher_.join();
+}
+
+void MultiPipelineNodelet::onInit()
+{
+  ros::NodeHandle &nh         = getNodeHandle();
+  ros::NodeHandle &private_nh = getPrivateNodeHandle();
+
+  // Read parameters
+  std::vector<std::string> names;
+  private_nh.getParam("cameras", names);
+  if (names.empty())
+  {
+    NODELET_ERROR("No cameras given in ~cameras, nothing to do");
+    return;
+  }
+  private_nh.param("queue_size", queue_size_, 5);
+  int num_threads;
+  private_nh.param("num_threads", num_threads, std::min((int)names.size(),
+                                                        std::max((int)boost::thread::hardware_concurrency(), 1)));
+  double batch_window;
+  private_nh.param("batch_window", batch_window, 0.005);
+  batch_window_ = boost::chrono::duration_cast<LatencyMonitor::Clock::duration>(
+    boost::chrono::duration<double>(std::max(batch_window, 0.0)));
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
+  // The dispatcher thread takes part in each batch, so this starts num_threads - 1 more
+  pool_.reset(new WorkerPool(std::max(num_threads, 1)));
+
+  // Set up dynamic reconfigure
+  reconfigure_server_.reset(new ReconfigureServer(config_mutex_, private_nh));
+  ReconfigureServer::CallbackType f = boost::bind(&MultiPipelineNodelet::configCb, this, _1, _2);
+  reconfigure_server_->setCallback(f);
+
+  // Make sure we don't enter connectCb() between advertising and assigning to pub_XXX
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    boost::shared_ptr<Camera> camera = boost::make_shared<Camera>();
+    camera->name = names[i];
+    ros::NodeHandle camera_nh(nh, names[i]);
+    camera->info_topic = image_transport::getCameraInfoTopic(camera_nh.resolveName("image_raw"));
+    camera->it.reset(new image_transport::ImageTransport(camera_nh));
+
+    // Monitor whether anyone is subscribed to the camera's outputs
+    image_transport::SubscriberStatusCallback connect_cb =
+      boost::bind(&MultiPipelineNodelet::connectCb, this, camera.get());
+    camera->pub_mono       = camera->it->advertise("image_mono",       1, connect_cb, connect_cb);
+    camera->pub_color      = camera->it->advertise("image_color",      1, connect_cb, connect_cb);
+    camera->pub_rect       = camera->it->advertise("image_rect",       1, connect_cb, connect_cb);
+    camera->pub_rect_color = camera->it->advertise("image_rect_color", 1, connect_cb, connect_cb);
+    cameras_.push_back(camera);
+  }
+  dispatcher_ = boost::thread(&MultiPipelineNodelet::dispatchLoop, this);
+  NODELET_INFO("Processing %d cameras on %d threads", (int)cameras_.size(), pool_->size());
+}
+
+// Handles (un)subscribing when clients (un)subscribe
+void MultiPipelineNodelet::connectCb(Camera* camera)
+{
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  bool wanted = camera->pub_mono.getNumSubscribers() || camera->pub_color.getNumSubscribers() ||
+                camera->pub_rect.getNumSubscribers() || camera->pub_rect_color.getNumSubscribers();
+  if (!wanted)
+    camera->sub.shutdown();
+  else if (!camera->sub)
+  {
+    image_transport::TransportHints hints("raw", ros::TransportHints(), getPrivateNodeHandle());
+    camera->sub = camera->it->subscribeCamera("image_raw", queue_size_,
+                                              boost::bind(&MultiPipelineNodelet::imageCb, this, camera, _1, _2),
+                                              ros::VoidPtr(), hints);
+  }
+
+  // Batches only wait for cameras that can deliver
+  boost::lock_guard<boost::mutex> batch_lock(batch_mutex_);
+  camera->active = wanted;
+  if (!wanted && camera->pending_raw)
+  {
+    camera->pending_raw.reset();
+    camera->pending_info.reset();
+    --num_pending_;
+  }
+  batch_cond_.notify_all();
+}
+
+void MultiPipelineNodelet::imageCb(Camera* camera, const sensor_msgs::ImageConstPtr& raw_msg,
+                                   const sensor_msgs::CameraInfoConstPtr& info_msg)
+{
+  // Processor views the raw data in place, so there has to be some
+  if (raw_msg->data.empty())
+  {
+    NODELET_ERROR_THROTTLE(10, "Camera '%s' published an image with no data", camera->name.c_str());
+    return;
+  }
+
+  LatencyMonitor::Clock::time_point start;
+  if (monitor_)
+    start = monitor_->begin(raw_msg->header);
+
+  boost::lock_guard<boost::mutex> lock(batch_mutex_);
+  if (!camera->pending_raw)
+  {
+    if (num_pending_++ == 0)
+      batch_start_ = LatencyMonitor::Clock::now();
+  }
+  else
+    NODELET_DEBUG_THROTTLE(1, "Camera '%s' dropped a frame waiting for the worker pool", camera->name.c_str());
+  camera->pending_raw = raw_msg;
+  camera->pending_info = info_msg;
+  camera->pending_start = start;
+  batch_cond_.notify_all();
+}
+
+void MultiPipelineNodelet::dispatchLoop()
+{
+  std::vector<Job> batch;
+  boost::unique_lock<boost::mutex> lock(batch_mutex_);
+  while (true)
+  {
+    while (!shutdown_ && num_pending_ == 0)
+      batch_cond_.wait(lock);
+    if (shutdown_)
+      return;
+
+    // Give the rest of the cameras that fired with the first one a chance to arrive
+    LatencyMonitor::Clock::time_point deadline = batch_start_ + batch_window_;
+    while (!shutdown_ && num_pending_ > 0)
+    {
+      int num_active = 0;
+      for (size_t i = 0; i < cameras_.size(); ++i)
+        num_active += cameras_[i]->active;
+      if (num_pending_ >= num_active ||
+          batch_cond_.wait_until(lock, deadline) == boost::cv_status::timeout)
+        break;
+    }
+    if (shutdown_)
+      return;
+
+    int interpolation = config_.get()->interpolation;
+    batch.clear();
+    for (size_t i = 0; i < cameras_.size(); ++i)
+    {
+      Camera& camera = *cameras_[i];
+      if (!camera.pending_raw)
+        continue;
+      Job job;
+      job.camera = &camera;
+      job.raw.swap(camera.pending_raw);
+      job.info.swap(camera.pending_info);
+      job.start = camera.pending_start;
+      job.interpolation = interpolation;
+      batch.push_back(job);
+    }
+    num_pending_ = 0;
+    if (batch.empty())
+      continue;
+    std::sort(batch.begin(), batch.end());
+
+    // Frames arriving meanwhile make up the next batch
+    lock.unlock();
+    pool_->parallelFor((int)batch.size(), boost::bind(&MultiPipelineNodelet::process, this, &batch, _1));
+    lock.lock();
+  }
+}
+
+void MultiPipelineNodelet::process(std::vector<Job>* batch, int i)
+{
+  const Job& job = (*batch)[i];
+  Camera& camera = *job.camera;
+
+  // Work out which outputs anyone is listening to
+  int flags = 0;
+  if (camera.pub_mono.getNumSubscribers())
+    flags |= Processor::MONO;
+  if (camera.pub_color.getNumSubscribers())
+    flags |= Processor::COLOR;
+  if (camera.pub_rect.getNumSubscribers())
+    flags |= Processor::RECT;
+  if (camera.pub_rect_color.getNumSubscribers())
+    flags |= Processor::RECT_COLOR;
+
+  // Rectified outputs need a calibrated camera
+  if ((flags & (Processor::RECT | Processor::RECT_COLOR)) && job.info->K[0] == 0.0)
+  {
+    NODELET_ERROR_THROTTLE(30, "Rectified topics requested but camera publishing '%s' "
+                           "is uncalibrated", camera.info_topic.c_str());
+    flags &= ~(Processor::RECT | Processor::RECT_COLOR);
+  }
+
+  ImageSet output;
+  if (flags)
+  {
+    // Update the camera model
+    camera.model.fromCameraInfo(job.info);
+    camera.processor.interpolation_ = job.interpolation;
+    if (!camera.processor.process(job.raw, camera.model, output, flags))
+    {
+      NODELET_ERROR_THROTTLE(30, "Dropping '%s' frames from camera '%s', which the multi-camera "
+                             "pipeline can't handle", job.raw->encoding.c_str(), camera.name.c_str());
+      flags = 0;
+    }
+  }
+
+  if (flags & Processor::MONO)
+    publish(camera.pub_mono, job.raw, output.mono, enc::MONO8);
+  if (flags & Processor::COLOR)
+    publish(camera.pub_color, job.raw, output.color, output.color_encoding);
+  if (flags & Processor::RECT)
+    publish(camera.pub_rect, job.raw, output.rect, enc::MONO8);
+  if (flags & Processor::RECT_COLOR)
+    publish(camera.pub_rect_color, job.raw, output.rect_color, output.color_encoding);
+
+  if (monitor_)
+    monitor_->end(job.start, job.raw->header.stamp);
+}
+
+void MultiPipelineNodelet::publish(const image_transport::Publisher& pub,
+                                   const sensor_msgs::ImageConstPtr& raw_msg,
+                                   const cv::Mat& image, const std::string& encoding)
+{
+  // Processor aliases the raw data when no conversion was needed, so just pass it along
+  if (!raw_msg->data.empty() && image.data == &raw_msg->data[0])
+  {
+    pub.publish(raw_msg);
+    return;
+  }
+
+  sensor_msgs::ImagePtr msg =
+    ImagePool::shared().allocate(image.rows, image.cols, encoding, image.cols * image.elemSize());
+  msg->header = raw_msg->header;
+  cv::Mat view(image.rows, image.cols, image.type(), &msg->data[0], msg->step);
+  image.copyTo(view);
+  pub.publish(msg);
+}
+
+void MultiPipelineNodelet::configCb(Config &config, uint32_t level)
+{
+  config_.set(config);
+}
+
+} // namespace image_proc
+
+// Register nodelet
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS( image_proc::MultiPipelineNodelet, nodelet::Nodelet)
@@ -0,0 +1,325 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "packed_bayer.h"
+#include "simd.h"
+#include <cmath>
+
+namespace image_proc {
+
+bool packedBayerFormat(const std::string& encoding, BayerPattern& pattern, int& bits)
+{
+  // bayer_rggb10p and so on: the pattern is the one of the 8-bit encoding
+  if (encoding.size() != 13 || encoding.compare(0, 6, "bayer_") != 0)
+    return false;
+  std::string suffix = encoding.substr(10);
+  if (suffix == "10p")
+    bits = 10;
+  else if (suffix == "12p")
+    bits = 12;
+  else
+    return false;
+  return bayerPattern(encoding.substr(0, 10) + "8", pattern);
+}
+
+int packedRowBytes(int width, int bits)
+{
+  int group = bits == 10 ? 4 : 2;
+  if (width % group != 0)
+    return 0;
+  return width / group * (bits == 10 ? 5 : 3);
+}
+
+namespace {
+
+// Tone curves are indexed by the top bits of 16-bit samples
+const int CURVE_BITS = 12;
+
+// Unpacks one row of width samples to their plain values, below 2^bits
+void unpack12Row(const uint8_t* src, uint16_t* dst, int width, int row_bytes)
+{
+  int x = 0;
+#if defined(__SSSE3__)
+  // Lane 2k takes bytes 3k, 3k + 1 and lane 2k + 1 bytes 3k + 1, 3k + 2. The
+  // multiply moves the wanted 12 bits to the top of the lane, the shift back down.
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+  const __m128i scale = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+  for (; x + 8 <= width && x / 2 * 3 + 16 <= row_bytes; x += 8)
+  {
+    __m128i v = _mm_shuffle_epi8(simd::load(src + x / 2 * 3), shuffle);
+    simd::store(dst + x, _mm_srli_epi16(_mm_mullo_epi16(v, scale), 4));
+  }
+#elif defined(IMAGE_PROC_SIMD) && !defined(__SSE2__) // NEON
+  for (; x + 16 <= width; x += 16)
+  {
+    uint8x8x3_t b = vld3_u8(src + x / 2 * 3);
+    uint16x8x2_t samples;
+    samples.val[0] = vorrq_u16(vmovl_u8(b.val[0]),
+                               vshlq_n_u16(vmovl_u8(vand_u8(b.val[1], vdup_n_u8(0x0F))), 8));
+    samples.val[1] = vorrq_u16(vmovl_u8(vshr_n_u8(b.val[1], 4)), vshlq_n_u16(vmovl_u8(b.val[2]), 4));
+    vst2q_u16(dst + x, samples);
+  }
+#endif
+  for (; x < width; x += 2)
+  {
+    const uint8_t* b = src + x / 2 * 3;
+    dst[x]     = b[0] | (b[1] & 0x0F) << 8;
+    dst[x + 1] = b[1] >> 4 | b[2] << 4;
+  }
+}
+
+void unpack10Row(const uint8_t* src, uint16_t* dst, int width, int row_bytes)
+{
+  int x = 0;
+#if defined(__SSSE3__)
+  // Sample k of 8 starts at bit 10k: byte 10k / 8, shifted by 10k % 8
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+  const __m128i scale = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+  for (; x + 8 <= width && x / 4 * 5 + 16 <= row_bytes; x += 8)
+  {
+    __m128i v = _mm_shuffle_epi8(simd::load(src + x / 4 * 5), shuffle);
+    simd::store(dst + x, _mm_srli_epi16(_mm_mullo_epi16(v, scale), 6));
+  }
+#endif
+  for (; x < width; x += 4)
+  {
+    const uint8_t* b = src + x / 4 * 5;
+    dst[x]     = b[0]      | (b[1] & 0x03) << 8;
+    dst[x + 1] = b[1] >> 2 | (b[2] & 0x0F) << 6;
+    dst[x + 2] = b[2] >> 4 | (b[3] & 0x3F) << 4;
+    dst[x + 3] = b[3] >> 6 | b[4] << 2;
+  }
+}
+
+void unpackRow(const cv::Mat& packed, int y, int width, int bits, uint16_t* dst)
+{
+  if (bits == 10)
+    unpack10Row(packed.ptr<uint8_t>(y), dst, width, packed.cols);
+  else
+    unpack12Row(packed.ptr<uint8_t>(y), dst, width, packed.cols);
+}
+
+// Unpacks row y into a line padded by one reflected sample on each side
+void unpackLine(const cv::Mat& packed, int y, int width, int bits, uint16_t* line)
+{
+  unpackRow(packed, y, width, bits, line + 1);
+  line[0] = line[2];
+  line[width + 1] = line[width - 1];
+}
+
+inline int reflect101(int i, int n)
+{
+  if (i < 0)
+    return -i;
+  if (i >= n)
+    return 2 * n - 2 - i;
+  return i;
+}
+
+/*
+ * Bilinear debayering of one row from padded lines, where index x + 1 is
+ * column x. Samples are below 2^bits; the output is scaled to 16 bits. On that
+ * scale the rounded averages of cvtColor are exact, so they become shifts: the
+ * sum of four neighbours is shifted by 14 - bits, of two by 15 - bits.
+ *
+ * "Own" is the color sampled in this row (red or blue) and "opposite" the one
+ * sampled in the rows above and below. Pixel x is colored, that is samples the
+ * own color, when x has the parity colored_parity.
+ */
+void debayerLine(const uint16_t* up, const uint16_t* row, const uint16_t* down, int width,
+                 int bits, bool red_row, int colored_parity, uint16_t* out)
+{
+  int shift = 14 - bits;
+  int x = 0;
+#if defined(__SSE2__)
+  {
+    short mask[8];
+    for (int i = 0; i < 8; ++i)
+      mask[i] = (i & 1) == colored_parity ? -1 : 0;
+    const __m128i colored = simd::load(mask);
+    const __m128i shift4 = _mm_cvtsi32_si128(shift);
+    const __m128i shift2 = _mm_cvtsi32_si128(shift + 1);
+    const __m128i shift1 = _mm_cvtsi32_si128(shift + 2);
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i l = simd::load(row + x), c = simd::load(row + x + 1), r = simd::load(row + x + 2);
+      __m128i ul = simd::load(up + x), u = simd::load(up + x + 1), ur = simd::load(up + x + 2);
+      __m128i dl = simd::load(down + x), d = simd::load(down + x + 1), dr = simd::load(down + x + 2);
+      __m128i horizontal = _mm_add_epi16(l, r);
+      __m128i vertical = _mm_add_epi16(u, d);
+      __m128i cross = _mm_sll_epi16(_mm_add_epi16(horizontal, vertical), shift4);
+      __m128i diagonal = _mm_sll_epi16(_mm_add_epi16(_mm_add_epi16(ul, ur), _mm_add_epi16(dl, dr)), shift4);
+      c = _mm_sll_epi16(c, shift1);
+      horizontal = _mm_sll_epi16(horizontal, shift2);
+      vertical = _mm_sll_epi16(vertical, shift2);
+
+      __m128i own = _mm_or_si128(_mm_and_si128(colored, c), _mm_andnot_si128(colored, horizontal));
+      __m128i green = _mm_or_si128(_mm_and_si128(colored, cross), _mm_andnot_si128(colored, c));
+      __m128i opposite = _mm_or_si128(_mm_and_si128(colored, diagonal), _mm_andnot_si128(colored, vertical));
+      if (red_row)
+        simd::storeBGR(out + 3 * x, opposite, green, own);
+      else
+        simd::storeBGR(out + 3 * x, own, green, opposite);
+    }
+  }
+#elif defined(IMAGE_PROC_SIMD) // NEON
+  {
+    uint16_t mask[8];
+    for (int i = 0; i < 8; ++i)
+      mask[i] = (i & 1) == colored_parity ? 0xFFFF : 0;
+    const uint16x8_t colored = vld1q_u16(mask);
+    const int16x8_t shift4 = vdupq_n_s16(shift);
+    const int16x8_t shift2 = vdupq_n_s16(shift + 1);
+    const int16x8_t shift1 = vdupq_n_s16(shift + 2);
+    for (; x + 8 <= width; x += 8)
+    {
+      uint16x8_t l = vld1q_u16(row + x), c = vld1q_u16(row + x + 1), r = vld1q_u16(row + x + 2);
+      uint16x8_t ul = vld1q_u16(up + x), u = vld1q_u16(up + x + 1), ur = vld1q_u16(up + x + 2);
+      uint16x8_t dl = vld1q_u16(down + x), d = vld1q_u16(down + x + 1), dr = vld1q_u16(down + x + 2);
+      uint16x8_t horizontal = vaddq_u16(l, r);
+      uint16x8_t vertical = vaddq_u16(u, d);
+      uint16x8_t cross = vshlq_u16(vaddq_u16(horizontal, vertical), shift4);
+      uint16x8_t diagonal = vshlq_u16(vaddq_u16(vaddq_u16(ul, ur), vaddq_u16(dl, dr)), shift4);
+      c = vshlq_u16(c, shift1);
+      horizontal = vshlq_u16(horizontal, shift2);
+      vertical = vshlq_u16(vertical, shift2);
+
+      uint16x8_t own = vbslq_u16(colored, c, horizontal);
+      uint16x8_t green = vbslq_u16(colored, cross, c);
+      uint16x8_t opposite = vbslq_u16(colored, diagonal, vertical);
+      if (red_row)
+        simd::storeBGR(out + 3 * x, opposite, green, own);
+      else
+        simd::storeBGR(out + 3 * x, own, green, opposite);
+    }
+  }
+#endif
+  for (; x < width; ++x)
+  {
+    int own, green, opposite;
+    if ((x & 1) == colored_parity)
+    {
+      own = row[x + 1] << (shift + 2);
+      green = (row[x] + row[x + 2] + up[x + 1] + down[x + 1]) << shift;
+      opposite = (up[x] + up[x + 2] + down[x] + down[x + 2]) << shift;
+    }
+    else
+    {
+      green = row[x + 1] << (shift + 2);
+      own = (row[x] + row[x + 2]) << (shift + 1);
+      opposite = (up[x + 1] + down[x + 1]) << (shift + 1);
+    }
+    out[3 * x]     = red_row ? opposite : own;
+    out[3 * x + 1] = green;
+    out[3 * x + 2] = red_row ? own : opposite;
+  }
+}
+
+inline void toneMapRow(const uint16_t* src, int n, const uint8_t* curve, uint8_t* dst)
+{
+  for (int i = 0; i < n; ++i)
+    dst[i] = curve[src[i] >> (16 - CURVE_BITS)];
+}
+
+} // namespace
+
+void unpackBayer(const cv::Mat& packed, int width, int bits, cv::Mat& bayer)
+{
+  CV_Assert(packed.type() == CV_8UC1 && (bits == 10 || bits == 12));
+  int row_bytes = packedRowBytes(width, bits);
+  CV_Assert(row_bytes > 0 && packed.cols >= row_bytes);
+  bayer.create(packed.rows, width, CV_16UC1);
+
+  for (int y = 0; y < packed.rows; ++y)
+  {
+    uint16_t* dst = bayer.ptr<uint16_t>(y);
+    unpackRow(packed, y, width, bits, dst);
+    for (int x = 0; x < width; ++x)
+      dst[x] <<= 16 - bits;
+  }
+}
+
+void debayerPacked(const cv::Mat& packed, int width, int bits, BayerPattern pattern,
+                   const std::vector<uint8_t>* curve, cv::Mat& color)
+{
+  CV_Assert(packed.type() == CV_8UC1 && (bits == 10 || bits == 12));
+  int row_bytes = packedRowBytes(width, bits);
+  CV_Assert(row_bytes > 0 && packed.cols >= row_bytes && packed.rows >= 2 && width >= 2);
+  CV_Assert(!curve || curve->size() == (1u << CURVE_BITS));
+  int height = packed.rows;
+  color.create(height, width, curve ? CV_8UC3 : CV_16UC3);
+
+  // Row y is unpacked once, into line y % 3, just before it is first needed
+  int stride = width + 2;
+  std::vector<uint16_t> lines(3 * stride);
+  std::vector<uint16_t> bgr(curve ? 3 * width : 0);
+  unpackLine(packed, 0, width, bits, &lines[0]);
+  unpackLine(packed, 1, width, bits, &lines[stride]);
+
+  for (int y = 0; y < height; ++y)
+  {
+    if (y + 1 >= 2 && y + 1 < height)
+      unpackLine(packed, y + 1, width, bits, &lines[(y + 1) % 3 * stride]);
+    const uint16_t* up = &lines[reflect101(y - 1, height) % 3 * stride];
+    const uint16_t* row = &lines[y % 3 * stride];
+    const uint16_t* down = &lines[reflect101(y + 1, height) % 3 * stride];
+
+    bool red_row = (y & 1) == pattern.red_y;
+    int colored_parity = red_row ? pattern.red_x : 1 - pattern.red_x;
+    if (curve)
+    {
+      debayerLine(up, row, down, width, bits, red_row, colored_parity, &bgr[0]);
+      toneMapRow(&bgr[0], 3 * width, &(*curve)[0], color.ptr<uint8_t>(y));
+    }
+    else
+      debayerLine(up, row, down, width, bits, red_row, colored_parity, color.ptr<uint16_t>(y));
+  }
+}
+
+void toneCurve(double gamma, std::vector<uint8_t>& curve)
+{
+  const int size = 1 << CURVE_BITS;
+  curve.resize(size);
+  for (int i = 0; i < size; ++i)
+    curve[i] = (uint8_t)std::floor(255.0 * std::pow(i / (size - 1.0), 1.0 / gamma) + 0.5);
+}
+
+void toneMap(const cv::Mat& src, const std::vector<uint8_t>& curve, cv::Mat& dst)
+{
+  CV_Assert(src.depth() == CV_16U && curve.size() == (1u << CURVE_BITS));
+  dst.create(src.rows, src.cols, CV_MAKETYPE(CV_8U, src.channels()));
+  for (int y = 0; y < src.rows; ++y)
+    toneMapRow(src.ptr<uint16_t>(y), src.cols * src.channels(), &curve[0], dst.ptr<uint8_t>(y));
+}
+
+} // namespace image_proc
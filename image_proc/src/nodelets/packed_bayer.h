@@ -0,0 +1,80 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_PACKED_BAYER
+#define IMAGE_PROC_PACKED_BAYER
+
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <vector>
+#include "image_proc/bayer.h"
+
+// Kernels for Bayer mosaics with 10- or 12-bit samples packed without padding,
+// as GenICam cameras send them (PFNC BayerRG10p, BayerRG12p, ...). Samples are
+// stored least significant bits first: 4 samples in 5 bytes or 2 in 3 bytes.
+// The ROS encodings are bayer_<pattern>10p and bayer_<pattern>12p.
+
+namespace image_proc {
+
+/// Looks up the pattern and sample size of a packed Bayer encoding. Returns false for other encodings.
+bool packedBayerFormat(const std::string& encoding, BayerPattern& pattern, int& bits);
+
+/// Bytes in one packed row of width samples, or 0 if width does not fill whole groups.
+int packedRowBytes(int width, int bits);
+
+/// Unpacks to CV_16UC1, with the samples shifted up to the 16-bit range.
+/// packed is CV_8UC1 with one image row per row and at least packedRowBytes() columns.
+void unpackBayer(const cv::Mat& packed, int width, int bits, cv::Mat& bayer);
+
+/**
+ * Unpacks and bilinearly debayers in a single pass over the packed rows,
+ * without building the 16-bit mosaic. The result is the same as unpackBayer()
+ * followed by cv::cvtColor to BGR, with the border reflected
+ * (BORDER_REFLECT_101). The image must be at least 2x2.
+ *
+ * Without a tone curve, color is BGR16. With one (see toneCurve()), color is
+ * BGR8 and each channel is mapped through the curve.
+ */
+void debayerPacked(const cv::Mat& packed, int width, int bits, BayerPattern pattern,
+                   const std::vector<uint8_t>* curve, cv::Mat& color);
+
+/// Builds the 8-bit tone curve, indexed by the top 12 bits of a 16-bit
+/// sample: out = 255 * in^(1 / gamma), for in and out normalized to [0, 1].
+void toneCurve(double gamma, std::vector<uint8_t>& curve);
+
+/// Maps a 16-bit image of any number of channels through a tone curve to 8 bits.
+void toneMap(const cv::Mat& src, const std::vector<uint8_t>& curve, cv::Mat& dst);
+
+} // namespace image_proc
+
+#endif
@@ -0,0 +1,230 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+#include <image_geometry/pinhole_camera_model.h>
+#include <dynamic_reconfigure/server.h>
+#include <image_proc/RectifyConfig.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/image_pool.h>
+#include <image_proc/latency_monitor.h>
+#include <image_proc/processor.h>
+
+namespace image_proc {
+
+namespace enc = sensor_msgs::image_encodings;
+
+/**
+ * Does the work of the debayer, rectify_mono and rectify_color nodelets in a
+ * single callback: image_raw -> image_mono, image_color, image_rect, image_rect_color.
+ * Only the outputs that currently have subscribers are computed.
+ *
+ * Debayering is done by Processor, not DebayerNodelet, so it only reads the
+ * Rectify config: Bayer images are always debayered bilinearly, whatever the
+ * Debayer config's algorithm, and only 8-bit Bayer, bgr8, rgb8 and mono8
+ * input is handled. Frames in other encodings (16-bit or packed Bayer,
+ * YUV 4:2:2, ...) are dropped with an error; use the separate nodelets for those.
+ */
+class PipelineNodelet : public nodelet::Nodelet
+{
+  // ROS communication
+  boost::shared_ptr<image_transport::ImageTransport> it_;
+  image_transport::CameraSubscriber sub_camera_;
+  int queue_size_;
+
+  boost::mutex connect_mutex_;
+  image_transport::Publisher pub_mono_;
+  image_transport::Publisher pub_color_;
+  image_transport::Publisher pub_rect_;
+  image_transport::Publisher pub_rect_color_;
+
+  // Dynamic reconfigure
+  boost::recursive_mutex config_mutex_;
+  typedef image_proc::RectifyConfig Config;
+  typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
+  boost::shared_ptr<ReconfigureServer> reconfigure_server_;
+  ConfigSnapshot<Config> config_;
+
+  // Processing state (note: only safe because we're using single-threaded NodeHandle!)
+  image_geometry::PinholeCameraModel model_;
+  Processor processor_;
+  boost::shared_ptr<LatencyMonitor> monitor_;
+
+  virtual void onInit();
+
+  void connectCb();
+
+  void imageCb(const sensor_msgs::ImageConstPtr& raw_msg,
+               const sensor_msgs::CameraInfoConstPtr& info_msg);
+
+  void publish(const image_transport::Publisher& pub, const sensor_msgs::ImageConstPtr& raw_msg,
+               const cv::Mat& image, const std::string& encoding);
+
+  void configCb(Config &config, uint32_t level);
+};
+
+void PipelineNodelet::onInit()
+{
+  ros::NodeHandle &nh         = getNodeHandle();
+  ros::NodeHandle &private_nh = getPrivateNodeHandle();
+  it_.reset(new image_transport::ImageTransport(nh));
+
+  // Read parameters
+  private_nh.param("queue_size", queue_size_, 5);
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
+
+  // Set up dynamic reconfigure
+  reconfigure_server_.reset(new ReconfigureServer(config_mutex_, private_nh));
+  ReconfigureServer::CallbackType f = boost::bind(&PipelineNodelet::configCb, this, _1, _2);
+  reconfigure_server_->setCallback(f);
+
+  // Monitor whether anyone is subscribed to the output
+  image_transport::SubscriberStatusCallback connect_cb = boost::bind(&PipelineNodelet::connectCb, this);
+  // Make sure we don't enter connectCb() between advertising and assigning to pub_XXX
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  pub_mono_       = it_->advertise("image_mono",       1, connect_cb, connect_cb);
+  pub_color_      = it_->advertise("image_color",      1, connect_cb, connect_cb);
+  pub_rect_       = it_->advertise("image_rect",       1, connect_cb, connect_cb);
+  pub_rect_color_ = it_->advertise("image_rect_color", 1, connect_cb, connect_cb);
+}
+
+// Handles (un)subscribing when clients (un)subscribe
+void PipelineNodelet::connectCb()
+{
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  if (pub_mono_.getNumSubscribers() == 0 && pub_color_.getNumSubscribers() == 0 &&
+      pub_rect_.getNumSubscribers() == 0 && pub_rect_color_.getNumSubscribers() == 0)
+    sub_camera_.shutdown();
+  else if (!sub_camera_)
+  {
+    image_transport::TransportHints hints("raw", ros::TransportHints(), getPrivateNodeHandle());
+    sub_camera_ = it_->subscribeCamera("image_raw", queue_size_, &PipelineNodelet::imageCb, this, hints);
+  }
+}
+
+void PipelineNodelet::imageCb(const sensor_msgs::ImageConstPtr& raw_msg,
+                              const sensor_msgs::CameraInfoConstPtr& info_msg)
+{
+  // Processor views the raw data in place, so there has to be some
+  if (raw_msg->data.empty())
+  {
+    NODELET_ERROR_THROTTLE(10, "Raw image topic '%s' published an image with no data",
+                           sub_camera_.getTopic().c_str());
+    return;
+  }
+
+  LatencyMonitor::Scope scope(monitor_.get(), raw_msg->header);
+
+  // Work out which outputs anyone is listening to
+  int flags = 0;
+  if (pub_mono_.getNumSubscribers())
+    flags |= Processor::MONO;
+  if (pub_color_.getNumSubscribers())
+    flags |= Processor::COLOR;
+  if (pub_rect_.getNumSubscribers())
+    flags |= Processor::RECT;
+  if (pub_rect_color_.getNumSubscribers())
+    flags |= Processor::RECT_COLOR;
+  if (!flags)
+    return;
+
+  // Rectified outputs need a calibrated camera
+  if ((flags & (Processor::RECT | Processor::RECT_COLOR)) && info_msg->K[0] == 0.0)
+  {
+    NODELET_ERROR_THROTTLE(30, "Rectified topics requested but camera publishing '%s' "
+                           "is uncalibrated", sub_camera_.getInfoTopic().c_str());
+    flags &= ~(Processor::RECT | Processor::RECT_COLOR);
+    if (!flags)
+      return;
+  }
+
+  // Update the camera model
+  model_.fromCameraInfo(info_msg);
+
+  processor_.interpolation_ = config_.get()->interpolation;
+
+  ImageSet output;
+  if (!processor_.process(raw_msg, model_, output, flags))
+  {
+    NODELET_ERROR_THROTTLE(30, "Dropping '%s' frames from '%s', which the pipeline nodelet can't "
+                           "handle; use the separate debayer and rectify nodelets instead",
+                           raw_msg->encoding.c_str(), sub_camera_.getTopic().c_str());
+    return;
+  }
+
+  if (flags & Processor::MONO)
+    publish(pub_mono_, raw_msg, output.mono, enc::MONO8);
+  if (flags & Processor::COLOR)
+    publish(pub_color_, raw_msg, output.color, output.color_encoding);
+  if (flags & Processor::RECT)
+    publish(pub_rect_, raw_msg, output.rect, enc::MONO8);
+  if (flags & Processor::RECT_COLOR)
+    publish(pub_rect_color_, raw_msg, output.rect_color, output.color_encoding);
+}
+
+void PipelineNodelet::publish(const image_transport::Publisher& pub,
+                              const sensor_msgs::ImageConstPtr& raw_msg,
+                              const cv::Mat& image, const std::string& encoding)
+{
+  // Processor aliases the raw data when no conversion was needed, so just pass it along
+  if (!raw_msg->data.empty() && image.data == &raw_msg->data[0])
+  {
+    pub.publish(raw_msg);
+    return;
+  }
+
+  sensor_msgs::ImagePtr msg =
+    ImagePool::shared().allocate(image.rows, image.cols, encoding, image.cols * image.elemSize());
+  msg->header = raw_msg->header;
+  cv::Mat view(image.rows, image.cols, image.type(), &msg->data[0], msg->step);
+  image.copyTo(view);
+  pub.publish(msg);
+}
+
+void PipelineNodelet::configCb(Config &config, uint32_t level)
+{
+  config_.set(config);
+}
+
+} // namespace image_proc
+
+// Register nodelet
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS( image_proc::PipelineNodelet, nodelet::Nodelet)
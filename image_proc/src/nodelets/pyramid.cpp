@@ -0,0 +1,235 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+#include <dynamic_reconfigure/server.h>
+#include <cv_bridge/cv_bridge.h>
+#include <image_proc/PyramidConfig.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/image_pool.h>
+#include <image_proc/latency_monitor.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <sstream>
+#include "decimate.h"
+
+namespace image_proc {
+
+using namespace cv_bridge; // CvImage, toCvShare
+
+/**
+ * Publishes levels 1 to ~levels of an image pyramid, level k being the input
+ * downsampled by 2^k, on camera_out/level<k>/image with a matching CameraInfo.
+ * Each level is halved from the one before, and only as many levels are
+ * computed as the deepest one with subscribers needs.
+ */
+class PyramidNodelet : public nodelet::Nodelet
+{
+  // ROS communication
+  boost::shared_ptr<image_transport::ImageTransport> it_in_, it_out_;
+  image_transport::CameraSubscriber sub_;
+  int queue_size_;
+
+  boost::mutex connect_mutex_;
+  std::vector<image_transport::CameraPublisher> pubs_;
+
+  // Dynamic reconfigure
+  boost::recursive_mutex config_mutex_;
+  typedef image_proc::PyramidConfig Config;
+  typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
+  boost::shared_ptr<ReconfigureServer> reconfigure_server_;
+  ConfigSnapshot<Config> config_;
+
+  // Latency statistics, null unless ~instrumentation is set
+  boost::shared_ptr<LatencyMonitor> monitor_;
+
+  virtual void onInit();
+
+  void connectCb();
+
+  void imageCb(const sensor_msgs::ImageConstPtr& image_msg,
+               const sensor_msgs::CameraInfoConstPtr& info_msg);
+
+  void configCb(Config &config, uint32_t level);
+};
+
+void PyramidNodelet::onInit()
+{
+  ros::NodeHandle& nh         = getNodeHandle();
+  ros::NodeHandle& private_nh = getPrivateNodeHandle();
+  ros::NodeHandle nh_in (nh, "camera");
+  ros::NodeHandle nh_out(nh, "camera_out");
+  it_in_ .reset(new image_transport::ImageTransport(nh_in));
+  it_out_.reset(new image_transport::ImageTransport(nh_out));
+
+  // Read parameters
+  private_nh.param("queue_size", queue_size_, 5);
+  int levels;
+  private_nh.param("levels", levels, 3);
+  if (levels < 1)
+  {
+    NODELET_WARN("~levels must be at least 1, using 1");
+    levels = 1;
+  }
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
+
+  // Set up dynamic reconfigure
+  reconfigure_server_.reset(new ReconfigureServer(config_mutex_, private_nh));
+  ReconfigureServer::CallbackType f = boost::bind(&PyramidNodelet::configCb, this, _1, _2);
+  reconfigure_server_->setCallback(f);
+
+  // Monitor whether anyone is subscribed to the output
+  image_transport::SubscriberStatusCallback connect_cb = boost::bind(&PyramidNodelet::connectCb, this);
+  ros::SubscriberStatusCallback connect_cb_info = boost::bind(&PyramidNodelet::connectCb, this);
+  // Make sure we don't enter connectCb() between advertising and assigning to pubs_
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  pubs_.resize(levels);
+  for (int k = 0; k < levels; ++k)
+  {
+    std::ostringstream topic;
+    topic << "level" << k + 1 << "/image";
+    pubs_[k] = it_out_->advertiseCamera(topic.str(), 1, connect_cb, connect_cb, connect_cb_info, connect_cb_info);
+  }
+}
+
+// Handles (un)subscribing when clients (un)subscribe
+void PyramidNodelet::connectCb()
+{
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  bool subscribed = false;
+  for (size_t k = 0; k < pubs_.size(); ++k)
+    subscribed = subscribed || pubs_[k].getNumSubscribers() > 0;
+  if (!subscribed)
+    sub_.shutdown();
+  else if (!sub_)
+  {
+    image_transport::TransportHints hints("raw", ros::TransportHints(), getPrivateNodeHandle());
+    sub_ = it_in_->subscribeCamera("image", queue_size_, &PyramidNodelet::imageCb, this, hints);
+  }
+}
+
+void PyramidNodelet::imageCb(const sensor_msgs::ImageConstPtr& image_msg,
+                             const sensor_msgs::CameraInfoConstPtr& info_msg)
+{
+  LatencyMonitor::Scope scope(monitor_.get(), image_msg->header);
+
+  int interpolation = config_.get()->interpolation;
+
+  // Levels past the deepest one with subscribers are not needed
+  int levels = 0;
+  for (int k = 0; k < (int)pubs_.size(); ++k)
+  {
+    if (pubs_[k].getNumSubscribers() > 0)
+      levels = k + 1;
+  }
+
+  // Bayer input is debayered by the first halving, as in CropDecimateNodelet
+  BayerPattern pattern;
+  bool debayer = bayerPattern(image_msg->encoding, pattern);
+
+  CvImageConstPtr source = toCvShare(image_msg);
+  cv::Mat previous = source->image;
+  // Keeps the data of previous alive once it points into a level's message
+  sensor_msgs::ImagePtr previous_image;
+  std::string encoding = image_msg->encoding;
+  for (int k = 0; k < levels; ++k)
+  {
+    int out_width = previous.cols / 2;
+    int out_height = previous.rows / 2;
+    if (out_width == 0 || out_height == 0)
+      break;
+
+    int type = previous.type();
+    if (debayer && k == 0)
+    {
+      encoding = previous.depth() == CV_8U ? sensor_msgs::image_encodings::BGR8
+                                           : sensor_msgs::image_encodings::BGR16;
+      type = CV_MAKETYPE(previous.depth(), 3);
+    }
+
+    // Each level is written straight into its message, and read from there by the next
+    int out_step = out_width * CV_ELEM_SIZE(type);
+    sensor_msgs::ImagePtr out_image =
+      ImagePool::shared().allocate(out_height, out_width, encoding, out_step);
+    out_image->header = image_msg->header;
+    cv::Mat output(out_height, out_width, type, &out_image->data[0], out_step);
+
+    if (debayer && k == 0)
+    {
+      if (interpolation == image_proc::Pyramid_Area)
+        binBayerToBGR(previous, pattern, output, 2, 2);
+      else
+        debayer2x2toBGR(previous, pattern, output, 2, 2);
+    }
+    else if (interpolation == image_proc::Pyramid_NN)
+    {
+      if (!decimateNearest(previous, output, 2, 2))
+      {
+        NODELET_ERROR_THROTTLE(2, "Unsupported pixel size, %d bytes", (int)previous.elemSize());
+        return;
+      }
+    }
+    else
+      cv::resize(previous, output, output.size(), 0.0, 0.0, interpolation);
+
+    if (pubs_[k].getNumSubscribers() > 0)
+    {
+      // The level covers whole 2^k blocks of the input image
+      int factor = 1 << (k + 1);
+      cv::Rect covered(0, 0, out_width * factor, out_height * factor);
+      sensor_msgs::CameraInfoPtr out_info =
+        decimateCameraInfo(*info_msg, image_msg->width, image_msg->height, covered, factor, factor);
+      pubs_[k].publish(out_image, out_info);
+    }
+    previous = output;
+    previous_image = out_image;
+  }
+}
+
+void PyramidNodelet::configCb(Config &config, uint32_t level)
+{
+  config_.set(config);
+}
+
+} // namespace image_proc
+
+// Register nodelet
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS( image_proc::PyramidNodelet, nodelet::Nodelet)
@@ -43,36 +43,65 @@
 #include <cv_bridge/cv_bridge.h>
 #include <dynamic_reconfigure/server.h>
 #include <image_proc/RectifyConfig.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/image_pool.h>
+#include <image_proc/latency_monitor.h>
+#include <image_proc/rectifier.h>
+#include <image_proc/worker_pool.h>
+#include <boost/make_shared.hpp>
+#include "depth_remap.h"
 
 namespace image_proc {
 
+/**
+ * Rectifies image_mono into image_rect. The output can be restricted to part of
+ * the rectified image and resized, with ~x_offset, ~y_offset, ~width and
+ * ~height (in rectified pixels, 0 extending to the edge) and ~scale. With
+ * ~crop_to_valid, it is also cropped to the rectangle whose pixels all come
+ * from inside the raw image, dropping the black corners. Only the output pixels
+ * are then computed, straight from the raw image. As the output then no longer
+ * matches camera_info, it is published instead on camera_rect/image together
+ * with its own calibration on camera_rect/camera_info.
+ *
+ * 16UC1 and 32FC1 images are taken to be depth, and rectified without blending
+ * across depth edges or into invalid pixels: with NN interpolation, by
+ * DEPTH_NEAREST, and otherwise by DEPTH_MIN_VALID.
+ */
 class RectifyNodelet : public nodelet::Nodelet
 {
   // ROS communication
-  boost::shared_ptr<image_transport::ImageTransport> it_;
+  boost::shared_ptr<image_transport::ImageTransport> it_, it_out_;
   image_transport::CameraSubscriber sub_camera_;
   int queue_size_;
   
   boost::mutex connect_mutex_;
   image_transport::Publisher pub_rect_;
+  image_transport::CameraPublisher pub_rect_camera_; // instead of pub_rect_ if the output is cropped or scaled
 
   // Dynamic reconfigure
   boost::recursive_mutex config_mutex_;
   typedef image_proc::RectifyConfig Config;
   typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
   boost::shared_ptr<ReconfigureServer> reconfigure_server_;
-  Config config_;
+  ConfigSnapshot<Config> config_;
 
   // Processing state (note: only safe because we're using single-threaded NodeHandle!)
   image_geometry::PinholeCameraModel model_;
+  Rectifier rectifier_;
+  boost::shared_ptr<WorkerPool> pool_;
+  boost::shared_ptr<LatencyMonitor> monitor_;
 
   virtual void onInit();
 
   void connectCb();
 
+  uint32_t numSubscribers() const;
+
   void imageCb(const sensor_msgs::ImageConstPtr& image_msg,
                const sensor_msgs::CameraInfoConstPtr& info_msg);
 
+  void publish(const sensor_msgs::ImageConstPtr& rect_msg);
+
   void configCb(Config &config, uint32_t level);
 };
 
@@ -84,6 +113,29 @@ void RectifyNodelet::onInit()
 
   // Read parameters
   private_nh.param("queue_size", queue_size_, 5);
+  int num_threads;
+  private_nh.param("num_threads", num_threads, 1);
+  if (num_threads > 1)
+    pool_.reset(new WorkerPool(num_threads));
+  std::string map_cache_dir;
+  private_nh.param("map_cache_dir", map_cache_dir, std::string());
+  rectifier_.setCacheDirectory(map_cache_dir);
+  cv::Rect output_roi;
+  double output_scale;
+  private_nh.param("x_offset", output_roi.x, 0);
+  private_nh.param("y_offset", output_roi.y, 0);
+  private_nh.param("width",    output_roi.width, 0);
+  private_nh.param("height",   output_roi.height, 0);
+  private_nh.param("scale",    output_scale, 1.0);
+  bool crop_to_valid;
+  private_nh.param("crop_to_valid", crop_to_valid, false);
+  if (output_scale <= 0.0)
+  {
+    NODELET_WARN("Ignoring invalid scale %f", output_scale);
+    output_scale = 1.0;
+  }
+  rectifier_.setOutput(output_roi, output_scale, crop_to_valid);
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
 
   // Set up dynamic reconfigure
   reconfigure_server_.reset(new ReconfigureServer(config_mutex_, private_nh));
@@ -92,16 +144,28 @@ void RectifyNodelet::onInit()
 
   // Monitor whether anyone is subscribed to the output
   image_transport::SubscriberStatusCallback connect_cb = boost::bind(&RectifyNodelet::connectCb, this);
+  ros::SubscriberStatusCallback connect_info_cb = boost::bind(&RectifyNodelet::connectCb, this);
   // Make sure we don't enter connectCb() between advertising and assigning to pub_rect_
   boost::lock_guard<boost::mutex> lock(connect_mutex_);
-  pub_rect_  = it_->advertise("image_rect",  1, connect_cb, connect_cb);
+  if (rectifier_.hasOutputRegion())
+  {
+    it_out_.reset(new image_transport::ImageTransport(ros::NodeHandle(nh, "camera_rect")));
+    pub_rect_camera_ = it_out_->advertiseCamera("image", 1, connect_cb, connect_cb, connect_info_cb, connect_info_cb);
+  }
+  else
+    pub_rect_  = it_->advertise("image_rect",  1, connect_cb, connect_cb);
+}
+
+uint32_t RectifyNodelet::numSubscribers() const
+{
+  return it_out_ ? pub_rect_camera_.getNumSubscribers() : pub_rect_.getNumSubscribers();
 }
 
 // Handles (un)subscribing when clients (un)subscribe
 void RectifyNodelet::connectCb()
 {
   boost::lock_guard<boost::mutex> lock(connect_mutex_);
-  if (pub_rect_.getNumSubscribers() == 0)
+  if (numSubscribers() == 0)
     sub_camera_.shutdown();
   else if (!sub_camera_)
   {
@@ -113,44 +177,76 @@ void RectifyNodelet::connectCb()
 void RectifyNodelet::imageCb(const sensor_msgs::ImageConstPtr& image_msg,
                              const sensor_msgs::CameraInfoConstPtr& info_msg)
 {
+  LatencyMonitor::Scope scope(monitor_.get(), image_msg->header);
+
   // Verify camera is actually calibrated
   if (info_msg->K[0] == 0.0) {
+    std::string rect_topic = it_out_ ? pub_rect_camera_.getTopic() : pub_rect_.getTopic();
     NODELET_ERROR_THROTTLE(30, "Rectified topic '%s' requested but camera publishing '%s' "
-                           "is uncalibrated", pub_rect_.getTopic().c_str(),
+                           "is uncalibrated", rect_topic.c_str(),
                            sub_camera_.getInfoTopic().c_str());
     return;
   }
 
-  // If zero distortion, just pass the message along
-  if (info_msg->D.empty() || info_msg->D[0] == 0.0)
+  // Update the camera model
+  model_.fromCameraInfo(info_msg);
+  rectifier_.update(model_);
+
+  // If zero distortion and no output region, just pass the message along
+  if (!rectifier_.hasMaps())
   {
-    pub_rect_.publish(image_msg);
+    publish(image_msg);
     return;
   }
 
-  // Update the camera model
-  model_.fromCameraInfo(info_msg);
-  
   // Create cv::Mat views onto both buffers
   const cv::Mat image = cv_bridge::toCvShare(image_msg)->image;
-  cv::Mat rect;
+  cv::Size size = rectifier_.map1().size();
+  sensor_msgs::ImagePtr rect_msg =
+    ImagePool::shared().allocate(size.height, size.width, image_msg->encoding,
+                                 size.width * image.elemSize());
+  rect_msg->header = image_msg->header;
+  cv::Mat rect(size, image.type(), &rect_msg->data[0], rect_msg->step);
 
   // Rectify and publish
-  int interpolation;
+  int interpolation = config_.get()->interpolation;
+  if (isDepthEncoding(image_msg->encoding))
   {
-    boost::lock_guard<boost::recursive_mutex> lock(config_mutex_);
-    interpolation = config_.interpolation;
+    // Blending depths across edges would invent points, so depth gets its own kernels
+    DepthInterpolation depth_interpolation =
+      interpolation == image_proc::Rectify_NN ? DEPTH_NEAREST : DEPTH_MIN_VALID;
+    if (pool_)
+      depthRemap(image, rectifier_.map1(), rectifier_.map2(), depth_interpolation, rect, *pool_);
+    else
+      depthRemap(image, rectifier_.map1(), rectifier_.map2(), depth_interpolation, rect);
+  }
+  else if (pool_)
+    rectifier_.rectify(image, rect, interpolation, *pool_);
+  else
+    rectifier_.rectify(image, rect, interpolation);
+
+  publish(rect_msg);
+}
+
+void RectifyNodelet::publish(const sensor_msgs::ImageConstPtr& rect_msg)
+{
+  if (!it_out_)
+  {
+    pub_rect_.publish(rect_msg);
+    return;
   }
-  model_.rectifyImage(image, rect, interpolation);
 
-  // Allocate new rectified image message
-  sensor_msgs::ImagePtr rect_msg = cv_bridge::CvImage(image_msg->header, image_msg->encoding, rect).toImageMsg();
-  pub_rect_.publish(rect_msg);
+  // Cropped or scaled, so with the calibration of the output. With ~crop_to_valid the crop
+  // follows the camera's calibration, so this is taken afresh for every frame.
+  sensor_msgs::CameraInfoPtr rect_info_msg =
+    boost::make_shared<sensor_msgs::CameraInfo>(rectifier_.outputCameraInfo());
+  rect_info_msg->header = rect_msg->header;
+  pub_rect_camera_.publish(rect_msg, rect_info_msg);
 }
 
 void RectifyNodelet::configCb(Config &config, uint32_t level)
 {
-  config_ = config;
+  config_.set(config);
 }
 
 } // namespace image_proc
@@ -0,0 +1,203 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_geometry/pinhole_camera_model.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <boost/make_shared.hpp>
+#include <image_proc/latency_monitor.h>
+#include <image_proc/point_rectifier.h>
+#include <algorithm>
+#include <cstring>
+
+namespace image_proc {
+
+/**
+ * Rectifies sparse raw pixel coordinates, for pipelines such as feature
+ * trackers that never need the rectified image: points -> points_rect, using
+ * the latest calibration on camera_info.
+ *
+ * The points are a PointCloud2 with FLOAT32 fields x and y holding raw pixel
+ * coordinates. The output is a copy with x and y replaced by rectified
+ * coordinates, so any other fields, like feature ids, are passed through.
+ * Points are looked up in a PointRectifier table with a node every
+ * ~lut_step raw pixels (default 4).
+ */
+class RectifyPointsNodelet : public nodelet::Nodelet
+{
+  // ROS communication
+  ros::Subscriber sub_points_;
+  ros::Subscriber sub_info_;
+  int queue_size_;
+
+  boost::mutex connect_mutex_;
+  ros::Publisher pub_points_;
+
+  // Processing state (note: only safe because we're using single-threaded NodeHandle!)
+  image_geometry::PinholeCameraModel model_;
+  boost::shared_ptr<PointRectifier> rectifier_;
+  boost::shared_ptr<LatencyMonitor> monitor_;
+
+  virtual void onInit();
+
+  void connectCb();
+
+  void infoCb(const sensor_msgs::CameraInfoConstPtr& info_msg);
+
+  void pointsCb(const sensor_msgs::PointCloud2ConstPtr& points_msg);
+};
+
+void RectifyPointsNodelet::onInit()
+{
+  ros::NodeHandle &nh         = getNodeHandle();
+  ros::NodeHandle &private_nh = getPrivateNodeHandle();
+
+  // Read parameters
+  private_nh.param("queue_size", queue_size_, 5);
+  int lut_step;
+  private_nh.param("lut_step", lut_step, 4);
+  rectifier_.reset(new PointRectifier(lut_step));
+  monitor_ = LatencyMonitor::create(nh, private_nh, getName());
+
+  // Monitor whether anyone is subscribed to the output
+  ros::SubscriberStatusCallback connect_cb = boost::bind(&RectifyPointsNodelet::connectCb, this);
+  // Make sure we don't enter connectCb() between advertising and assigning to pub_points_
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  pub_points_ = nh.advertise<sensor_msgs::PointCloud2>("points_rect", 1, connect_cb, connect_cb);
+}
+
+// Handles (un)subscribing when clients (un)subscribe
+void RectifyPointsNodelet::connectCb()
+{
+  boost::lock_guard<boost::mutex> lock(connect_mutex_);
+  if (pub_points_.getNumSubscribers() == 0)
+  {
+    sub_points_.shutdown();
+    sub_info_.shutdown();
+  }
+  else if (!sub_points_)
+  {
+    ros::NodeHandle &nh = getNodeHandle();
+    sub_info_   = nh.subscribe("camera_info", 1, &RectifyPointsNodelet::infoCb, this);
+    sub_points_ = nh.subscribe("points", queue_size_, &RectifyPointsNodelet::pointsCb, this);
+  }
+}
+
+void RectifyPointsNodelet::infoCb(const sensor_msgs::CameraInfoConstPtr& info_msg)
+{
+  // Verify camera is actually calibrated
+  if (info_msg->K[0] == 0.0)
+  {
+    NODELET_ERROR_THROTTLE(30, "Rectified points requested but camera publishing '%s' "
+                           "is uncalibrated", sub_info_.getTopic().c_str());
+    return;
+  }
+
+  // Only rebuilds the table when the calibration changes
+  model_.fromCameraInfo(info_msg);
+  rectifier_->update(model_);
+}
+
+void RectifyPointsNodelet::pointsCb(const sensor_msgs::PointCloud2ConstPtr& points_msg)
+{
+  LatencyMonitor::Scope scope(monitor_.get(), points_msg->header);
+
+  if (!rectifier_->initialized())
+  {
+    NODELET_WARN_THROTTLE(30, "Dropping points until a calibration arrives on '%s'",
+                          sub_info_.getTopic().c_str());
+    return;
+  }
+
+  // Find the raw coordinates
+  int x_offset = -1, y_offset = -1;
+  for (size_t i = 0; i < points_msg->fields.size(); ++i)
+  {
+    const sensor_msgs::PointField& field = points_msg->fields[i];
+    if (field.datatype != sensor_msgs::PointField::FLOAT32 || field.count != 1)
+      continue;
+    if (field.name == "x")
+      x_offset = field.offset;
+    else if (field.name == "y")
+      y_offset = field.offset;
+  }
+  if (x_offset < 0 || y_offset < 0)
+  {
+    NODELET_ERROR_THROTTLE(30, "Points on '%s' need FLOAT32 fields x and y",
+                           sub_points_.getTopic().c_str());
+    return;
+  }
+  if (std::max(x_offset, y_offset) + sizeof(float) > points_msg->point_step ||
+      (uint64_t)points_msg->point_step * points_msg->width > points_msg->row_step ||
+      (uint64_t)points_msg->row_step * points_msg->height > points_msg->data.size())
+  {
+    NODELET_ERROR_THROTTLE(30, "Points on '%s' have an inconsistent layout",
+                           sub_points_.getTopic().c_str());
+    return;
+  }
+  if (points_msg->data.empty())
+  {
+    pub_points_.publish(points_msg);
+    return;
+  }
+
+  sensor_msgs::PointCloud2Ptr rect_msg = boost::make_shared<sensor_msgs::PointCloud2>(*points_msg);
+  for (uint32_t row = 0; row < rect_msg->height; ++row)
+  {
+    uint8_t* point = &rect_msg->data[0] + row * rect_msg->row_step;
+    for (uint32_t i = 0; i < rect_msg->width; ++i, point += rect_msg->point_step)
+    {
+      // Fields need not be aligned
+      cv::Point2f raw;
+      memcpy(&raw.x, point + x_offset, sizeof(float));
+      memcpy(&raw.y, point + y_offset, sizeof(float));
+      cv::Point2f rect = rectifier_->rectify(raw);
+      memcpy(point + x_offset, &rect.x, sizeof(float));
+      memcpy(point + y_offset, &rect.y, sizeof(float));
+    }
+  }
+  pub_points_.publish(rect_msg);
+}
+
+} // namespace image_proc
+
+// Register nodelet
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS( image_proc::RectifyPointsNodelet, nodelet::Nodelet)
@@ -0,0 +1,250 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef IMAGE_PROC_SIMD_H
+#define IMAGE_PROC_SIMD_H
+
+// Small helpers shared by the vectorized kernels. IMAGE_PROC_SIMD is defined
+// when 128-bit vectors are available, through SSE2 (with SSSE3 used on top
+// when the compiler targets it) or NEON.
+
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#define IMAGE_PROC_SIMD 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMAGE_PROC_SIMD 1
+#endif
+
+namespace image_proc {
+namespace simd {
+
+#if defined(__SSE2__)
+
+inline __m128i load(const void* p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+inline void store(void* p, __m128i v)
+{
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+/// floor((a + b) / 2) of unsigned bytes; _mm_avg_epu8 rounds up
+inline __m128i avgFloor8(__m128i a, __m128i b)
+{
+  return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+/// floor((a + b) / 2) of unsigned 16-bit words
+inline __m128i avgFloor16(__m128i a, __m128i b)
+{
+  return _mm_sub_epi16(_mm_avg_epu16(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi16(1)));
+}
+
+#if defined(__SSSE3__)
+// Interleaves three 16-byte planes into 48 bytes. Row j of the table picks
+// the bytes of output register j / 3 from plane j % 3.
+inline void storeInterleaved(uint8_t* dst, __m128i b, __m128i g, __m128i r,
+                             const int8_t (*masks)[16])
+{
+  for (int j = 0; j < 3; ++j)
+  {
+    __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, load(masks[3 * j])),
+                                            _mm_shuffle_epi8(g, load(masks[3 * j + 1]))),
+                               _mm_shuffle_epi8(r, load(masks[3 * j + 2])));
+    store(dst + 16 * j, out);
+  }
+}
+#else
+// Without SSSE3 there is no cheap 3-way interleave; go through memory.
+template <typename T>
+inline void storeInterleaved(T* dst, __m128i b, __m128i g, __m128i r)
+{
+  const int N = 16 / sizeof(T);
+  T bb[N], gg[N], rr[N];
+  store(bb, b);
+  store(gg, g);
+  store(rr, r);
+  for (int i = 0; i < N; ++i)
+  {
+    dst[3 * i]     = bb[i];
+    dst[3 * i + 1] = gg[i];
+    dst[3 * i + 2] = rr[i];
+  }
+}
+#endif
+
+/// Stores 16 pixels, given as planes of blue, green and red bytes, as packed BGR.
+inline void storeBGR(uint8_t* dst, __m128i b, __m128i g, __m128i r)
+{
+#if defined(__SSSE3__)
+  static const int8_t masks[9][16] = {
+    { 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+    {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+    {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1},
+    {-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+    { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+    {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1},
+    {-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+    {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+    {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15},
+  };
+  storeInterleaved(dst, b, g, r, masks);
+#else
+  storeInterleaved(dst, b, g, r);
+#endif
+}
+
+/// Stores 8 pixels, given as planes of blue, green and red words, as packed BGR.
+inline void storeBGR(uint16_t* dst, __m128i b, __m128i g, __m128i r)
+{
+#if defined(__SSSE3__)
+  static const int8_t masks[9][16] = {
+    { 0,  1, -1, -1, -1, -1,  2,  3, -1, -1, -1, -1,  4,  5, -1, -1},
+    {-1, -1,  0,  1, -1, -1, -1, -1,  2,  3, -1, -1, -1, -1,  4,  5},
+    {-1, -1, -1, -1,  0,  1, -1, -1, -1, -1,  2,  3, -1, -1, -1, -1},
+    {-1, -1,  6,  7, -1, -1, -1, -1,  8,  9, -1, -1, -1, -1, 10, 11},
+    {-1, -1, -1, -1,  6,  7, -1, -1, -1, -1,  8,  9, -1, -1, -1, -1},
+    { 4,  5, -1, -1, -1, -1,  6,  7, -1, -1, -1, -1,  8,  9, -1, -1},
+    {-1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1},
+    {10, 11, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15, -1, -1},
+    {-1, -1, 10, 11, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15},
+  };
+  storeInterleaved(reinterpret_cast<uint8_t*>(dst), b, g, r, masks);
+#else
+  storeInterleaved(dst, b, g, r);
+#endif
+}
+
+/// Loads 16 pixels of three bytes each as three planes, the inverse of storeBGR().
+inline void loadPlanes3(const uint8_t* src, __m128i& c0, __m128i& c1, __m128i& c2)
+{
+#if defined(__SSSE3__)
+  // Row 3 * j + k of the table picks the bytes of plane k from input register j.
+  static const int8_t masks[9][16] = {
+    { 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13},
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14},
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15},
+  };
+  __m128i in[3] = { load(src), load(src + 16), load(src + 32) };
+  __m128i* out[3] = { &c0, &c1, &c2 };
+  for (int k = 0; k < 3; ++k)
+    *out[k] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in[0], load(masks[k])),
+                                        _mm_shuffle_epi8(in[1], load(masks[3 + k]))),
+                           _mm_shuffle_epi8(in[2], load(masks[6 + k])));
+#else
+  uint8_t planes[3][16];
+  for (int i = 0; i < 16; ++i)
+  {
+    planes[0][i] = src[3 * i];
+    planes[1][i] = src[3 * i + 1];
+    planes[2][i] = src[3 * i + 2];
+  }
+  c0 = load(planes[0]);
+  c1 = load(planes[1]);
+  c2 = load(planes[2]);
+#endif
+}
+
+/// Loads 16 pixels of four bytes each as four planes.
+inline void loadPlanes4(const uint8_t* src, __m128i& c0, __m128i& c1, __m128i& c2, __m128i& c3)
+{
+  const __m128i low_byte = _mm_set1_epi32(0xFF);
+  __m128i v0 = load(src), v1 = load(src + 16), v2 = load(src + 32), v3 = load(src + 48);
+  __m128i* out[4] = { &c0, &c1, &c2, &c3 };
+  for (int k = 0; k < 4; ++k)
+  {
+    __m128i a = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v0, 8 * k), low_byte),
+                                _mm_and_si128(_mm_srli_epi32(v1, 8 * k), low_byte));
+    __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v2, 8 * k), low_byte),
+                                _mm_and_si128(_mm_srli_epi32(v3, 8 * k), low_byte));
+    *out[k] = _mm_packus_epi16(a, b);
+  }
+}
+
+#elif defined(IMAGE_PROC_SIMD) // NEON
+
+inline void storeBGR(uint8_t* dst, uint8x16_t b, uint8x16_t g, uint8x16_t r)
+{
+  uint8x16x3_t bgr;
+  bgr.val[0] = b;
+  bgr.val[1] = g;
+  bgr.val[2] = r;
+  vst3q_u8(dst, bgr);
+}
+
+inline void storeBGR(uint16_t* dst, uint16x8_t b, uint16x8_t g, uint16x8_t r)
+{
+  uint16x8x3_t bgr;
+  bgr.val[0] = b;
+  bgr.val[1] = g;
+  bgr.val[2] = r;
+  vst3q_u16(dst, bgr);
+}
+
+inline void loadPlanes3(const uint8_t* src, uint8x16_t& c0, uint8x16_t& c1, uint8x16_t& c2)
+{
+  uint8x16x3_t planes = vld3q_u8(src);
+  c0 = planes.val[0];
+  c1 = planes.val[1];
+  c2 = planes.val[2];
+}
+
+inline void loadPlanes4(const uint8_t* src, uint8x16_t& c0, uint8x16_t& c1, uint8x16_t& c2, uint8x16_t& c3)
+{
+  uint8x16x4_t planes = vld4q_u8(src);
+  c0 = planes.val[0];
+  c1 = planes.val[1];
+  c2 = planes.val[2];
+  c3 = planes.val[3];
+}
+
+#endif
+
+} // namespace simd
+} // namespace image_proc
+
+#endif
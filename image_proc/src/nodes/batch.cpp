@@ -0,0 +1,409 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <image_proc/batch_scheduler.h>
+#include <image_proc/processor.h>
+#include <camera_calibration_parsers/parse.h>
+#include <cv_bridge/cv_bridge.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/image_encodings.h>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+
+namespace enc = sensor_msgs::image_encodings;
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+using image_proc::Processor;
+
+// Output names, indexed by the bit of the Processor flag that produces them
+static const char* PRODUCTS[] = {"image_mono", "image_rect", "image_color", "image_rect_color"};
+static const int NUM_PRODUCTS = 4;
+
+struct Frame
+{
+  // The raw image, or the file to load it from
+  sensor_msgs::ImageConstPtr raw;
+  fs::path path;
+  sensor_msgs::CameraInfoConstPtr info;
+  ros::Time time; // recording time, for bag output
+  std::string name; // file name for directory output
+  bool ok;
+
+  sensor_msgs::ImagePtr outputs[NUM_PRODUCTS];
+  std::vector<uchar> png[NUM_PRODUCTS];
+};
+typedef boost::shared_ptr<Frame> FramePtr;
+
+// Everything one thread needs to process frames independently of the others
+struct Worker
+{
+  Processor processor;
+  image_geometry::PinholeCameraModel model;
+};
+
+/**
+ * Debayers and rectifies frames on every core and writes the results in input
+ * order, to a bag and/or as PNG files.
+ */
+class Batch
+{
+public:
+  Batch(const po::variables_map& vm, const std::string& camera, int flags)
+    : flags_(flags), encoding_(vm.count("encoding") ? vm["encoding"].as<std::string>() : ""),
+      camera_(camera), frames_(0), failed_(0), warned_uncalibrated_(false),
+      scheduler_(vm["threads"].as<int>(), 4 * vm["threads"].as<int>())
+  {
+    for (int i = 0; i < scheduler_.size(); ++i)
+    {
+      workers_.push_back(boost::make_shared<Worker>());
+      workers_.back()->processor.interpolation_ = vm["interpolation"].as<int>();
+    }
+
+    if (vm.count("output-bag"))
+      bag_.open(vm["output-bag"].as<std::string>(), rosbag::bagmode::Write);
+    if (vm.count("output"))
+    {
+      output_dir_ = vm["output"].as<std::string>();
+      for (int i = 0; i < NUM_PRODUCTS; ++i)
+        if (flags_ & (1 << i))
+          fs::create_directories(output_dir_ / PRODUCTS[i]);
+    }
+  }
+
+  void add(const FramePtr& frame)
+  {
+    scheduler_.submit(boost::bind(&Batch::process, this, frame, _1), boost::bind(&Batch::write, this, frame));
+  }
+
+  void finish()
+  {
+    scheduler_.wait();
+    if (bag_.isOpen())
+      bag_.close();
+  }
+
+  int frames() const { return frames_; }
+  int failed() const { return failed_; }
+
+private:
+  void process(const FramePtr& frame, int worker_index)
+  {
+    // Set by processFrame() on success. An exception here would end the whole run,
+    // so a bad frame only counts as failed
+    frame->ok = false;
+    try
+    {
+      processFrame(frame, *workers_[worker_index]);
+    }
+    catch (const std::exception& e)
+    {
+      ROS_ERROR("Failed to process frame %s: %s", frame->name.c_str(), e.what());
+    }
+  }
+
+  void processFrame(const FramePtr& frame, Worker& worker)
+  {
+    if (!frame->raw && !(frame->raw = load(frame->path)))
+      return;
+
+    // Rectified outputs need a calibrated camera
+    int flags = flags_;
+    if ((flags & (Processor::RECT | Processor::RECT_COLOR)) && frame->info->K[0] == 0.0)
+    {
+      if (!warned_uncalibrated_.exchange(true))
+        ROS_WARN("Camera is uncalibrated, skipping rectified outputs");
+      flags &= ~(Processor::RECT | Processor::RECT_COLOR);
+    }
+    worker.model.fromCameraInfo(frame->info);
+
+    image_proc::ImageSet output;
+    if (!worker.processor.process(frame->raw, worker.model, output, flags))
+      return;
+
+    const cv::Mat* images[NUM_PRODUCTS] = {&output.mono, &output.rect, &output.color, &output.rect_color};
+    for (int i = 0; i < NUM_PRODUCTS; ++i)
+    {
+      if (!(flags & (1 << i)))
+        continue;
+      std::string encoding = output.color_encoding;
+      if (i < 2)
+        encoding = images[i]->depth() == CV_16U ? enc::MONO16 : enc::MONO8;
+      frame->outputs[i] = cv_bridge::CvImage(frame->raw->header, encoding, *images[i]).toImageMsg();
+
+      // Compress here rather than in write(), which only one thread runs at a time
+      if (!output_dir_.empty())
+      {
+        cv::Mat bgr = *images[i];
+        if (encoding == enc::RGB8 || encoding == enc::RGB16)
+          cv::cvtColor(bgr, bgr, cv::COLOR_RGB2BGR);
+        else if (encoding == enc::RGBA8 || encoding == enc::RGBA16)
+          cv::cvtColor(bgr, bgr, cv::COLOR_RGBA2BGRA);
+        cv::imencode(".png", bgr, frame->png[i]);
+      }
+    }
+    frame->raw.reset();
+    frame->ok = true;
+  }
+
+  sensor_msgs::ImageConstPtr load(const fs::path& path) const
+  {
+    cv::Mat image = cv::imread(path.string(), cv::IMREAD_UNCHANGED);
+    if (image.empty())
+    {
+      ROS_ERROR("Failed to read image %s", path.string().c_str());
+      return sensor_msgs::ImageConstPtr();
+    }
+
+    std::string encoding = encoding_;
+    if (encoding.empty())
+    {
+      static const std::string ENCODINGS[2][4] = {{enc::MONO8, "", enc::BGR8, enc::BGRA8},
+                                                  {enc::MONO16, "", enc::BGR16, enc::BGRA16}};
+      encoding = ENCODINGS[image.depth() == CV_16U][image.channels() - 1];
+    }
+    return cv_bridge::CvImage(std_msgs::Header(), encoding, image).toImageMsg();
+  }
+
+  void write(const FramePtr& frame)
+  {
+    if (!frame->ok)
+    {
+      ++failed_;
+      return;
+    }
+
+    for (int i = 0; i < NUM_PRODUCTS; ++i)
+    {
+      if (!frame->outputs[i])
+        continue;
+      if (bag_.isOpen())
+        bag_.write(camera_ + "/" + PRODUCTS[i], frame->time, *frame->outputs[i]);
+      if (!output_dir_.empty())
+      {
+        fs::path file = output_dir_ / PRODUCTS[i] / (frame->name + ".png");
+        std::ofstream out(file.string().c_str(), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&frame->png[i][0]), frame->png[i].size());
+        if (!out)
+          ROS_ERROR("Failed to write %s", file.string().c_str());
+      }
+    }
+    if (bag_.isOpen())
+      bag_.write(camera_ + "/camera_info", frame->time, *frame->info);
+
+    if (++frames_ % 100 == 0)
+      std::cerr << "\r" << frames_ << " frames" << std::flush;
+  }
+
+  int flags_;
+  std::string encoding_;
+  std::string camera_;
+  fs::path output_dir_;
+  rosbag::Bag bag_;
+  int frames_, failed_;
+  boost::atomic<bool> warned_uncalibrated_;
+  std::vector< boost::shared_ptr<Worker> > workers_;
+  image_proc::BatchScheduler scheduler_; // last, so it finishes before the rest is destroyed
+};
+
+static sensor_msgs::CameraInfoConstPtr readCalibration(const std::string& file)
+{
+  sensor_msgs::CameraInfoPtr info(new sensor_msgs::CameraInfo);
+  std::string camera_name;
+  if (!camera_calibration_parsers::readCalibration(file, camera_name, *info))
+    throw std::runtime_error("Failed to read calibration file " + file);
+  return info;
+}
+
+// Camera info from the calibration file if given, otherwise the latest one in the bag
+static int readBag(const std::string& file, const std::string& camera,
+                   sensor_msgs::CameraInfoConstPtr info, Batch& batch)
+{
+  bool use_bag_info = !info;
+  std::vector<std::string> topics;
+  topics.push_back(camera + "/image_raw");
+  topics.push_back(camera + "/camera_info");
+
+  rosbag::Bag bag(file, rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+  int skipped = 0;
+  BOOST_FOREACH(const rosbag::MessageInstance& m, view)
+  {
+    if (m.getTopic() == topics[1])
+    {
+      if (use_bag_info)
+        info = m.instantiate<sensor_msgs::CameraInfo>();
+      continue;
+    }
+
+    FramePtr frame = boost::make_shared<Frame>();
+    frame->raw = m.instantiate<sensor_msgs::Image>();
+    if (!frame->raw || !info)
+    {
+      ++skipped; // e.g. images recorded before the first camera info
+      continue;
+    }
+    frame->info = info;
+    frame->time = m.getTime();
+    std::ostringstream name;
+    name << frame->raw->header.stamp;
+    frame->name = name.str();
+    batch.add(frame);
+  }
+  return skipped;
+}
+
+static void readDirectory(const fs::path& dir, sensor_msgs::CameraInfoConstPtr info, Batch& batch)
+{
+  static const char* EXTENSIONS[] = {".png", ".pgm", ".ppm", ".bmp", ".tif", ".tiff", ".jpg", ".jpeg"};
+  std::vector<fs::path> files;
+  for (fs::directory_iterator it(dir), end; it != end; ++it)
+  {
+    std::string extension = boost::algorithm::to_lower_copy(it->path().extension().string());
+    if (fs::is_regular_file(it->status()) && std::count(EXTENSIONS, EXTENSIONS + 8, extension))
+      files.push_back(it->path());
+  }
+  std::sort(files.begin(), files.end());
+
+  if (!info)
+    info = boost::make_shared<sensor_msgs::CameraInfo>();
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    FramePtr frame = boost::make_shared<Frame>();
+    frame->path = files[i];
+    frame->info = info;
+    frame->time = ros::Time(0, i + 1); // bags need distinct, nonzero times to keep the order
+    frame->name = files[i].stem().string();
+    batch.add(frame);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  po::options_description options(
+    "Debayers and rectifies recorded images as fast as the CPU allows, without a ROS master.\n"
+    "Reads raw images from a bag (image_raw and camera_info under the camera namespace) or a\n"
+    "directory, and writes image_mono, image_color, image_rect and image_rect_color in input\n"
+    "order to a bag and/or as PNG files.\n\nOptions");
+  options.add_options()
+    ("help,h", "print this message")
+    ("bag", po::value<std::string>(), "input bag")
+    ("camera", po::value<std::string>()->default_value("/camera"), "camera namespace in the bags")
+    ("images", po::value<std::string>(), "input directory, read in file name order")
+    ("encoding", po::value<std::string>(),
+     "encoding of the images in the input directory, e.g. bayer_grbg8. Defaults to mono or bgr by channels")
+    ("calibration", po::value<std::string>(), "camera calibration file, instead of camera_info from the bag")
+    ("output-bag", po::value<std::string>(), "output bag")
+    ("output", po::value<std::string>(), "output directory, with a subdirectory per product")
+    ("products", po::value<std::string>()->default_value("image_mono,image_color,image_rect,image_rect_color"),
+     "comma-separated outputs to produce")
+    ("interpolation", po::value<int>()->default_value(cv::INTER_LINEAR), "interpolation for rectification")
+    ("threads,j", po::value<int>()->default_value(std::max(1u, boost::thread::hardware_concurrency())),
+     "number of threads");
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    po::notify(vm);
+  }
+  catch (const po::error& e)
+  {
+    std::cerr << e.what() << "\n\n" << options << std::endl;
+    return 1;
+  }
+  if (vm.count("help") || vm.count("bag") == vm.count("images") ||
+      !(vm.count("output-bag") || vm.count("output")))
+  {
+    std::cerr << "Need one of --bag or --images, and --output-bag and/or --output\n\n" << options << std::endl;
+    return vm.count("help") ? 0 : 1;
+  }
+
+  int flags = 0;
+  std::vector<std::string> products;
+  boost::split(products, vm["products"].as<std::string>(), boost::is_any_of(","));
+  BOOST_FOREACH(const std::string& product, products)
+  {
+    const char** found = std::find(PRODUCTS, PRODUCTS + NUM_PRODUCTS, product);
+    if (found == PRODUCTS + NUM_PRODUCTS)
+    {
+      std::cerr << "Unknown product " << product << std::endl;
+      return 1;
+    }
+    flags |= 1 << (found - PRODUCTS);
+  }
+
+  try
+  {
+    sensor_msgs::CameraInfoConstPtr info;
+    if (vm.count("calibration"))
+      info = readCalibration(vm["calibration"].as<std::string>());
+
+    std::string camera = vm["camera"].as<std::string>();
+    if (boost::algorithm::ends_with(camera, "/"))
+      camera.erase(camera.size() - 1);
+
+    boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    Batch batch(vm, camera, flags);
+    int skipped = 0;
+    if (vm.count("bag"))
+      skipped = readBag(vm["bag"].as<std::string>(), camera, info, batch);
+    else
+      readDirectory(vm["images"].as<std::string>(), info, batch);
+    batch.finish();
+
+    double seconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+    std::cerr << "\r" << batch.frames() << " frames in " << seconds << " s, " << batch.frames() / seconds
+              << " frames/s";
+    if (batch.failed() || skipped)
+      std::cerr << ", " << batch.failed() << " failed, " << skipped << " skipped";
+    std::cerr << std::endl;
+    return batch.failed() ? 1 : 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
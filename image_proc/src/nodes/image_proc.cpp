@@ -61,29 +61,52 @@ int main(int argc, char **argv)
   int queue_size;
   if (private_nh.getParam("queue_size", queue_size))
     shared_params["queue_size"] = queue_size;
+  int num_threads;
+  if (private_nh.getParam("num_threads", num_threads))
+    shared_params["num_threads"] = num_threads;
+  std::string map_cache_dir;
+  if (private_nh.getParam("map_cache_dir", map_cache_dir))
+    shared_params["map_cache_dir"] = map_cache_dir;
 
   nodelet::Loader manager(false); // Don't bring up the manager ROS API
   nodelet::M_string remappings;
   nodelet::V_string my_argv;
 
-  // Debayer nodelet, image_raw -> image_mono, image_color
-  std::string debayer_name = ros::this_node::getName() + "_debayer";
-  manager.load(debayer_name, "image_proc/debayer", remappings, my_argv);
+  // Optionally do all the processing in one nodelet instead of three. It debayers
+  // bilinearly only, ignoring the debayer nodelet's algorithm setting, and drops
+  // encodings other than 8-bit Bayer, bgr8, rgb8 and mono8 (see PipelineNodelet).
+  bool pipeline;
+  private_nh.param("pipeline", pipeline, false);
+  if (pipeline)
+  {
+    // Pipeline nodelet, image_raw -> image_mono, image_color, image_rect, image_rect_color
+    std::string pipeline_name = ros::this_node::getName() + "_pipeline";
+    if (shared_params.valid())
+      ros::param::set(pipeline_name, shared_params);
+    manager.load(pipeline_name, "image_proc/pipeline", remappings, my_argv);
+  }
+  else
+  {
+    // Debayer nodelet, image_raw -> image_mono, image_color
+    std::string debayer_name = ros::this_node::getName() + "_debayer";
+    manager.load(debayer_name, "image_proc/debayer", remappings, my_argv);
 
-  // Rectify nodelet, image_mono -> image_rect
-  std::string rectify_mono_name = ros::this_node::getName() + "_rectify_mono";
-  if (shared_params.valid())
-    ros::param::set(rectify_mono_name, shared_params);
-  manager.load(rectify_mono_name, "image_proc/rectify", remappings, my_argv);
+    // Rectify nodelet, image_mono -> image_rect
+    std::string rectify_mono_name = ros::this_node::getName() + "_rectify_mono";
+    if (shared_params.valid())
+      ros::param::set(rectify_mono_name, shared_params);
+    manager.load(rectify_mono_name, "image_proc/rectify", remappings, my_argv);
 
-  // Rectify nodelet, image_color -> image_rect_color
-  // NOTE: Explicitly resolve any global remappings here, so they don't get hidden.
-  remappings["image_mono"] = ros::names::resolve("image_color");
-  remappings["image_rect"] = ros::names::resolve("image_rect_color");
-  std::string rectify_color_name = ros::this_node::getName() + "_rectify_color";
-  if (shared_params.valid())
-    ros::param::set(rectify_color_name, shared_params);
-  manager.load(rectify_color_name, "image_proc/rectify", remappings, my_argv);
+    // Rectify nodelet, image_color -> image_rect_color
+    // NOTE: Explicitly resolve any global remappings here, so they don't get hidden.
+    remappings["image_mono"] = ros::names::resolve("image_color");
+    remappings["image_rect"] = ros::names::resolve("image_rect_color");
+    remappings["camera_rect"] = ros::names::resolve("camera_rect_color");
+    std::string rectify_color_name = ros::this_node::getName() + "_rectify_color";
+    if (shared_params.valid())
+      ros::param::set(rectify_color_name, shared_params);
+    manager.load(rectify_color_name, "image_proc/rectify", remappings, my_argv);
+  }
 
   // Check for only the original camera topics
   ros::V_string topics;
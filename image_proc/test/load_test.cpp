@@ -0,0 +1,339 @@
+#include <ros/ros.h>
+#include <gtest/gtest.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <stereo_msgs/DisparityImage.h>
+#include <opencv2/core/core.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <set>
+
+namespace enc = sensor_msgs::image_encodings;
+
+// Publishes synthetic frames at a fixed rate into a running pipeline and
+// measures, at each of its output topics, the time from header.stamp to
+// receipt and the fraction of frames that never arrive. The private
+// parameters are
+//   source:      "camera" (image_raw), "stereo" (left/ and right/image_raw)
+//                or "depth" (depth/image_rect and rgb/image_rect_color)
+//   encoding:    of the raw or depth images
+//   width, height, rate, warmup and duration (in seconds)
+//   outputs:     topics to measure, relative to the node namespace
+//   report_file: if set, the results are also written there as YAML
+//   max_drop_rate, max_latency: optional pass criteria, latency is the p99
+class LoadTest : public testing::Test
+{
+protected:
+  struct Output
+  {
+    std::string topic;
+    ros::Subscriber sub;
+    boost::mutex mutex;
+    // Stamp and latency in seconds of each message received
+    std::vector<std::pair<ros::Time, double> > samples;
+  };
+  typedef boost::shared_ptr<Output> OutputPtr;
+
+  virtual void SetUp()
+  {
+    ros::NodeHandle local_nh("~");
+    local_nh.param("source", source, std::string("camera"));
+    local_nh.param("encoding", encoding, std::string(source == "depth" ? enc::TYPE_16UC1 : enc::BAYER_GRBG8));
+    local_nh.param("width", width, 640);
+    local_nh.param("height", height, 480);
+    local_nh.param("rate", rate, 30.0);
+    local_nh.param("warmup", warmup, 2.0);
+    local_nh.param("duration", duration, 10.0);
+    local_nh.param("report_file", report_file, std::string());
+    local_nh.param("max_drop_rate", max_drop_rate, 1.0);
+    local_nh.param("max_latency", max_latency, 0.0);
+    std::vector<std::string> topics;
+    if (!local_nh.getParam("outputs", topics) || topics.empty())
+      throw "Must set parameter ~outputs.";
+    BOOST_FOREACH(const std::string& topic, topics)
+    {
+      OutputPtr output = boost::make_shared<Output>();
+      output->topic = nh.resolveName(topic);
+      outputs.push_back(output);
+    }
+
+    image_transport::ImageTransport it(nh);
+    if (source == "camera")
+    {
+      pubs.push_back(it.advertiseCamera("image_raw", 1));
+      images.push_back(makeImage(encoding, 0));
+      infos.push_back(makeInfo(0.0));
+    }
+    else if (source == "stereo")
+    {
+      pubs.push_back(it.advertiseCamera("left/image_raw", 1));
+      pubs.push_back(it.advertiseCamera("right/image_raw", 1));
+      // Random texture, seen by the right camera shifted 16 pixels to the left
+      images.push_back(makeImage(encoding, 0));
+      images.push_back(makeImage(encoding, 16));
+      infos.push_back(makeInfo(0.0));
+      infos.push_back(makeInfo(0.12));
+    }
+    else if (source == "depth")
+    {
+      pubs.push_back(it.advertiseCamera("depth/image_rect", 1));
+      pubs.push_back(it.advertiseCamera("rgb/image_rect_color", 1));
+      images.push_back(makeDepth(encoding));
+      images.push_back(makeImage(enc::BGR8, 0));
+      infos.push_back(makeInfo(0.0));
+      infos.push_back(makeInfo(0.0));
+    }
+    else
+      throw "Parameter ~source must be camera, stereo or depth.";
+
+    spinner.reset(new ros::AsyncSpinner(2));
+    spinner->start();
+  }
+
+  virtual void TearDown()
+  {
+    if (spinner)
+      spinner->stop();
+  }
+
+  // Random content, rotated left by shift columns
+  sensor_msgs::ImagePtr makeImage(const std::string& image_encoding, int shift)
+  {
+    sensor_msgs::ImagePtr image(new sensor_msgs::Image);
+    image->encoding = image_encoding;
+    image->width = width;
+    image->height = height;
+    int pixel_size = enc::numChannels(image_encoding) * (enc::bitDepth(image_encoding) / 8);
+    image->step = width * pixel_size;
+    image->data.resize(image->step * height);
+    cv::Mat data(height, image->step, CV_8UC1, &image->data[0]);
+    cv::RNG rng(12345);
+    rng.fill(data, cv::RNG::UNIFORM, 0, 256);
+    if (shift > 0)
+    {
+      cv::Mat rotated;
+      cv::hconcat(data.colRange(shift * pixel_size, data.cols), data.colRange(0, shift * pixel_size), rotated);
+      rotated.copyTo(data);
+    }
+    return image;
+  }
+
+  // Slanted plane from 0.5 to 4 m, with every 17th pixel missing
+  sensor_msgs::ImagePtr makeDepth(const std::string& depth_encoding)
+  {
+    sensor_msgs::ImagePtr image(new sensor_msgs::Image);
+    image->encoding = depth_encoding;
+    image->width = width;
+    image->height = height;
+    bool metric = (depth_encoding == enc::TYPE_32FC1);
+    image->step = width * (metric ? sizeof(float) : sizeof(uint16_t));
+    image->data.resize(image->step * height);
+    for (int i = 0; i < width * height; ++i)
+    {
+      float meters = 0.5f + 3.5f * (i % width) / width;
+      if (metric)
+        reinterpret_cast<float*>(&image->data[0])[i] = i % 17 == 0 ? std::numeric_limits<float>::quiet_NaN() : meters;
+      else
+        reinterpret_cast<uint16_t*>(&image->data[0])[i] = i % 17 == 0 ? 0 : uint16_t(meters * 1000.0f);
+    }
+    return image;
+  }
+
+  // Mildly distorted camera, baseline is in meters to the right of the first camera
+  sensor_msgs::CameraInfo makeInfo(double baseline)
+  {
+    sensor_msgs::CameraInfo info;
+    info.width = width;
+    info.height = height;
+    info.distortion_model = "plumb_bob";
+    double D[] = {-0.1, 0.01, 0.0, 0.0, 0.0};
+    info.D.assign(D, D + 5);
+    double f = 0.8 * width;
+    double K[] = {f, 0, width / 2.0, 0, f, height / 2.0, 0, 0, 1};
+    std::copy(K, K + 9, info.K.begin());
+    double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    std::copy(R, R + 9, info.R.begin());
+    double P[] = {f, 0, width / 2.0, -f * baseline, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+    std::copy(P, P + 12, info.P.begin());
+    return info;
+  }
+
+  template<class M>
+  void outputCb(const boost::shared_ptr<const M>& msg, Output* output)
+  {
+    double latency = (ros::Time::now() - msg->header.stamp).toSec();
+    boost::lock_guard<boost::mutex> lock(output->mutex);
+    output->samples.push_back(std::make_pair(msg->header.stamp, latency));
+  }
+
+  // Waits for the pipeline to advertise every output, then subscribes with its type
+  bool subscribeOutputs(double timeout)
+  {
+    ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+    while (ros::WallTime::now() < deadline)
+    {
+      ros::master::V_TopicInfo topics;
+      if (ros::master::getTopics(topics))
+      {
+        size_t found = 0;
+        BOOST_FOREACH(const OutputPtr& output, outputs)
+        {
+          BOOST_FOREACH(const ros::master::TopicInfo& topic, topics)
+          {
+            if (topic.name == output->topic)
+            {
+              ++found;
+              if (!output->sub)
+                output->sub = subscribe(topic.datatype, output.get());
+            }
+          }
+        }
+        if (found == outputs.size())
+          return true;
+      }
+      ros::WallDuration(0.5).sleep();
+    }
+    return false;
+  }
+
+  ros::Subscriber subscribe(const std::string& datatype, Output* output)
+  {
+    if (datatype == "sensor_msgs/Image")
+      return nh.subscribe<sensor_msgs::Image>(output->topic, 10,
+          boost::bind(&LoadTest::outputCb<sensor_msgs::Image>, this, _1, output));
+    if (datatype == "sensor_msgs/PointCloud2")
+      return nh.subscribe<sensor_msgs::PointCloud2>(output->topic, 10,
+          boost::bind(&LoadTest::outputCb<sensor_msgs::PointCloud2>, this, _1, output));
+    if (datatype == "sensor_msgs/PointCloud")
+      return nh.subscribe<sensor_msgs::PointCloud>(output->topic, 10,
+          boost::bind(&LoadTest::outputCb<sensor_msgs::PointCloud>, this, _1, output));
+    if (datatype == "stereo_msgs/DisparityImage")
+      return nh.subscribe<stereo_msgs::DisparityImage>(output->topic, 10,
+          boost::bind(&LoadTest::outputCb<stereo_msgs::DisparityImage>, this, _1, output));
+    ADD_FAILURE() << "Output " << output->topic << " has unsupported type " << datatype;
+    return ros::Subscriber();
+  }
+
+  // Publishes a frame on every source with the current time as its stamp
+  ros::Time publishFrame()
+  {
+    ros::Time stamp = ros::Time::now();
+    for (size_t i = 0; i < pubs.size(); ++i)
+    {
+      sensor_msgs::ImagePtr image(new sensor_msgs::Image(*images[i]));
+      sensor_msgs::CameraInfoPtr info(new sensor_msgs::CameraInfo(infos[i]));
+      image->header.stamp = info->header.stamp = stamp;
+      image->header.frame_id = info->header.frame_id = (i == 0 ? "camera" : "camera_2");
+      pubs[i].publish(image, info);
+    }
+    return stamp;
+  }
+
+  static double percentile(const std::vector<double>& sorted, double p)
+  {
+    if (sorted.empty())
+      return 0.0;
+    return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+  }
+
+  ros::NodeHandle nh;
+  boost::shared_ptr<ros::AsyncSpinner> spinner;
+  std::string source, encoding, report_file;
+  int width, height;
+  double rate, warmup, duration, max_drop_rate, max_latency;
+
+  std::vector<image_transport::CameraPublisher> pubs;
+  std::vector<sensor_msgs::ImagePtr> images;
+  std::vector<sensor_msgs::CameraInfo> infos;
+  std::vector<OutputPtr> outputs;
+};
+
+TEST_F(LoadTest, latencyAndDrops)
+{
+  ASSERT_TRUE(subscribeOutputs(30.0)) << "Timed out waiting for the pipeline to advertise its outputs";
+
+  // Frames published during warmup only let subscriptions connect and caches fill
+  ros::Rate loop(rate);
+  ros::Time warmup_end = ros::Time::now() + ros::Duration(warmup);
+  while (ros::ok() && ros::Time::now() < warmup_end)
+  {
+    publishFrame();
+    loop.sleep();
+  }
+
+  std::set<ros::Time> published;
+  ros::Time end = ros::Time::now() + ros::Duration(duration);
+  while (ros::ok() && ros::Time::now() < end)
+  {
+    published.insert(publishFrame());
+    loop.sleep();
+  }
+  ASSERT_FALSE(published.empty());
+  // Give frames in flight time to arrive
+  ros::Duration(1.0).sleep();
+
+  std::ofstream report;
+  if (!report_file.empty())
+  {
+    report.open(report_file.c_str());
+    report << "source: " << source << "\nencoding: " << encoding << "\nwidth: " << width
+           << "\nheight: " << height << "\nrate: " << rate << "\nframes_published: " << published.size()
+           << "\noutputs:\n";
+  }
+
+  ROS_INFO("%d x %d %s at %.1f Hz, %d frames", width, height, encoding.c_str(), rate, (int)published.size());
+  ROS_INFO("%-40s %8s %8s %10s %10s %10s", "output", "frames", "dropped", "p50 (ms)", "p99 (ms)", "max (ms)");
+  BOOST_FOREACH(const OutputPtr& output, outputs)
+  {
+    output->sub.shutdown();
+
+    // Only frames published in the measurement window count, and each only once
+    std::set<ros::Time> received;
+    std::vector<double> latencies;
+    {
+      boost::lock_guard<boost::mutex> lock(output->mutex);
+      for (size_t i = 0; i < output->samples.size(); ++i)
+      {
+        const ros::Time& stamp = output->samples[i].first;
+        if (published.count(stamp) && received.insert(stamp).second)
+          latencies.push_back(output->samples[i].second);
+      }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double drop_rate = 1.0 - double(received.size()) / published.size();
+    double p50 = percentile(latencies, 0.50), p99 = percentile(latencies, 0.99);
+    double max = latencies.empty() ? 0.0 : latencies.back();
+
+    ROS_INFO("%-40s %8d %7.1f%% %10.2f %10.2f %10.2f", output->topic.c_str(), (int)received.size(),
+             100.0 * drop_rate, p50 * 1e3, p99 * 1e3, max * 1e3);
+    if (report.is_open())
+    {
+      report << "  - topic: " << output->topic << "\n    frames: " << received.size()
+             << "\n    drop_rate: " << drop_rate << "\n    latency_ms: {p50: " << p50 * 1e3
+             << ", p99: " << p99 * 1e3 << ", max: " << max * 1e3 << "}\n";
+    }
+
+    EXPECT_FALSE(received.empty()) << "No frames received on " << output->topic;
+    EXPECT_LE(drop_rate, max_drop_rate) << output->topic;
+    if (max_latency > 0.0)
+      EXPECT_LE(p99, max_latency) << output->topic;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "imageproc_load_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
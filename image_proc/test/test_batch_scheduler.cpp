@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <image_proc/batch_scheduler.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+
+struct Recorder
+{
+  Recorder() : running(0), peak(0) {}
+
+  void work(int job, int worker, int num_workers)
+  {
+    EXPECT_GE(worker, 0);
+    EXPECT_LT(worker, num_workers);
+    int now = ++running;
+    int before = peak;
+    while (now > before && !peak.compare_exchange_weak(before, now))
+      ;
+    // Uneven job lengths, so jobs complete out of order
+    boost::this_thread::sleep_for(boost::chrono::microseconds((job * 7919) % 500));
+    --running;
+  }
+
+  void commit(int job)
+  {
+    EXPECT_LE(running, 4);
+    order.push_back(job);
+  }
+
+  boost::atomic<int> running, peak;
+  std::vector<int> order;
+};
+
+TEST(BatchScheduler, commitsInSubmissionOrder)
+{
+  Recorder recorder;
+  {
+    image_proc::BatchScheduler scheduler(4, 8);
+    for (int i = 0; i < 500; ++i)
+      scheduler.submit(boost::bind(&Recorder::work, &recorder, i, _1, scheduler.size()),
+                       boost::bind(&Recorder::commit, &recorder, i));
+    scheduler.wait();
+    ASSERT_EQ(500u, recorder.order.size());
+
+    // Destruction also waits for everything submitted
+    for (int i = 500; i < 1000; ++i)
+      scheduler.submit(boost::bind(&Recorder::work, &recorder, i, _1, scheduler.size()),
+                       boost::bind(&Recorder::commit, &recorder, i));
+  }
+  ASSERT_EQ(1000u, recorder.order.size());
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(i, recorder.order[i]);
+  EXPECT_GT(recorder.peak, 1);
+  EXPECT_LE(recorder.peak, 4);
+}
+
+static void idle(int)
+{
+  boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+}
+
+static void countCommit(int* committed, int max_in_flight, const boost::atomic<int>* submitted)
+{
+  ++*committed;
+  EXPECT_LE(*submitted - *committed, max_in_flight);
+}
+
+TEST(BatchScheduler, boundsJobsInFlight)
+{
+  boost::atomic<int> submitted(0);
+  int committed = 0;
+  {
+    image_proc::BatchScheduler scheduler(3, 5);
+    for (int i = 0; i < 200; ++i)
+    {
+      scheduler.submit(idle,
+                       boost::bind(countCommit, &committed, 5, &submitted));
+      ++submitted;
+    }
+  }
+  EXPECT_EQ(200, committed);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
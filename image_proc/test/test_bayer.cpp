@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <image_proc/bayer.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+struct BayerCase
+{
+  const char* encoding;
+  int code; // cvtColor code to BGR
+};
+
+static const BayerCase BAYER_CASES[] = {
+#if OPENCV3
+  {"bayer_rggb", cv::COLOR_BayerBG2BGR},
+  {"bayer_bggr", cv::COLOR_BayerRG2BGR},
+  {"bayer_gbrg", cv::COLOR_BayerGR2BGR},
+  {"bayer_grbg", cv::COLOR_BayerGB2BGR},
+#else
+  {"bayer_rggb", CV_BayerBG2BGR},
+  {"bayer_bggr", CV_BayerRG2BGR},
+  {"bayer_gbrg", CV_BayerGR2BGR},
+  {"bayer_grbg", CV_BayerGB2BGR},
+#endif
+};
+
+class DebayerMonoTest : public testing::TestWithParam<int> {};
+
+TEST_P(DebayerMonoTest, matchesColorThenGray)
+{
+  int depth = GetParam();
+  double max_value = depth == CV_8U ? 255 : 65535;
+  // Odd width leaves a tail after the vectorized part
+  cv::Mat bayer(37, 1283, CV_MAKETYPE(depth, 1));
+  cv::randu(bayer, cv::Scalar::all(0), cv::Scalar::all(max_value));
+
+  for (int i = 0; i < 4; ++i)
+  {
+    std::string encoding = std::string(BAYER_CASES[i].encoding) + (depth == CV_8U ? "8" : "16");
+    image_proc::BayerPattern pattern;
+    ASSERT_TRUE(image_proc::bayerPattern(encoding, pattern));
+
+    cv::Mat color, expected;
+    cv::cvtColor(bayer, color, BAYER_CASES[i].code);
+#if OPENCV3
+    cv::cvtColor(color, expected, cv::COLOR_BGR2GRAY);
+#else
+    cv::cvtColor(color, expected, CV_BGR2GRAY);
+#endif
+
+    cv::Mat mono;
+    image_proc::debayerMono(bayer, pattern, mono);
+    ASSERT_EQ(expected.size(), mono.size());
+    ASSERT_EQ(expected.type(), mono.type());
+
+    // cvtColor rounds each channel before weighting them, and handles the
+    // border differently
+    cv::Mat diff;
+    cv::absdiff(expected, mono, diff);
+    cv::Rect interior(2, 2, diff.cols - 4, diff.rows - 4);
+    double max_diff;
+    cv::minMaxLoc(diff(interior), NULL, &max_diff);
+    EXPECT_LE(max_diff, 1.0) << encoding;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Depth, DebayerMonoTest, testing::Values(CV_8U, CV_16U));
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
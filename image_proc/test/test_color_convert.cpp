@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "../src/nodelets/color_convert.h"
+
+// Random image, as a view into a larger one so rows are not contiguous and
+// reading past the view would change the result
+static cv::Mat makeView(int width, int height, int type)
+{
+  cv::Mat full(height + 4, width + 6, type);
+  cv::randu(full, cv::Scalar::all(0), cv::Scalar::all(256));
+  return full(cv::Rect(2, 2, width, height));
+}
+
+// The integer conversion of cv::cvtColor COLOR_YUV2BGR_UYVY, with 20-bit coefficients
+static void yuvReference(int y, int u, int v, int bgr[3])
+{
+  const int shift = 20, round = 1 << (shift - 1);
+  y = std::max(0, y - 16) * 1220542;
+  u -= 128;
+  v -= 128;
+  bgr[0] = std::min(std::max((y + round + 2116026 * u) >> shift, 0), 255);
+  bgr[1] = std::min(std::max((y + round - 409993 * u - 852492 * v) >> shift, 0), 255);
+  bgr[2] = std::min(std::max((y + round + 1673527 * v) >> shift, 0), 255);
+}
+
+TEST(ColorConvert, encodings)
+{
+  image_proc::Yuv422Order order;
+  EXPECT_TRUE(image_proc::yuv422Order("yuv422", order));
+  EXPECT_EQ(image_proc::YUV422_UYVY, order);
+  EXPECT_TRUE(image_proc::yuv422Order("yuv422_yuy2", order));
+  EXPECT_EQ(image_proc::YUV422_YUYV, order);
+  EXPECT_FALSE(image_proc::yuv422Order("rgb8", order));
+
+  image_proc::PackedLayout layout;
+  ASSERT_TRUE(image_proc::packedLayout("rgba8", layout));
+  EXPECT_EQ(4, layout.channels);
+  EXPECT_EQ(0, layout.red);
+  ASSERT_TRUE(image_proc::packedLayout("bgr8", layout));
+  EXPECT_EQ(3, layout.channels);
+  EXPECT_EQ(2, layout.red);
+  EXPECT_FALSE(image_proc::packedLayout("yuv422", layout));
+}
+
+TEST(ColorConvert, yuv422WithinOneOfCvtColor)
+{
+  // Width leaves a tail after the vectorized part
+  cv::Mat yuv = makeView(646, 21, CV_8UC2);
+  for (int yuyv = 0; yuyv < 2; ++yuyv)
+  {
+    image_proc::Yuv422Order order = yuyv ? image_proc::YUV422_YUYV : image_proc::YUV422_UYVY;
+    int luma = yuyv ? 0 : 1;
+    cv::Mat bgr, mono;
+    image_proc::yuv422ToBGR(yuv, order, bgr);
+    image_proc::yuv422ToMono(yuv, order, mono);
+    ASSERT_EQ(CV_8UC3, bgr.type());
+    ASSERT_EQ(CV_8UC1, mono.type());
+
+    for (int y = 0; y < yuv.rows; ++y)
+    {
+      const uint8_t* src = yuv.ptr<uint8_t>(y);
+      for (int x = 0; x < yuv.cols; ++x)
+      {
+        const uint8_t* group = src + 4 * (x / 2);
+        int expected[3];
+        yuvReference(src[2 * x + luma], group[1 - luma], group[3 - luma], expected);
+        for (int c = 0; c < 3; ++c)
+          ASSERT_NEAR(expected[c], bgr.ptr<uint8_t>(y)[3 * x + c], 1) << "at " << x << ", " << y;
+        ASSERT_EQ(src[2 * x + luma], mono.at<uint8_t>(y, x)) << "at " << x << ", " << y;
+      }
+    }
+  }
+}
+
+TEST(ColorConvert, packedMatchesReference)
+{
+  const char* encodings[] = {"rgb8", "bgr8", "rgba8", "bgra8"};
+  for (int e = 0; e < 4; ++e)
+  {
+    image_proc::PackedLayout layout;
+    ASSERT_TRUE(image_proc::packedLayout(encodings[e], layout));
+    cv::Mat src = makeView(1283, 19, CV_MAKETYPE(CV_8U, layout.channels));
+    cv::Mat bgr, mono;
+    image_proc::packedToBGR(src, layout, bgr);
+    image_proc::packedToMono(src, layout, mono);
+
+    for (int y = 0; y < src.rows; ++y)
+    {
+      for (int x = 0; x < src.cols; ++x)
+      {
+        const uint8_t* pixel = src.ptr<uint8_t>(y) + layout.channels * x;
+        int b = pixel[2 - layout.red], g = pixel[1], r = pixel[layout.red];
+        const uint8_t* out = bgr.ptr<uint8_t>(y) + 3 * x;
+        ASSERT_EQ(b, out[0]);
+        ASSERT_EQ(g, out[1]);
+        ASSERT_EQ(r, out[2]);
+        // cv::cvtColor BGR2GRAY
+        int gray = (b * 1868 + g * 9617 + r * 4899 + (1 << 13)) >> 14;
+        ASSERT_EQ(gray, mono.at<uint8_t>(y, x)) << encodings[e] << " at " << x << ", " << y;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
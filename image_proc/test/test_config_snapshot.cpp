@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <image_proc/config_snapshot.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+// Stands in for a generated dynamic_reconfigure config
+struct TestConfig
+{
+  int a;
+  int b;
+};
+
+TEST(ConfigSnapshot, heldSnapshotsDoNotChange)
+{
+  image_proc::ConfigSnapshot<TestConfig> snapshot;
+  TestConfig config = { 1, 1 };
+  snapshot.set(config);
+  boost::shared_ptr<const TestConfig> held = snapshot.get();
+
+  config.a = config.b = 2;
+  snapshot.set(config);
+  EXPECT_EQ(1, held->a);
+  EXPECT_EQ(2, snapshot.get()->a);
+  EXPECT_NE(held, snapshot.get());
+}
+
+static void readUntilStopped(const image_proc::ConfigSnapshot<TestConfig>* snapshot,
+                             const boost::atomic<bool>* stop, boost::atomic<int>* torn)
+{
+  int last = 0;
+  while (!stop->load())
+  {
+    boost::shared_ptr<const TestConfig> config = snapshot->get();
+    if (config->a != config->b || config->a < last)
+      ++*torn;
+    last = config->a;
+  }
+}
+
+TEST(ConfigSnapshot, readersSeeWholeConfigs)
+{
+  image_proc::ConfigSnapshot<TestConfig> snapshot;
+  TestConfig config = { 0, 0 };
+  snapshot.set(config);
+
+  boost::atomic<bool> stop(false);
+  boost::atomic<int> torn(0);
+  boost::thread_group readers;
+  for (int i = 0; i < 4; ++i)
+    readers.create_thread(boost::bind(&readUntilStopped, &snapshot, &stop, &torn));
+  for (int i = 1; i <= 20000; ++i)
+  {
+    config.a = config.b = i;
+    snapshot.set(config);
+  }
+  stop = true;
+  readers.join_all();
+  EXPECT_EQ(0, torn.load());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
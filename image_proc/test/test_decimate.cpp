@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "../src/nodelets/decimate.h"
+
+static void expectIdentical(const cv::Mat& a, const cv::Mat& b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  ASSERT_EQ(a.type(), b.type());
+  cv::Mat diff = (a.reshape(1) != b.reshape(1));
+  EXPECT_EQ(0, cv::countNonZero(diff));
+}
+
+// Random image, as a view into a larger one so rows are not contiguous and
+// reading past the view would change the result
+static cv::Mat makeView(int width, int height, int type)
+{
+  cv::Mat full(height + 4, width + 6, type);
+  cv::randu(full, cv::Scalar::all(0), cv::Scalar::all(255));
+  return full(cv::Rect(2, 2, width, height));
+}
+
+static void decimateReference(const cv::Mat& src, cv::Mat& dst, int decimation_x, int decimation_y)
+{
+  switch (src.elemSize())
+  {
+    case 1: image_proc::decimate<1>(src, dst, decimation_x, decimation_y); break;
+    case 3: image_proc::decimate<3>(src, dst, decimation_x, decimation_y); break;
+    case 4: image_proc::decimate<4>(src, dst, decimation_x, decimation_y); break;
+    case 8: image_proc::decimate<8>(src, dst, decimation_x, decimation_y); break;
+  }
+}
+
+TEST(Decimate, matchesTemplate)
+{
+  int types[] = {CV_8UC1, CV_8UC3, CV_8UC4, CV_16UC4};
+  int factors[] = {1, 2, 3, 4, 8};
+  for (int t = 0; t < 4; ++t)
+  {
+    // Widths that leave tails after the vectorized part
+    cv::Mat src = makeView(1283, 37, types[t]);
+    for (int i = 0; i < 5; ++i)
+    {
+      for (int decimation_y = 1; decimation_y <= 4; decimation_y *= 2)
+      {
+        cv::Mat expected, decimated;
+        decimateReference(src, expected, factors[i], decimation_y);
+        ASSERT_TRUE(image_proc::decimateNearest(src, decimated, factors[i], decimation_y));
+        expectIdentical(expected, decimated);
+      }
+    }
+  }
+}
+
+TEST(Decimate, debayer2x2MatchesTemplate)
+{
+  for (int depth = 0; depth < 2; ++depth)
+  {
+    cv::Mat bayer = makeView(1282, 36, depth == 0 ? CV_8UC1 : CV_16UC1);
+    if (depth == 1)
+      bayer *= 257; // use the full 16-bit range
+    int step = bayer.step1();
+    for (int red_y = 0; red_y < 2; ++red_y)
+    {
+      for (int red_x = 0; red_x < 2; ++red_x)
+      {
+        image_proc::BayerPattern pattern = { red_x, red_y };
+        int R  = red_y * step + red_x;
+        int B  = (1 - red_y) * step + 1 - red_x;
+        int G1 = red_y * step + 1 - red_x;
+        int G2 = (1 - red_y) * step + red_x;
+        for (int decimation = 2; decimation <= 8; decimation *= 2)
+        {
+          cv::Mat expected, bgr;
+          if (depth == 0)
+            image_proc::debayer2x2toBGR<uint8_t>(bayer, expected, R, G1, G2, B, decimation, decimation);
+          else
+            image_proc::debayer2x2toBGR<uint16_t>(bayer, expected, R, G1, G2, B, decimation, decimation);
+          image_proc::debayer2x2toBGR(bayer, pattern, bgr, decimation, decimation);
+          expectIdentical(expected, bgr);
+        }
+      }
+    }
+  }
+}
+
+TEST(Decimate, binBayerAveragesEachColor)
+{
+  cv::Mat bayer = makeView(1282, 36, CV_16UC1);
+  bayer *= 257;
+  image_proc::BayerPattern rggb = { 0, 0 };
+  int decimation_x = 6, decimation_y = 4;
+  cv::Mat bgr;
+  image_proc::binBayerToBGR(bayer, rggb, bgr, decimation_x, decimation_y);
+  ASSERT_EQ(cv::Size(bayer.cols / decimation_x, bayer.rows / decimation_y), bgr.size());
+  ASSERT_EQ(CV_16UC3, bgr.type());
+
+  for (int y = 0; y < bgr.rows; ++y)
+  {
+    for (int x = 0; x < bgr.cols; ++x)
+    {
+      // Channel of each RGGB sample: B = 0, G = 1, R = 2
+      int sum[3] = {0, 0, 0}, count[3] = {0, 0, 0};
+      for (int v = y * decimation_y; v < (y + 1) * decimation_y; ++v)
+      {
+        for (int u = x * decimation_x; u < (x + 1) * decimation_x; ++u)
+        {
+          int channel = (v % 2 == 0 && u % 2 == 0) ? 2 : (v % 2 == 1 && u % 2 == 1) ? 0 : 1;
+          sum[channel] += bayer.at<uint16_t>(v, u);
+          ++count[channel];
+        }
+      }
+      const cv::Vec3w& pixel = bgr.at<cv::Vec3w>(y, x);
+      for (int c = 0; c < 3; ++c)
+        ASSERT_EQ((sum[c] + count[c] / 2) / count[c], pixel[c]) << "at " << x << ", " << y;
+    }
+  }
+}
+
+TEST(Decimate, cameraInfo)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = 640;
+  info.height = 480;
+
+  // Decimation alone keeps the full-image ROI and leaves do_rectify alone
+  sensor_msgs::CameraInfoPtr out =
+    image_proc::decimateCameraInfo(info, 640, 480, cv::Rect(0, 0, 640, 480), 4, 4);
+  EXPECT_EQ(4u, out->binning_x);
+  EXPECT_EQ(4u, out->binning_y);
+  EXPECT_EQ(640u, out->roi.width);
+  EXPECT_EQ(480u, out->roi.height);
+  EXPECT_FALSE(out->roi.do_rectify);
+
+  // Cropping an already binned image moves the ROI in sensor pixels
+  info.binning_x = info.binning_y = 2;
+  out = image_proc::decimateCameraInfo(info, 320, 240, cv::Rect(10, 20, 100, 60), 2, 2);
+  EXPECT_EQ(4u, out->binning_x);
+  EXPECT_EQ(4u, out->binning_y);
+  EXPECT_EQ(20u, out->roi.x_offset);
+  EXPECT_EQ(40u, out->roi.y_offset);
+  EXPECT_EQ(200u, out->roi.width);
+  EXPECT_EQ(120u, out->roi.height);
+  EXPECT_TRUE(out->roi.do_rectify);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+#include <image_proc/worker_pool.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "../src/nodelets/depth_remap.h"
+
+// Fixed-point maps, as Rectifier builds them, that shift the image by (dx, dy)
+// and add a random jitter of up to a pixel if jitter is set
+static void makeMaps(int width, int height, float dx, float dy, bool jitter, cv::Mat& map1, cv::Mat& map2)
+{
+  map1.create(height, width, CV_16SC2);
+  map2.create(height, width, CV_16UC1);
+  cv::RNG rng(42);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      float fx = x + dx + (jitter ? rng.uniform(-1.0f, 1.0f) : 0.0f);
+      float fy = y + dy + (jitter ? rng.uniform(-1.0f, 1.0f) : 0.0f);
+      int ix = cvRound(fx * cv::INTER_TAB_SIZE), iy = cvRound(fy * cv::INTER_TAB_SIZE);
+      map1.at<cv::Vec2s>(y, x) = cv::Vec2s(ix >> cv::INTER_BITS, iy >> cv::INTER_BITS);
+      map2.at<uint16_t>(y, x) = (iy & (cv::INTER_TAB_SIZE - 1)) * cv::INTER_TAB_SIZE +
+                                (ix & (cv::INTER_TAB_SIZE - 1));
+    }
+  }
+}
+
+static bool valid(float depth)
+{
+  return depth > 0.0f && depth < std::numeric_limits<float>::infinity();
+}
+
+// Straightforward DEPTH_MIN_VALID of one pixel
+static float minValidReference(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2, int x, int y)
+{
+  cv::Vec2s whole = map1.at<cv::Vec2s>(y, x);
+  int fraction = map2.at<uint16_t>(y, x);
+  float fx = (fraction % cv::INTER_TAB_SIZE) / (float)cv::INTER_TAB_SIZE;
+  float fy = (fraction / cv::INTER_TAB_SIZE) / (float)cv::INTER_TAB_SIZE;
+
+  float depth[4], weight[4];
+  float nearest = std::numeric_limits<float>::infinity();
+  for (int i = 0; i < 4; ++i)
+  {
+    int sx = whole[0] + i % 2, sy = whole[1] + i / 2;
+    depth[i] = 0.0f;
+    if (sx >= 0 && sx < src.cols && sy >= 0 && sy < src.rows)
+      depth[i] = src.depth() == CV_16U ? src.at<uint16_t>(sy, sx) : src.at<float>(sy, sx);
+    weight[i] = (i % 2 ? fx : 1.0f - fx) * (i / 2 ? fy : 1.0f - fy);
+    if (valid(depth[i]))
+      nearest = std::min(nearest, depth[i]);
+  }
+  if (!valid(nearest))
+    return 0.0f;
+
+  float sum = 0.0f, total = 0.0f;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (valid(depth[i]) && depth[i] <= nearest * image_proc::DEPTH_BLEND_RATIO)
+    {
+      sum += weight[i] * depth[i];
+      total += weight[i];
+    }
+  }
+  return total > 0.0f ? sum / total : nearest;
+}
+
+TEST(DepthRemap, encodings)
+{
+  EXPECT_TRUE(image_proc::isDepthEncoding("16UC1"));
+  EXPECT_TRUE(image_proc::isDepthEncoding("32FC1"));
+  EXPECT_FALSE(image_proc::isDepthEncoding("mono16"));
+  EXPECT_FALSE(image_proc::isDepthEncoding("mono8"));
+}
+
+TEST(DepthRemap, minValidKeepsEdges)
+{
+  // Foreground on the left, background on the right
+  cv::Mat depth(48, 64, CV_16UC1, cv::Scalar(3000));
+  depth.colRange(0, 31).setTo(cv::Scalar(1000));
+  cv::Mat map1, map2;
+  makeMaps(64, 48, 0.5f, 0.25f, false, map1, map2);
+
+  cv::Mat rect;
+  image_proc::depthRemap(depth, map1, map2, image_proc::DEPTH_MIN_VALID, rect);
+  ASSERT_EQ(CV_16UC1, rect.type());
+  for (int y = 0; y < rect.rows - 1; ++y)
+  {
+    for (int x = 0; x < rect.cols; ++x)
+    {
+      // The pixel straddling the edge takes the foreground, never a blend
+      int expected = x < 31 ? 1000 : 3000;
+      ASSERT_EQ(expected, rect.at<uint16_t>(y, x)) << "at " << x << ", " << y;
+    }
+  }
+}
+
+TEST(DepthRemap, holesDoNotPullDown)
+{
+  cv::Mat depth(40, 50, CV_32FC1, cv::Scalar(2.0f));
+  cv::RNG rng(7);
+  for (int i = 0; i < 300; ++i)
+    depth.at<float>(rng.uniform(0, 40), rng.uniform(0, 50)) = i % 2 ? 0.0f : std::numeric_limits<float>::quiet_NaN();
+  // A block of holes wide enough that some pixels see no valid sample
+  depth(cv::Rect(20, 10, 6, 6)).setTo(cv::Scalar(0.0f));
+
+  cv::Mat map1, map2;
+  makeMaps(50, 40, 0.3f, 0.6f, false, map1, map2);
+  cv::Mat rect;
+  image_proc::depthRemap(depth, map1, map2, image_proc::DEPTH_MIN_VALID, rect);
+  for (int y = 0; y < rect.rows; ++y)
+  {
+    for (int x = 0; x < rect.cols; ++x)
+    {
+      float d = rect.at<float>(y, x);
+      if (minValidReference(depth, map1, map2, x, y) == 0.0f)
+        EXPECT_TRUE(std::isnan(d)) << "at " << x << ", " << y;
+      else
+        EXPECT_FLOAT_EQ(2.0f, d) << "at " << x << ", " << y;
+    }
+  }
+  EXPECT_TRUE(std::isnan(rect.at<float>(13, 22)));
+}
+
+TEST(DepthRemap, minValidMatchesReference)
+{
+  // Odd width, so rows end with a scalar tail
+  int width = 157, height = 33;
+  cv::Mat map1, map2;
+  makeMaps(width, height, 0.0f, 0.0f, true, map1, map2);
+
+  for (int t = 0; t < 2; ++t)
+  {
+    // Smooth surfaces at two depths, with holes
+    cv::Mat depth(height, width, t == 0 ? CV_16UC1 : CV_32FC1);
+    cv::RNG rng(t);
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        float d = (x / 20) % 2 ? 4000.0f + 10.0f * y : 1500.0f + 3.0f * x;
+        if (rng.uniform(0, 10) == 0)
+          d = 0.0f;
+        if (t == 0)
+          depth.at<uint16_t>(y, x) = (uint16_t)d;
+        else
+          depth.at<float>(y, x) = d / 1000.0f;
+      }
+    }
+
+    cv::Mat rect;
+    image_proc::depthRemap(depth, map1, map2, image_proc::DEPTH_MIN_VALID, rect);
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        float expected = minValidReference(depth, map1, map2, x, y);
+        if (t == 0)
+          ASSERT_NEAR(expected, rect.at<uint16_t>(y, x), 1.0) << "at " << x << ", " << y;
+        else if (expected == 0.0f)
+          ASSERT_TRUE(std::isnan(rect.at<float>(y, x))) << "at " << x << ", " << y;
+        else
+          ASSERT_NEAR(expected, rect.at<float>(y, x), 1e-5f) << "at " << x << ", " << y;
+      }
+    }
+
+    // Bands on a pool give the same result
+    image_proc::WorkerPool pool(3);
+    cv::Mat banded;
+    image_proc::depthRemap(depth, map1, map2, image_proc::DEPTH_MIN_VALID, banded, pool);
+    cv::Mat diff = (rect != banded) & (rect == rect);
+    EXPECT_EQ(0, cv::countNonZero(diff));
+  }
+}
+
+TEST(DepthRemap, nearestRounds)
+{
+  cv::Mat depth(20, 30, CV_16UC1);
+  for (int y = 0; y < depth.rows; ++y)
+    for (int x = 0; x < depth.cols; ++x)
+      depth.at<uint16_t>(y, x) = 100 * y + x + 1;
+
+  cv::Mat map1, map2;
+  makeMaps(30, 20, 0.75f, 0.25f, false, map1, map2);
+  cv::Mat rect;
+  image_proc::depthRemap(depth, map1, map2, image_proc::DEPTH_NEAREST, rect);
+  for (int y = 0; y < rect.rows; ++y)
+  {
+    for (int x = 0; x < rect.cols; ++x)
+    {
+      // Rounds x + 0.75 up and y + 0.25 down; past the right edge is invalid
+      int expected = x + 1 < depth.cols ? depth.at<uint16_t>(y, x + 1) : 0;
+      ASSERT_EQ(expected, rect.at<uint16_t>(y, x)) << "at " << x << ", " << y;
+    }
+  }
+}
+
+TEST(DepthRemap, nearestMatchesReference)
+{
+  // Odd width, and shifted so that samples fall off the left and top edges
+  int width = 157, height = 33;
+  cv::Mat map1, map2;
+  makeMaps(width, height, -1.5f, -0.5f, true, map1, map2);
+
+  for (int t = 0; t < 2; ++t)
+  {
+    // A view into a wider image, so its rows are further apart than its width
+    cv::Mat whole(height + 4, width + 40, t == 0 ? CV_16UC1 : CV_32FC1);
+    cv::randu(whole, 0, 5000);
+    cv::Mat depth = whole(cv::Rect(20, 2, width, height));
+
+    cv::Mat rect;
+    image_proc::depthRemap(depth, map1, map2, image_proc::DEPTH_NEAREST, rect);
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        cv::Vec2s pos = map1.at<cv::Vec2s>(y, x);
+        int fraction = map2.at<uint16_t>(y, x);
+        int sx = pos[0] + (fraction % cv::INTER_TAB_SIZE >= cv::INTER_TAB_SIZE / 2);
+        int sy = pos[1] + (fraction / cv::INTER_TAB_SIZE >= cv::INTER_TAB_SIZE / 2);
+        bool inside = sx >= 0 && sx < width && sy >= 0 && sy < height;
+        if (t == 0)
+          ASSERT_EQ(inside ? depth.at<uint16_t>(sy, sx) : 0, rect.at<uint16_t>(y, x)) << "at " << x << ", " << y;
+        else if (inside)
+          ASSERT_EQ(depth.at<float>(sy, sx), rect.at<float>(y, x)) << "at " << x << ", " << y;
+        else
+          ASSERT_TRUE(std::isnan(rect.at<float>(y, x))) << "at " << x << ", " << y;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "../src/nodelets/edge_aware.h"
+
+static void expectIdentical(const cv::Mat& a, const cv::Mat& b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  ASSERT_EQ(a.type(), b.type());
+  cv::Mat diff = (a != b);
+  EXPECT_EQ(0, cv::countNonZero(diff.reshape(1)));
+}
+
+// Noise with runs of saturated and black pixels, so that both the gradient
+// tie-breaks and the largest weighted sums get exercised
+static cv::Mat makeBayer(int width, int height, int type)
+{
+  cv::Mat bayer(height, width, type);
+  double max_value = type == CV_8UC1 ? 255 : 65535;
+  cv::randu(bayer, cv::Scalar::all(0), cv::Scalar::all(max_value + 1));
+  bayer.rowRange(height / 3, height / 3 + 2).setTo(cv::Scalar::all(max_value));
+  bayer.colRange(width / 2, width / 2 + 3).setTo(cv::Scalar::all(0));
+  return bayer;
+}
+
+class EdgeAwareTest : public testing::TestWithParam<int> {};
+
+TEST_P(EdgeAwareTest, vectorizedMatchesScalar)
+{
+  // Odd sizes leave a scalar tail at the end of every row
+  for (int size = 0; size < 3; ++size)
+  {
+    int width = 643 + 17 * size, height = 37 + size;
+    cv::Mat bayer = makeBayer(width, height, GetParam());
+    for (int red_y = 0; red_y < 2; ++red_y)
+    {
+      for (int red_x = 0; red_x < 2; ++red_x)
+      {
+        image_proc::BayerPattern pattern = { red_x, red_y };
+        cv::Mat expected, color;
+        image_proc::debayerEdgeAwareScalar(bayer, pattern, expected);
+        image_proc::debayerEdgeAware(bayer, pattern, color);
+        expectIdentical(expected, color);
+
+        image_proc::debayerEdgeAwareWeightedScalar(bayer, pattern, expected);
+        image_proc::debayerEdgeAwareWeighted(bayer, pattern, color);
+        expectIdentical(expected, color);
+      }
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Depth, EdgeAwareTest, testing::Values(CV_8UC1, CV_16UC1));
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <image_proc/image_pool.h>
+#include <sensor_msgs/image_encodings.h>
+
+namespace enc = sensor_msgs::image_encodings;
+
+TEST(ImagePool, allocatesRequestedLayout)
+{
+  image_proc::ImagePool pool;
+  sensor_msgs::ImagePtr msg = pool.allocate(480, 640, enc::BGR8);
+  EXPECT_EQ(480u, msg->height);
+  EXPECT_EQ(640u, msg->width);
+  EXPECT_EQ(enc::BGR8, msg->encoding);
+  EXPECT_EQ(640u * 3, msg->step);
+  EXPECT_EQ(480u * 640 * 3, msg->data.size());
+
+  msg = pool.allocate(10, 10, enc::MONO16, 32);
+  EXPECT_EQ(32u, msg->step);
+  EXPECT_EQ(320u, msg->data.size());
+}
+
+TEST(ImagePool, recyclesReleasedMessages)
+{
+  image_proc::ImagePool pool;
+  sensor_msgs::ImagePtr msg = pool.allocate(480, 640, enc::BGR8);
+  const uint8_t* data = &msg->data[0];
+  msg->header.frame_id = "camera";
+  sensor_msgs::ImageConstPtr subscriber = msg;
+
+  // Still referenced downstream, so not reusable yet
+  msg.reset();
+  EXPECT_EQ(0u, pool.numFree());
+  msg = pool.allocate(480, 640, enc::BGR8);
+  EXPECT_NE(data, &msg->data[0]);
+  msg.reset();
+
+  subscriber.reset();
+  EXPECT_EQ(2u, pool.numFree());
+  msg = pool.allocate(480, 640, enc::BGR8);
+  EXPECT_EQ(data, &msg->data[0]);
+  EXPECT_TRUE(msg->header.frame_id.empty());
+}
+
+TEST(ImagePool, keyedByEncodingAndSize)
+{
+  image_proc::ImagePool pool;
+  pool.allocate(480, 640, enc::BGR8);
+  EXPECT_EQ(1u, pool.numFree());
+
+  sensor_msgs::ImagePtr rgb = pool.allocate(480, 640, enc::RGB8);
+  sensor_msgs::ImagePtr smaller = pool.allocate(240, 320, enc::BGR8);
+  EXPECT_EQ(1u, pool.numFree());
+}
+
+TEST(ImagePool, boundsIdleMessages)
+{
+  image_proc::ImagePool pool(2);
+  {
+    sensor_msgs::ImagePtr a = pool.allocate(1, 1, enc::MONO8);
+    sensor_msgs::ImagePtr b = pool.allocate(1, 2, enc::MONO8);
+    sensor_msgs::ImagePtr c = pool.allocate(1, 3, enc::MONO8);
+  }
+  EXPECT_EQ(2u, pool.numFree());
+  pool.clear();
+  EXPECT_EQ(0u, pool.numFree());
+}
+
+TEST(ImagePool, messagesOutlivePool)
+{
+  sensor_msgs::ImagePtr msg;
+  {
+    image_proc::ImagePool pool;
+    msg = pool.allocate(480, 640, enc::MONO8);
+  }
+  msg.reset(); // must not touch the destroyed pool
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include <image_proc/latency_monitor.h>
+
+TEST(LatencyHistogram, percentiles)
+{
+  image_proc::LatencyHistogram histogram;
+  for (int i = 1; i <= 1000; ++i)
+    histogram.record(i * 1e-3);
+
+  image_proc::LatencyHistogram::Summary summary = histogram.takeSummary();
+  EXPECT_EQ(1000u, summary.count);
+  EXPECT_NEAR(0.5005, summary.mean, 1e-6);
+  EXPECT_DOUBLE_EQ(1.0, summary.max);
+  // Buckets are about 20% wide
+  EXPECT_NEAR(0.5, summary.p50, 0.1);
+  EXPECT_NEAR(0.9, summary.p90, 0.18);
+  EXPECT_NEAR(0.99, summary.p99, 0.2);
+  EXPECT_LE(summary.p99, summary.max);
+}
+
+TEST(LatencyHistogram, takeSummaryResets)
+{
+  image_proc::LatencyHistogram histogram;
+  histogram.record(0.002);
+  histogram.record(-1.0); // clock skew counts as zero
+  EXPECT_EQ(2u, histogram.takeSummary().count);
+
+  image_proc::LatencyHistogram::Summary summary = histogram.takeSummary();
+  EXPECT_EQ(0u, summary.count);
+  EXPECT_EQ(0.0, summary.mean);
+  EXPECT_EQ(0.0, summary.p50);
+  EXPECT_EQ(0.0, summary.max);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
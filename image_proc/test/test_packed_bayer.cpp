@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include "../src/nodelets/packed_bayer.h"
+
+// Random samples of the given size, and the same samples packed LSB first,
+// in a view of a larger image so rows are not contiguous
+static void makePacked(int width, int height, int bits, cv::Mat& samples, cv::Mat& packed)
+{
+  int row_bytes = image_proc::packedRowBytes(width, bits);
+  ASSERT_GT(row_bytes, 0);
+  samples.create(height, width, CV_16UC1);
+  cv::Mat full(height, row_bytes + 7, CV_8UC1, cv::Scalar::all(0));
+  packed = full(cv::Rect(0, 0, row_bytes, height));
+  for (int y = 0; y < height; ++y)
+  {
+    uint8_t* dst = packed.ptr<uint8_t>(y);
+    for (int x = 0; x < width; ++x)
+    {
+      int value = rand() % (1 << bits);
+      samples.at<uint16_t>(y, x) = value;
+      for (int b = 0; b < bits; ++b)
+      {
+        int bit = x * bits + b;
+        if (value & (1 << b))
+          dst[bit / 8] |= 1 << (bit % 8);
+      }
+    }
+  }
+}
+
+static int reflect101(int i, int n)
+{
+  return i < 0 ? -i : i >= n ? 2 * n - 2 - i : i;
+}
+
+// Bilinear debayering of a 16-bit mosaic with the rounding of cv::cvtColor
+static void debayerReference(const cv::Mat& bayer, image_proc::BayerPattern pattern, cv::Mat& bgr)
+{
+  bgr.create(bayer.rows, bayer.cols, CV_16UC3);
+  for (int y = 0; y < bayer.rows; ++y)
+  {
+    for (int x = 0; x < bayer.cols; ++x)
+    {
+      int v[3][3];
+      for (int j = 0; j < 3; ++j)
+        for (int i = 0; i < 3; ++i)
+          v[j][i] = bayer.at<uint16_t>(reflect101(y + j - 1, bayer.rows), reflect101(x + i - 1, bayer.cols));
+      int cross = (v[0][1] + v[1][0] + v[1][2] + v[2][1] + 2) >> 2;
+      int diagonal = (v[0][0] + v[0][2] + v[2][0] + v[2][2] + 2) >> 2;
+      int horizontal = (v[1][0] + v[1][2] + 1) >> 1;
+      int vertical = (v[0][1] + v[2][1] + 1) >> 1;
+      bool red_row = (y & 1) == pattern.red_y, red_column = (x & 1) == pattern.red_x;
+      uint16_t* out = bgr.ptr<uint16_t>(y) + 3 * x;
+      if (red_row && red_column)
+      {
+        out[0] = diagonal; out[1] = cross; out[2] = v[1][1];
+      }
+      else if (!red_row && !red_column)
+      {
+        out[0] = v[1][1]; out[1] = cross; out[2] = diagonal;
+      }
+      else
+      {
+        out[0] = red_row ? vertical : horizontal;
+        out[1] = v[1][1];
+        out[2] = red_row ? horizontal : vertical;
+      }
+    }
+  }
+}
+
+static void expectIdentical(const cv::Mat& a, const cv::Mat& b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  ASSERT_EQ(a.type(), b.type());
+  for (int y = 0; y < a.rows; ++y)
+    ASSERT_EQ(0, memcmp(a.ptr(y), b.ptr(y), a.cols * a.elemSize())) << "in row " << y;
+}
+
+TEST(PackedBayer, encodings)
+{
+  image_proc::BayerPattern pattern;
+  int bits;
+  ASSERT_TRUE(image_proc::packedBayerFormat("bayer_gbrg12p", pattern, bits));
+  EXPECT_EQ(12, bits);
+  EXPECT_EQ(0, pattern.red_x);
+  EXPECT_EQ(1, pattern.red_y);
+  ASSERT_TRUE(image_proc::packedBayerFormat("bayer_bggr10p", pattern, bits));
+  EXPECT_EQ(10, bits);
+  EXPECT_EQ(1, pattern.red_x);
+  EXPECT_EQ(1, pattern.red_y);
+  EXPECT_FALSE(image_proc::packedBayerFormat("bayer_rggb16", pattern, bits));
+  EXPECT_FALSE(image_proc::packedBayerFormat("bayer_rggb14p", pattern, bits));
+
+  EXPECT_EQ(5, image_proc::packedRowBytes(4, 10));
+  EXPECT_EQ(0, image_proc::packedRowBytes(6, 10));
+  EXPECT_EQ(9, image_proc::packedRowBytes(6, 12));
+}
+
+TEST(PackedBayer, unpackShiftsToSixteenBits)
+{
+  for (int bits = 10; bits <= 12; bits += 2)
+  {
+    // Width leaves a tail after the vectorized part
+    cv::Mat samples, packed, bayer;
+    makePacked(1292, 5, bits, samples, packed);
+    image_proc::unpackBayer(packed, samples.cols, bits, bayer);
+    ASSERT_EQ(CV_16UC1, bayer.type());
+    for (int y = 0; y < samples.rows; ++y)
+      for (int x = 0; x < samples.cols; ++x)
+        ASSERT_EQ(samples.at<uint16_t>(y, x) << (16 - bits), bayer.at<uint16_t>(y, x))
+          << bits << " bits at " << x << ", " << y;
+  }
+}
+
+TEST(PackedBayer, debayerMatchesUnpackThenDebayer)
+{
+  for (int bits = 10; bits <= 12; bits += 2)
+  {
+    cv::Mat samples, packed, bayer;
+    makePacked(652, 7, bits, samples, packed);
+    image_proc::unpackBayer(packed, samples.cols, bits, bayer);
+    for (int red_y = 0; red_y < 2; ++red_y)
+    {
+      for (int red_x = 0; red_x < 2; ++red_x)
+      {
+        image_proc::BayerPattern pattern = { red_x, red_y };
+        cv::Mat expected, bgr;
+        debayerReference(bayer, pattern, expected);
+        image_proc::debayerPacked(packed, samples.cols, bits, pattern, NULL, bgr);
+        expectIdentical(expected, bgr);
+      }
+    }
+  }
+}
+
+TEST(PackedBayer, toneMappedOutput)
+{
+  std::vector<uint8_t> curve;
+  image_proc::toneCurve(2.2, curve);
+  ASSERT_EQ(4096u, curve.size());
+  EXPECT_EQ(0, curve[0]);
+  EXPECT_EQ(255, curve[4095]);
+  // Gamma brightens the midtones
+  EXPECT_GT(curve[2048], 128);
+
+  cv::Mat samples, packed, bgr16, expected, bgr8;
+  makePacked(640, 4, 12, samples, packed);
+  image_proc::BayerPattern pattern = { 1, 0 };
+  image_proc::debayerPacked(packed, samples.cols, 12, pattern, NULL, bgr16);
+  image_proc::toneMap(bgr16, curve, expected);
+  image_proc::debayerPacked(packed, samples.cols, 12, pattern, &curve, bgr8);
+  expectIdentical(expected, bgr8);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <image_proc/point_rectifier.h>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <cmath>
+#include <limits>
+
+// Plumb-bob calibration of a wide-ish lens, scaled to the requested resolution
+static sensor_msgs::CameraInfo makeCameraInfo(int width, int height)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = width;
+  info.height = height;
+  info.distortion_model = "plumb_bob";
+  double D[] = {-0.28, 0.09, 0.0004, -0.0002, 0.0};
+  info.D.assign(D, D + 5);
+  double f = 0.8 * width;
+  double K[] = {f, 0, width / 2.0 + 3.5, 0, f, height / 2.0 - 2.5, 0, 0, 1};
+  std::copy(K, K + 9, info.K.begin());
+  // A small rectifying rotation, as for one camera of a stereo pair
+  cv::Matx33d R;
+  cv::Rodrigues(cv::Vec3d(-0.003, 0.005, 0.01), R);
+  std::copy(R.val, R.val + 9, info.R.begin());
+  double P[] = {f, 0, width / 2.0, 0, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, info.P.begin());
+  return info;
+}
+
+// Rectifying then unrectifying should land back on the raw point
+static void expectRoundTrip(const image_geometry::PinholeCameraModel& model,
+                            const image_proc::PointRectifier& rectifier, double tolerance)
+{
+  cv::Size size = model.reducedResolution();
+  // Off the table's nodes, including the last row and column of pixels
+  for (float y = 0.3f; y < size.height; y += 6.7f)
+  {
+    for (float x = 0.6f; x < size.width; x += 9.1f)
+    {
+      cv::Point2f raw(std::min(x, size.width - 1.0f), std::min(y, size.height - 1.0f));
+      cv::Point2d back = model.unrectifyPoint(rectifier.rectify(raw));
+      ASSERT_NEAR(raw.x, back.x, tolerance) << "at " << raw.x << ", " << raw.y;
+      ASSERT_NEAR(raw.y, back.y, tolerance) << "at " << raw.x << ", " << raw.y;
+    }
+  }
+}
+
+TEST(PointRectifier, inverseOfUnrectify)
+{
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  image_proc::PointRectifier rectifier;
+  EXPECT_FALSE(rectifier.initialized());
+  rectifier.update(model);
+  ASSERT_TRUE(rectifier.initialized());
+  expectRoundTrip(model, rectifier, 0.02);
+
+  // Agrees with cv::undistortPoints where its few iterations converge
+  cv::Point2f center(300.5f, 250.25f);
+  cv::Point2d expected = model.rectifyPoint(center);
+  cv::Point2f rect = rectifier.rectify(center);
+  EXPECT_NEAR(expected.x, rect.x, 0.01);
+  EXPECT_NEAR(expected.y, rect.y, 0.01);
+
+  std::vector<cv::Point2f> raw(1, center), rectified;
+  rectifier.rectify(raw, rectified);
+  ASSERT_EQ(1u, rectified.size());
+  EXPECT_EQ(rect, rectified[0]);
+}
+
+TEST(PointRectifier, binningAndRoi)
+{
+  sensor_msgs::CameraInfo info = makeCameraInfo(1280, 960);
+  info.binning_x = 2;
+  info.binning_y = 2;
+  info.roi.x_offset = 200;
+  info.roi.y_offset = 120;
+  info.roi.width = 800;
+  info.roi.height = 600;
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+
+  // A coarser table is less accurate
+  image_proc::PointRectifier rectifier(8);
+  rectifier.update(model);
+  expectRoundTrip(model, rectifier, 0.05);
+}
+
+TEST(PointRectifier, nonFinitePoints)
+{
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  image_proc::PointRectifier rectifier;
+  rectifier.update(model);
+
+  float nan = std::numeric_limits<float>::quiet_NaN();
+  float inf = std::numeric_limits<float>::infinity();
+  std::vector<cv::Point2f> raw, rectified;
+  raw.push_back(cv::Point2f(nan, 100.0f));
+  raw.push_back(cv::Point2f(100.0f, nan));
+  raw.push_back(cv::Point2f(inf, 100.0f));
+  raw.push_back(cv::Point2f(100.0f, -inf));
+  rectifier.rectify(raw, rectified);
+  ASSERT_EQ(raw.size(), rectified.size());
+  for (size_t i = 0; i < rectified.size(); ++i)
+  {
+    EXPECT_TRUE(std::isnan(rectified[i].x)) << "point " << i;
+    EXPECT_TRUE(std::isnan(rectified[i].y)) << "point " << i;
+  }
+
+  // Finite points beyond int range are still extrapolated
+  cv::Point2f right = rectifier.rectify(cv::Point2f(1e10f, 100.0f));
+  cv::Point2f above = rectifier.rectify(cv::Point2f(100.0f, -1e10f));
+  EXPECT_GT(right.x, 640.0f);
+  EXPECT_LT(above.y, 0.0f);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
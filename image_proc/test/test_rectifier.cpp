@@ -0,0 +1,350 @@
+#include <gtest/gtest.h>
+#include <image_proc/rectifier.h>
+#include <image_proc/worker_pool.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <boost/filesystem.hpp>
+
+// Plumb-bob calibration of a wide-ish lens, scaled to the requested resolution
+static sensor_msgs::CameraInfo makeCameraInfo(int width, int height)
+{
+  sensor_msgs::CameraInfo info;
+  info.width = width;
+  info.height = height;
+  info.distortion_model = "plumb_bob";
+  double D[] = {-0.28, 0.09, 0.0004, -0.0002, 0.0};
+  info.D.assign(D, D + 5);
+  double f = 0.8 * width;
+  double K[] = {f, 0, width / 2.0 + 3.5, 0, f, height / 2.0 - 2.5, 0, 0, 1};
+  std::copy(K, K + 9, info.K.begin());
+  double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(R, R + 9, info.R.begin());
+  double P[] = {f, 0, width / 2.0, 0, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, info.P.begin());
+  return info;
+}
+
+static cv::Mat makeImage(int width, int height, int type)
+{
+  cv::Mat image(height, width, type);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+  return image;
+}
+
+static void expectIdentical(const cv::Mat& a, const cv::Mat& b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  ASSERT_EQ(a.type(), b.type());
+  cv::Mat diff = (a != b);
+  EXPECT_EQ(0, cv::countNonZero(diff.reshape(1)));
+}
+
+class RectifierTest : public testing::TestWithParam<int> {};
+
+TEST_P(RectifierTest, matchesCameraModel)
+{
+  int interpolation = GetParam();
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  cv::Mat raw = makeImage(640, 480, CV_8UC3);
+
+  cv::Mat expected;
+  model.rectifyImage(raw, expected, interpolation);
+
+  image_proc::Rectifier rectifier;
+  rectifier.update(model);
+  ASSERT_TRUE(rectifier.hasMaps());
+
+  cv::Mat single;
+  rectifier.rectify(raw, single, interpolation);
+  expectIdentical(expected, single);
+
+  for (int threads = 2; threads <= 5; ++threads)
+  {
+    image_proc::WorkerPool pool(threads);
+    cv::Mat banded;
+    rectifier.rectify(raw, banded, interpolation, pool);
+    expectIdentical(expected, banded);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Interpolation, RectifierTest,
+                        testing::Values((int)cv::INTER_NEAREST, (int)cv::INTER_LINEAR,
+                                        (int)cv::INTER_CUBIC, (int)cv::INTER_LANCZOS4));
+
+TEST(Rectifier, binningAndRoi)
+{
+  sensor_msgs::CameraInfo info = makeCameraInfo(1280, 960);
+  info.binning_x = 2;
+  info.binning_y = 2;
+  info.roi.x_offset = 200;
+  info.roi.y_offset = 120;
+  info.roi.width = 800;
+  info.roi.height = 600;
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+  cv::Mat raw = makeImage(400, 300, CV_8UC1);
+
+  cv::Mat expected;
+  model.rectifyImage(raw, expected, cv::INTER_LINEAR);
+
+  image_proc::Rectifier rectifier;
+  rectifier.update(model);
+  image_proc::WorkerPool pool(3);
+  cv::Mat banded;
+  rectifier.rectify(raw, banded, cv::INTER_LINEAR, pool);
+  expectIdentical(expected, banded);
+}
+
+TEST(Rectifier, noDistortionCopies)
+{
+  sensor_msgs::CameraInfo info = makeCameraInfo(320, 240);
+  std::fill(info.D.begin(), info.D.end(), 0.0);
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+
+  image_proc::Rectifier rectifier;
+  rectifier.update(model);
+  EXPECT_FALSE(rectifier.hasMaps());
+
+  cv::Mat raw = makeImage(320, 240, CV_8UC1);
+  cv::Mat rect;
+  rectifier.rectify(raw, rect, cv::INTER_LINEAR);
+  expectIdentical(raw, rect);
+}
+
+TEST(Rectifier, bayerMatchesDebayerThenRectify)
+{
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  image_proc::Rectifier rectifier;
+  rectifier.update(model);
+  ASSERT_TRUE(rectifier.canRectifyBayer(cv::INTER_LINEAR));
+
+  // Smooth image, so that differences in border handling stay local
+  cv::Mat bayer(480, 640, CV_8UC1);
+  for (int y = 0; y < bayer.rows; ++y)
+    for (int x = 0; x < bayer.cols; ++x)
+      bayer.at<uint8_t>(y, x) = (x * 255 / 640 + y * 255 / 480) / 2;
+
+  image_proc::BayerPattern pattern;
+  ASSERT_TRUE(image_proc::bayerPattern("bayer_rggb8", pattern));
+  cv::Mat color, expected;
+#if OPENCV3
+  cv::cvtColor(bayer, color, cv::COLOR_BayerBG2BGR);
+#else
+  cv::cvtColor(bayer, color, CV_BayerBG2BGR);
+#endif
+  rectifier.rectify(color, expected, cv::INTER_LINEAR);
+
+  cv::Mat fused;
+  rectifier.rectifyBayer(bayer, pattern, fused, cv::INTER_LINEAR);
+  ASSERT_EQ(expected.size(), fused.size());
+  ASSERT_EQ(expected.type(), fused.type());
+
+  // Only rounding differences, apart from near the image border
+  cv::Mat diff;
+  cv::absdiff(expected, fused, diff);
+  cv::Rect interior(8, 8, diff.cols - 16, diff.rows - 16);
+  double max_diff;
+  cv::minMaxLoc(diff(interior).reshape(1), NULL, &max_diff);
+  EXPECT_LE(max_diff, 2.0);
+
+  image_proc::WorkerPool pool(3);
+  cv::Mat banded;
+  rectifier.rectifyBayer(bayer, pattern, banded, cv::INTER_LINEAR, pool);
+  expectIdentical(fused, banded);
+}
+
+TEST(Rectifier, outputRegionCrops)
+{
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  cv::Mat raw = makeImage(640, 480, CV_8UC3);
+
+  cv::Mat expected;
+  model.rectifyImage(raw, expected, cv::INTER_LINEAR);
+
+  // Width 0 extends to the right edge
+  image_proc::Rectifier rectifier;
+  rectifier.setOutput(cv::Rect(40, 30, 0, 200), 1.0);
+  rectifier.update(model);
+  cv::Mat rect;
+  rectifier.rectify(raw, rect, cv::INTER_LINEAR);
+  expectIdentical(expected(cv::Rect(40, 30, 600, 200)), rect);
+
+  const sensor_msgs::CameraInfo& info = rectifier.outputCameraInfo();
+  EXPECT_EQ(600u, info.width);
+  EXPECT_EQ(200u, info.height);
+  EXPECT_DOUBLE_EQ(model.cx() - 40, info.P[2]);
+  EXPECT_DOUBLE_EQ(model.cy() - 30, info.P[6]);
+  EXPECT_DOUBLE_EQ(0.0, info.D[0]);
+
+  // An undistorted camera still gets maps when cropping
+  sensor_msgs::CameraInfo undistorted = makeCameraInfo(640, 480);
+  std::fill(undistorted.D.begin(), undistorted.D.end(), 0.0);
+  model.fromCameraInfo(undistorted);
+  rectifier.update(model);
+  ASSERT_TRUE(rectifier.hasMaps());
+}
+
+TEST(Rectifier, outputScaleMapsStraightFromRaw)
+{
+  sensor_msgs::CameraInfo full_info = makeCameraInfo(640, 480);
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(full_info);
+
+  double scale = 0.5;
+  cv::Rect roi(64, 48, 512, 384);
+  image_proc::Rectifier rectifier;
+  rectifier.setOutput(roi, scale);
+  rectifier.update(model);
+  ASSERT_TRUE(rectifier.hasMaps());
+  ASSERT_EQ(cv::Size(256, 192), rectifier.map1().size());
+
+  // The output calibration describes the resized region
+  const sensor_msgs::CameraInfo& info = rectifier.outputCameraInfo();
+  EXPECT_EQ(256u, info.width);
+  EXPECT_EQ(192u, info.height);
+  EXPECT_DOUBLE_EQ(model.fx() * scale, info.P[0]);
+  EXPECT_DOUBLE_EQ((model.cx() - roi.x + 0.5) * scale - 0.5, info.P[2]);
+
+  // Each output pixel samples the raw point the full-size rectified image would
+  for (int y = 0; y < 192; y += 13)
+  {
+    for (int x = 0; x < 256; x += 17)
+    {
+      cv::Point2d rect_point(roi.x + (x + 0.5) / scale - 0.5, roi.y + (y + 0.5) / scale - 0.5);
+      cv::Point2d raw_point = model.unrectifyPoint(rect_point);
+      cv::Vec2s whole = rectifier.map1().at<cv::Vec2s>(y, x);
+      int fraction = rectifier.map2().at<uint16_t>(y, x);
+      double map_x = whole[0] + (fraction % cv::INTER_TAB_SIZE) / (double)cv::INTER_TAB_SIZE;
+      double map_y = whole[1] + (fraction / cv::INTER_TAB_SIZE) / (double)cv::INTER_TAB_SIZE;
+      EXPECT_NEAR(raw_point.x, map_x, 0.1) << "at " << x << ", " << y;
+      EXPECT_NEAR(raw_point.y, map_y, 0.1) << "at " << x << ", " << y;
+    }
+  }
+
+  // A different scale gives differently sized maps
+  image_proc::Rectifier other;
+  other.setOutput(roi, 0.25);
+  other.update(model);
+  EXPECT_EQ(cv::Size(128, 96), other.map1().size());
+}
+
+// Every pixel of region comes from inside the raw image, according to the maps
+static void expectMappedFromRaw(const image_proc::Rectifier& rectifier, const cv::Rect& region,
+                                const cv::Size& raw_size)
+{
+  for (int y = region.y; y < region.br().y; ++y)
+  {
+    for (int x = region.x; x < region.br().x; ++x)
+    {
+      cv::Vec2s whole = rectifier.map1().at<cv::Vec2s>(y, x);
+      int fraction = rectifier.map2().at<uint16_t>(y, x);
+      double map_x = whole[0] + (fraction % cv::INTER_TAB_SIZE) / (double)cv::INTER_TAB_SIZE;
+      double map_y = whole[1] + (fraction / cv::INTER_TAB_SIZE) / (double)cv::INTER_TAB_SIZE;
+      ASSERT_TRUE(map_x > -0.05 && map_x < raw_size.width - 0.95 &&
+                  map_y > -0.05 && map_y < raw_size.height - 0.95)
+        << "at " << x << ", " << y << ": " << map_x << ", " << map_y;
+    }
+  }
+}
+
+TEST(Rectifier, validRegion)
+{
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  cv::Rect region = image_proc::Rectifier::validRegion(model);
+  ASSERT_LT(region.area(), 640 * 480);
+  ASSERT_GT(region.area(), 640 * 480 / 2);
+
+  image_proc::Rectifier full;
+  full.update(model);
+  EXPECT_FALSE(full.hasOutputRegion());
+  expectMappedFromRaw(full, region, cv::Size(640, 480));
+
+  // Cropping to it keeps those pixels and shifts the principal point
+  image_proc::Rectifier cropped;
+  cropped.setOutput(cv::Rect(), 1.0, true);
+  EXPECT_TRUE(cropped.hasOutputRegion());
+  cropped.update(model);
+  EXPECT_EQ(region.size(), cropped.map1().size());
+  EXPECT_DOUBLE_EQ(model.cx() - region.x, cropped.outputCameraInfo().P[2]);
+  EXPECT_DOUBLE_EQ(model.cy() - region.y, cropped.outputCameraInfo().P[6]);
+  cv::Mat raw = makeImage(640, 480, CV_8UC1), expected, rect;
+  full.rectify(raw, expected, cv::INTER_LINEAR);
+  cropped.rectify(raw, rect, cv::INTER_LINEAR);
+  expectIdentical(expected(region), rect);
+}
+
+TEST(Rectifier, validRegionBinned)
+{
+  // The region is in binned pixels, like the maps
+  sensor_msgs::CameraInfo info = makeCameraInfo(640, 480);
+  info.binning_x = 2;
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(info);
+  cv::Rect region = image_proc::Rectifier::validRegion(model);
+  ASSERT_LE(region.br().x, 320);
+  ASSERT_LT(region.area(), 320 * 480);
+  ASSERT_GT(region.area(), 320 * 480 / 2);
+
+  image_proc::Rectifier full;
+  full.update(model);
+  ASSERT_EQ(cv::Size(320, 480), full.map1().size());
+  expectMappedFromRaw(full, region, cv::Size(320, 480));
+
+  // The same region as without binning, halved horizontally
+  image_geometry::PinholeCameraModel unbinned;
+  unbinned.fromCameraInfo(makeCameraInfo(640, 480));
+  cv::Rect full_region = image_proc::Rectifier::validRegion(unbinned);
+  EXPECT_NEAR(full_region.x / 2.0, region.x, 1.0);
+  EXPECT_NEAR(full_region.width / 2.0, region.width, 1.0);
+  EXPECT_NEAR(full_region.y, region.y, 1);
+  EXPECT_NEAR(full_region.height, region.height, 1);
+}
+
+TEST(Rectifier, mapCache)
+{
+  namespace fs = boost::filesystem;
+  fs::path cache_dir = fs::temp_directory_path() / fs::unique_path("image_proc_test_%%%%-%%%%");
+
+  image_geometry::PinholeCameraModel model;
+  model.fromCameraInfo(makeCameraInfo(640, 480));
+  cv::Mat raw = makeImage(640, 480, CV_8UC1);
+
+  // First rectifier builds the maps and saves them
+  image_proc::Rectifier built;
+  built.setCacheDirectory(cache_dir.string());
+  built.update(model);
+  ASSERT_EQ(1, std::distance(fs::directory_iterator(cache_dir), fs::directory_iterator()));
+
+  // Second one maps them from disk
+  image_proc::Rectifier loaded;
+  loaded.setCacheDirectory(cache_dir.string());
+  loaded.update(model);
+  expectIdentical(built.map1(), loaded.map1());
+  expectIdentical(built.map2(), loaded.map2());
+
+  cv::Mat expected, rect;
+  model.rectifyImage(raw, expected, cv::INTER_LINEAR);
+  loaded.rectify(raw, rect, cv::INTER_LINEAR);
+  expectIdentical(expected, rect);
+
+  // A different calibration gets its own file
+  sensor_msgs::CameraInfo info = makeCameraInfo(640, 480);
+  info.D[0] = -0.25;
+  EXPECT_NE(image_proc::Rectifier::calibrationHash(model.cameraInfo()),
+            image_proc::Rectifier::calibrationHash(info));
+  model.fromCameraInfo(info);
+  loaded.update(model);
+  EXPECT_EQ(2, std::distance(fs::directory_iterator(cache_dir), fs::directory_iterator()));
+
+  fs::remove_all(cache_dir);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <image_proc/worker_pool.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <stdexcept>
+
+struct Items
+{
+  explicit Items(int n) : calls(n), caller(boost::this_thread::get_id()), by_caller(0) {}
+
+  void run(int i)
+  {
+    ++calls[i];
+    if (boost::this_thread::get_id() == caller)
+      ++by_caller;
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(2));
+  }
+
+  void fail(int i)
+  {
+    run(i);
+    if (i == 3)
+      throw std::runtime_error("item 3 failed");
+  }
+
+  std::vector< boost::atomic<int> > calls;
+  boost::thread::id caller;
+  boost::atomic<int> by_caller;
+};
+
+TEST(WorkerPool, runsEachItemOnce)
+{
+  image_proc::WorkerPool pool(4);
+  for (int n = 0; n < 20; ++n)
+  {
+    Items items(n);
+    pool.parallelFor(n, boost::bind(&Items::run, &items, _1));
+    for (int i = 0; i < n; ++i)
+      EXPECT_EQ(1, items.calls[i]) << "item " << i << " of " << n;
+  }
+}
+
+TEST(WorkerPool, callerSharesTheWork)
+{
+  // With one helper, the caller should end up with about half of the items
+  image_proc::WorkerPool pool(2);
+  Items items(32);
+  pool.parallelFor(32, boost::bind(&Items::run, &items, _1));
+  EXPECT_GE(items.by_caller, 8);
+  EXPECT_LE(items.by_caller, 24);
+}
+
+TEST(WorkerPool, rethrowsInTheCaller)
+{
+  image_proc::WorkerPool pool(3);
+  Items items(8);
+  EXPECT_THROW(pool.parallelFor(8, boost::bind(&Items::fail, &items, _1)), std::runtime_error);
+  for (int i = 0; i < 8; ++i)
+    EXPECT_EQ(1, items.calls[i]) << "item " << i;
+
+  // And is still usable afterwards
+  Items again(8);
+  pool.parallelFor(8, boost::bind(&Items::run, &again, _1));
+  for (int i = 0; i < 8; ++i)
+    EXPECT_EQ(1, again.calls[i]) << "item " << i;
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,74 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef SHM_IMAGE_TRANSPORT_SHM_PUBLISHER_H
+#define SHM_IMAGE_TRANSPORT_SHM_PUBLISHER_H
+
+#include <image_transport/simple_publisher_plugin.h>
+#include <shm_image_transport/ShmImage.h>
+#include <boost/thread/mutex.hpp>
+#include "shm_image_transport/shm_ring.h"
+
+namespace shm_image_transport {
+
+/**
+ * Publishes images through a shared memory ring, sending only a ShmImage
+ * handle over the topic. The ring has ~num_slots slots (in the transport
+ * namespace, default 4) sized for the largest image so far; a larger image
+ * moves the publisher to a new segment.
+ */
+class ShmPublisher : public image_transport::SimplePublisherPlugin<shm_image_transport::ShmImage>
+{
+public:
+  ShmPublisher();
+
+  virtual ~ShmPublisher() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "shm";
+  }
+
+protected:
+  virtual void publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const;
+
+private:
+  mutable boost::mutex mutex_;
+  mutable boost::shared_ptr<ShmRing> ring_;
+  // Number of segments created so far, to give each a new name
+  mutable int generation_;
+};
+
+} // namespace shm_image_transport
+
+#endif
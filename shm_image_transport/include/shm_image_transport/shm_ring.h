@@ -0,0 +1,132 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef SHM_IMAGE_TRANSPORT_SHM_RING_H
+#define SHM_IMAGE_TRANSPORT_SHM_RING_H
+
+#include <string>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+
+namespace shm_image_transport {
+
+/**
+ * Fixed-size slots in a named shared memory segment, written round-robin by
+ * one publisher and read by any number of processes on the same host. Each
+ * write stamps its slot with a new sequence number, which the publisher
+ * sends to subscribers along with the slot index.
+ *
+ * Every slot has a reference count in shared memory. Readers hold a
+ * reference while copying out, and the writer only takes slots nobody
+ * references, so a frame is never overwritten while it is being read. A
+ * reader that finds the slot reused since its handle was sent gets false
+ * from read() instead of a mix of two frames.
+ *
+ * Each reference is recorded with the reader's process id, and the writer
+ * takes back slots whose references are all held by processes that no
+ * longer exist, so a subscriber killed while copying does not lose the slot
+ * for good. This relies on the processes sharing a pid namespace. A writer
+ * in another namespace may take a live reader for dead and overwrite its
+ * slot, in which case read() still returns false rather than a torn frame.
+ * At most MAX_READERS processes can hold references to one slot at once;
+ * more readers of the same frame get false.
+ */
+class ShmRing : boost::noncopyable
+{
+public:
+  enum { MAX_READERS = 16 };
+
+  /// Creates the segment, replacing a stale one of the same name, and
+  /// reserves its memory. It is removed again when the returned ring is
+  /// destroyed. Throws boost::interprocess::interprocess_exception if there
+  /// is not enough shared memory.
+  static boost::shared_ptr<ShmRing> create(const std::string& name, uint32_t num_slots, size_t slot_size);
+
+  /// Maps a segment made by create(). Throws
+  /// boost::interprocess::interprocess_exception if there is none, e.g. when
+  /// the publisher runs on another host.
+  static boost::shared_ptr<ShmRing> open(const std::string& name);
+
+  ~ShmRing();
+
+  const std::string& name() const { return name_; }
+  /// Differs between segments even if they reuse a name, e.g. after a
+  /// publisher is respawned with a recycled pid.
+  uint64_t nonce() const { return nonce_; }
+  uint32_t numSlots() const { return num_slots_; }
+  size_t slotSize() const { return slot_size_; }
+
+  /// Copies size bytes into the next unreferenced slot. Returns false if
+  /// size exceeds slotSize() or every slot is being read.
+  bool write(const uint8_t* data, size_t size, uint32_t& slot, uint64_t& sequence);
+
+  /// Copies size bytes out of slot if it still holds the write that
+  /// returned sequence, and returns whether it did.
+  bool read(uint32_t slot, uint64_t sequence, uint8_t* data, size_t size) const;
+
+  /// Takes a reference to slot if it still holds the write that returned
+  /// sequence and at least size bytes, and returns its data, else NULL. The
+  /// writer leaves the slot alone until release(), unless this process dies.
+  const uint8_t* acquire(uint32_t slot, uint64_t sequence, size_t size) const;
+
+  /// Drops a reference taken by acquire().
+  void release(uint32_t slot) const;
+
+private:
+  struct Header;
+  struct Slot;
+
+  ShmRing(const std::string& name, bool owner);
+
+  bool claim(Slot* s);
+  Slot* slot(uint32_t i) const;
+  uint8_t* slotData(uint32_t i) const;
+
+  std::string name_;
+  bool owner_;
+  boost::interprocess::shared_memory_object segment_;
+  boost::interprocess::mapped_region region_;
+  uint64_t nonce_;
+  uint32_t num_slots_;
+  size_t slot_size_;
+  // Writer state, not shared
+  uint32_t next_slot_;
+  uint64_t next_sequence_;
+};
+
+} // namespace shm_image_transport
+
+#endif
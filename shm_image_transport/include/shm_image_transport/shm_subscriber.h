@@ -0,0 +1,67 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef SHM_IMAGE_TRANSPORT_SHM_SUBSCRIBER_H
+#define SHM_IMAGE_TRANSPORT_SHM_SUBSCRIBER_H
+
+#include <image_transport/simple_subscriber_plugin.h>
+#include <shm_image_transport/ShmImage.h>
+#include "shm_image_transport/shm_ring.h"
+
+namespace shm_image_transport {
+
+/**
+ * Receives ShmImage handles and copies the images they refer to out of the
+ * publisher's shared memory ring. Only works on the publisher's host.
+ */
+class ShmSubscriber : public image_transport::SimpleSubscriberPlugin<shm_image_transport::ShmImage>
+{
+public:
+  virtual ~ShmSubscriber() {}
+
+  virtual std::string getTransportName() const
+  {
+    return "shm";
+  }
+
+protected:
+  virtual void internalCallback(const shm_image_transport::ShmImageConstPtr& message, const Callback& user_cb);
+
+private:
+  // The segment of the last handle, mapped until the publisher moves on
+  boost::shared_ptr<ShmRing> ring_;
+};
+
+} // namespace shm_image_transport
+
+#endif
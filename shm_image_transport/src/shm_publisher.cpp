@@ -0,0 +1,155 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <boost/version.hpp>
+#if ((BOOST_VERSION / 100) % 1000) >= 53
+#include <boost/thread/lock_guard.hpp>
+#endif
+
+#include "shm_image_transport/shm_publisher.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace shm_image_transport {
+
+namespace {
+
+// POSIX shared memory names are flat, so the topic's slashes become underscores.
+// Segments are named <prefix><pid>_<generation>, where the process id keeps
+// publishers of the same topic in different processes apart.
+std::string segmentPrefix(const std::string& topic)
+{
+  std::string prefix = "image_transport_shm";
+  for (size_t i = 0; i < topic.size(); ++i)
+    prefix += isalnum((unsigned char)topic[i]) ? topic[i] : '_';
+  return prefix + '_';
+}
+
+std::string segmentName(const std::string& topic, int generation)
+{
+  std::ostringstream name;
+  name << segmentPrefix(topic) << getpid() << '_' << generation;
+  return name.str();
+}
+
+// A publisher that crashed or was killed never removes its segments, and a
+// respawned one gets a new pid, so it cleans up after its predecessors of the
+// same topic. Called before this process has made any segments, so its own
+// pid's are left over from an earlier process as well.
+void removeStaleSegments(const std::string& topic)
+{
+  DIR* dir = opendir("/dev/shm");
+  if (!dir)
+    return;
+  std::string prefix = segmentPrefix(topic);
+  while (dirent* entry = readdir(dir))
+  {
+    std::string name = entry->d_name;
+    int pid, generation;
+    char trailing;
+    if (name.compare(0, prefix.size(), prefix) != 0 ||
+        sscanf(name.c_str() + prefix.size(), "%d_%d%c", &pid, &generation, &trailing) != 2)
+      continue;
+    if (pid != getpid() && (kill(pid, 0) == 0 || errno != ESRCH))
+      continue;
+    ROS_INFO("Removing shared memory segment '%s' left behind by an earlier publisher", name.c_str());
+    boost::interprocess::shared_memory_object::remove(name.c_str());
+  }
+  closedir(dir);
+}
+
+} // namespace
+
+ShmPublisher::ShmPublisher()
+  : generation_(0)
+{
+}
+
+void ShmPublisher::publish(const sensor_msgs::Image& message, const PublishFn& publish_fn) const
+{
+  size_t size = (size_t)message.step * message.height;
+  if (message.data.size() < size)
+  {
+    ROS_ERROR_THROTTLE(10, "Image on topic '%s' has %u rows of %u bytes, but only %zu bytes of data",
+                       getTopic().c_str(), message.height, message.step, message.data.size());
+    return;
+  }
+
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  if (!ring_ || ring_->slotSize() < size)
+  {
+    // Subscribers follow to the new segment with the next handle. Any still
+    // copying out of the old one keep it mapped until they are done.
+    int num_slots;
+    nh().param("num_slots", num_slots, 4);
+    if (generation_ == 0)
+      removeStaleSegments(getTopic());
+    std::string name = segmentName(getTopic(), generation_++);
+    ring_.reset();
+    try
+    {
+      ring_ = ShmRing::create(name, std::max(num_slots, 2), size);
+    }
+    catch (boost::interprocess::interprocess_exception& e)
+    {
+      ROS_ERROR_THROTTLE(10, "Could not create shared memory segment '%s' for topic '%s': %s",
+                         name.c_str(), getTopic().c_str(), e.what());
+      return;
+    }
+  }
+
+  shm_image_transport::ShmImage handle;
+  if (!ring_->write(size ? &message.data[0] : NULL, size, handle.slot, handle.sequence))
+  {
+    ROS_WARN_THROTTLE(10, "All %u shared memory slots of topic '%s' are being read, dropping an image",
+                      ring_->numSlots(), getTopic().c_str());
+    return;
+  }
+  handle.header       = message.header;
+  handle.height       = message.height;
+  handle.width        = message.width;
+  handle.encoding     = message.encoding;
+  handle.is_bigendian = message.is_bigendian;
+  handle.step         = message.step;
+  handle.segment      = ring_->name();
+  handle.nonce        = ring_->nonce();
+  publish_fn(handle);
+}
+
+} // namespace shm_image_transport
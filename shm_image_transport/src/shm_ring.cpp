@@ -0,0 +1,318 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "shm_image_transport/shm_ring.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <boost/atomic.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/static_assert.hpp>
+
+namespace bip = boost::interprocess;
+
+namespace shm_image_transport {
+
+// Slot reference counts are shared between processes, which only works if
+// the atomics are implemented in place rather than with a process-local lock
+BOOST_STATIC_ASSERT(BOOST_ATOMIC_INT32_LOCK_FREE == 2);
+BOOST_STATIC_ASSERT(BOOST_ATOMIC_INT64_LOCK_FREE == 2);
+
+namespace {
+
+const uint32_t MAGIC = 0x52534d32; // "RSM2"
+
+// The ring header and pixel data each start on their own cache line
+const size_t LINE_SIZE = 64;
+const size_t SLOT_HEADER_SIZE = 2 * LINE_SIZE;
+
+size_t roundUp(size_t size)
+{
+  return (size + LINE_SIZE - 1) / LINE_SIZE * LINE_SIZE;
+}
+
+size_t headerSize(uint32_t num_slots)
+{
+  return LINE_SIZE + SLOT_HEADER_SIZE * num_slots;
+}
+
+bool processAlive(int32_t pid)
+{
+  return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+} // namespace
+
+struct ShmRing::Header
+{
+  uint32_t magic;
+  uint32_t num_slots;
+  uint64_t slot_size;
+  // Creation time in nanoseconds
+  uint64_t nonce;
+};
+
+struct ShmRing::Slot
+{
+  // Number of references held by readers, or -1 while the writer fills the slot
+  boost::atomic<int32_t> refs;
+  // Stamped by each write, and zero while the writer fills the slot
+  boost::atomic<uint64_t> sequence;
+  uint64_t size;
+  // Process ids of the readers holding references, or 0. A reader records
+  // itself before taking its reference and clears its entry after dropping
+  // it, so every reference has an entry.
+  boost::atomic<int32_t> readers[MAX_READERS];
+};
+
+ShmRing::ShmRing(const std::string& name, bool owner)
+  : name_(name),
+    owner_(owner),
+    nonce_(0),
+    num_slots_(0),
+    slot_size_(0),
+    next_slot_(0),
+    next_sequence_(1)
+{
+  BOOST_STATIC_ASSERT(sizeof(Header) <= LINE_SIZE);
+  BOOST_STATIC_ASSERT(sizeof(Slot) <= SLOT_HEADER_SIZE);
+}
+
+boost::shared_ptr<ShmRing> ShmRing::create(const std::string& name, uint32_t num_slots, size_t slot_size)
+{
+  bip::shared_memory_object::remove(name.c_str());
+  boost::shared_ptr<ShmRing> ring(new ShmRing(name, true));
+  ring->num_slots_ = num_slots;
+  ring->slot_size_ = roundUp(slot_size);
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  ring->nonce_ = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+  size_t total = headerSize(num_slots) + ring->slot_size_ * num_slots;
+  bip::shared_memory_object(bip::create_only, name.c_str(), bip::read_write).swap(ring->segment_);
+  ring->segment_.truncate(total);
+  // On tmpfs truncate() only sets the size. Reserve the pages now, so running
+  // out of shared memory is an error here rather than SIGBUS in write().
+  int error = posix_fallocate(ring->segment_.get_mapping_handle().handle, 0, total);
+  if (error)
+  {
+    std::ostringstream message;
+    message << "Could not reserve " << total << " bytes of shared memory for " << name << ": "
+            << std::strerror(error);
+    throw bip::interprocess_exception(message.str().c_str());
+  }
+  bip::mapped_region(ring->segment_, bip::read_write).swap(ring->region_);
+
+  for (uint32_t i = 0; i < num_slots; ++i)
+  {
+    Slot* slot = new (ring->slot(i)) Slot;
+    slot->refs.store(0, boost::memory_order_relaxed);
+    slot->sequence.store(0, boost::memory_order_relaxed);
+    slot->size = 0;
+    for (int r = 0; r < MAX_READERS; ++r)
+      slot->readers[r].store(0, boost::memory_order_relaxed);
+  }
+  Header* header = new (ring->region_.get_address()) Header;
+  header->num_slots = num_slots;
+  header->slot_size = ring->slot_size_;
+  header->nonce = ring->nonce_;
+  header->magic = MAGIC;
+  return ring;
+}
+
+boost::shared_ptr<ShmRing> ShmRing::open(const std::string& name)
+{
+  // Readers update the reference counts, so they need write access too
+  boost::shared_ptr<ShmRing> ring(new ShmRing(name, false));
+  bip::shared_memory_object(bip::open_only, name.c_str(), bip::read_write).swap(ring->segment_);
+  bip::mapped_region(ring->segment_, bip::read_write).swap(ring->region_);
+
+  const Header* header = static_cast<const Header*>(ring->region_.get_address());
+  if (ring->region_.get_size() < LINE_SIZE || header->magic != MAGIC)
+    throw bip::interprocess_exception(("Not an image ring: " + name).c_str());
+  ring->nonce_ = header->nonce;
+  ring->num_slots_ = header->num_slots;
+  ring->slot_size_ = header->slot_size;
+  if (ring->region_.get_size() < headerSize(ring->num_slots_) + ring->slot_size_ * ring->num_slots_)
+    throw bip::interprocess_exception(("Truncated image ring: " + name).c_str());
+  return ring;
+}
+
+ShmRing::~ShmRing()
+{
+  // Processes that still have the segment mapped keep it until they unmap
+  if (owner_)
+    bip::shared_memory_object::remove(name_.c_str());
+}
+
+ShmRing::Slot* ShmRing::slot(uint32_t i) const
+{
+  return reinterpret_cast<Slot*>(static_cast<uint8_t*>(region_.get_address()) + LINE_SIZE +
+                                 SLOT_HEADER_SIZE * i);
+}
+
+uint8_t* ShmRing::slotData(uint32_t i) const
+{
+  return static_cast<uint8_t*>(region_.get_address()) + headerSize(num_slots_) + slot_size_ * i;
+}
+
+bool ShmRing::claim(Slot* s)
+{
+  // References held only by processes that have died are never dropped, so
+  // they don't keep the slot
+  int32_t refs = s->refs.load();
+  if (refs > 0)
+  {
+    for (int r = 0; r < MAX_READERS; ++r)
+    {
+      int32_t pid = s->readers[r].load();
+      if (pid != 0 && processAlive(pid))
+        return false;
+    }
+  }
+  // Fails if a reader came or went since
+  if (!s->refs.compare_exchange_strong(refs, -1))
+    return false;
+
+  // Readers that died before taking their reference or after dropping it
+  // leave an entry behind as well
+  for (int r = 0; r < MAX_READERS; ++r)
+  {
+    int32_t pid = s->readers[r].load();
+    if (pid != 0 && !processAlive(pid))
+      s->readers[r].compare_exchange_strong(pid, 0);
+  }
+  return true;
+}
+
+bool ShmRing::write(const uint8_t* data, size_t size, uint32_t& slot_index, uint64_t& sequence)
+{
+  if (size > slot_size_)
+    return false;
+
+  // Take the oldest slot that no one is reading
+  for (uint32_t n = 0; n < num_slots_; ++n)
+  {
+    uint32_t i = (next_slot_ + n) % num_slots_;
+    Slot* s = slot(i);
+    if (!claim(s))
+      continue;
+
+    // Zero the sequence before touching the data, so that a reader this
+    // writer wrongly took for dead notices the overwrite
+    s->sequence.store(0, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+    std::memcpy(slotData(i), data, size);
+    s->size = size;
+    s->sequence.store(next_sequence_, boost::memory_order_release);
+    s->refs.store(0);
+
+    slot_index = i;
+    sequence = next_sequence_++;
+    next_slot_ = (i + 1) % num_slots_;
+    return true;
+  }
+  return false;
+}
+
+const uint8_t* ShmRing::acquire(uint32_t slot_index, uint64_t sequence, size_t size) const
+{
+  if (slot_index >= num_slots_ || size > slot_size_)
+    return NULL;
+
+  Slot* s = slot(slot_index);
+  int32_t pid = getpid();
+  int entry = 0;
+  for (; entry < MAX_READERS; ++entry)
+  {
+    int32_t empty = 0;
+    if (s->readers[entry].compare_exchange_strong(empty, pid))
+      break;
+  }
+  if (entry == MAX_READERS)
+    return NULL;
+
+  int32_t refs = s->refs.load();
+  do
+  {
+    // Being overwritten, so the frame is gone
+    if (refs < 0)
+    {
+      s->readers[entry].store(0);
+      return NULL;
+    }
+  } while (!s->refs.compare_exchange_weak(refs, refs + 1));
+
+  if (s->sequence.load(boost::memory_order_acquire) != sequence || s->size < size)
+  {
+    release(slot_index);
+    return NULL;
+  }
+  return slotData(slot_index);
+}
+
+void ShmRing::release(uint32_t slot_index) const
+{
+  Slot* s = slot(slot_index);
+  s->refs.fetch_sub(1);
+  // Any of this process's entries will do, they are interchangeable
+  int32_t pid = getpid();
+  for (int r = 0; r < MAX_READERS; ++r)
+  {
+    int32_t mine = pid;
+    if (s->readers[r].compare_exchange_strong(mine, 0))
+      return;
+  }
+}
+
+bool ShmRing::read(uint32_t slot_index, uint64_t sequence, uint8_t* data, size_t size) const
+{
+  const uint8_t* source = acquire(slot_index, sequence, size);
+  if (!source)
+    return false;
+  std::memcpy(data, source, size);
+
+  // The writer only overwrites a referenced slot if it took this process for
+  // dead, which can happen across pid namespaces. It zeroes the sequence first.
+  boost::atomic_thread_fence(boost::memory_order_acquire);
+  bool intact = slot(slot_index)->sequence.load(boost::memory_order_relaxed) == sequence;
+  release(slot_index);
+  return intact;
+}
+
+} // namespace shm_image_transport
@@ -0,0 +1,80 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include "shm_image_transport/shm_subscriber.h"
+#include <boost/make_shared.hpp>
+
+namespace shm_image_transport {
+
+void ShmSubscriber::internalCallback(const shm_image_transport::ShmImageConstPtr& message,
+                                     const Callback& user_cb)
+{
+  // A respawned publisher can reuse a segment name, so the nonce tells them apart
+  if (!ring_ || ring_->name() != message->segment || ring_->nonce() != message->nonce)
+  {
+    ring_.reset();
+    try
+    {
+      ring_ = ShmRing::open(message->segment);
+    }
+    catch (boost::interprocess::interprocess_exception& e)
+    {
+      ROS_ERROR_THROTTLE(10, "Could not map shared memory segment '%s' of topic '%s'. The shm transport "
+                         "only works on the publisher's host. %s",
+                         message->segment.c_str(), getTopic().c_str(), e.what());
+      return;
+    }
+    // An image from before the segment was replaced
+    if (ring_->nonce() != message->nonce)
+      return;
+  }
+
+  sensor_msgs::ImagePtr image = boost::make_shared<sensor_msgs::Image>();
+  image->header       = message->header;
+  image->height       = message->height;
+  image->width        = message->width;
+  image->encoding     = message->encoding;
+  image->is_bigendian = message->is_bigendian;
+  image->step         = message->step;
+  size_t size = (size_t)message->step * message->height;
+  image->data.resize(size);
+  if (!ring_->read(message->slot, message->sequence, size ? &image->data[0] : NULL, size))
+  {
+    ROS_WARN_THROTTLE(10, "Image on topic '%s' was overwritten before it could be read. Raising the "
+                      "publisher's shm/num_slots parameter leaves more time.", getTopic().c_str());
+    return;
+  }
+  user_cb(image);
+}
+
+} // namespace shm_image_transport
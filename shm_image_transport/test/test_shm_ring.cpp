@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+#include <shm_image_transport/shm_ring.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using shm_image_transport::ShmRing;
+
+static std::string uniqueName(const std::string& test)
+{
+  std::ostringstream name;
+  name << "shm_image_transport_test_" << test << '_' << getpid();
+  return name.str();
+}
+
+TEST(ShmRing, readsBackWrites)
+{
+  boost::shared_ptr<ShmRing> writer = ShmRing::create(uniqueName("readsBackWrites"), 3, 1000);
+  boost::shared_ptr<ShmRing> reader = ShmRing::open(writer->name());
+  EXPECT_EQ(3u, reader->numSlots());
+  EXPECT_LE(1000u, reader->slotSize());
+
+  std::vector<uint8_t> image(1000), copy(1000);
+  for (size_t i = 0; i < image.size(); ++i)
+    image[i] = i * 7;
+  uint32_t slot;
+  uint64_t sequence;
+  ASSERT_TRUE(writer->write(&image[0], image.size(), slot, sequence));
+  ASSERT_TRUE(reader->read(slot, sequence, &copy[0], copy.size()));
+  EXPECT_TRUE(image == copy);
+
+  // Too large for the slots
+  image.resize(reader->slotSize() + 1);
+  EXPECT_FALSE(writer->write(&image[0], image.size(), slot, sequence));
+}
+
+TEST(ShmRing, detectsReusedSlots)
+{
+  boost::shared_ptr<ShmRing> writer = ShmRing::create(uniqueName("detectsReusedSlots"), 2, 16);
+  boost::shared_ptr<ShmRing> reader = ShmRing::open(writer->name());
+  uint8_t data[16] = {0};
+  uint32_t first_slot, slot;
+  uint64_t first_sequence, sequence;
+  ASSERT_TRUE(writer->write(data, 16, first_slot, first_sequence));
+  ASSERT_TRUE(writer->write(data, 16, slot, sequence));
+  EXPECT_NE(first_slot, slot);
+  EXPECT_TRUE(reader->read(first_slot, first_sequence, data, 16));
+
+  // The third write wraps around onto the first slot
+  ASSERT_TRUE(writer->write(data, 16, slot, sequence));
+  EXPECT_EQ(first_slot, slot);
+  EXPECT_FALSE(reader->read(first_slot, first_sequence, data, 16));
+  EXPECT_TRUE(reader->read(slot, sequence, data, 16));
+
+  // Handles out of range are rejected rather than read
+  EXPECT_FALSE(reader->read(2, sequence, data, 16));
+  EXPECT_FALSE(reader->read(slot, sequence, data, 17));
+}
+
+// Writes n frames and returns the slots they went to
+static std::vector<uint32_t> writeFrames(ShmRing& writer, int n)
+{
+  uint8_t data[16] = {0};
+  std::vector<uint32_t> slots;
+  for (int i = 0; i < n; ++i)
+  {
+    uint32_t slot;
+    uint64_t sequence;
+    if (writer.write(data, 16, slot, sequence))
+      slots.push_back(slot);
+  }
+  return slots;
+}
+
+TEST(ShmRing, readersKeepTheirSlot)
+{
+  boost::shared_ptr<ShmRing> writer = ShmRing::create(uniqueName("readersKeepTheirSlot"), 2, 16);
+  boost::shared_ptr<ShmRing> reader = ShmRing::open(writer->name());
+  uint8_t data[16] = {0};
+  uint32_t slot;
+  uint64_t sequence;
+  ASSERT_TRUE(writer->write(data, 16, slot, sequence));
+  ASSERT_TRUE(reader->acquire(slot, sequence, 16) != NULL);
+
+  std::vector<uint32_t> slots = writeFrames(*writer, 4);
+  ASSERT_EQ(4u, slots.size());
+  EXPECT_EQ(0, std::count(slots.begin(), slots.end(), slot));
+
+  reader->release(slot);
+  slots = writeFrames(*writer, 4);
+  EXPECT_EQ(2, std::count(slots.begin(), slots.end(), slot));
+}
+
+TEST(ShmRing, deadReadersReleaseTheirSlot)
+{
+  boost::shared_ptr<ShmRing> writer = ShmRing::create(uniqueName("deadReadersReleaseTheirSlot"), 2, 16);
+  uint8_t data[16] = {0};
+  uint32_t slot;
+  uint64_t sequence;
+  ASSERT_TRUE(writer->write(data, 16, slot, sequence));
+
+  // A subscriber killed while it holds a reference
+  pid_t child = fork();
+  ASSERT_NE(-1, child);
+  if (child == 0)
+  {
+    boost::shared_ptr<ShmRing> reader = ShmRing::open(writer->name());
+    _exit(reader->acquire(slot, sequence, 16) ? 0 : 1);
+  }
+  int status;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  std::vector<uint32_t> slots = writeFrames(*writer, 4);
+  ASSERT_EQ(4u, slots.size());
+  EXPECT_EQ(2, std::count(slots.begin(), slots.end(), slot));
+}
+
+TEST(ShmRing, removedWithWriter)
+{
+  std::string name = uniqueName("removedWithWriter");
+  ShmRing::create(name, 2, 16).reset();
+  EXPECT_THROW(ShmRing::open(name), boost::interprocess::interprocess_exception);
+}
+
+TEST(ShmRing, nonceTellsReusedNamesApart)
+{
+  std::string name = uniqueName("nonceTellsReusedNamesApart");
+  boost::shared_ptr<ShmRing> first = ShmRing::create(name, 2, 16);
+  boost::shared_ptr<ShmRing> reader = ShmRing::open(name);
+  EXPECT_EQ(first->nonce(), reader->nonce());
+
+  // As when a publisher is respawned with the same pid
+  first.reset();
+  boost::shared_ptr<ShmRing> second = ShmRing::create(name, 2, 16);
+  EXPECT_NE(reader->nonce(), second->nonce());
+  EXPECT_EQ(second->nonce(), ShmRing::open(name)->nonce());
+}
+
+TEST(ShmRing, failsWithoutEnoughSharedMemory)
+{
+  // Far more than /dev/shm holds, which must fail here rather than on first write
+  std::string name = uniqueName("failsWithoutEnoughSharedMemory");
+  EXPECT_THROW(ShmRing::create(name, 2, size_t(1) << 40), boost::interprocess::interprocess_exception);
+  EXPECT_THROW(ShmRing::open(name), boost::interprocess::interprocess_exception);
+}
+
+// Each frame is filled with the low byte of its sequence number, so a read
+// that overlapped a write would show up as a mix of values
+static void readUntilStopped(const std::string& name, const boost::atomic<bool>* stop,
+                             boost::atomic<uint64_t>* latest, boost::atomic<int>* torn)
+{
+  boost::shared_ptr<ShmRing> reader = ShmRing::open(name);
+  std::vector<uint8_t> frame(65536);
+  while (!stop->load())
+  {
+    uint64_t handle = latest->load();
+    if (handle == 0)
+      continue;
+    uint32_t slot = handle & 0xffff;
+    uint64_t sequence = handle >> 16;
+    if (!reader->read(slot, sequence, &frame[0], frame.size()))
+      continue;
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+      if (frame[i] != (uint8_t)sequence)
+      {
+        ++*torn;
+        break;
+      }
+    }
+  }
+}
+
+TEST(ShmRing, concurrentReadersSeeWholeFrames)
+{
+  boost::shared_ptr<ShmRing> writer = ShmRing::create(uniqueName("concurrent"), 2, 65536);
+  boost::atomic<bool> stop(false);
+  boost::atomic<uint64_t> latest(0);
+  boost::atomic<int> torn(0);
+  boost::thread_group readers;
+  for (int i = 0; i < 3; ++i)
+    readers.create_thread(boost::bind(&readUntilStopped, writer->name(), &stop, &latest, &torn));
+
+  std::vector<uint8_t> frame(65536);
+  int written = 0;
+  for (int i = 0; i < 20000; ++i)
+  {
+    // Sequence numbers only advance on successful writes
+    std::fill(frame.begin(), frame.end(), (uint8_t)(written + 1));
+    uint32_t slot;
+    uint64_t sequence;
+    if (!writer->write(&frame[0], frame.size(), slot, sequence))
+      continue;
+    ++written;
+    ASSERT_EQ((uint64_t)written, sequence);
+    latest = (sequence << 16) | slot;
+  }
+  stop = true;
+  readers.join_all();
+  EXPECT_EQ(0, torn.load());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
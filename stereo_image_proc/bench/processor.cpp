@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <stereo_image_proc/processor.h>
+#include <opencv2/core/core.hpp>
+
+// Arguments are (width, height) at VGA, 1080p and 4K
+static void sizeArgs(benchmark::internal::Benchmark* b)
+{
+  b->Args({640, 480})->Args({1920, 1080})->Args({3840, 2160});
+}
+
+// Rectified pair with a 12 cm baseline
+static image_geometry::StereoCameraModel makeModel(int width, int height)
+{
+  sensor_msgs::CameraInfo left, right;
+  left.width = width;
+  left.height = height;
+  double f = 0.8 * width;
+  double K[] = {f, 0, width / 2.0, 0, f, height / 2.0, 0, 0, 1};
+  std::copy(K, K + 9, left.K.begin());
+  double R[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(R, R + 9, left.R.begin());
+  double P[] = {f, 0, width / 2.0, 0, 0, f, height / 2.0, 0, 0, 0, 1, 0};
+  std::copy(P, P + 12, left.P.begin());
+  right = left;
+  right.P[3] = -f * 0.12;
+
+  image_geometry::StereoCameraModel model;
+  model.fromCameraInfo(left, right);
+  return model;
+}
+
+// Random texture, seen by the right camera shifted 16 pixels to the left
+static void makePair(int width, int height, cv::Mat& left, cv::Mat& right)
+{
+  left.create(height, width, CV_8UC1);
+  cv::randu(left, cv::Scalar::all(0), cv::Scalar::all(255));
+  right.create(height, width, CV_8UC1);
+  left.colRange(16, width).copyTo(right.colRange(0, width - 16));
+  left.colRange(0, 16).copyTo(right.colRange(width - 16, width));
+}
+
+static void BM_ProcessDisparity(benchmark::State& state)
+{
+  int width = state.range(0), height = state.range(1);
+  image_geometry::StereoCameraModel model = makeModel(width, height);
+  cv::Mat left, right;
+  makePair(width, height, left, right);
+
+  stereo_image_proc::StereoProcessor processor;
+  stereo_msgs::DisparityImage disparity;
+  while (state.KeepRunning())
+    processor.processDisparity(left, right, model, disparity);
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_ProcessDisparity)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_ProcessPoints2(benchmark::State& state)
+{
+  int width = state.range(0), height = state.range(1);
+  image_geometry::StereoCameraModel model = makeModel(width, height);
+  cv::Mat left, right;
+  makePair(width, height, left, right);
+
+  stereo_image_proc::StereoProcessor processor;
+  stereo_msgs::DisparityImage disparity;
+  processor.processDisparity(left, right, model, disparity);
+  sensor_msgs::PointCloud2 points;
+  while (state.KeepRunning())
+    processor.processPoints2(disparity, left, "mono8", model, points);
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_ProcessPoints2)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
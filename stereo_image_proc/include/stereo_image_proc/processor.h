@@ -167,7 +167,8 @@ public:
                       sensor_msgs::PointCloud2& points) const;
 
 private:
-  image_proc::Processor mono_processor_;
+  // One per camera, as each caches the rectification maps of its camera
+  image_proc::Processor left_processor_, right_processor_;
   
   mutable cv::Mat_<int16_t> disparity16_; // scratch buffer for 16-bit signed disparity image
 
@@ -191,12 +192,13 @@ private:
 
 inline int StereoProcessor::getInterpolation() const
 {
-  return mono_processor_.interpolation_;
+  return left_processor_.interpolation_;
 }
 
 inline void StereoProcessor::setInterpolation(int interp)
 {
-  mono_processor_.interpolation_ = interp;
+  left_processor_.interpolation_ = interp;
+  right_processor_.interpolation_ = interp;
 }
 
 inline int StereoProcessor::getPreFilterSize() const
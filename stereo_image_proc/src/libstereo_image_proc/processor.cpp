@@ -69,9 +69,9 @@ bool StereoProcessor::process(const sensor_msgs::ImageConstPtr& left_raw,
     // Need the color channels for the point cloud
     left_flags |= LEFT_RECT_COLOR;
   }
-  if (!mono_processor_.process(left_raw, model.left(), output.left, left_flags))
+  if (!left_processor_.process(left_raw, model.left(), output.left, left_flags))
     return false;
-  if (!mono_processor_.process(right_raw, model.right(), output.right, right_flags >> 4))
+  if (!right_processor_.process(right_raw, model.right(), output.right, right_flags >> 4))
     return false;
 
   // Do block matching to produce the disparity image
@@ -98,8 +98,8 @@ void StereoProcessor::processDisparity(const cv::Mat& left_rect, const cv::Mat&
 {
   // Fixed-point disparity is 16 times the true value: d = d_fp / 16.0 = x_l - x_r.
 
-  static int DPP = 0;
-  static double inv_dpp = 0;
+  int DPP = 0;
+  double inv_dpp = 0;
 
   // Block matcher produces 16-bit signed (fixed point) disparity image
 #if OPENCV3
@@ -56,6 +56,10 @@
 #include <stereo_image_proc/DisparityConfig.h>
 #include <dynamic_reconfigure/server.h>
 
+#include <image_proc/batch_scheduler.h>
+#include <image_proc/config_snapshot.h>
+#include <image_proc/latency_monitor.h>
+
 #include <stereo_image_proc/processor.h>
 
 namespace stereo_image_proc {
@@ -88,9 +92,21 @@ class DisparityNodelet : public nodelet::Nodelet
   typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
   boost::shared_ptr<ReconfigureServer> reconfigure_server_;
   
-  // Processing state (note: only safe because we're single-threaded!)
-  image_geometry::StereoCameraModel model_;
-  stereo_image_proc::StereoProcessor block_matcher_; // contains scratch buffers for block matching
+  image_proc::ConfigSnapshot<Config> config_;
+
+  // Processing state, one per frame in flight
+  struct Worker
+  {
+    image_geometry::StereoCameraModel model;
+    stereo_image_proc::StereoProcessor block_matcher; // contains scratch buffers for block matching
+    // The config block_matcher was last set up with. Each change is a new
+    // snapshot, so comparing pointers tells whether to update.
+    boost::shared_ptr<const Config> config;
+  };
+  std::vector< boost::shared_ptr<Worker> > workers_;
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
+  // Processes frames concurrently and publishes them in order, if ~concurrent_frames > 1
+  boost::shared_ptr<image_proc::BatchScheduler> scheduler_;
 
   virtual void onInit();
 
@@ -99,6 +115,13 @@ class DisparityNodelet : public nodelet::Nodelet
   void imageCb(const ImageConstPtr& l_image_msg, const CameraInfoConstPtr& l_info_msg,
                const ImageConstPtr& r_image_msg, const CameraInfoConstPtr& r_info_msg);
 
+  void process(int worker_index,
+               const ImageConstPtr& l_image_msg, const CameraInfoConstPtr& l_info_msg,
+               const ImageConstPtr& r_image_msg, const CameraInfoConstPtr& r_info_msg,
+               const DisparityImagePtr& disp_msg);
+
+  void publish(const DisparityImagePtr& disp_msg, image_proc::LatencyMonitor::Clock::time_point start);
+
   void configCb(Config &config, uint32_t level);
 };
 
@@ -115,6 +138,22 @@ void DisparityNodelet::onInit()
   private_nh.param("queue_size", queue_size, 5);
   bool approx;
   private_nh.param("approximate_sync", approx, false);
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
+
+  // Optionally block match several frames at once, for when one takes longer than the frame period
+  int concurrent_frames;
+  private_nh.param("concurrent_frames", concurrent_frames, 1);
+#if CUDA_GPU
+  if (concurrent_frames > 1)
+  {
+    NODELET_WARN("concurrent_frames is not supported with the GPU block matcher, using 1");
+    concurrent_frames = 1;
+  }
+#endif
+  for (int i = 0; i < std::max(concurrent_frames, 1); ++i)
+    workers_.push_back(boost::make_shared<Worker>());
+  if (concurrent_frames > 1)
+    scheduler_.reset(new image_proc::BatchScheduler(concurrent_frames, concurrent_frames));
   if (approx)
   {
     approximate_sync_.reset( new ApproximateSync(ApproximatePolicy(queue_size),
@@ -174,18 +213,72 @@ void DisparityNodelet::imageCb(const ImageConstPtr& l_image_msg,
                                const ImageConstPtr& r_image_msg,
                                const CameraInfoConstPtr& r_info_msg)
 {
+  DisparityImagePtr disp_msg = boost::make_shared<DisparityImage>();
+  if (!scheduler_)
+  {
+    image_proc::LatencyMonitor::Scope scope(monitor_.get(), l_image_msg->header);
+    process(0, l_image_msg, l_info_msg, r_image_msg, r_info_msg, disp_msg);
+    if (!disp_msg->image.data.empty())
+      pub_disparity_.publish(disp_msg);
+    return;
+  }
+
+  // Frames are published in the order they arrive here, which blocks while all workers are busy
+  image_proc::LatencyMonitor::Clock::time_point start;
+  if (monitor_)
+    start = monitor_->begin(l_image_msg->header);
+  scheduler_->submit(boost::bind(&DisparityNodelet::process, this, _1,
+                                 l_image_msg, l_info_msg, r_image_msg, r_info_msg, disp_msg),
+                     boost::bind(&DisparityNodelet::publish, this, disp_msg, start));
+}
+
+void DisparityNodelet::process(int worker_index,
+                               const ImageConstPtr& l_image_msg, const CameraInfoConstPtr& l_info_msg,
+                               const ImageConstPtr& r_image_msg, const CameraInfoConstPtr& r_info_msg,
+                               const DisparityImagePtr& disp_msg)
+{
+  Worker& worker = *workers_[worker_index];
+  stereo_image_proc::StereoProcessor& block_matcher = worker.block_matcher;
+  boost::shared_ptr<const Config> config = config_.get();
+  if (worker.config != config)
+  {
+    block_matcher.setPreFilterSize(config->prefilter_size);
+    block_matcher.setPreFilterCap(config->prefilter_cap);
+    block_matcher.setCorrelationWindowSize(config->correlation_window_size);
+    block_matcher.setMinDisparity(config->min_disparity);
+    block_matcher.setDisparityRange(config->disparity_range);
+    block_matcher.setUniquenessRatio(config->uniqueness_ratio);
+    block_matcher.setTextureThreshold(config->texture_threshold);
+    block_matcher.setSpeckleSize(config->speckle_size);
+    block_matcher.setSpeckleRange(config->speckle_range);
+    worker.config = config;
+  }
+
+  // Create cv::Mat views onto all buffers. This may run on the scheduler's threads, which must
+  // not throw, so a frame that can't be converted is left empty and not published.
+  cv::Mat_<uint8_t> l_image, r_image;
+  try
+  {
+    l_image = cv_bridge::toCvShare(l_image_msg, sensor_msgs::image_encodings::MONO8)->image;
+    r_image = cv_bridge::toCvShare(r_image_msg, sensor_msgs::image_encodings::MONO8)->image;
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    NODELET_ERROR_THROTTLE(10, "Unable to convert stereo images to mono8: %s", e.what());
+    return;
+  }
+
   // Update the camera model
-  model_.fromCameraInfo(l_info_msg, r_info_msg);
+  worker.model.fromCameraInfo(l_info_msg, r_info_msg);
 
-  // Allocate new disparity image message
-  DisparityImagePtr disp_msg = boost::make_shared<DisparityImage>();
+  // Fill in the disparity image message
   disp_msg->header         = l_info_msg->header;
   disp_msg->image.header   = l_info_msg->header;
 
   // Compute window of (potentially) valid disparities
-  int border   = block_matcher_.getCorrelationWindowSize() / 2;
-  int left   = block_matcher_.getDisparityRange() + block_matcher_.getMinDisparity() + border - 1;
-  int wtf = (block_matcher_.getMinDisparity() >= 0) ? border + block_matcher_.getMinDisparity() : std::max(border, -block_matcher_.getMinDisparity());
+  int border   = block_matcher.getCorrelationWindowSize() / 2;
+  int left   = block_matcher.getDisparityRange() + block_matcher.getMinDisparity() + border - 1;
+  int wtf = (block_matcher.getMinDisparity() >= 0) ? border + block_matcher.getMinDisparity() : std::max(border, -block_matcher.getMinDisparity());
   int right  = disp_msg->image.width - 1 - wtf;
   int top    = border;
   int bottom = disp_msg->image.height - 1 - border;
@@ -194,24 +287,30 @@ void DisparityNodelet::imageCb(const ImageConstPtr& l_image_msg,
   disp_msg->valid_window.width    = right - left;
   disp_msg->valid_window.height   = bottom - top;
 
-  // Create cv::Mat views onto all buffers
-  const cv::Mat_<uint8_t> l_image = cv_bridge::toCvShare(l_image_msg, sensor_msgs::image_encodings::MONO8)->image;
-  const cv::Mat_<uint8_t> r_image = cv_bridge::toCvShare(r_image_msg, sensor_msgs::image_encodings::MONO8)->image;
-
   // Perform block matching to find the disparities
-  block_matcher_.processDisparity(l_image, r_image, model_, *disp_msg);
+  block_matcher.processDisparity(l_image, r_image, worker.model, *disp_msg);
 
   // Adjust for any x-offset between the principal points: d' = d - (cx_l - cx_r)
-  double cx_l = model_.left().cx();
-  double cx_r = model_.right().cx();
+  double cx_l = worker.model.left().cx();
+  double cx_r = worker.model.right().cx();
   if (cx_l != cx_r) {
     cv::Mat_<float> disp_image(disp_msg->image.height, disp_msg->image.width,
                               reinterpret_cast<float*>(&disp_msg->image.data[0]),
                               disp_msg->image.step);
     cv::subtract(disp_image, cv::Scalar(cx_l - cx_r), disp_image);
   }
+}
+
+void DisparityNodelet::publish(const DisparityImagePtr& disp_msg,
+                               image_proc::LatencyMonitor::Clock::time_point start)
+{
+  // Left empty by process() if the frame couldn't be converted
+  if (disp_msg->image.data.empty())
+    return;
 
   pub_disparity_.publish(disp_msg);
+  if (monitor_)
+    monitor_->end(start, disp_msg->header.stamp);
 }
 
 void DisparityNodelet::configCb(Config &config, uint32_t level)
@@ -221,17 +320,8 @@ void DisparityNodelet::configCb(Config &config, uint32_t level)
   config.correlation_window_size |= 0x1; // must be odd
   config.disparity_range = (config.disparity_range / 16) * 16; // must be multiple of 16
 
-  // Note: With single-threaded NodeHandle, configCb and imageCb can't be called
-  // concurrently, so this is thread-safe.
-  block_matcher_.setPreFilterSize(config.prefilter_size);
-  block_matcher_.setPreFilterCap(config.prefilter_cap);
-  block_matcher_.setCorrelationWindowSize(config.correlation_window_size);
-  block_matcher_.setMinDisparity(config.min_disparity);
-  block_matcher_.setDisparityRange(config.disparity_range);
-  block_matcher_.setUniquenessRatio(config.uniqueness_ratio);
-  block_matcher_.setTextureThreshold(config.texture_threshold);
-  block_matcher_.setSpeckleSize(config.speckle_size);
-  block_matcher_.setSpeckleRange(config.speckle_range);
+  // Workers pick up the new settings before their next frame
+  config_.set(config);
 }
 
 } // namespace stereo_image_proc
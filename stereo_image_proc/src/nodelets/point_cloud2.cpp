@@ -51,6 +51,8 @@
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 
+#include <image_proc/latency_monitor.h>
+
 namespace stereo_image_proc {
 
 using namespace sensor_msgs;
@@ -79,6 +81,7 @@ class PointCloud2Nodelet : public nodelet::Nodelet
   // Processing state (note: only safe because we're single-threaded!)
   image_geometry::StereoCameraModel model_;
   cv::Mat_<cv::Vec3f> points_mat_; // scratch buffer
+  boost::shared_ptr<image_proc::LatencyMonitor> monitor_;
   
   virtual void onInit();
 
@@ -102,6 +105,7 @@ void PointCloud2Nodelet::onInit()
   private_nh.param("queue_size", queue_size, 5);
   bool approx;
   private_nh.param("approximate_sync", approx, false);
+  monitor_ = image_proc::LatencyMonitor::create(nh, private_nh, getName());
   if (approx)
   {
     approximate_sync_.reset( new ApproximateSync(ApproximatePolicy(queue_size),
@@ -161,6 +165,8 @@ void PointCloud2Nodelet::imageCb(const ImageConstPtr& l_image_msg,
                                  const CameraInfoConstPtr& r_info_msg,
                                  const DisparityImageConstPtr& disp_msg)
 {
+  image_proc::LatencyMonitor::Scope scope(monitor_.get(), l_image_msg->header);
+
   // Update the camera model
   model_.fromCameraInfo(l_info_msg, r_info_msg);
 
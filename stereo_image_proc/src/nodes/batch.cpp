@@ -0,0 +1,328 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <stereo_image_proc/processor.h>
+#include <image_proc/batch_scheduler.h>
+#include <cv_bridge/cv_bridge.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <map>
+
+namespace enc = sensor_msgs::image_encodings;
+namespace po = boost::program_options;
+using stereo_image_proc::StereoProcessor;
+
+// Output names and the StereoProcessor flags that produce them
+static const char* PRODUCTS[] = {"left/image_rect", "left/image_rect_color", "right/image_rect",
+                                 "right/image_rect_color", "disparity", "points2"};
+static const int PRODUCT_FLAGS[] = {StereoProcessor::LEFT_RECT, StereoProcessor::LEFT_RECT_COLOR,
+                                    StereoProcessor::RIGHT_RECT, StereoProcessor::RIGHT_RECT_COLOR,
+                                    StereoProcessor::DISPARITY, StereoProcessor::POINT_CLOUD2};
+static const int NUM_PRODUCTS = 6;
+static const int NUM_IMAGES = 4; // the first products are images
+
+struct StereoFrame
+{
+  sensor_msgs::ImageConstPtr raw[2];
+  sensor_msgs::CameraInfoConstPtr info[2];
+  ros::Time time; // recording time of the left image
+  bool ok;
+
+  sensor_msgs::ImagePtr images[NUM_IMAGES];
+  stereo_image_proc::StereoImageSet output;
+};
+typedef boost::shared_ptr<StereoFrame> StereoFramePtr;
+
+// Everything one thread needs to process frames independently of the others
+struct Worker
+{
+  StereoProcessor processor;
+  image_geometry::StereoCameraModel model;
+};
+
+/**
+ * Runs StereoProcessor over pairs of frames on every core and writes the
+ * results to a bag in input order.
+ */
+class StereoBatch
+{
+public:
+  StereoBatch(const std::string& output, const std::string& camera, int flags, int threads)
+    : flags_(flags), camera_(camera), frames_(0), failed_(0), bag_(output, rosbag::bagmode::Write),
+      scheduler_(threads, 4 * threads)
+  {
+    for (int i = 0; i < scheduler_.size(); ++i)
+      workers_.push_back(boost::make_shared<Worker>());
+  }
+
+  void add(const StereoFramePtr& frame)
+  {
+    scheduler_.submit(boost::bind(&StereoBatch::process, this, frame, _1),
+                      boost::bind(&StereoBatch::write, this, frame));
+  }
+
+  void finish()
+  {
+    scheduler_.wait();
+    bag_.close();
+  }
+
+  int frames() const { return frames_; }
+  int failed() const { return failed_; }
+
+private:
+  void process(const StereoFramePtr& frame, int worker_index)
+  {
+    // An exception here would end the whole run, so a bad frame only counts as failed
+    try
+    {
+      processFrame(frame, *workers_[worker_index]);
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "\nFailed to process frame at " << frame->time << ": " << e.what() << std::endl;
+      frame->ok = false;
+    }
+  }
+
+  void processFrame(const StereoFramePtr& frame, Worker& worker)
+  {
+    worker.model.fromCameraInfo(frame->info[0], frame->info[1]);
+    frame->ok = worker.processor.process(frame->raw[0], frame->raw[1], worker.model, frame->output, flags_);
+    if (!frame->ok)
+      return;
+
+    const image_proc::ImageSet* sides[2] = {&frame->output.left, &frame->output.right};
+    for (int i = 0; i < NUM_IMAGES; ++i)
+    {
+      if (!(flags_ & PRODUCT_FLAGS[i]))
+        continue;
+      const image_proc::ImageSet& side = *sides[i / 2];
+      const cv::Mat& image = (i % 2 == 0) ? side.rect : side.rect_color;
+      std::string encoding = (i % 2 == 0) ? std::string(enc::MONO8) : side.color_encoding;
+      frame->images[i] = cv_bridge::CvImage(frame->raw[i / 2]->header, encoding, image).toImageMsg();
+    }
+
+    stereo_msgs::DisparityImage& disparity = frame->output.disparity;
+    disparity.header = disparity.image.header = frame->info[0]->header;
+    // Adjust for any x-offset between the principal points: d' = d - (cx_l - cx_r)
+    double cx_l = worker.model.left().cx();
+    double cx_r = worker.model.right().cx();
+    if ((flags_ & StereoProcessor::DISPARITY) && cx_l != cx_r)
+    {
+      cv::Mat_<float> disp_image(disparity.image.height, disparity.image.width,
+                                 reinterpret_cast<float*>(&disparity.image.data[0]), disparity.image.step);
+      cv::subtract(disp_image, cv::Scalar(cx_l - cx_r), disp_image);
+    }
+    frame->output.points2.header = disparity.header;
+
+    // Only the outputs are needed from here on
+    frame->raw[0].reset();
+    frame->raw[1].reset();
+    frame->output.left = frame->output.right = image_proc::ImageSet();
+  }
+
+  void write(const StereoFramePtr& frame)
+  {
+    if (!frame->ok)
+    {
+      ++failed_;
+      return;
+    }
+
+    for (int i = 0; i < NUM_IMAGES; ++i)
+      if (frame->images[i])
+        bag_.write(camera_ + "/" + PRODUCTS[i], frame->time, *frame->images[i]);
+    if (flags_ & StereoProcessor::DISPARITY)
+      bag_.write(camera_ + "/disparity", frame->time, frame->output.disparity);
+    if (flags_ & StereoProcessor::POINT_CLOUD2)
+      bag_.write(camera_ + "/points2", frame->time, frame->output.points2);
+    bag_.write(camera_ + "/left/camera_info", frame->time, *frame->info[0]);
+    bag_.write(camera_ + "/right/camera_info", frame->time, *frame->info[1]);
+
+    if (++frames_ % 100 == 0)
+      std::cerr << "\r" << frames_ << " frames" << std::flush;
+  }
+
+  int flags_;
+  std::string camera_;
+  int frames_, failed_;
+  rosbag::Bag bag_;
+  std::vector< boost::shared_ptr<Worker> > workers_;
+  image_proc::BatchScheduler scheduler_; // last, so it finishes before the rest is destroyed
+};
+
+// Pairs up left and right images with the same stamp, using the latest camera infos
+static int readBag(const std::string& file, const std::string& camera, StereoBatch& batch)
+{
+  std::vector<std::string> topics;
+  topics.push_back(camera + "/left/image_raw");
+  topics.push_back(camera + "/right/image_raw");
+  topics.push_back(camera + "/left/camera_info");
+  topics.push_back(camera + "/right/camera_info");
+
+  rosbag::Bag bag(file, rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+  sensor_msgs::CameraInfoConstPtr infos[2];
+  std::map<ros::Time, StereoFramePtr> pending;
+  int skipped = 0;
+  BOOST_FOREACH(const rosbag::MessageInstance& m, view)
+  {
+    int side = (m.getTopic() == topics[0] || m.getTopic() == topics[2]) ? 0 : 1;
+    if (m.getTopic() == topics[2] || m.getTopic() == topics[3])
+    {
+      infos[side] = m.instantiate<sensor_msgs::CameraInfo>();
+      continue;
+    }
+
+    sensor_msgs::ImageConstPtr image = m.instantiate<sensor_msgs::Image>();
+    if (!image)
+      continue;
+    StereoFramePtr& frame = pending[image->header.stamp];
+    if (!frame)
+    {
+      frame = boost::make_shared<StereoFrame>();
+      frame->time = m.getTime();
+    }
+    frame->raw[side] = image;
+    if (!frame->raw[0] || !frame->raw[1])
+      continue;
+
+    // Complete pair, anything older never will be
+    ros::Time stamp = image->header.stamp;
+    for (std::map<ros::Time, StereoFramePtr>::iterator it = pending.begin(); it->first < stamp; )
+    {
+      ++skipped;
+      pending.erase(it++);
+    }
+    if (infos[0] && infos[1])
+    {
+      frame->info[0] = infos[0];
+      frame->info[1] = infos[1];
+      batch.add(frame);
+    }
+    else
+      ++skipped; // recorded before the first camera infos
+    pending.erase(stamp);
+  }
+  return skipped + pending.size();
+}
+
+int main(int argc, char** argv)
+{
+  po::options_description options(
+    "Runs stereo processing on recorded image pairs as fast as the CPU allows, without a ROS master.\n"
+    "Reads left/image_raw, right/image_raw and their camera_info under the camera namespace of a bag,\n"
+    "and writes the products in input order to another bag.\n\nOptions");
+  options.add_options()
+    ("help,h", "print this message")
+    ("bag", po::value<std::string>(), "input bag")
+    ("camera", po::value<std::string>()->default_value("/stereo"), "stereo camera namespace in the bags")
+    ("output-bag", po::value<std::string>(), "output bag")
+    ("products", po::value<std::string>()->default_value("disparity,points2"),
+     "comma-separated outputs to produce, from left/image_rect, left/image_rect_color, right/image_rect, "
+     "right/image_rect_color, disparity and points2")
+    ("threads,j", po::value<int>()->default_value(std::max(1u, boost::thread::hardware_concurrency())),
+     "number of threads");
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    po::notify(vm);
+  }
+  catch (const po::error& e)
+  {
+    std::cerr << e.what() << "\n\n" << options << std::endl;
+    return 1;
+  }
+  if (vm.count("help") || !vm.count("bag") || !vm.count("output-bag"))
+  {
+    std::cerr << "Need --bag and --output-bag\n\n" << options << std::endl;
+    return vm.count("help") ? 0 : 1;
+  }
+
+  int flags = 0;
+  std::vector<std::string> products;
+  boost::split(products, vm["products"].as<std::string>(), boost::is_any_of(","));
+  BOOST_FOREACH(const std::string& product, products)
+  {
+    const char** found = std::find(PRODUCTS, PRODUCTS + NUM_PRODUCTS, product);
+    if (found == PRODUCTS + NUM_PRODUCTS)
+    {
+      std::cerr << "Unknown product " << product << std::endl;
+      return 1;
+    }
+    flags |= PRODUCT_FLAGS[found - PRODUCTS];
+  }
+
+  int threads = vm["threads"].as<int>();
+#if CUDA_GPU
+  // The GPU block matcher is shared by all StereoProcessors
+  threads = 1;
+#endif
+
+  try
+  {
+    std::string camera = vm["camera"].as<std::string>();
+    if (boost::algorithm::ends_with(camera, "/"))
+      camera.erase(camera.size() - 1);
+
+    boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    StereoBatch batch(vm["output-bag"].as<std::string>(), camera, flags, threads);
+    int skipped = readBag(vm["bag"].as<std::string>(), camera, batch);
+    batch.finish();
+
+    double seconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+    std::cerr << "\r" << batch.frames() << " frames in " << seconds << " s, " << batch.frames() / seconds
+              << " frames/s";
+    if (batch.failed() || skipped)
+      std::cerr << ", " << batch.failed() << " failed, " << skipped << " skipped";
+    std::cerr << std::endl;
+    return batch.failed() ? 1 : 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}